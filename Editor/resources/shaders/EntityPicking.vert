@@ -1,7 +1,9 @@
 #version 450
 
+// The position is in the mesh's quantization box, which the model matrix
+// maps back
 layout (location = 0) in vec3 inPosition;
-layout (location = 1) in vec3 inNormal;
+layout (location = 1) in vec2 inNormal; // Octahedral encoded
 layout (location = 2) in vec2 inTexCoord; // Needed for compatibility reasons
 
 layout(location = 3) in mat4 inModel;
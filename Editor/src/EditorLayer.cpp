@@ -707,6 +707,35 @@ void EditorLayer::on_imgui_render() {
                     m_project->set_vsync(vsync);
                     app.get_renderer().recreate_swapchain_next_frame(vsync);
                 }
+
+                // Compare the render paths on the same scenes
+                const char* render_paths[] = {"Forward", "Deferred"};
+                const bool deferred = proj_settings.deferred_rendering;
+                if (ImGui::BeginCombo("Render path",
+                                      render_paths[deferred ? 1 : 0])) {
+                    for (int i = 0; i < 2; i++) {
+                        if (ImGui::Selectable(render_paths[i],
+                                              deferred == (i == 1))) {
+                            m_project->set_deferred_rendering(i == 1);
+                            app.get_renderer().set_render_path(
+                                i == 1 ? RenderPath::Deferred
+                                       : RenderPath::Forward);
+                        }
+                    }
+                    ImGui::EndCombo();
+                }
+
+                bool depth_prepass = proj_settings.depth_prepass;
+                if (ImGui::Checkbox("Depth pre-pass", &depth_prepass)) {
+                    m_project->set_depth_prepass(depth_prepass);
+                    app.get_renderer().set_depth_prepass(depth_prepass);
+                }
+
+                bool gpu_driven = proj_settings.gpu_driven_rendering;
+                if (ImGui::Checkbox("GPU culling", &gpu_driven)) {
+                    m_project->set_gpu_driven_rendering(gpu_driven);
+                    app.get_renderer().set_gpu_driven_rendering(gpu_driven);
+                }
             }
             ImGui::End();
 
@@ -882,16 +911,26 @@ void EditorLayer::update_entity_picking() {
             // First we prepare the data
             for (auto [entity, transform_component, mesh_component] :
                  view.each()) {
+                // The positions are in the mesh's quantization box, the
+                // model matrix maps them back to mesh space first
+                const VertexQuantization& quantization =
+                    mesh_component.mesh->get_vertex_quantization();
+                glm::mat4 model =
+                    glm::scale(glm::translate(
+                                   transform_component.to_transform().ToMat4(),
+                                   quantization.offset),
+                               glm::vec3(quantization.scale));
                 m_entity_picking_shader_data.push_back(
-                    {.model = transform_component.to_transform().ToMat4(),
+                    {.model = model,
                      .entity_id = static_cast<uint32_t>(entity)});
             }
 
-            // Then copy the data
-            m_entity_picking_buffers[app.get_current_frame()]->insert_memory(
-                m_entity_picking_shader_data.data(),
-                sizeof(EntityPickingShaderData) *
-                    m_entity_picking_shader_data.size());
+            // Then write the data to the renderer's instance buffer
+            TransientAllocation picking_instances =
+                renderer.get_instance_buffer().allocate(
+                    m_entity_picking_shader_data.data(),
+                    sizeof(EntityPickingShaderData) *
+                        m_entity_picking_shader_data.size());
 
             // Transition the entity picking image
             VulkanUtils::transition_image_layout(
@@ -931,18 +970,18 @@ void EditorLayer::update_entity_picking() {
             for (auto [entity, transform_component, mesh_component] :
                  view.each()) {
                 VkBuffer buffers[2] = {
-                    mesh_component.mesh->get_vertex_buffer()->get_vk_buffer(),
-                    m_entity_picking_buffers[app.get_current_frame()]
-                        ->get_vk_buffer()};
-                VkDeviceSize offsets[2] = {0, offset};
+                    mesh_component.mesh->get_vk_vertex_buffer(),
+                    picking_instances.buffer};
+                VkDeviceSize offsets[2] = {0,
+                                           picking_instances.offset + offset};
                 vkCmdBindVertexBuffers(
                     renderer.get_current_command_buffer()->get_command_buffer(),
                     0, 2, buffers, offsets);
 
                 vkCmdBindIndexBuffer(
                     renderer.get_current_command_buffer()->get_command_buffer(),
-                    mesh_component.mesh->get_index_buffer()->get_vk_buffer(), 0,
-                    VK_INDEX_TYPE_UINT32);
+                    mesh_component.mesh->get_vk_index_buffer(), 0,
+                    mesh_component.mesh->get_index_type());
 
                 VkDescriptorSet sets[] = {
                     m_scene_camera_descriptor_sets[app.get_current_frame()]
@@ -957,8 +996,9 @@ void EditorLayer::update_entity_picking() {
 
                 vkCmdDrawIndexed(
                     renderer.get_current_command_buffer()->get_command_buffer(),
-                    mesh_component.mesh->get_index_buffer()->get_index_count(),
-                    1, 0, 0, 0);
+                    mesh_component.mesh->get_index_count(), 1,
+                    mesh_component.mesh->get_first_index(),
+                    mesh_component.mesh->get_vertex_offset(), 0);
 
                 offset += sizeof(EntityPickingShaderData);
             }
@@ -1216,14 +1256,10 @@ void EditorLayer::setup_entity_picking() {
 
     create_or_recreate_picking_images();
 
-    m_entity_picking_buffers.resize(max_frames_in_flight);
     m_scene_camera_uniform_buffers.resize(max_frames_in_flight);
     m_scene_camera_descriptor_sets.resize(max_frames_in_flight);
 
     for (size_t i = 0; i < max_frames_in_flight; i++) {
-        m_entity_picking_buffers[i] = VertexBuffer::create(
-            nullptr, sizeof(EntityPickingShaderData) * k_max_meshes);
-
         m_scene_camera_uniform_buffers[i] =
             Buffer::create(sizeof(CameraUniformBuffer),
                            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
@@ -1536,6 +1572,9 @@ bool EditorLayer::new_project(const std::filesystem::path& project_path) {
         Application::get().set_asset_base_path(
             m_project.value().get_project_path());
         m_assets_browser.set_project(&m_project.value());
+        // Before the scene creates its material pipelines
+        Application::get().get_vulkan_manager()->get_pipeline_cache().load(
+            m_project->get_pipeline_cache_path());
 
         if (m_project.value().get_settings().default_scene) {
             new_scene({.reset_window_title = false});
@@ -1550,6 +1589,14 @@ bool EditorLayer::new_project(const std::filesystem::path& project_path) {
 
         Application::get().set_fixed_update_rate(
             m_project->get_settings().fixed_update_rate);
+        Application::get().get_renderer().set_render_path(
+            m_project->get_settings().deferred_rendering
+                ? RenderPath::Deferred
+                : RenderPath::Forward);
+        Application::get().get_renderer().set_depth_prepass(
+            m_project->get_settings().depth_prepass);
+        Application::get().get_renderer().set_gpu_driven_rendering(
+            m_project->get_settings().gpu_driven_rendering);
 
         return true;
     }
@@ -123,8 +123,6 @@ class EditorLayer : public Helios::Layer {
 
     // Entity picking //
     std::unique_ptr<Helios::Pipeline> m_entity_picking_pipeline;
-    std::vector<Helios::SharedPtr<Helios::VertexBuffer>>
-        m_entity_picking_buffers;
     // Maybe use multi-buffering for these as well?
     std::vector<EntityPickingShaderData> m_entity_picking_shader_data;
     std::vector<Helios::SharedPtr<Helios::Image>>
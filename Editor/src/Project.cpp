@@ -15,6 +15,9 @@ Project::Project(const std::filesystem::path& project_path)
                                         .default_scene = "scenes/main.scene",
                                         .fixed_update_rate = 1.0f / 50,
                                         .vsync = true,
+                                        .deferred_rendering = false,
+                                        .depth_prepass = false,
+                                        .gpu_driven_rendering = false,
                                         .instancing_settings =
                                             {
                                                 .min_instances_for_mt = 100,
@@ -45,6 +48,12 @@ void Project::save() {
     out << YAML::Key << "fixed_update_rate" << YAML::Value
         << m_settings.fixed_update_rate;
     out << YAML::Key << "vsync" << YAML::Value << m_settings.vsync;
+    out << YAML::Key << "deferred_rendering" << YAML::Value
+        << m_settings.deferred_rendering;
+    out << YAML::Key << "depth_prepass" << YAML::Value
+        << m_settings.depth_prepass;
+    out << YAML::Key << "gpu_driven_rendering" << YAML::Value
+        << m_settings.gpu_driven_rendering;
 
     {
         out << YAML::Key << "instancing" << YAML::Value << YAML::BeginMap;
@@ -110,6 +119,22 @@ void Project::load_project() {
             m_settings.vsync = vsync.as<bool>();
         }
 
+        auto deferred_rendering = data["deferred_rendering"];
+        if (!deferred_rendering.IsNull() && deferred_rendering.IsScalar()) {
+            m_settings.deferred_rendering = deferred_rendering.as<bool>();
+        }
+
+        auto depth_prepass = data["depth_prepass"];
+        if (!depth_prepass.IsNull() && depth_prepass.IsScalar()) {
+            m_settings.depth_prepass = depth_prepass.as<bool>();
+        }
+
+        auto gpu_driven_rendering = data["gpu_driven_rendering"];
+        if (!gpu_driven_rendering.IsNull() &&
+            gpu_driven_rendering.IsScalar()) {
+            m_settings.gpu_driven_rendering = gpu_driven_rendering.as<bool>();
+        }
+
         auto instancing = data["instancing"];
         if (!instancing.IsNull() && instancing.IsMap()) {
             auto min_instances_for_mt = instancing["min_instances_for_mt"];
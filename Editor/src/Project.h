@@ -13,6 +13,12 @@ struct ProjectSettings {
     std::optional<std::string> default_scene;
     float fixed_update_rate;
     bool vsync;
+    // Light the meshes with the deferred path instead of forward
+    bool deferred_rendering;
+    // Draw the depth before lighting the meshes (forward only)
+    bool depth_prepass;
+    // Cull the mesh instances on the GPU, and draw them indirectly
+    bool gpu_driven_rendering;
     InstancingSettings instancing_settings;
 };
 
@@ -25,6 +31,10 @@ class Project {
     const std::filesystem::path& get_project_path() const {
         return m_project_path;
     }
+    // The compiled pipelines of this project, for this machine only
+    std::filesystem::path get_pipeline_cache_path() const {
+        return m_project_path / "cache" / "pipelines.bin";
+    }
 
     void save();
 
@@ -37,6 +47,15 @@ class Project {
         m_settings.fixed_update_rate = rate;
     }
     void set_vsync(bool vsync) { m_settings.vsync = vsync; }
+    void set_deferred_rendering(bool deferred) {
+        m_settings.deferred_rendering = deferred;
+    }
+    void set_depth_prepass(bool enabled) {
+        m_settings.depth_prepass = enabled;
+    }
+    void set_gpu_driven_rendering(bool enabled) {
+        m_settings.gpu_driven_rendering = enabled;
+    }
     void set_instancing_settings(const InstancingSettings& new_settings) {
         m_settings.instancing_settings = new_settings;
     }
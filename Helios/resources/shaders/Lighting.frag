@@ -1,6 +1,9 @@
 #version 450
 #extension GL_EXT_nonuniform_qualifier : require
 
+// The atomics don't make the depth test run late
+layout(early_fragment_tests) in;
+
 layout (location = 0) out vec4 out_color;
 
 struct DirLight {
@@ -21,8 +24,6 @@ struct PointLight {
 };
 
 #define MAX_DIR_LIGHTS 32
-#define MAX_POINT_LIGHTS 32
-#define MAX_TEXTURES 32
 
 layout(location = 0) in VertexInput {
     vec2 frag_tex_coord;
@@ -35,23 +36,61 @@ layout(location = 0) in VertexInput {
     vec4 tint_color;
     vec3 view_pos;
 } v_in;
+layout(location = 9) flat in uint v_sampler_indices; // 4 bits per texture
 
 layout(set = 1, binding = 0) uniform sampler u_samp;
-layout(set = 1, binding = 1) uniform texture2D u_textures[MAX_TEXTURES];
+// Bindless, sized at runtime by the renderer (up to k_max_textures)
+layout(set = 1, binding = 1) uniform texture2D u_textures[];
+// The sampler states the materials use, k_max_samplers
+layout(set = 1, binding = 2) uniform sampler u_samplers[16];
+// The slot of each texture index, with the first mip level its image holds
+// in the upper 16 bits (streamed textures)
+layout(set = 1, binding = 3) readonly buffer TextureSlots {
+    uint entries[];
+} b_texture_slots;
+// The finest mip level each texture index is sampled at, read back by the
+// texture streamer
+layout(set = 1, binding = 4) buffer TextureFeedback {
+    uint levels[];
+} b_texture_feedback;
 
 layout(set = 2, binding = 0) uniform DirectionalLights {
     DirLight lights[MAX_DIR_LIGHTS];
 } u_directional_lights;
 
-layout(set = 2, binding = 1) uniform PointLights {
-    PointLight lights[MAX_POINT_LIGHTS];
-} u_point_lights;
+layout(set = 2, binding = 1) readonly buffer PointLights {
+    PointLight lights[];
+} b_point_lights;
+
+// Matches cluster_lights.comp and deferred_lighting.frag
+layout(set = 2, binding = 2) uniform ClusterInfo {
+    mat4 view;
+    mat4 projection;
+    mat4 inverse_projection;
+    mat4 inverse_view;
+    uvec4 grid_size; // xyz: the clusters per axis, w: max lights per cluster
+    float z_near;
+    float z_far;
+    uint point_light_count;
+} u_clusters;
+
+// For each cluster, its light count followed by the light indices
+layout(set = 2, binding = 3) readonly buffer ClusterLights {
+    uint data[];
+} b_clusters;
 
 layout(push_constant) uniform LightCount {
     int directional;
     int point;
+    int clustered; // If the point lights were binned into the clusters
 } u_light_count;
 
+// Set by the renderer for the lights of the frame, so the loops can be
+// unrolled or removed. -1 reads the count from the push constants.
+layout(constant_id = 0) const int k_directional_light_count = -1;
+// False if the frame has no point lights
+layout(constant_id = 1) const bool k_point_lights = true;
+
 vec3 linearize_srgb(vec3 srgb_color) {
     return mix(srgb_color / 12.92, pow((srgb_color + vec3(0.055)) / 1.055, vec3(2.4)), step(vec3(0.04045), srgb_color));
 }
@@ -99,20 +138,63 @@ vec3 calc_point_light(PointLight light, vec3 diffuse_texture, vec3 specular_text
     return ambient + diffuse + specular;
 }
 
+uint find_cluster(vec3 frag_pos) {
+    uvec3 grid = u_clusters.grid_size.xyz;
+
+    vec4 view_pos = u_clusters.view * vec4(frag_pos, 1.0);
+    vec4 clip_pos = u_clusters.projection * view_pos;
+    vec2 tile = clamp((clip_pos.xy / clip_pos.w * 0.5 + 0.5) * vec2(grid.xy),
+                      vec2(0.0), vec2(grid.xy) - 1.0);
+
+    // The depth slices are exponentially spaced between the near and far
+    // planes
+    float depth = max(-view_pos.z, u_clusters.z_near);
+    float slice = log(depth / u_clusters.z_near) /
+                  log(u_clusters.z_far / u_clusters.z_near) * float(grid.z);
+    slice = clamp(slice, 0.0, float(grid.z) - 1.0);
+
+    return (uint(slice) * grid.y + uint(tile.y)) * grid.x + uint(tile.x);
+}
+
+// The level is reported from 1 pixel in 64, which is plenty, and keeps the
+// atomics few. It's computed by every pixel, the derivatives need them all.
+vec4 sample_texture(int texture_index, uint sampler_index, vec2 tex_coord) {
+    uint entry = b_texture_slots.entries[texture_index];
+    uint slot = entry & 0xFFFFu;
+    float lod = textureQueryLod(sampler2D(u_textures[nonuniformEXT(slot)], u_samplers[nonuniformEXT(sampler_index)]), tex_coord).y;
+    if (((uint(gl_FragCoord.x) | uint(gl_FragCoord.y)) & 7u) == 0u) {
+        int level = max(int(entry >> 16) + int(floor(lod)), 0);
+        atomicMin(b_texture_feedback.levels[texture_index], uint(level));
+    }
+    return texture(sampler2D(u_textures[nonuniformEXT(slot)], u_samplers[nonuniformEXT(sampler_index)]), tex_coord);
+}
+
 void main() {
     vec3 view_dir = normalize(v_in.view_pos - v_in.frag_pos);
 
-    vec3 diffuse_texture = vec3(texture(sampler2D(u_textures[nonuniformEXT(v_in.diffuse_index)], u_samp), v_in.frag_tex_coord));
-    vec3 specular_texture = vec3(texture(sampler2D(u_textures[nonuniformEXT(v_in.specular_index)], u_samp), v_in.frag_tex_coord));
+    uint diffuse_sampler = v_sampler_indices & 0xFu;
+    uint specular_sampler = (v_sampler_indices >> 4) & 0xFu;
+    vec3 diffuse_texture = vec3(sample_texture(v_in.diffuse_index, diffuse_sampler, v_in.frag_tex_coord));
+    vec3 specular_texture = vec3(sample_texture(v_in.specular_index, specular_sampler, v_in.frag_tex_coord));
 
     vec3 result = vec3(0.0);
 
-    for (int i = 0; i < u_light_count.directional; i++) {
+    int directional_count = k_directional_light_count >= 0 ? k_directional_light_count : u_light_count.directional;
+    for (int i = 0; i < directional_count; i++) {
         result += calc_dir_light(u_directional_lights.lights[i], diffuse_texture, specular_texture, v_in.normal, view_dir);
     }
 
-    for (int i = 0; i < u_light_count.point; i++) {
-        result += calc_point_light(u_point_lights.lights[i], diffuse_texture, specular_texture, v_in.normal, v_in.frag_pos, view_dir);
+    if (k_point_lights && u_light_count.clustered != 0) {
+        uint base = find_cluster(v_in.frag_pos) * (u_clusters.grid_size.w + 1);
+        uint count = b_clusters.data[base];
+        for (uint i = 0; i < count; i++) {
+            uint light = b_clusters.data[base + 1 + i];
+            result += calc_point_light(b_point_lights.lights[light], diffuse_texture, specular_texture, v_in.normal, v_in.frag_pos, view_dir);
+        }
+    } else if (k_point_lights) {
+        for (int i = 0; i < u_light_count.point; i++) {
+            result += calc_point_light(b_point_lights.lights[i], diffuse_texture, specular_texture, v_in.normal, v_in.frag_pos, view_dir);
+        }
     }
 
     out_color = delinearize_srgb(vec4(result, 1.0)) * v_in.tint_color;
@@ -1,19 +1,19 @@
 #version 450
 
-// Per-vertex data
+// Per-vertex data, see PackedMeshVertex. The position is in the mesh's
+// quantization box, which the model matrix maps back.
 layout(location = 0) in vec3 iv_position;
-layout(location = 1) in vec3 iv_normal;
+layout(location = 1) in vec2 iv_normal; // Octahedral encoded
 layout(location = 2) in vec2 iv_tex_coord;
 
-// Per-instance data
-layout(location = 3) in mat4 ii_model;
-
-layout(location = 7) in int ii_diffuse_index;
-layout(location = 8) in int ii_specular_index;
-layout(location = 9) in int ii_emission_index;
-layout(location = 10) in float ii_shininess;
-
-layout(location = 11) in vec4 ii_tint_color;
+// Per-instance data, see MeshRenderingShaderInstanceData. The model matrix is
+// built from the position, rotation and scale.
+layout(location = 3) in vec3 ii_position;
+layout(location = 4) in float ii_shininess;
+layout(location = 5) in vec3 ii_scale;
+layout(location = 6) in vec4 ii_tint_color;
+layout(location = 7) in vec4 ii_rotation; // Quaternion, xyzw
+layout(location = 8) in uvec4 ii_texture_indices; // Diffuse, specular, emission, their samplers
 
 layout(set = 0, binding = 0) uniform CameraUniform {
     mat4 perspective_view_proj;
@@ -35,19 +35,41 @@ layout(location = 0) out VertexInput {
     vec4 tint_color;
     vec3 view_pos;
 } v_out;
+// Outside the block, so custom fragment shaders don't have to declare it.
+// The sampler indices of the textures, 4 bits each.
+layout(location = 9) flat out uint v_sampler_indices;
+
+// The depth pre-pass computes the same position, so the depths are equal
+invariant gl_Position;
+
+// Rotate a vector by a unit quaternion
+vec3 rotate(vec4 q, vec3 v) {
+    vec3 t = 2.0 * cross(q.xyz, v);
+    return v + q.w * t + cross(q.xyz, t);
+}
+
+vec3 decode_octahedral(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0);
+    normal.x += normal.x >= 0.0 ? -fold : fold;
+    normal.y += normal.y >= 0.0 ? -fold : fold;
+    return normalize(normal);
+}
 
 void main() {
-    gl_Position = u_camera.perspective_view_proj * ii_model * vec4(iv_position, 1.0);
+    vec4 rotation = normalize(ii_rotation);
+    vec3 world_pos = ii_position + rotate(rotation, ii_scale * iv_position);
+    gl_Position = u_camera.perspective_view_proj * vec4(world_pos, 1.0);
     v_out.frag_tex_coord = iv_tex_coord;
-    v_out.frag_pos = vec3(ii_model * vec4(iv_position, 1.0));
+    v_out.frag_pos = world_pos;
 
-    // Get rotation/scale part of the model matrix
-    mat3 normal_matrix = mat3(ii_model);
-    v_out.normal = normalize(normal_matrix * iv_normal);
+    // The inverse transpose of the rotation and scale
+    v_out.normal = normalize(rotate(rotation, decode_octahedral(iv_normal) / ii_scale));
 
-    v_out.diffuse_index = ii_diffuse_index;
-    v_out.specular_index = ii_specular_index;
-    v_out.emission_index = ii_emission_index;
+    v_out.diffuse_index = int(ii_texture_indices.x);
+    v_out.specular_index = int(ii_texture_indices.y);
+    v_out.emission_index = int(ii_texture_indices.z);
+    v_sampler_indices = ii_texture_indices.w;
     v_out.shininess = ii_shininess;
     v_out.tint_color = ii_tint_color;
     v_out.view_pos = u_camera.perspective_pos;
@@ -0,0 +1,168 @@
+#version 450
+
+// Shades every pixel of the G-buffer written by gbuffer.frag once, with the
+// same lighting as Lighting.frag. The pixels without any geometry are
+// discarded, so what was drawn before (e.g. the skybox) is kept.
+
+layout(location = 0) in vec2 v_uv;
+
+layout(location = 0) out vec4 out_color;
+
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+    float constant;
+    float linear;
+    float quadratic;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+#define MAX_DIR_LIGHTS 32
+
+// The G-buffer can be larger than the view, so it's read per texel
+layout(set = 0, binding = 0) uniform sampler2D u_albedo;
+layout(set = 0, binding = 1) uniform sampler2D u_normal;
+layout(set = 0, binding = 2) uniform sampler2D u_material;
+layout(set = 0, binding = 3) uniform sampler2D u_depth;
+
+layout(set = 1, binding = 0) uniform DirectionalLights {
+    DirLight lights[MAX_DIR_LIGHTS];
+} u_directional_lights;
+
+layout(set = 1, binding = 1) readonly buffer PointLights {
+    PointLight lights[];
+} b_point_lights;
+
+// Matches cluster_lights.comp and Lighting.frag
+layout(set = 1, binding = 2) uniform ClusterInfo {
+    mat4 view;
+    mat4 projection;
+    mat4 inverse_projection;
+    mat4 inverse_view;
+    uvec4 grid_size; // xyz: the clusters per axis, w: max lights per cluster
+    float z_near;
+    float z_far;
+    uint point_light_count;
+} u_clusters;
+
+// For each cluster, its light count followed by the light indices
+layout(set = 1, binding = 3) readonly buffer ClusterLights {
+    uint data[];
+} b_clusters;
+
+layout(push_constant) uniform LightCount {
+    int directional;
+    int point;
+    int clustered; // If the point lights were binned into the clusters
+} u_light_count;
+
+vec3 delinearize_srgb(vec3 linear_color) {
+    return mix(12.92 * linear_color, 1.055 * pow(linear_color, vec3(1.0 / 2.4)) - vec3(0.055), step(vec3(0.0031308), linear_color));
+}
+
+vec3 decode_octahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+vec3 calc_dir_light(DirLight light, vec3 diffuse_texture, vec3 specular_texture, float shininess, vec3 normal, vec3 view_dir) {
+    vec3 light_dir = normalize(-light.direction);
+
+    float diff = max(dot(normal, light_dir), 0.0);
+    vec3 reflect_dir = reflect(-light_dir, normal);
+    float spec = pow(max(dot(view_dir, reflect_dir), 0.0), shininess);
+
+    vec3 ambient = light.ambient * diffuse_texture;
+    vec3 diffuse = light.diffuse * diff * diffuse_texture;
+    vec3 specular = light.specular * spec * specular_texture;
+
+    return ambient + diffuse + specular;
+}
+
+vec3 calc_point_light(PointLight light, vec3 diffuse_texture, vec3 specular_texture, float shininess, vec3 normal, vec3 frag_pos, vec3 view_dir) {
+    vec3 light_dir = normalize(light.position - frag_pos);
+
+    float diff = max(dot(normal, light_dir), 0.0);
+    vec3 reflect_dir = reflect(-light_dir, normal);
+    float spec = pow(max(dot(view_dir, reflect_dir), 0.0), shininess);
+
+    float distance = length(light.position - frag_pos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+    vec3 ambient = light.ambient * diffuse_texture * attenuation;
+    vec3 diffuse = light.diffuse * diff * diffuse_texture * attenuation;
+    vec3 specular = light.specular * spec * specular_texture * attenuation;
+
+    return ambient + diffuse + specular;
+}
+
+uint find_cluster(vec3 view_pos) {
+    uvec3 grid = u_clusters.grid_size.xyz;
+
+    vec2 tile = clamp(v_uv * vec2(grid.xy), vec2(0.0), vec2(grid.xy) - 1.0);
+
+    // The depth slices are exponentially spaced between the near and far
+    // planes
+    float depth = max(-view_pos.z, u_clusters.z_near);
+    float slice = log(depth / u_clusters.z_near) /
+                  log(u_clusters.z_far / u_clusters.z_near) * float(grid.z);
+    slice = clamp(slice, 0.0, float(grid.z) - 1.0);
+
+    return (uint(slice) * grid.y + uint(tile.y)) * grid.x + uint(tile.x);
+}
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(u_depth, texel, 0).r;
+    if (depth <= 0.0) {
+        discard;
+    }
+
+    vec4 albedo = texelFetch(u_albedo, texel, 0);
+    vec4 material = texelFetch(u_material, texel, 0);
+    vec3 normal = decode_octahedral(texelFetch(u_normal, texel, 0).rg);
+
+    // Rebuild the position from the ray through the pixel
+    vec4 near_point = u_clusters.inverse_projection * vec4(v_uv * 2.0 - 1.0, 0.0, 1.0);
+    vec3 view_pos = near_point.xyz / near_point.w;
+    view_pos *= depth / -view_pos.z;
+    vec3 frag_pos = vec3(u_clusters.inverse_view * vec4(view_pos, 1.0));
+    vec3 camera_pos = vec3(u_clusters.inverse_view[3]);
+    vec3 view_dir = normalize(camera_pos - frag_pos);
+
+    vec3 diffuse_texture = albedo.rgb;
+    vec3 specular_texture = vec3(albedo.a);
+    float shininess = material.a;
+
+    vec3 result = vec3(0.0);
+
+    for (int i = 0; i < u_light_count.directional; i++) {
+        result += calc_dir_light(u_directional_lights.lights[i], diffuse_texture, specular_texture, shininess, normal, view_dir);
+    }
+
+    if (u_light_count.clustered != 0) {
+        uint base = find_cluster(view_pos) * (u_clusters.grid_size.w + 1);
+        uint count = b_clusters.data[base];
+        for (uint i = 0; i < count; i++) {
+            uint light = b_clusters.data[base + 1 + i];
+            result += calc_point_light(b_point_lights.lights[light], diffuse_texture, specular_texture, shininess, normal, frag_pos, view_dir);
+        }
+    } else {
+        for (int i = 0; i < u_light_count.point; i++) {
+            result += calc_point_light(b_point_lights.lights[i], diffuse_texture, specular_texture, shininess, normal, frag_pos, view_dir);
+        }
+    }
+
+    out_color = vec4(delinearize_srgb(result) * material.rgb, 1.0);
+}
@@ -0,0 +1,36 @@
+#version 450
+
+// Writes only the depth of the meshes drawn with the default pipeline, so the
+// lighting pass shades just the visible fragments.
+
+// Per-vertex data
+layout(location = 0) in vec3 iv_position;
+
+// Per-instance data, see Lighting.vert
+layout(location = 3) in vec3 ii_position;
+layout(location = 5) in vec3 ii_scale;
+layout(location = 7) in vec4 ii_rotation;
+
+layout(set = 0, binding = 0) uniform CameraUniform {
+    mat4 perspective_view_proj;
+    mat4 perspective_proj;
+    mat4 perspective_view_no_translation;
+    vec3 perspective_pos;
+
+    mat4 orthographic_proj;
+} u_camera;
+
+// Lighting.vert computes the same position, so the depths are equal
+invariant gl_Position;
+
+// Rotate a vector by a unit quaternion
+vec3 rotate(vec4 q, vec3 v) {
+    vec3 t = 2.0 * cross(q.xyz, v);
+    return v + q.w * t + cross(q.xyz, t);
+}
+
+void main() {
+    vec4 rotation = normalize(ii_rotation);
+    vec3 world_pos = ii_position + rotate(rotation, ii_scale * iv_position);
+    gl_Position = u_camera.perspective_view_proj * vec4(world_pos, 1.0);
+}
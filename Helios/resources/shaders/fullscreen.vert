@@ -0,0 +1,11 @@
+#version 450
+
+// A single triangle covering the viewport, without any vertex buffers. Draw it
+// with 3 vertices.
+
+layout(location = 0) out vec2 v_uv; // 0 to 1 over the viewport
+
+void main() {
+    v_uv = vec2(gl_VertexIndex & 2, (gl_VertexIndex << 1) & 2);
+    gl_Position = vec4(v_uv * 2.0 - 1.0, 0.0, 1.0);
+}
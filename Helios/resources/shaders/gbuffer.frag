@@ -0,0 +1,78 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// The atomics don't make the depth test run late
+layout(early_fragment_tests) in;
+
+// Writes the surface attributes of the meshes drawn with the default pipeline
+// into the G-buffer, which deferred_lighting.frag then shades once per pixel.
+
+layout(location = 0) out vec4 out_albedo;   // rgb: diffuse, a: specular
+layout(location = 1) out vec2 out_normal;   // Octahedral encoded
+layout(location = 2) out vec4 out_material; // rgb: tint, a: shininess
+layout(location = 3) out float out_depth;   // Linear view depth, 0 is empty
+
+layout(location = 0) in VertexInput {
+    vec2 frag_tex_coord;
+    vec3 frag_pos;
+    vec3 normal;
+    flat int diffuse_index;
+    flat int specular_index;
+    flat int emission_index;
+    flat float shininess;
+    vec4 tint_color;
+    vec3 view_pos;
+} v_in;
+layout(location = 9) flat in uint v_sampler_indices; // 4 bits per texture
+
+layout(set = 1, binding = 0) uniform sampler u_samp;
+// Bindless, sized at runtime by the renderer (up to k_max_textures)
+layout(set = 1, binding = 1) uniform texture2D u_textures[];
+// The sampler states the materials use, k_max_samplers
+layout(set = 1, binding = 2) uniform sampler u_samplers[16];
+// The slot of each texture index, with the first mip level its image holds
+// in the upper 16 bits (streamed textures)
+layout(set = 1, binding = 3) readonly buffer TextureSlots {
+    uint entries[];
+} b_texture_slots;
+// The finest mip level each texture index is sampled at, read back by the
+// texture streamer
+layout(set = 1, binding = 4) buffer TextureFeedback {
+    uint levels[];
+} b_texture_feedback;
+
+// The level is reported from 1 pixel in 64, which is plenty, and keeps the
+// atomics few. It's computed by every pixel, the derivatives need them all.
+vec4 sample_texture(int texture_index, uint sampler_index, vec2 tex_coord) {
+    uint entry = b_texture_slots.entries[texture_index];
+    uint slot = entry & 0xFFFFu;
+    float lod = textureQueryLod(sampler2D(u_textures[nonuniformEXT(slot)], u_samplers[nonuniformEXT(sampler_index)]), tex_coord).y;
+    if (((uint(gl_FragCoord.x) | uint(gl_FragCoord.y)) & 7u) == 0u) {
+        int level = max(int(entry >> 16) + int(floor(lod)), 0);
+        atomicMin(b_texture_feedback.levels[texture_index], uint(level));
+    }
+    return texture(sampler2D(u_textures[nonuniformEXT(slot)], u_samplers[nonuniformEXT(sampler_index)]), tex_coord);
+}
+
+vec2 encode_octahedral(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0.0) {
+        vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * signs;
+    }
+    return n.xy;
+}
+
+void main() {
+    uint diffuse_sampler = v_sampler_indices & 0xFu;
+    uint specular_sampler = (v_sampler_indices >> 4) & 0xFu;
+    vec3 diffuse_texture = vec3(sample_texture(v_in.diffuse_index, diffuse_sampler, v_in.frag_tex_coord));
+    vec3 specular_texture = vec3(sample_texture(v_in.specular_index, specular_sampler, v_in.frag_tex_coord));
+
+    // The specular maps are grey scale, so a single channel is kept
+    out_albedo = vec4(diffuse_texture, max(specular_texture.r, max(specular_texture.g, specular_texture.b)));
+    out_normal = encode_octahedral(normalize(v_in.normal));
+    out_material = vec4(v_in.tint_color.rgb, v_in.shininess);
+    // The projection puts the view depth in w
+    out_depth = 1.0 / gl_FragCoord.w;
+}
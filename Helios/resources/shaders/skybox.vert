@@ -16,5 +16,6 @@ layout(set = 1, binding = 0) uniform CameraUniform {
 void main() 
 {
   v_tex_coords = iv_position;
-	gl_Position = u_camera.perspective_proj * u_camera.perspective_view_no_translation * vec4(iv_position, 1.0);
+	// Put it on the far plane, so it's only drawn where no mesh is
+	gl_Position = (u_camera.perspective_proj * u_camera.perspective_view_no_translation * vec4(iv_position, 1.0)).xyww;
 }
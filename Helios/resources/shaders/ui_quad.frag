@@ -10,10 +10,15 @@ layout(location = 0) in VertexInput {
 } v_in;
 
 layout(set = 0, binding = 0) uniform sampler u_samp;
-layout (set = 0, binding = 1) uniform texture2D u_textures[1000];
+layout (set = 0, binding = 1) uniform texture2D u_textures[];
+// The slot of each texture index, in the lower 16 bits
+layout(set = 0, binding = 3) readonly buffer TextureSlots {
+    uint entries[];
+} b_texture_slots;
 
 void main()
 {
-    vec4 tex_color = texture(sampler2D(u_textures[nonuniformEXT(v_in.texture_index)], u_samp), v_in.tex_coord);
+    uint slot = b_texture_slots.entries[v_in.texture_index] & 0xFFFFu;
+    vec4 tex_color = texture(sampler2D(u_textures[nonuniformEXT(slot)], u_samp), v_in.tex_coord);
     out_color = v_in.tint_color * vec4(tex_color.r, tex_color.r, tex_color.r, 1.0);
 } 
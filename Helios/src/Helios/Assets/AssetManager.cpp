@@ -69,14 +69,8 @@ std::vector<uint32_t> quad_indices = {
 namespace Helios {
 void AssetManager::init() {
     /* Create meshes */
-    add_mesh(Mesh::create(
-        "Cube", cube_vertices.data(), sizeof(MeshVertex) * cube_vertices.size(),
-        cube_indices.data(), sizeof(uint32_t) * cube_indices.size(),
-        cube_indices.size()));
-    add_mesh(Mesh::create(
-        "Quad", quad_vertices.data(), sizeof(MeshVertex) * quad_vertices.size(),
-        quad_indices.data(), sizeof(uint32_t) * quad_indices.size(),
-        quad_indices.size()));
+    add_mesh(Mesh::create("Cube", cube_vertices, cube_indices));
+    add_mesh(Mesh::create("Quad", quad_vertices, quad_indices));
 
     add_texture(Texture::create(
         {
@@ -6,6 +6,10 @@
 #include "SharedPtr.h"
 
 namespace Helios {
+// The initial size of the geometry pool (in vertices and indices)
+constexpr uint32_t k_initial_pool_vertex_capacity = 1 << 16;
+constexpr uint32_t k_initial_pool_index_capacity = 1 << 18;
+
 #define BIND_EVENT_FN(x) std::bind(&Application::x, this, std::placeholders::_1)
 
 Application* Application::s_instance = nullptr;
@@ -22,10 +26,18 @@ Application::Application(const ApplicationInfo& info)
     m_window->set_event_callback_fn(BIND_EVENT_FN(on_event));
     m_window->set_title("Helios");
 
+    m_job_system = JobSystem::create_unique(info.job_system);
+
     m_vulkan_manager.init();
+    m_upload_manager =
+        UploadManager::create_unique(m_vulkan_manager.get_context());
+    m_texture_streamer = TextureStreamer::create_unique(info.texture_streaming);
+    m_geometry_pool = GeometryPool::create_unique(
+        m_max_frames_in_flight, k_initial_pool_vertex_capacity,
+        k_initial_pool_index_capacity);
     m_asset_manager.init();
     m_renderer.init(m_max_frames_in_flight);
-    m_physics_manager.init();
+    m_physics_manager.init(*m_job_system);
 
     m_imgui_layer = new ImGuiLayer();
     push_overlay(m_imgui_layer);
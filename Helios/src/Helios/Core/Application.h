@@ -4,9 +4,13 @@
 #include <memory>
 
 #include "Helios/Assets/AssetManager.h"
+#include "Helios/Core/JobSystem.h"
 #include "Helios/ImGui/ImGuiLayer.h"
 #include "Helios/Physics/PhysicsManager.h"
+#include "Helios/Renderer/GeometryPool.h"
 #include "Helios/Renderer/Renderer.h"
+#include "Helios/Renderer/TextureStreamer.h"
+#include "Helios/Renderer/UploadManager.h"
 #include "Helios/Vulkan/VulkanManager.h"
 #include "LayerStack.h"
 #include "Window.h"
@@ -14,6 +18,8 @@
 namespace Helios {
 struct ApplicationInfo {
     uint32_t max_frames_in_flight = 2;
+    JobSystemSpecification job_system = {};
+    TextureStreamerSpecification texture_streaming = {};
 };
 
 class Application {
@@ -29,6 +35,10 @@ class Application {
 
     VulkanManager* get_vulkan_manager() { return &m_vulkan_manager; }
     AssetManager& get_asset_manager() { return m_asset_manager; }
+    JobSystem& get_job_system() { return *m_job_system; }
+    GeometryPool& get_geometry_pool() { return *m_geometry_pool; }
+    UploadManager& get_upload_manager() { return *m_upload_manager; }
+    TextureStreamer& get_texture_streamer() { return *m_texture_streamer; }
     Physics::PhysicsManager& get_physics_manager() { return m_physics_manager; }
 
     Renderer& get_renderer() { return m_renderer; }
@@ -57,6 +67,11 @@ class Application {
 
   private:
     VulkanManager m_vulkan_manager; // Destroy the vulkan context last
+    std::unique_ptr<JobSystem> m_job_system; // Outlives its users
+    std::unique_ptr<GeometryPool> m_geometry_pool; // Outlives the meshes
+    std::unique_ptr<UploadManager> m_upload_manager; // Outlives the assets
+    // Outlives the textures
+    std::unique_ptr<TextureStreamer> m_texture_streamer;
     AssetManager m_asset_manager;
     Physics::PhysicsManager m_physics_manager;
 
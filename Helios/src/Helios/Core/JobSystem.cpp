@@ -0,0 +1,277 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+#include "Log.h"
+
+#ifdef _LINUX
+#include <pthread.h>
+#elif _WINDOWS
+#include <windows.h>
+#endif
+
+namespace Helios {
+namespace {
+// The job system the calling thread is a worker of, and its index
+thread_local const JobSystem* t_job_system = nullptr;
+thread_local uint32_t t_worker_index = 0;
+} // namespace
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard lock(m_sleep_mutex);
+        m_running = false;
+    }
+    m_wake_condition.notify_all();
+
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::submit(JobFunction function, JobCounter* counter) {
+    push(*m_queues[get_queue_index()], std::move(function), counter);
+}
+
+void JobSystem::submit_background(JobFunction function, JobCounter* counter) {
+    push(m_background_queue, std::move(function), counter);
+}
+
+void JobSystem::wait(const JobCounter& counter) {
+    const uint32_t queue_index = get_queue_index();
+    while (!counter.is_done()) {
+        if (!try_run_job(queue_index, &counter)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool JobSystem::is_worker_thread() const { return t_job_system == this; }
+
+void JobSystem::push(JobQueue& queue, JobFunction function,
+                     JobCounter* counter) {
+    if (counter) {
+        counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard lock(queue.mutex);
+        queue.jobs.push_back({std::move(function), counter});
+    }
+
+    m_queued_jobs.fetch_add(1);
+    if (m_sleeping_workers.load() > 0) {
+        // Taking the lock makes sure a worker that is about to sleep either
+        // sees the job, or is already waiting on the condition
+        { std::lock_guard lock(m_sleep_mutex); }
+        m_wake_condition.notify_one();
+    }
+}
+
+void JobSystem::init(const JobSystemSpecification& spec) {
+    uint32_t worker_count = spec.worker_count;
+    if (worker_count == 0) {
+        worker_count =
+            std::max<uint32_t>(std::thread::hardware_concurrency(), 2) - 1;
+    }
+
+    m_queues.resize(worker_count + 1);
+    for (auto& queue : m_queues) {
+        queue = std::make_unique<JobQueue>();
+    }
+
+    m_running = true;
+    m_workers.reserve(worker_count);
+    for (uint32_t i = 0; i < worker_count; i++) {
+        m_workers.emplace_back(&JobSystem::worker_main, this, i);
+
+        if (spec.pin_workers) {
+            pin_thread(m_workers.back(), i < spec.worker_cores.size()
+                                             ? spec.worker_cores[i]
+                                             : i + 1);
+        }
+    }
+}
+
+void JobSystem::worker_main(uint32_t index) {
+    t_job_system = this;
+    t_worker_index = index;
+
+    while (true) {
+        if (try_run_job(index, nullptr)) {
+            continue;
+        }
+
+        std::unique_lock lock(m_sleep_mutex);
+        m_sleeping_workers.fetch_add(1);
+        m_wake_condition.wait(lock, [this] {
+            return m_queued_jobs.load() > 0 || !m_running;
+        });
+        m_sleeping_workers.fetch_sub(1);
+
+        if (!m_running) {
+            return;
+        }
+    }
+}
+
+uint32_t JobSystem::get_queue_index() const {
+    return is_worker_thread() ? t_worker_index : m_queues.size() - 1;
+}
+
+bool JobSystem::try_pop(uint32_t queue_index, const JobCounter* waited,
+                        Job& job) {
+    const uint32_t queue_count = m_queues.size();
+    const bool is_worker_queue = queue_index != queue_count - 1;
+
+    // Start with the own queue, newest job first since its data is most
+    // likely still in the cache
+    {
+        JobQueue& queue = *m_queues[queue_index];
+        std::lock_guard lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            if (is_worker_queue) {
+                job = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+            } else {
+                job = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+            }
+            return true;
+        }
+    }
+
+    // Then steal the oldest job of another queue
+    for (uint32_t i = 1; i < queue_count; i++) {
+        JobQueue& queue = *m_queues[(queue_index + i) % queue_count];
+        std::lock_guard lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            return true;
+        }
+    }
+
+    // Last, the background jobs, which a waiting thread only runs if it
+    // waits on them
+    std::lock_guard lock(m_background_queue.mutex);
+    auto& jobs = m_background_queue.jobs;
+    auto it = waited == nullptr
+                  ? jobs.begin()
+                  : std::find_if(jobs.begin(), jobs.end(),
+                                 [waited](const Job& background_job) {
+                                     return background_job.counter == waited;
+                                 });
+    if (it == jobs.end()) {
+        return false;
+    }
+    job = std::move(*it);
+    jobs.erase(it);
+    return true;
+}
+
+bool JobSystem::try_run_job(uint32_t queue_index,
+                            const JobCounter* waited) {
+    if (m_queued_jobs.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+
+    Job job;
+    if (!try_pop(queue_index, waited, job)) {
+        return false;
+    }
+    m_queued_jobs.fetch_sub(1);
+
+    execute(job);
+    return true;
+}
+
+void JobSystem::execute(Job& job) {
+    job.function();
+
+    if (job.counter) {
+        job.counter->m_pending.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void JobSystem::pin_thread([[maybe_unused]] std::thread& thread,
+                           uint32_t core) {
+    if (core >= std::thread::hardware_concurrency()) {
+        HL_WARN("[JobSystem] Can't pin a worker to core {}, there are only {} "
+                "cores.",
+                core, std::thread::hardware_concurrency());
+        return;
+    }
+
+#ifdef _LINUX
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(core, &cpu_set);
+    if (pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set),
+                               &cpu_set) != 0) {
+        HL_WARN("[JobSystem] Failed to pin a worker to core {}.", core);
+    }
+#elif _WINDOWS
+    if (SetThreadAffinityMask(thread.native_handle(),
+                              static_cast<DWORD_PTR>(1) << core) == 0) {
+        HL_WARN("[JobSystem] Failed to pin a worker to core {}.", core);
+    }
+#endif
+}
+
+TaskGraph::TaskId TaskGraph::add_task(JobSystem::JobFunction function) {
+    m_tasks.push_back({.function = std::move(function),
+                       .successors = {},
+                       .dependency_count = 0});
+    return m_tasks.size() - 1;
+}
+
+void TaskGraph::add_dependency(TaskId before, TaskId after) {
+    m_tasks[before].successors.push_back(after);
+    m_tasks[after].dependency_count++;
+}
+
+void TaskGraph::run(JobSystem& job_system) {
+    if (m_tasks.empty()) {
+        return;
+    }
+
+    m_remaining_dependencies =
+        std::make_unique<std::atomic<uint32_t>[]>(m_tasks.size());
+    for (size_t i = 0; i < m_tasks.size(); i++) {
+        m_remaining_dependencies[i] = m_tasks[i].dependency_count;
+    }
+    m_executed_tasks = 0;
+
+    JobCounter counter;
+    for (size_t i = 0; i < m_tasks.size(); i++) {
+        if (m_tasks[i].dependency_count == 0) {
+            submit_task(job_system, i, counter);
+        }
+    }
+    job_system.wait(counter);
+
+    if (m_executed_tasks != m_tasks.size()) {
+        HL_ERROR("[TaskGraph] Only {} of {} tasks ran, the graph has a cycle.",
+                 m_executed_tasks.load(), m_tasks.size());
+    }
+}
+
+void TaskGraph::submit_task(JobSystem& job_system, TaskId id,
+                            JobCounter& counter) {
+    // The successors are submitted before this job is counted as done, so the
+    // counter can't reach zero while there is work left
+    job_system.submit(
+        [this, &job_system, &counter, id] {
+            m_tasks[id].function();
+            m_executed_tasks.fetch_add(1, std::memory_order_relaxed);
+
+            for (TaskId successor : m_tasks[id].successors) {
+                if (m_remaining_dependencies[successor].fetch_sub(1) == 1) {
+                    submit_task(job_system, successor, counter);
+                }
+            }
+        },
+        &counter);
+}
+} // namespace Helios
@@ -0,0 +1,223 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Helios {
+struct JobSystemSpecification {
+    // The number of worker threads, 0 uses one per hardware thread except for
+    // the main thread
+    uint32_t worker_count = 0;
+    // Pin every worker to a single core
+    bool pin_workers = false;
+    // The core of each worker when pinned. If empty, worker i is pinned to
+    // core i + 1, which leaves core 0 to the main thread.
+    std::vector<uint32_t> worker_cores = {};
+};
+
+/**
+ * \brief Tracks a group of submitted jobs, so they can be waited on.
+ */
+class JobCounter {
+  public:
+    bool is_done() const {
+        return m_pending.load(std::memory_order_acquire) == 0;
+    }
+
+  private:
+    std::atomic<uint32_t> m_pending = 0;
+
+    friend class JobSystem;
+};
+
+/**
+ * \brief A work stealing job scheduler with persistent worker threads. Every
+ * worker has its own queue, which it takes jobs from in LIFO order, and it
+ * steals jobs from the front of the other queues when its own is empty.
+ * Threads waiting on jobs help running them, so jobs can submit and wait on
+ * other jobs.
+ *
+ * Long jobs (pipeline compiles, file reads...) are submitted as background
+ * jobs, which idle workers run once the other queues are empty. A waiting
+ * thread only runs the background jobs of the counter it waits on, so e.g.
+ * the main thread in a parallel_for doesn't pick up a compile.
+ */
+class JobSystem {
+  public:
+    using JobFunction = std::function<void()>;
+
+    static std::unique_ptr<JobSystem>
+    create_unique(const JobSystemSpecification& spec) {
+        std::unique_ptr<JobSystem> obj = std::make_unique<JobSystem>();
+        obj->init(spec);
+        return obj;
+    }
+
+    /**
+     * \brief Queue a job. Jobs submitted from a worker go to its own queue.
+     * \param function The job.
+     * \param counter Optional counter to wait on, must outlive the job.
+     */
+    void submit(JobFunction function, JobCounter* counter = nullptr);
+
+    /**
+     * \brief Queue a long job, which doesn't hold up the threads waiting on
+     * other jobs.
+     * \param function The job.
+     * \param counter Optional counter to wait on, must outlive the job.
+     */
+    void submit_background(JobFunction function,
+                           JobCounter* counter = nullptr);
+
+    /**
+     * \brief Run jobs on the calling thread until every job of a counter is
+     * done.
+     */
+    void wait(const JobCounter& counter);
+
+    /**
+     * \brief Run a function over a range, split into batches which are
+     * spread over the workers and the calling thread. Returns once the whole
+     * range is done.
+     * \param count The size of the range.
+     * \param batch_size The number of elements per call.
+     * \param function Called as function(begin, end) for every batch.
+     */
+    template <typename Function>
+    void parallel_for(size_t count, size_t batch_size,
+                      const Function& function) {
+        if (count == 0) {
+            return;
+        }
+        batch_size = std::max<size_t>(batch_size, 1);
+
+        const size_t batch_count = (count + batch_size - 1) / batch_size;
+        if (batch_count == 1 || m_workers.empty()) {
+            function(0, count);
+            return;
+        }
+
+        // The batches are handed out through a shared cursor, so a job only
+        // captures one pointer and faster threads simply take more batches
+        struct Range {
+            const Function& function;
+            size_t count;
+            size_t batch_size;
+            std::atomic<size_t> next = 0;
+
+            void run() {
+                for (;;) {
+                    size_t begin =
+                        next.fetch_add(batch_size, std::memory_order_relaxed);
+                    if (begin >= count) {
+                        return;
+                    }
+                    function(begin, std::min(begin + batch_size, count));
+                }
+            }
+        } range{function, count, batch_size};
+
+        JobCounter counter;
+        const size_t job_count =
+            std::min<size_t>(batch_count - 1, m_workers.size());
+        for (size_t i = 0; i < job_count; i++) {
+            submit([&range] { range.run(); }, &counter);
+        }
+        range.run();
+        wait(counter);
+    }
+
+    uint32_t get_worker_count() const { return m_workers.size(); }
+
+    /**
+     * \brief Get if the calling thread is one of the workers.
+     */
+    bool is_worker_thread() const;
+
+    JobSystem() = default;
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    JobSystem(JobSystem&&) = delete;
+    JobSystem& operator=(JobSystem&&) = delete;
+
+  private:
+    struct Job {
+        JobFunction function;
+        JobCounter* counter;
+    };
+
+    struct JobQueue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    void init(const JobSystemSpecification& spec);
+    void worker_main(uint32_t index);
+
+    uint32_t get_queue_index() const;
+    void push(JobQueue& queue, JobFunction function, JobCounter* counter);
+    // The background jobs are taken by idle workers (waited is null), or by
+    // the threads waiting on their counter
+    bool try_pop(uint32_t queue_index, const JobCounter* waited, Job& job);
+    bool try_run_job(uint32_t queue_index, const JobCounter* waited);
+    void execute(Job& job);
+
+    static void pin_thread([[maybe_unused]] std::thread& thread,
+                           uint32_t core);
+
+  private:
+    std::vector<std::thread> m_workers;
+    // One for each worker, and a last one for the other threads
+    std::vector<std::unique_ptr<JobQueue>> m_queues;
+    JobQueue m_background_queue;
+
+    std::atomic<uint32_t> m_queued_jobs = 0;
+    std::atomic<uint32_t> m_sleeping_workers = 0;
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_wake_condition;
+    std::atomic<bool> m_running = false;
+};
+
+/**
+ * \brief A set of jobs with dependencies between them. Every task is
+ * submitted once all the tasks it depends on are done. The graph can be run
+ * again after it has finished.
+ */
+class TaskGraph {
+  public:
+    using TaskId = uint32_t;
+
+    TaskId add_task(JobSystem::JobFunction function);
+
+    /**
+     * \brief Make a task wait on another one. The graph must stay acyclic.
+     */
+    void add_dependency(TaskId before, TaskId after);
+
+    /**
+     * \brief Run every task, and wait for all of them.
+     */
+    void run(JobSystem& job_system);
+
+  private:
+    void submit_task(JobSystem& job_system, TaskId id, JobCounter& counter);
+
+  private:
+    struct Task {
+        JobSystem::JobFunction function;
+        std::vector<TaskId> successors;
+        uint32_t dependency_count = 0;
+    };
+
+    std::vector<Task> m_tasks;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_remaining_dependencies;
+    std::atomic<uint32_t> m_executed_tasks = 0;
+};
+} // namespace Helios
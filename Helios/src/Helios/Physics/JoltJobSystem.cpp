@@ -0,0 +1,48 @@
+#include "JoltJobSystem.h"
+
+namespace Helios::Physics {
+JoltJobSystem::JoltJobSystem(Helios::JobSystem& job_system,
+                             uint32_t max_barriers)
+    : m_job_system(job_system) {
+    Init(max_barriers);
+}
+
+int JoltJobSystem::GetMaxConcurrency() const {
+    // The thread waiting on a barrier runs jobs as well
+    return m_job_system.get_worker_count() + 1;
+}
+
+JoltJobSystem::JobHandle
+JoltJobSystem::CreateJob(const char* in_job_name, JPH::ColorArg in_color,
+                         const JobFunction& in_job_function,
+                         JPH::uint32 in_num_dependencies) {
+    Job* job = new Job(in_job_name, in_color, this, in_job_function,
+                       in_num_dependencies);
+
+    // The handle holds a reference, so the job is freed once it has run and
+    // the handle is gone
+    JobHandle handle(job);
+    if (in_num_dependencies == 0) {
+        QueueJob(job);
+    }
+    return handle;
+}
+
+void JoltJobSystem::QueueJob(Job* in_job) {
+    // Keep the job alive until it has run. A barrier may already have run it,
+    // in which case Execute does nothing.
+    in_job->AddRef();
+    m_job_system.submit([in_job] {
+        in_job->Execute();
+        in_job->Release();
+    });
+}
+
+void JoltJobSystem::QueueJobs(Job** in_jobs, JPH::uint in_num_jobs) {
+    for (JPH::uint i = 0; i < in_num_jobs; i++) {
+        QueueJob(in_jobs[i]);
+    }
+}
+
+void JoltJobSystem::FreeJob(Job* in_job) { delete in_job; }
+} // namespace Helios::Physics
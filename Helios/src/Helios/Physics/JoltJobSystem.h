@@ -0,0 +1,30 @@
+#pragma once
+#include <Jolt/Jolt.h>
+#include <Jolt/Core/JobSystemWithBarrier.h>
+
+#include "Helios/Core/JobSystem.h"
+
+namespace Helios::Physics {
+/**
+ * \brief Runs Jolt's jobs on the engine's job system, so physics shares the
+ * workers with the rest of the engine instead of having its own threads.
+ */
+class JoltJobSystem final : public JPH::JobSystemWithBarrier {
+  public:
+    JoltJobSystem(Helios::JobSystem& job_system, uint32_t max_barriers);
+
+    int GetMaxConcurrency() const override;
+
+    JobHandle CreateJob(const char* in_job_name, JPH::ColorArg in_color,
+                        const JobFunction& in_job_function,
+                        JPH::uint32 in_num_dependencies = 0) override;
+
+  protected:
+    void QueueJob(Job* in_job) override;
+    void QueueJobs(Job** in_jobs, JPH::uint in_num_jobs) override;
+    void FreeJob(Job* in_job) override;
+
+  private:
+    Helios::JobSystem& m_job_system;
+};
+} // namespace Helios::Physics
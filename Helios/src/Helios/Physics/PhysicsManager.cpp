@@ -40,7 +40,7 @@ PhysicsManager::~PhysicsManager() {
     Factory::sInstance = nullptr;
 }
 
-void PhysicsManager::init() noexcept {
+void PhysicsManager::init(JobSystem& job_system) noexcept {
     // Allocation hook
     RegisterDefaultAllocator();
     Trace = trace_func;
@@ -50,9 +50,8 @@ void PhysicsManager::init() noexcept {
     RegisterTypes();
 
     m_temp_allocator = std::make_unique<TempAllocatorImpl>(10 * 1024 * 1024);
-    m_job_system = std::make_unique<JobSystemThreadPool>(
-        cMaxPhysicsJobs, cMaxPhysicsBarriers,
-        thread::hardware_concurrency() - 1);
+    m_job_system =
+        std::make_unique<JoltJobSystem>(job_system, cMaxPhysicsBarriers);
 
     m_physics_system.Init(
         MAX_BODIES, NUM_BODY_MUTEXES, MAX_BODY_PAIRS, MAX_CONTACT_CONSTRAINTS,
@@ -7,6 +7,7 @@
 #include "PhysicsBody.h"
 
 #include "JoltImpls.h"
+#include "JoltJobSystem.h"
 
 namespace Helios::Physics {
 
@@ -28,7 +29,7 @@ struct BodyInfo {
 class PhysicsManager {
   public:
     ~PhysicsManager();
-    void init() noexcept;
+    void init(JobSystem& job_system) noexcept;
 
     void create_body(uint32_t entity, const BodyInfo& info) noexcept;
     void destroy_body(uint32_t entity) noexcept;
@@ -58,7 +59,7 @@ class PhysicsManager {
     MyBodyActivationListener m_body_activation_listener;
 
     std::unique_ptr<JPH::TempAllocatorImpl> m_temp_allocator = nullptr;
-    std::unique_ptr<JPH::JobSystemThreadPool> m_job_system = nullptr;
+    std::unique_ptr<JoltJobSystem> m_job_system = nullptr;
 
     std::unordered_map<JPH::BodyID, uint32_t> m_body_forward_map;
     std::unordered_map<uint32_t, JPH::BodyID> m_body_backward_map;
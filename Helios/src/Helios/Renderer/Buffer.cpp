@@ -7,18 +7,16 @@ namespace Helios {
 Buffer::~Buffer() {
     if (m_is_initialized) {
         auto buffer = m_buffer;
-        auto buffer_memory = m_buffer_memory;
-        auto useMappedMemory = m_use_mapped_memory;
+        auto allocation = m_allocation;
         auto device =
             Application::get().get_vulkan_manager()->get_context().device;
+        MemoryAllocator* allocator =
+            &Application::get().get_vulkan_manager()->get_memory_allocator();
 
         // Enqueue the destruction command
         Application::get().get_vulkan_manager()->enqueue_for_destruction([=]() {
-            if (useMappedMemory) {
-                vkUnmapMemory(device, buffer_memory);
-            }
             vkDestroyBuffer(device, buffer, nullptr);
-            vkFreeMemory(device, buffer_memory, nullptr);
+            allocator->free(allocation);
         });
     }
 }
@@ -46,23 +44,22 @@ void Buffer::init(VkDeviceSize size, VkBufferUsageFlags usage,
     VkMemoryRequirements mem_requirements;
     vkGetBufferMemoryRequirements(context.device, m_buffer, &mem_requirements);
 
-    VkMemoryAllocateInfo alloc_info{};
-    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    alloc_info.allocationSize = mem_requirements.size;
-    alloc_info.memoryTypeIndex = VulkanUtils::find_memory_type(
-        mem_requirements.memoryTypeBits, properties, context.physical_device);
-
-    if (vkAllocateMemory(context.device, &alloc_info, nullptr,
-                         &m_buffer_memory) != VK_SUCCESS) {
+    MemoryAllocator& allocator =
+        Application::get().get_vulkan_manager()->get_memory_allocator();
+    m_allocation = allocator.allocate(mem_requirements, properties, false);
+    if (m_allocation.memory == VK_NULL_HANDLE) {
         HL_ERROR("Failed to allocate buffer");
     }
 
-    vkBindBufferMemory(context.device, m_buffer, m_buffer_memory, 0);
+    vkBindBufferMemory(context.device, m_buffer, m_allocation.memory,
+                       m_allocation.offset);
 
-    m_use_mapped_memory = map_memory;
-    if (m_use_mapped_memory) {
-        vkMapMemory(context.device, m_buffer_memory, 0, size, 0,
-                    &m_mapped_memory);
+    // Host visible memory stays mapped by the allocator
+    if (map_memory) {
+        m_mapped_memory = m_allocation.mapped;
+        if (m_mapped_memory == nullptr) {
+            HL_ERROR("Failed to map buffer memory");
+        }
     }
 }
 } // namespace Helios
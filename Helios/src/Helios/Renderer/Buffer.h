@@ -2,6 +2,7 @@
 #include <volk/volk.h>
 
 #include "Helios/Core/Core.h"
+#include "Helios/Vulkan/MemoryAllocator.h"
 #include "Resource.h"
 
 namespace Helios {
@@ -27,7 +28,7 @@ class Buffer : public Resource {
     }
 
     const VkBuffer& get_vk_buffer() const { return m_buffer; }
-    const VkDeviceMemory& get_vk_memory() const { return m_buffer_memory; }
+    const MemoryAllocation& get_allocation() const { return m_allocation; }
     const VkDeviceSize& get_vk_size() const { return m_size; }
 
     /**
@@ -52,12 +53,11 @@ class Buffer : public Resource {
 
   private:
     VkBuffer m_buffer;
-    VkDeviceMemory m_buffer_memory;
+    MemoryAllocation m_allocation;
     VkDeviceSize m_size;
 
     // Optional
-    void* m_mapped_memory;
-    bool m_use_mapped_memory;
+    void* m_mapped_memory = nullptr;
 
     bool m_is_initialized = false;
 };
@@ -0,0 +1,70 @@
+#include "ComputePipeline.h"
+
+#include "Helios/Core/Application.h"
+#include <volk/volk.h>
+
+namespace Helios {
+ComputePipeline::~ComputePipeline() {
+    if (m_is_initialized) {
+        auto layout = m_layout;
+        auto pipeline = m_pipeline;
+        auto device =
+            Application::get().get_vulkan_manager()->get_context().device;
+
+        // Enqueue the destruction command
+        Application::get().get_vulkan_manager()->enqueue_for_destruction([=]() {
+            vkDestroyPipelineLayout(device, layout, nullptr);
+            vkDestroyPipeline(device, pipeline, nullptr);
+        });
+    }
+}
+
+void ComputePipeline::init(const ComputePipelineCreateInfo& info) {
+    m_is_initialized = true;
+
+    const VulkanContext& context =
+        Application::get().get_vulkan_manager()->get_context();
+
+    std::vector<VkDescriptorSetLayout> layouts(
+        info.descriptor_set_layouts.size());
+
+    for (size_t i = 0; i < info.descriptor_set_layouts.size(); i++) {
+        layouts[i] = info.descriptor_set_layouts[i]->get_vk_layout();
+    }
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
+    pipelineLayoutInfo.pSetLayouts = layouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount =
+        static_cast<uint32_t>(info.push_constants.size());
+    pipelineLayoutInfo.pPushConstantRanges = info.push_constants.data();
+
+    if (vkCreatePipelineLayout(context.device, &pipelineLayoutInfo, nullptr,
+                               &m_layout) != VK_SUCCESS) {
+        HL_ERROR("Failed to create compute pipeline layout!");
+    }
+
+    VkPipelineShaderStageCreateInfo computeShaderStageInfo{};
+    computeShaderStageInfo.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    computeShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    computeShaderStageInfo.module = info.compute_shader->get_vk_module();
+    computeShaderStageInfo.pName = "main";
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = computeShaderStageInfo;
+    pipelineInfo.layout = m_layout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    VkPipelineCache cache = Application::get()
+                                .get_vulkan_manager()
+                                ->get_pipeline_cache()
+                                .get_vk_cache();
+    if (vkCreateComputePipelines(context.device, cache, 1, &pipelineInfo,
+                                 nullptr, &m_pipeline) != VK_SUCCESS) {
+        HL_ERROR("Failed to create compute pipeline!");
+    }
+}
+} // namespace Helios
@@ -0,0 +1,57 @@
+#pragma once
+#include "DescriptorSetLayout.h"
+#include "Helios/Core/Core.h"
+#include "Shader.h"
+
+namespace Helios {
+
+struct ComputePipelineCreateInfo {
+    std::vector<SharedPtr<DescriptorSetLayout>> descriptor_set_layouts;
+    SharedPtr<Shader> compute_shader;
+    std::vector<VkPushConstantRange> push_constants = {};
+};
+
+class ComputePipeline {
+  public:
+    static SharedPtr<ComputePipeline>
+    create(const ComputePipelineCreateInfo& info) {
+        SharedPtr<ComputePipeline> pl = SharedPtr<ComputePipeline>::create();
+        pl->init(info);
+        return pl;
+    }
+    /**
+     * \brief create a new ComputePipeline.
+     * \param descriptor_set_layouts All the layouts of the different types of
+     * descriptor sets.
+     * \param compute_shader The compute shader.
+     * \param push_constants Optional push constants.
+     */
+    static std::unique_ptr<ComputePipeline>
+    create_unique(const ComputePipelineCreateInfo& info) {
+        std::unique_ptr<ComputePipeline> pl =
+            std::make_unique<ComputePipeline>();
+        pl->init(info);
+        return pl;
+    }
+
+    VkPipeline get_vk_pipeline() const { return m_pipeline; }
+    VkPipelineLayout get_vk_layout() const { return m_layout; }
+
+    ComputePipeline() = default;
+    ~ComputePipeline();
+
+    ComputePipeline(const ComputePipeline&) = delete;
+    ComputePipeline& operator=(const ComputePipeline&) = delete;
+    ComputePipeline(ComputePipeline&&) = delete;
+    ComputePipeline& operator=(ComputePipeline&&) = delete;
+
+  private:
+    void init(const ComputePipelineCreateInfo& info);
+
+  private:
+    VkPipeline m_pipeline;
+    VkPipelineLayout m_layout;
+
+    bool m_is_initialized = false;
+};
+} // namespace Helios
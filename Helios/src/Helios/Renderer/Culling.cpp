@@ -0,0 +1,142 @@
+#include "Culling.h"
+
+#if defined(__SSE__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define HL_CULLING_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace Helios {
+namespace {
+bool sphere_in_frustum(const Frustum& frustum, float x, float y, float z,
+                       float radius) {
+    for (const auto& plane : frustum.planes) {
+        if (plane.x * x + plane.y * y + plane.z * z + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+Frustum Frustum::from_view_projection(const glm::mat4& view_projection) {
+    // glm matrices are column major, so pick out the rows
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i],
+                            view_projection[2][i], view_projection[3][i]);
+    }
+
+    Frustum frustum{{
+        rows[3] + rows[0], // Left
+        rows[3] - rows[0], // Right
+        rows[3] + rows[1], // Bottom
+        rows[3] - rows[1], // Top
+        rows[2],           // Near (depth is zero to one)
+        rows[3] - rows[2], // Far
+    }};
+
+    for (auto& plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    return frustum;
+}
+
+void BoundingSpheres::clear() {
+    center_x.clear();
+    center_y.clear();
+    center_z.clear();
+    radius.clear();
+}
+
+void BoundingSpheres::reserve(size_t count) {
+    center_x.reserve(count);
+    center_y.reserve(count);
+    center_z.reserve(count);
+    radius.reserve(count);
+}
+
+void BoundingSpheres::resize(size_t count) {
+    center_x.resize(count);
+    center_y.resize(count);
+    center_z.resize(count);
+    radius.resize(count);
+}
+
+void BoundingSpheres::push_back(const BoundingSphere& sphere) {
+    center_x.push_back(sphere.center.x);
+    center_y.push_back(sphere.center.y);
+    center_z.push_back(sphere.center.z);
+    radius.push_back(sphere.radius);
+}
+
+void BoundingSpheres::set(size_t index, const BoundingSphere& sphere) {
+    center_x[index] = sphere.center.x;
+    center_y[index] = sphere.center.y;
+    center_z[index] = sphere.center.z;
+    radius[index] = sphere.radius;
+}
+
+BoundingSphere transform_bounding_sphere(const BoundingSphere& sphere,
+                                         const Transform& transform) {
+    glm::vec3 scale = glm::abs(transform.scale);
+    return BoundingSphere{
+        .center = transform.position +
+                  transform.rotation * (transform.scale * sphere.center),
+        .radius = sphere.radius * glm::max(scale.x, glm::max(scale.y, scale.z)),
+    };
+}
+
+void cull_spheres(const std::vector<Frustum>& frustums,
+                  const BoundingSpheres& spheres,
+                  std::vector<uint8_t>& visible) {
+    const size_t count = spheres.size();
+    if (frustums.empty()) {
+        visible.assign(count, 1);
+        return;
+    }
+    visible.assign(count, 0);
+
+    for (const auto& frustum : frustums) {
+        size_t i = 0;
+#ifdef HL_CULLING_SSE
+        __m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+        for (size_t p = 0; p < 6; p++) {
+            plane_x[p] = _mm_set1_ps(frustum.planes[p].x);
+            plane_y[p] = _mm_set1_ps(frustum.planes[p].y);
+            plane_z[p] = _mm_set1_ps(frustum.planes[p].z);
+            plane_w[p] = _mm_set1_ps(frustum.planes[p].w);
+        }
+
+        for (; i + 4 <= count; i += 4) {
+            __m128 x = _mm_loadu_ps(&spheres.center_x[i]);
+            __m128 y = _mm_loadu_ps(&spheres.center_y[i]);
+            __m128 z = _mm_loadu_ps(&spheres.center_z[i]);
+            __m128 neg_radius =
+                _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+
+            __m128 inside = _mm_cmpeq_ps(neg_radius, neg_radius);
+            for (size_t p = 0; p < 6; p++) {
+                __m128 distance = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(plane_x[p], x),
+                               _mm_mul_ps(plane_y[p], y)),
+                    _mm_add_ps(_mm_mul_ps(plane_z[p], z), plane_w[p]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, neg_radius));
+            }
+
+            int mask = _mm_movemask_ps(inside);
+            visible[i + 0] |= (mask >> 0) & 1;
+            visible[i + 1] |= (mask >> 1) & 1;
+            visible[i + 2] |= (mask >> 2) & 1;
+            visible[i + 3] |= (mask >> 3) & 1;
+        }
+#endif
+        for (; i < count; i++) {
+            visible[i] |= sphere_in_frustum(
+                frustum, spheres.center_x[i], spheres.center_y[i],
+                spheres.center_z[i], spheres.radius[i]);
+        }
+    }
+}
+} // namespace Helios
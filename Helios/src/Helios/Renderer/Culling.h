@@ -0,0 +1,76 @@
+#pragma once
+#include <array>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Helios/Scene/Transform.h"
+
+namespace Helios {
+struct AABB {
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+};
+
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+};
+
+/**
+ * \brief The six planes of a view frustum, in world space. The normals (xyz)
+ * point inwards, so a point p is inside a plane if dot(xyz, p) + w >= 0.
+ */
+struct Frustum {
+    std::array<glm::vec4, 6> planes;
+
+    /**
+     * \brief Extract the planes from a (zero to one depth) view projection
+     * matrix.
+     */
+    static Frustum from_view_projection(const glm::mat4& view_projection);
+};
+
+// What picking the LODs of the instances needs to know about a view
+struct LodView {
+    glm::vec3 position = glm::vec3(0.0f);
+    // The size on screen of one unit at a distance of one, in pixels
+    float pixels_per_unit = 0.0f;
+};
+
+/**
+ * \brief World space bounding spheres stored as a structure of arrays, so
+ * they can be tested four at a time.
+ */
+struct BoundingSpheres {
+    std::vector<float> center_x;
+    std::vector<float> center_y;
+    std::vector<float> center_z;
+    std::vector<float> radius;
+
+    void clear();
+    void reserve(size_t count);
+    void resize(size_t count);
+    void push_back(const BoundingSphere& sphere);
+    void set(size_t index, const BoundingSphere& sphere);
+    size_t size() const { return radius.size(); }
+};
+
+/**
+ * \brief Transform a local space bounding sphere to world space. Non-uniform
+ * scale is handled by scaling the radius with the largest axis.
+ */
+BoundingSphere transform_bounding_sphere(const BoundingSphere& sphere,
+                                         const Transform& transform);
+
+/**
+ * \brief Test a batch of spheres against several frustums.
+ * \param frustums The frustums, a sphere is visible if it intersects any of
+ * them. If empty, every sphere is visible.
+ * \param spheres The spheres to test.
+ * \param visible Set to 1 for every visible sphere, 0 otherwise.
+ */
+void cull_spheres(const std::vector<Frustum>& frustums,
+                  const BoundingSpheres& spheres,
+                  std::vector<uint8_t>& visible);
+} // namespace Helios
@@ -22,8 +22,11 @@ void DescriptorSet::update_descriptor_set(
 
     if (descriptor_specs[i].descriptor_class == DescriptorClass::Buffer) {
         buffer_infos[i].buffer = descriptor_specs[i].buffer->get_vk_buffer();
-        buffer_infos[i].offset = 0;
-        buffer_infos[i].range = descriptor_specs[i].buffer->get_vk_size();
+        buffer_infos[i].offset = descriptor_specs[i].buffer_offset;
+        buffer_infos[i].range =
+            descriptor_specs[i].buffer_range == 0
+                ? descriptor_specs[i].buffer->get_vk_size()
+                : descriptor_specs[i].buffer_range;
 
         descriptor_writes[i].pBufferInfo = &buffer_infos[i];
     } else if (descriptor_specs[i].descriptor_class == DescriptorClass::Image) {
@@ -21,6 +21,8 @@ struct DescriptorSpec {
     VkSampler sampler;
     uint32_t descriptor_count = 1;
     uint32_t dst_array_element = 0;
+    VkDeviceSize buffer_range = 0; // 0 means the whole buffer
+    VkDeviceSize buffer_offset = 0;
 };
 
 class DescriptorSet {
@@ -33,10 +33,32 @@ void DescriptorSetLayout::init(
     bindings[i].pImmutableSamplers = nullptr;
   }
 
+  std::vector<VkDescriptorBindingFlags> binding_flags(layout_bindings.size());
+  bool update_after_bind = false;
+  for (size_t i = 0; i < layout_bindings.size(); i++) {
+    binding_flags[i] = layout_bindings[i].binding_flags;
+    update_after_bind |= (binding_flags[i] &
+                          VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT) != 0;
+  }
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info{};
+    binding_flags_info.sType =
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    binding_flags_info.bindingCount =
+        static_cast<uint32_t>(binding_flags.size());
+    binding_flags_info.pBindingFlags = binding_flags.data();
+
   VkDescriptorSetLayoutCreateInfo layout_info{};
     layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.pNext = &binding_flags_info;
     layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
     layout_info.pBindings = bindings.data();
+    // Sets with update after bind bindings must come from a pool created
+    // with VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT
+    if (update_after_bind) {
+        layout_info.flags =
+            VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    }
 
   if (vkCreateDescriptorSetLayout(context.device, &layout_info, nullptr,
                                   &m_layout) != VK_SUCCESS) {
@@ -12,6 +12,8 @@ namespace Helios
 		VkDescriptorType type;
 		VkShaderStageFlags stage;
 		uint32_t descriptor_count;
+		// E.g. VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT, for bindless arrays
+		VkDescriptorBindingFlags binding_flags = 0;
 	};
 
 	class DescriptorSetLayout
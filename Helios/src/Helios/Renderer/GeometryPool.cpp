@@ -0,0 +1,290 @@
+#include "GeometryPool.h"
+
+#include "Helios/Core/Application.h"
+
+namespace Helios {
+// Compact once at least this part of a buffer is free, and the free space is
+// split up so that the largest free range is less than half of it
+constexpr uint32_t k_defragment_free_divisor = 4;
+
+// The indices are relative to a mesh's first vertex, so 16 bits are enough
+// up to this many vertices
+constexpr uint32_t k_max_uint16_vertex_count = 65536;
+
+namespace {
+// The index buffer is allocated in 16 bit slots. The ranges are rounded up to
+// an even number of slots, so they all start on a 32 bit boundary.
+constexpr VkDeviceSize k_index_slot_size = sizeof(uint16_t);
+
+uint32_t get_index_size(VkIndexType index_type) {
+    return index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t)
+                                              : sizeof(uint32_t);
+}
+
+uint32_t get_index_slot_count(const GeometryRange& range) {
+    const uint32_t slots = range.index_count *
+                           get_index_size(range.index_type) /
+                           k_index_slot_size;
+    return (slots + 1) & ~1u;
+}
+
+uint32_t get_first_index_slot(const GeometryRange& range) {
+    return range.first_index * get_index_size(range.index_type) /
+           k_index_slot_size;
+}
+
+uint32_t get_first_index(uint32_t slot, VkIndexType index_type) {
+    return slot * k_index_slot_size / get_index_size(index_type);
+}
+} // namespace
+
+void GeometryPool::init(uint32_t max_frames_in_flight,
+                        uint32_t vertex_capacity, uint32_t index_capacity) {
+    m_vertex_buffer = create_vertex_buffer(vertex_capacity);
+    // The capacity is in 32 bit indices
+    const uint32_t index_slot_capacity = index_capacity * 2;
+    m_index_buffer = create_index_buffer(index_slot_capacity);
+    m_vertex_allocator.reset(vertex_capacity, 0);
+    m_index_allocator.reset(index_slot_capacity, 0);
+
+    m_pending_frees.resize(max_frames_in_flight);
+}
+
+uint32_t GeometryPool::allocate(const std::vector<PackedMeshVertex>& vertices,
+                                const std::vector<uint32_t>& indices) {
+    if (vertices.empty() || indices.empty()) {
+        return k_invalid_geometry;
+    }
+
+    const auto vertex_count = static_cast<uint32_t>(vertices.size());
+    const auto index_count = static_cast<uint32_t>(indices.size());
+    GeometryRange range{
+        .vertex_count = vertex_count,
+        .index_count = index_count,
+        .index_type = vertex_count <= k_max_uint16_vertex_count
+                          ? VK_INDEX_TYPE_UINT16
+                          : VK_INDEX_TYPE_UINT32,
+    };
+    const uint32_t index_slot_count = get_index_slot_count(range);
+    reserve(vertex_count, index_slot_count);
+
+    range.first_vertex = m_vertex_allocator.allocate(vertex_count);
+    range.first_index = get_first_index(
+        m_index_allocator.allocate(index_slot_count), range.index_type);
+
+    // The pool's buffers are also copied from when they grow
+    UploadManager& upload_manager = Application::get().get_upload_manager();
+    upload_manager.upload_buffer(
+        m_vertex_buffer->get_vk_buffer(),
+        sizeof(PackedMeshVertex) * range.first_vertex, vertices.data(),
+        sizeof(PackedMeshVertex) * vertex_count,
+        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    const VkDeviceSize index_offset =
+        k_index_slot_size * get_first_index_slot(range);
+    const VkAccessFlags index_access =
+        VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    const VkPipelineStageFlags index_stages =
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    if (range.index_type == VK_INDEX_TYPE_UINT16) {
+        std::vector<uint16_t> short_indices(indices.begin(), indices.end());
+        range.upload = upload_manager.upload_buffer(
+            m_index_buffer->get_vk_buffer(), index_offset,
+            short_indices.data(), sizeof(uint16_t) * index_count,
+            index_access, index_stages);
+    } else {
+        range.upload = upload_manager.upload_buffer(
+            m_index_buffer->get_vk_buffer(), index_offset, indices.data(),
+            sizeof(uint32_t) * index_count, index_access, index_stages);
+    }
+
+    if (!m_free_geometries.empty()) {
+        uint32_t geometry = m_free_geometries.back();
+        m_free_geometries.pop_back();
+        m_ranges[geometry] = range;
+        return geometry;
+    }
+
+    m_ranges.push_back(range);
+    return m_ranges.size() - 1;
+}
+
+void GeometryPool::free(uint32_t geometry) {
+    if (geometry == k_invalid_geometry) {
+        return;
+    }
+    m_pending_frees[Application::get().get_current_frame()].push_back(
+        geometry);
+}
+
+void GeometryPool::begin_frame(uint32_t frame) {
+    for (uint32_t geometry : m_pending_frees[frame]) {
+        GeometryRange& range = m_ranges[geometry];
+        m_vertex_allocator.free(range.first_vertex, range.vertex_count);
+        m_index_allocator.free(get_first_index_slot(range),
+                               get_index_slot_count(range));
+        range = {};
+        m_free_geometries.push_back(geometry);
+    }
+    m_pending_frees[frame].clear();
+
+    if (is_fragmented(m_vertex_allocator) ||
+        is_fragmented(m_index_allocator)) {
+        defragment();
+    }
+}
+
+void GeometryPool::defragment() {
+    // Geometries that are still pending are only used by the frames in
+    // flight, which keep using the old buffers. Dropping their ranges means
+    // they free nothing once released.
+    for (const auto& pending : m_pending_frees) {
+        for (uint32_t geometry : pending) {
+            m_ranges[geometry] = {};
+        }
+    }
+
+    std::vector<VkBufferCopy> vertex_regions;
+    std::vector<VkBufferCopy> index_regions;
+    uint32_t vertex_head = 0;
+    uint32_t index_head = 0;
+    for (auto& range : m_ranges) {
+        if (range.vertex_count == 0) {
+            continue;
+        }
+
+        vertex_regions.push_back({
+            .srcOffset = sizeof(PackedMeshVertex) * range.first_vertex,
+            .dstOffset = sizeof(PackedMeshVertex) * vertex_head,
+            .size = sizeof(PackedMeshVertex) * range.vertex_count,
+        });
+        const uint32_t index_slot_count = get_index_slot_count(range);
+        index_regions.push_back({
+            .srcOffset = k_index_slot_size * get_first_index_slot(range),
+            .dstOffset = k_index_slot_size * index_head,
+            .size = k_index_slot_size * index_slot_count,
+        });
+
+        range.first_vertex = vertex_head;
+        range.first_index = get_first_index(index_head, range.index_type);
+        vertex_head += range.vertex_count;
+        index_head += index_slot_count;
+    }
+
+    // Copy to new buffers, so the frames in flight can keep reading the old
+    // ones (which are destroyed through the destruction queue)
+    SharedPtr<Buffer> vertex_buffer =
+        create_vertex_buffer(m_vertex_allocator.get_capacity());
+    SharedPtr<Buffer> index_buffer =
+        create_index_buffer(m_index_allocator.get_capacity());
+    if (!vertex_regions.empty()) {
+        copy(m_vertex_buffer->get_vk_buffer(), vertex_buffer->get_vk_buffer(),
+             vertex_regions, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+        copy(m_index_buffer->get_vk_buffer(), index_buffer->get_vk_buffer(),
+             index_regions, VK_ACCESS_INDEX_READ_BIT);
+    }
+    m_vertex_buffer = vertex_buffer;
+    m_index_buffer = index_buffer;
+
+    m_vertex_allocator.reset(m_vertex_allocator.get_capacity(), vertex_head);
+    m_index_allocator.reset(m_index_allocator.get_capacity(), index_head);
+}
+
+SharedPtr<Buffer> GeometryPool::create_vertex_buffer(uint32_t capacity) const {
+    return Buffer::create(sizeof(PackedMeshVertex) * capacity,
+                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                              VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                              VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+SharedPtr<Buffer> GeometryPool::create_index_buffer(uint32_t capacity) const {
+    return Buffer::create(k_index_slot_size * capacity,
+                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                              VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                              VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+void GeometryPool::reserve(uint32_t vertex_count,
+                           uint32_t index_slot_count) {
+    // The old buffers are destroyed through the destruction queue, so they
+    // stay alive until the GPU is done with the frames in flight
+    if (m_vertex_allocator.get_largest_free_range() < vertex_count) {
+        const uint32_t capacity = m_vertex_allocator.get_capacity();
+        const uint32_t new_capacity =
+            std::max(capacity * 2, capacity + vertex_count);
+
+        SharedPtr<Buffer> buffer = create_vertex_buffer(new_capacity);
+        copy(m_vertex_buffer->get_vk_buffer(), buffer->get_vk_buffer(),
+             {{0, 0, sizeof(PackedMeshVertex) * capacity}},
+             VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+        m_vertex_buffer = buffer;
+        m_vertex_allocator.grow(new_capacity);
+    }
+
+    if (m_index_allocator.get_largest_free_range() < index_slot_count) {
+        const uint32_t capacity = m_index_allocator.get_capacity();
+        const uint32_t new_capacity =
+            std::max(capacity * 2, capacity + index_slot_count);
+
+        SharedPtr<Buffer> buffer = create_index_buffer(new_capacity);
+        copy(m_index_buffer->get_vk_buffer(), buffer->get_vk_buffer(),
+             {{0, 0, k_index_slot_size * capacity}}, VK_ACCESS_INDEX_READ_BIT);
+        m_index_buffer = buffer;
+        m_index_allocator.grow(new_capacity);
+    }
+}
+
+void GeometryPool::copy(VkBuffer src, VkBuffer dst,
+                        const std::vector<VkBufferCopy>& regions,
+                        VkAccessFlags dst_access) const {
+    const VulkanContext& context =
+        Application::get().get_vulkan_manager()->get_context();
+    const Renderer& renderer = Application::get().get_renderer();
+
+    // Only use the global command buffer if it is currently recording.
+    // Otherwise, the pending uploads to the source are submitted first.
+    if (!renderer.is_recording()) {
+        Application::get().get_upload_manager().flush();
+    }
+    VkCommandBuffer command_buffer =
+        renderer.is_recording()
+            ? renderer.get_current_command_buffer()->get_command_buffer()
+            : VulkanUtils::begin_single_time_commands(context.device,
+                                                      context.command_pool);
+
+    vkCmdCopyBuffer(command_buffer, src, dst, regions.size(), regions.data());
+
+    // The pool's buffers are also copied from when they grow
+    VkBufferMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = dst_access | VK_ACCESS_TRANSFER_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = dst,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+    vkCmdPipelineBarrier(
+        command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+        0, nullptr, 1, &barrier, 0, nullptr);
+
+    if (!renderer.is_recording()) {
+        VulkanUtils::end_single_time_commands(command_buffer, context.device,
+                                              context.command_pool,
+                                              context.graphics_queue);
+    }
+}
+
+bool GeometryPool::is_fragmented(const RangeAllocator& allocator) const {
+    return allocator.get_free_size() >
+               allocator.get_capacity() / k_defragment_free_divisor &&
+           allocator.get_largest_free_range() < allocator.get_free_size() / 2;
+}
+} // namespace Helios
@@ -0,0 +1,120 @@
+#pragma once
+#include <volk/volk.h>
+
+#include "Buffer.h"
+#include "Helios/Core/Core.h"
+#include "MeshVertex.h"
+#include "RangeAllocator.h"
+#include "UploadManager.h"
+
+namespace Helios {
+constexpr uint32_t k_invalid_geometry = UINT32_MAX;
+
+// Where a mesh's vertices and indices are in the pool's buffers (in elements)
+struct GeometryRange {
+    uint32_t first_vertex = 0;
+    uint32_t vertex_count = 0;
+    uint32_t first_index = 0; // In indices of the range's index type
+    uint32_t index_count = 0;
+    VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+    // The geometry's data is on the GPU once this is complete
+    UploadTicket upload = 0;
+};
+
+/**
+ * \brief Stores the vertices and indices of every mesh in one large vertex
+ * buffer and one large index buffer, so meshes can be drawn without
+ * rebinding buffers, and many meshes with a single indirect draw (using
+ * firstIndex and vertexOffset). The buffers grow when full, and are
+ * compacted when they get too fragmented. Meshes with up to 65536 vertices
+ * get 16 bit indices, the index buffer is bound with the type of each mesh.
+ */
+class GeometryPool {
+  public:
+    static std::unique_ptr<GeometryPool>
+    create_unique(uint32_t max_frames_in_flight, uint32_t vertex_capacity,
+                  uint32_t index_capacity) {
+        std::unique_ptr<GeometryPool> obj = std::make_unique<GeometryPool>();
+        obj->init(max_frames_in_flight, vertex_capacity, index_capacity);
+        return obj;
+    }
+
+    /**
+     * \brief Upload a mesh to the pool. The indices are relative to the
+     * mesh's first vertex.
+     * \return A handle to the geometry, k_invalid_geometry on failure.
+     */
+    uint32_t allocate(const std::vector<PackedMeshVertex>& vertices,
+                      const std::vector<uint32_t>& indices);
+
+    /**
+     * \brief Free a geometry. The ranges are only reused once the frames in
+     * flight are done with them.
+     */
+    void free(uint32_t geometry);
+
+    /**
+     * \brief Release the ranges freed during a frame, and compact the
+     * buffers if they are too fragmented. Only call this once the GPU is
+     * done with the frame, and before recording it.
+     * \param frame The frame in flight index.
+     */
+    void begin_frame(uint32_t frame);
+
+    /**
+     * \brief Move every geometry to the start of new buffers. The old buffers
+     * are kept alive for the frames in flight.
+     */
+    void defragment();
+
+    /**
+     * \brief Get the current range of a geometry. Ranges move when
+     * defragmenting, so don't keep them between frames.
+     */
+    const GeometryRange& get_range(uint32_t geometry) const {
+        return m_ranges[geometry];
+    }
+
+    const SharedPtr<Buffer>& get_vertex_buffer() const {
+        return m_vertex_buffer;
+    }
+    const SharedPtr<Buffer>& get_index_buffer() const { return m_index_buffer; }
+
+    GeometryPool() = default;
+    ~GeometryPool() = default;
+
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+    GeometryPool(GeometryPool&&) = delete;
+    GeometryPool& operator=(GeometryPool&&) = delete;
+
+  private:
+    void init(uint32_t max_frames_in_flight, uint32_t vertex_capacity,
+              uint32_t index_capacity);
+
+    SharedPtr<Buffer> create_vertex_buffer(uint32_t capacity) const;
+    SharedPtr<Buffer> create_index_buffer(uint32_t capacity) const;
+
+    // Make room for the given amount of vertices and index slots, growing
+    // the buffers
+    void reserve(uint32_t vertex_count, uint32_t index_slot_count);
+
+    void copy(VkBuffer src, VkBuffer dst,
+              const std::vector<VkBufferCopy>& regions,
+              VkAccessFlags dst_access) const;
+
+    bool is_fragmented(const RangeAllocator& allocator) const;
+
+  private:
+    SharedPtr<Buffer> m_vertex_buffer;
+    SharedPtr<Buffer> m_index_buffer;
+    RangeAllocator m_vertex_allocator;
+    // In 16 bit slots, a 32 bit index takes two
+    RangeAllocator m_index_allocator;
+
+    std::vector<GeometryRange> m_ranges;
+    std::vector<uint32_t> m_free_geometries;
+    std::vector<std::vector<uint32_t>>
+        m_pending_frees; // One for each frame in flight
+};
+} // namespace Helios
@@ -7,15 +7,17 @@ Image::~Image() {
     if (m_is_initialized) {
         auto image_view = m_image_view;
         auto image = m_image;
-        auto memory = m_image_memory;
+        auto allocation = m_allocation;
         auto device =
             Application::get().get_vulkan_manager()->get_context().device;
+        MemoryAllocator* allocator =
+            &Application::get().get_vulkan_manager()->get_memory_allocator();
 
         // Enqueue the destruction command
         Application::get().get_vulkan_manager()->enqueue_for_destruction([=]() {
             vkDestroyImageView(device, image_view, nullptr);
             vkDestroyImage(device, image, nullptr);
-            vkFreeMemory(device, memory, nullptr);
+            allocator->free(allocation);
         });
     }
 }
@@ -27,6 +29,8 @@ void Image::init(const ImageSpec& spec) {
 
     m_width = spec.width;
     m_height = spec.height;
+    m_mip_levels = spec.mip_levels;
+    m_layer_count = spec.cube_map ? 6 : 1;
 
     VkImageCreateInfo image_info{};
     image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -34,8 +38,8 @@ void Image::init(const ImageSpec& spec) {
     image_info.extent.width = m_width;
     image_info.extent.height = m_height;
     image_info.extent.depth = 1;
-    image_info.mipLevels = 1;
-    image_info.arrayLayers = spec.cube_map ? 6 : 1;
+    image_info.mipLevels = m_mip_levels;
+    image_info.arrayLayers = m_layer_count;
 
     image_info.format = spec.format;
     image_info.tiling = spec.tiling;
@@ -51,24 +55,37 @@ void Image::init(const ImageSpec& spec) {
         HL_ERROR("Failed to create image");
     }
 
-    VkMemoryRequirements mem_requirements;
-    vkGetImageMemoryRequirements(context.device, m_image, &mem_requirements);
+    VkImageMemoryRequirementsInfo2 requirements_info{};
+    requirements_info.sType =
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+    requirements_info.image = m_image;
+    VkMemoryDedicatedRequirements dedicated_requirements{};
+    dedicated_requirements.sType =
+        VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+    VkMemoryRequirements2 mem_requirements{};
+    mem_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    mem_requirements.pNext = &dedicated_requirements;
+    vkGetImageMemoryRequirements2(context.device, &requirements_info,
+                                  &mem_requirements);
 
-    m_image_size = mem_requirements.size;
+    m_image_size = mem_requirements.memoryRequirements.size;
 
-    VkMemoryAllocateInfo allocate_info{};
-    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocate_info.allocationSize = mem_requirements.size;
-    allocate_info.memoryTypeIndex = VulkanUtils::find_memory_type(
-        mem_requirements.memoryTypeBits, spec.memory_property,
-        context.physical_device);
-
-    if (vkAllocateMemory(context.device, &allocate_info, nullptr,
-                         &m_image_memory) != VK_SUCCESS) {
+    // Render targets usually prefer a dedicated allocation
+    MemoryAllocator& allocator =
+        Application::get().get_vulkan_manager()->get_memory_allocator();
+    m_allocation =
+        allocator.allocate(mem_requirements.memoryRequirements,
+                           spec.memory_property,
+                           spec.tiling == VK_IMAGE_TILING_OPTIMAL,
+                           dedicated_requirements.prefersDedicatedAllocation ||
+                               dedicated_requirements
+                                   .requiresDedicatedAllocation);
+    if (m_allocation.memory == VK_NULL_HANDLE) {
         HL_ERROR("Failed to allocate image memory");
     }
 
-    vkBindImageMemory(context.device, m_image, m_image_memory, 0);
+    vkBindImageMemory(context.device, m_image, m_allocation.memory,
+                      m_allocation.offset);
 
     VkImageViewCreateInfo view_info{};
     view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -78,9 +95,9 @@ void Image::init(const ImageSpec& spec) {
     view_info.format = spec.format;
     view_info.subresourceRange.aspectMask = spec.aspect_flags;
     view_info.subresourceRange.baseMipLevel = 0;
-    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.levelCount = m_mip_levels;
     view_info.subresourceRange.baseArrayLayer = 0;
-    view_info.subresourceRange.layerCount = spec.cube_map ? 6 : 1;
+    view_info.subresourceRange.layerCount = m_layer_count;
 
     if (vkCreateImageView(context.device, &view_info, nullptr, &m_image_view) !=
         VK_SUCCESS) {
@@ -3,6 +3,7 @@
 #include <volk/volk.h>
 
 #include "Helios/Core/Core.h"
+#include "Helios/Vulkan/MemoryAllocator.h"
 
 namespace Helios {
 struct ImageSpec {
@@ -11,6 +12,7 @@ struct ImageSpec {
 
     VkFormat format;
     bool cube_map = false;
+    uint32_t mip_levels = 1;
     VkImageAspectFlags aspect_flags = VK_IMAGE_ASPECT_COLOR_BIT;
     VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL;
     VkImageUsageFlags usage;
@@ -33,11 +35,13 @@ class Image {
 
     VkImage get_vk_image() const { return m_image; }
     const VkImageView& get_vk_image_view() const { return m_image_view; }
-    const VkDeviceMemory& get_vk_memory() const { return m_image_memory; }
+    const MemoryAllocation& get_allocation() const { return m_allocation; }
     const VkDeviceSize& get_vk_size() const { return m_image_size; }
 
     uint32_t get_width() const { return m_width; }
     uint32_t get_height() const { return m_height; }
+    uint32_t get_mip_levels() const { return m_mip_levels; }
+    uint32_t get_layer_count() const { return m_layer_count; }
 
     ~Image();
     Image() = default;
@@ -53,11 +57,13 @@ class Image {
   private:
     VkImage m_image;
     VkImageView m_image_view;
-    VkDeviceMemory m_image_memory;
+    MemoryAllocation m_allocation;
     VkDeviceSize m_image_size;
 
     uint32_t m_width;
     uint32_t m_height;
+    uint32_t m_mip_levels;
+    uint32_t m_layer_count;
 
     bool m_is_initialized = false;
 };
@@ -2,6 +2,7 @@
 #include <volk/volk.h>
 
 #include "Buffer.h"
+#include "UploadManager.h"
 
 namespace Helios
 {
@@ -32,6 +33,7 @@ namespace Helios
 		const VkBuffer& get_vk_buffer() const { return m_buffer->get_vk_buffer(); }
 
 		uint32_t get_index_count() const { return static_cast<uint32_t>(m_index_count); }
+		UploadTicket get_upload() const { return m_upload; }
 
 		IndexBuffer() = default;
 		~IndexBuffer() = default;
@@ -47,5 +49,6 @@ namespace Helios
 	private:
 		std::unique_ptr<Buffer> m_buffer;
 		size_t m_index_count;
+		UploadTicket m_upload = 0;
 	};
 }
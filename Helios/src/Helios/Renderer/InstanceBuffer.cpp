@@ -0,0 +1,73 @@
+#include "InstanceBuffer.h"
+
+#include "Helios/Core/Application.h"
+
+namespace Helios {
+// Every instance struct is 16 byte aligned
+constexpr VkDeviceSize k_instance_alignment = 16;
+
+void InstanceBuffer::reset(uint32_t frame) {
+    m_current_frame = frame;
+    m_head = 0;
+}
+
+TransientAllocation InstanceBuffer::allocate(VkDeviceSize size) {
+    VkDeviceSize offset =
+        (m_head + k_instance_alignment - 1) & ~(k_instance_alignment - 1);
+
+    auto& buffer = m_buffers[m_current_frame];
+    if (offset + size > buffer->get_vk_size()) {
+        // The old buffer is destroyed through the destruction queue, so it
+        // stays alive until the GPU is done with this frame.
+        VkDeviceSize capacity = buffer->get_vk_size() * 2;
+        while (capacity < size) {
+            capacity *= 2;
+        }
+        buffer = create_buffer(capacity);
+        offset = 0;
+    }
+
+    m_head = offset + size;
+
+    return TransientAllocation{
+        .buffer = buffer->get_vk_buffer(),
+        .offset = offset,
+        .size = size,
+        .mapped_memory =
+            static_cast<uint8_t*>(buffer->get_mapped_memory()) + offset,
+    };
+}
+
+bool InstanceBuffer::fits(VkDeviceSize size) const {
+    VkDeviceSize offset =
+        (m_head + k_instance_alignment - 1) & ~(k_instance_alignment - 1);
+    return offset + size <= m_buffers[m_current_frame]->get_vk_size();
+}
+
+TransientAllocation InstanceBuffer::allocate(const void* data,
+                                             VkDeviceSize size) {
+    TransientAllocation allocation = allocate(size);
+    if (data != nullptr) {
+        memcpy(allocation.mapped_memory, data, size);
+    }
+    return allocation;
+}
+
+void InstanceBuffer::init(uint32_t max_frames_in_flight,
+                          VkDeviceSize initial_capacity) {
+    m_memory_properties = VulkanUtils::get_host_write_memory_properties(
+        Application::get().get_vulkan_manager()->get_context().physical_device);
+
+    m_buffers.resize(max_frames_in_flight);
+    for (auto& buffer : m_buffers) {
+        buffer = create_buffer(initial_capacity);
+    }
+}
+
+SharedPtr<Buffer> InstanceBuffer::create_buffer(VkDeviceSize size) const {
+    return Buffer::create(
+        size,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        m_memory_properties, true);
+}
+} // namespace Helios
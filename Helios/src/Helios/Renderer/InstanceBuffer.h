@@ -0,0 +1,89 @@
+#pragma once
+#include <volk/volk.h>
+
+#include "Buffer.h"
+#include "Helios/Core/Core.h"
+#include "TransientAllocator.h"
+
+namespace Helios {
+/**
+ * \brief A persistently mapped vertex buffer for per-instance data, with one
+ * buffer for each frame in flight. Instance data is written straight into the
+ * mapped memory (device local if the device exposes it as host visible), and
+ * the buffers grow geometrically when they run out of space. The buffers can
+ * also be written by compute shaders (GPU culling).
+ */
+class InstanceBuffer {
+  public:
+    static std::unique_ptr<InstanceBuffer>
+    create_unique(uint32_t max_frames_in_flight,
+                  VkDeviceSize initial_capacity) {
+        std::unique_ptr<InstanceBuffer> obj =
+            std::make_unique<InstanceBuffer>();
+        obj->init(max_frames_in_flight, initial_capacity);
+        return obj;
+    }
+
+    /**
+     * \brief Reset the buffer for a frame. Only call this once the GPU is done
+     * with the frame.
+     * \param frame The frame in flight index.
+     */
+    void reset(uint32_t frame);
+
+    /**
+     * \brief Allocate memory for instances in the current frame's buffer. The
+     * buffer is replaced with a larger one if the allocation does not fit;
+     * allocations made before that stay valid until the frame is done.
+     * \param size The size (in bytes).
+     * \return The allocation.
+     */
+    TransientAllocation allocate(VkDeviceSize size);
+
+    /**
+     * \brief Allocate, and copy data into, the current frame's buffer.
+     */
+    TransientAllocation allocate(const void* data, VkDeviceSize size);
+
+    /**
+     * \brief Get if an allocation fits in the current frame's buffer, i.e.
+     * doesn't make it grow.
+     */
+    bool fits(VkDeviceSize size) const;
+
+    const SharedPtr<Buffer>& get_buffer(uint32_t frame) const {
+        return m_buffers[frame];
+    }
+
+    /**
+     * \brief The current frame's buffer, which the latest allocation is in.
+     */
+    const SharedPtr<Buffer>& get_current_buffer() const {
+        return m_buffers[m_current_frame];
+    }
+
+    VkDeviceSize get_capacity(uint32_t frame) const {
+        return m_buffers[frame]->get_vk_size();
+    }
+
+    InstanceBuffer() = default;
+    ~InstanceBuffer() = default;
+
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+    InstanceBuffer(InstanceBuffer&&) = delete;
+    InstanceBuffer& operator=(InstanceBuffer&&) = delete;
+
+  private:
+    void init(uint32_t max_frames_in_flight, VkDeviceSize initial_capacity);
+
+    SharedPtr<Buffer> create_buffer(VkDeviceSize size) const;
+
+  private:
+    std::vector<SharedPtr<Buffer>> m_buffers; // One for each frame in flight
+    uint32_t m_current_frame = 0;
+    VkDeviceSize m_head = 0;
+
+    VkMemoryPropertyFlags m_memory_properties = 0;
+};
+} // namespace Helios
@@ -0,0 +1,328 @@
+#include "Ktx2.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace Helios {
+namespace {
+constexpr uint8_t k_identifier[12] = {0xAB, 'K',  'T',  'X',  ' ',  '2',
+                                      '0',  0xBB, '\r', '\n', 0x1A, '\n'};
+
+// The files are little endian, like every platform we run on
+struct Header {
+    uint8_t identifier[12];
+    uint32_t vk_format;
+    uint32_t type_size;
+    uint32_t pixel_width;
+    uint32_t pixel_height;
+    uint32_t pixel_depth;
+    uint32_t layer_count;
+    uint32_t face_count;
+    uint32_t level_count;
+    uint32_t supercompression_scheme;
+
+    uint32_t dfd_byte_offset;
+    uint32_t dfd_byte_length;
+    uint32_t kvd_byte_offset;
+    uint32_t kvd_byte_length;
+    uint64_t sgd_byte_offset;
+    uint64_t sgd_byte_length;
+};
+static_assert(sizeof(Header) == 80);
+
+struct LevelIndex {
+    uint64_t byte_offset;
+    uint64_t byte_length;
+    uint64_t uncompressed_byte_length;
+};
+
+// Khronos data format descriptor values
+constexpr uint32_t k_model_rgbsda = 1;
+constexpr uint32_t k_model_bc1a = 128;
+constexpr uint32_t k_model_bc3 = 130;
+constexpr uint32_t k_model_bc5 = 132;
+constexpr uint32_t k_model_bc7 = 134;
+constexpr uint32_t k_primaries_bt709 = 1;
+constexpr uint32_t k_transfer_linear = 1;
+constexpr uint32_t k_transfer_srgb = 2;
+constexpr uint32_t k_sample_signed = 0x40;
+constexpr uint32_t k_sample_linear = 0x10;
+
+uint64_t get_level_size(const TexelBlock& block, uint32_t width,
+                        uint32_t height, uint32_t faces) {
+    uint64_t blocks_x = (width + block.width - 1) / block.width;
+    uint64_t blocks_y = (height + block.height - 1) / block.height;
+    return blocks_x * blocks_y * block.size * faces;
+}
+
+bool is_srgb(VkFormat format) {
+    return format == VK_FORMAT_BC1_RGB_SRGB_BLOCK ||
+           format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK ||
+           format == VK_FORMAT_BC3_SRGB_BLOCK ||
+           format == VK_FORMAT_BC7_SRGB_BLOCK ||
+           format == VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+// A basic data format descriptor block, with its total size first
+std::vector<uint32_t> create_dfd(VkFormat format) {
+    struct Sample {
+        uint32_t bit_offset;
+        uint32_t bit_length;
+        uint32_t channel;
+    };
+
+    uint32_t model = 0;
+    std::vector<Sample> samples;
+    bool is_signed = false;
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        model = k_model_bc1a;
+        samples = {{0, 64, 0}};
+        break;
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        model = k_model_bc1a;
+        samples = {{0, 64, 1}}; // Alpha present
+        break;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+        model = k_model_bc3;
+        samples = {{0, 64, 15}, {64, 64, 0}}; // Alpha, then color
+        break;
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+        is_signed = true;
+        [[fallthrough]];
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+        model = k_model_bc5;
+        samples = {{0, 64, 0}, {64, 64, 1}}; // Red, then green
+        break;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        model = k_model_bc7;
+        samples = {{0, 128, 0}};
+        break;
+    default:
+        model = k_model_rgbsda;
+        samples = {{0, 8, 0}, {8, 8, 1}, {16, 8, 2}, {24, 8, 15}};
+        break;
+    }
+
+    TexelBlock block = get_texel_block(format);
+    uint32_t block_size = 24 + 16 * static_cast<uint32_t>(samples.size());
+    std::vector<uint32_t> dfd = {
+        4 + block_size,
+        0, // Khronos vendor, basic descriptor type
+        2 | block_size << 16, // Version 1.3
+        model | k_primaries_bt709 << 8 |
+            (is_srgb(format) ? k_transfer_srgb : k_transfer_linear) << 16,
+        (block.width - 1) | (block.height - 1) << 8,
+        block.size,
+        0,
+    };
+
+    for (const Sample& sample : samples) {
+        uint32_t channel_type = sample.channel;
+        if (is_signed) {
+            channel_type |= k_sample_signed;
+        }
+        // Alpha isn't sRGB encoded
+        if (model == k_model_rgbsda && sample.channel == 15 &&
+            is_srgb(format)) {
+            channel_type |= k_sample_linear;
+        }
+
+        uint32_t upper = model == k_model_rgbsda ? 255 : UINT32_MAX;
+        dfd.push_back(sample.bit_offset | (sample.bit_length - 1) << 16 |
+                      channel_type << 24);
+        dfd.push_back(0); // Position
+        dfd.push_back(is_signed ? 0x80000000 : 0);
+        dfd.push_back(is_signed ? 0x7FFFFFFF : upper);
+    }
+    return dfd;
+}
+} // namespace
+
+TexelBlock get_texel_block(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        return {8, 4, 4};
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return {16, 4, 4};
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        return {4, 1, 1};
+    default:
+        return {0, 1, 1};
+    }
+}
+
+bool read_ktx2(const std::filesystem::path& path, Ktx2Texture& texture,
+               std::string& error) {
+    std::vector<Ktx2LevelRange> ranges;
+    return read_ktx2_header(path, texture, ranges, error) &&
+           read_ktx2_levels(path, ranges, 0, texture.levels, error);
+}
+
+bool read_ktx2_header(const std::filesystem::path& path, Ktx2Texture& texture,
+                      std::vector<Ktx2LevelRange>& ranges,
+                      std::string& error) {
+    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+    if (stream.fail()) {
+        error = "Failed to open the file";
+        return false;
+    }
+    const uint64_t file_size = static_cast<uint64_t>(stream.tellg());
+    stream.seekg(0);
+
+    Header header;
+    stream.read(reinterpret_cast<char*>(&header), sizeof(Header));
+    if (stream.fail() ||
+        memcmp(header.identifier, k_identifier, sizeof(k_identifier)) != 0) {
+        error = "Not a KTX2 file";
+        return false;
+    }
+    if (header.supercompression_scheme != 0) {
+        error = "Supercompressed files, e.g. Basis Universal, aren't supported";
+        return false;
+    }
+    if (header.pixel_depth > 1 || header.layer_count > 1 ||
+        (header.face_count != 1 && header.face_count != 6) ||
+        header.pixel_width == 0 || header.pixel_height == 0) {
+        error = "Only 2D textures and cube maps are supported";
+        return false;
+    }
+
+    texture.format = static_cast<VkFormat>(header.vk_format);
+    texture.width = header.pixel_width;
+    texture.height = header.pixel_height;
+    texture.cube_map = header.face_count == 6;
+    texture.levels.clear();
+
+    TexelBlock block = get_texel_block(texture.format);
+    if (block.size == 0) {
+        error = "Unsupported format " + std::to_string(header.vk_format);
+        return false;
+    }
+
+    // 0 asks for the levels to be generated, the first one is stored
+    uint32_t level_count = std::max(header.level_count, 1u);
+    if (level_count > 32) {
+        error = "Invalid level count";
+        return false;
+    }
+
+    ranges.resize(level_count);
+    for (uint32_t i = 0; i < level_count; i++) {
+        LevelIndex index;
+        stream.read(reinterpret_cast<char*>(&index), sizeof(LevelIndex));
+        if (stream.fail()) {
+            error = "Truncated level index";
+            return false;
+        }
+
+        uint64_t size = get_level_size(
+            block, std::max(texture.width >> i, 1u),
+            std::max(texture.height >> i, 1u), header.face_count);
+        if (index.byte_length != size ||
+            index.byte_offset + index.byte_length > file_size) {
+            error = "Invalid level " + std::to_string(i);
+            return false;
+        }
+        ranges[i] = {index.byte_offset, index.byte_length};
+    }
+    return true;
+}
+
+bool read_ktx2_levels(const std::filesystem::path& path,
+                      std::span<const Ktx2LevelRange> ranges,
+                      uint32_t first_level,
+                      std::vector<std::vector<uint8_t>>& levels,
+                      std::string& error) {
+    std::ifstream stream(path, std::ios::binary);
+    if (stream.fail()) {
+        error = "Failed to open the file";
+        return false;
+    }
+
+    levels.resize(ranges.size() - std::min<size_t>(first_level, ranges.size()));
+    for (size_t i = 0; i < levels.size(); i++) {
+        const Ktx2LevelRange& range = ranges[first_level + i];
+        levels[i].resize(range.size);
+        stream.seekg(static_cast<std::streamoff>(range.offset));
+        stream.read(reinterpret_cast<char*>(levels[i].data()),
+                    static_cast<std::streamsize>(range.size));
+        if (stream.fail()) {
+            error = "Failed to read level " + std::to_string(first_level + i);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool write_ktx2(const std::filesystem::path& path, const Ktx2Texture& texture,
+                std::string& error) {
+    TexelBlock block = get_texel_block(texture.format);
+    if (block.size == 0 || texture.levels.empty()) {
+        error = "Nothing to write, or an unsupported format";
+        return false;
+    }
+
+    uint32_t level_count = static_cast<uint32_t>(texture.levels.size());
+    std::vector<uint32_t> dfd = create_dfd(texture.format);
+
+    Header header{};
+    memcpy(header.identifier, k_identifier, sizeof(k_identifier));
+    header.vk_format = texture.format;
+    header.type_size = 1;
+    header.pixel_width = texture.width;
+    header.pixel_height = texture.height;
+    header.face_count = texture.cube_map ? 6 : 1;
+    header.level_count = level_count;
+    header.dfd_byte_offset = static_cast<uint32_t>(
+        sizeof(Header) + sizeof(LevelIndex) * level_count);
+    header.dfd_byte_length = static_cast<uint32_t>(dfd.size() * 4);
+
+    // The levels are stored from the smallest, each aligned to its blocks
+    std::vector<LevelIndex> level_index(level_count);
+    uint64_t offset = header.dfd_byte_offset + header.dfd_byte_length;
+    for (uint32_t i = level_count; i-- > 0;) {
+        offset = (offset + block.size - 1) / block.size * block.size;
+        level_index[i] = {
+            .byte_offset = offset,
+            .byte_length = texture.levels[i].size(),
+            .uncompressed_byte_length = texture.levels[i].size(),
+        };
+        offset += texture.levels[i].size();
+    }
+
+    std::vector<uint8_t> file(offset, 0);
+    memcpy(file.data(), &header, sizeof(Header));
+    memcpy(file.data() + sizeof(Header), level_index.data(),
+           sizeof(LevelIndex) * level_count);
+    memcpy(file.data() + header.dfd_byte_offset, dfd.data(),
+           header.dfd_byte_length);
+    for (uint32_t i = 0; i < level_count; i++) {
+        memcpy(file.data() + level_index[i].byte_offset,
+               texture.levels[i].data(), texture.levels[i].size());
+    }
+
+    std::ofstream stream(path, std::ios::binary);
+    stream.write(reinterpret_cast<const char*>(file.data()),
+                 static_cast<std::streamsize>(file.size()));
+    if (stream.fail()) {
+        error = "Failed to write the file";
+        return false;
+    }
+    return true;
+}
+} // namespace Helios
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+#include <volk/volk.h>
+
+namespace Helios {
+/**
+ * \brief A texture in a KTX2 container, e.g. a block compressed one with its
+ * mip levels, cooked by the texture converter. Only containers without
+ * supercompression are supported.
+ */
+struct Ktx2Texture {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    bool cube_map = false;
+    // The first level first, each holding all the faces
+    std::vector<std::vector<uint8_t>> levels;
+};
+
+// Where a level is in a KTX2 file
+struct Ktx2LevelRange {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
+/**
+ * \brief Read a KTX2 file.
+ * \param error Why the file couldn't be read.
+ * \return If the file was read.
+ */
+bool read_ktx2(const std::filesystem::path& path, Ktx2Texture& texture,
+               std::string& error);
+
+/**
+ * \brief Read a KTX2 file's header and level index, but not its levels, e.g.
+ * to load them later with read_ktx2_levels. The texture's levels are left
+ * empty.
+ * \param ranges Where each level is in the file.
+ */
+bool read_ktx2_header(const std::filesystem::path& path, Ktx2Texture& texture,
+                      std::vector<Ktx2LevelRange>& ranges, std::string& error);
+
+/**
+ * \brief Read the levels of a KTX2 file from first_level to the last one.
+ * \param ranges The file's level ranges, from read_ktx2_header.
+ * \param levels The data of the levels read, first_level first.
+ */
+bool read_ktx2_levels(const std::filesystem::path& path,
+                      std::span<const Ktx2LevelRange> ranges,
+                      uint32_t first_level,
+                      std::vector<std::vector<uint8_t>>& levels,
+                      std::string& error);
+
+/**
+ * \brief Write a KTX2 file, with a data format descriptor for the block
+ * compressed formats and R8G8B8A8.
+ * \param error Why the file couldn't be written.
+ * \return If the file was written.
+ */
+bool write_ktx2(const std::filesystem::path& path, const Ktx2Texture& texture,
+                std::string& error);
+
+// The bytes of a block, and its size in texels, e.g. 8 bytes for 4x4 BC1
+struct TexelBlock {
+    uint32_t size = 0;
+    uint32_t width = 1;
+    uint32_t height = 1;
+};
+
+// Zero sized for the formats the KTX2 files can't use
+TexelBlock get_texel_block(VkFormat format);
+} // namespace Helios
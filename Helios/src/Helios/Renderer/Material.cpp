@@ -2,10 +2,51 @@
 #include "Helios/Core/Application.h"
 #include "Helios/Core/IOUtils.h"
 #include "Helios/Renderer/Shader.h"
+#include <algorithm>
 #include <fstream>
 #include <yaml-cpp/yaml.h>
 
 namespace Helios {
+namespace {
+// A texture's sampler state, from its optional "sampler" node:
+//   filter: linear | nearest
+//   wrap: clamp | repeat | mirror
+//   anisotropy: 1 (off) to 16
+//   mipmaps: true | false
+SamplerSpec load_sampler_spec(const YAML::Node& node) {
+    SamplerSpec spec;
+    if (!node || !node.IsMap()) {
+        return spec;
+    }
+
+    if (node["filter"] && node["filter"].IsScalar()) {
+        auto filter = node["filter"].as<std::string>();
+        if (filter == "nearest") {
+            spec.filter = VK_FILTER_NEAREST;
+        } else if (filter != "linear") {
+            HL_WARN("Unknown sampler filter {0}", filter);
+        }
+    }
+    if (node["wrap"] && node["wrap"].IsScalar()) {
+        auto wrap = node["wrap"].as<std::string>();
+        if (wrap == "repeat") {
+            spec.address_mode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        } else if (wrap == "mirror") {
+            spec.address_mode = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+        } else if (wrap != "clamp") {
+            HL_WARN("Unknown sampler wrap mode {0}", wrap);
+        }
+    }
+    if (node["anisotropy"] && node["anisotropy"].IsScalar()) {
+        spec.max_anisotropy = std::max(node["anisotropy"].as<float>(), 1.0f);
+    }
+    if (node["mipmaps"] && node["mipmaps"].IsScalar()) {
+        spec.mipmaps = node["mipmaps"].as<bool>();
+    }
+    return spec;
+}
+} // namespace
+
 bool Material::init(const std::filesystem::path& path) {
     std::ifstream stream(
         IOUtils::resolve_path(Application::get().get_asset_base_path(), path)
@@ -43,6 +84,9 @@ bool Material::init(const std::filesystem::path& path) {
                     }
                 }
             }
+            m_diffuse_sampler =
+                Application::get().get_renderer().get_sampler_index(
+                    load_sampler_spec(diffuse["sampler"]));
         }
 
         if (data["specular"]) {
@@ -65,6 +109,9 @@ bool Material::init(const std::filesystem::path& path) {
                     }
                 }
             }
+            m_specular_sampler =
+                Application::get().get_renderer().get_sampler_index(
+                    load_sampler_spec(specular["sampler"]));
         }
         if (data["emission"]) {
             auto emission = data["emission"];
@@ -86,6 +133,9 @@ bool Material::init(const std::filesystem::path& path) {
                     }
                 }
             }
+            m_emission_sampler =
+                Application::get().get_renderer().get_sampler_index(
+                    load_sampler_spec(emission["sampler"]));
         }
         auto shininess = data["shininess"];
         if (shininess && !shininess.IsNull() && shininess.IsScalar()) {
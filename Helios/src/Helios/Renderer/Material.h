@@ -27,6 +27,16 @@ class Material : public Asset {
     const SharedPtr<Texture>& get_emission() const { return m_emission; }
     float get_shininess() const { return m_shininess; }
 
+    /**
+     * \brief The sampler indices of the diffuse, specular and emission
+     * textures, 4 bits each, as the mesh shaders take them.
+     */
+    uint16_t get_sampler_indices() const {
+        return static_cast<uint16_t>(m_diffuse_sampler |
+                                     m_specular_sampler << 4 |
+                                     m_emission_sampler << 8);
+    }
+
     const SharedPtr<Shader>& get_vertex_shader() const {
         return m_vertex_shader;
     }
@@ -44,5 +54,10 @@ class Material : public Asset {
     SharedPtr<Shader> m_vertex_shader = nullptr;
     SharedPtr<Shader> m_fragment_shader = nullptr;
     float m_shininess = 32.0f;
+
+    // Indices in the renderer's samplers
+    uint32_t m_diffuse_sampler = 0;
+    uint32_t m_specular_sampler = 0;
+    uint32_t m_emission_sampler = 0;
 };
 } // namespace Helios
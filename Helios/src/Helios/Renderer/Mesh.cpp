@@ -5,9 +5,101 @@
 
 #include <tiny_obj_loader.h>
 
+#include "MeshProcessing.h"
 #include "MeshVertex.h"
 
 namespace Helios {
+namespace {
+// Smaller meshes don't get LODs
+constexpr size_t k_min_lod_index_count = 3 * 256;
+// A LOD is only kept if it has at most this fraction of the previous one's
+// indices
+constexpr float k_min_lod_reduction = 0.75f;
+// The largest simplification error, relative to the bounding sphere's radius
+constexpr float k_max_lod_error = 0.1f;
+} // namespace
+
+Mesh::~Mesh() { Application::get().get_geometry_pool().free(m_geometry); }
+
+VkBuffer Mesh::get_vk_vertex_buffer() const {
+    return is_pooled() ? Application::get()
+                             .get_geometry_pool()
+                             .get_vertex_buffer()
+                             ->get_vk_buffer()
+                       : m_vertex_buffer->get_vk_buffer();
+}
+
+VkBuffer Mesh::get_vk_index_buffer() const {
+    return is_pooled() ? Application::get()
+                             .get_geometry_pool()
+                             .get_index_buffer()
+                             ->get_vk_buffer()
+                       : m_index_buffer->get_vk_buffer();
+}
+
+uint32_t Mesh::get_index_count(uint32_t lod) const {
+    if (!m_lods.empty()) {
+        return m_lods[std::min<size_t>(lod, m_lods.size() - 1)].index_count;
+    }
+
+    return is_pooled() ? Application::get()
+                             .get_geometry_pool()
+                             .get_range(m_geometry)
+                             .index_count
+                       : m_index_buffer->get_index_count();
+}
+
+uint32_t Mesh::get_first_index(uint32_t lod) const {
+    uint32_t first_index =
+        m_lods.empty()
+            ? 0
+            : m_lods[std::min<size_t>(lod, m_lods.size() - 1)].first_index;
+    return is_pooled() ? Application::get()
+                                 .get_geometry_pool()
+                                 .get_range(m_geometry)
+                                 .first_index +
+                             first_index
+                       : first_index;
+}
+
+VkIndexType Mesh::get_index_type() const {
+    return is_pooled() ? Application::get()
+                             .get_geometry_pool()
+                             .get_range(m_geometry)
+                             .index_type
+                       : VK_INDEX_TYPE_UINT32;
+}
+
+bool Mesh::is_uploaded() const {
+    const UploadManager& upload_manager =
+        Application::get().get_upload_manager();
+    if (is_pooled()) {
+        return upload_manager.is_complete(Application::get()
+                                              .get_geometry_pool()
+                                              .get_range(m_geometry)
+                                              .upload);
+    }
+    return upload_manager.is_complete(m_vertex_buffer->get_upload()) &&
+           upload_manager.is_complete(m_index_buffer->get_upload());
+}
+
+uint32_t Mesh::select_lod(float pixels_per_unit) const {
+    for (size_t lod = m_lods.size(); lod-- > 1;) {
+        if (m_lods[lod].error * pixels_per_unit <= k_max_lod_error_pixels) {
+            return static_cast<uint32_t>(lod);
+        }
+    }
+    return 0;
+}
+
+int32_t Mesh::get_vertex_offset() const {
+    return is_pooled() ? static_cast<int32_t>(Application::get()
+                                                  .get_geometry_pool()
+                                                  .get_range(m_geometry)
+                                                  .first_vertex)
+                       : 0;
+}
+
 bool Mesh::init(const std::filesystem::path& path) {
     const VulkanContext& context =
         Application::get().get_vulkan_manager()->get_context();
@@ -64,9 +156,40 @@ bool Mesh::init(const std::filesystem::path& path) {
         }
     }
 
-    init(vertices.data(), sizeof(MeshVertex) * vertices.size(), indices.data(),
-         sizeof(uint32_t) * indices.size(), indices.size());
-    return true;
+    optimize_vertex_cache(indices, vertices.size());
+    optimize_overdraw(indices, vertices);
+
+    // The LOD errors are relative to the bounds
+    compute_bounds(vertices);
+    generate_lods(vertices, indices);
+
+    // Last, since the LODs use the same vertices. The full mesh comes first
+    // in the indices, so it decides most of the order.
+    optimize_vertex_fetch(vertices, indices);
+
+    return init(vertices, indices);
+}
+
+bool Mesh::init(const std::vector<MeshVertex>& vertices,
+                const std::vector<uint32_t>& indices) {
+    if (!m_has_bounds) {
+        compute_bounds(vertices);
+    }
+
+    // The buffers only hold the packed vertices
+    std::vector<PackedMeshVertex> packed_vertices =
+        pack_vertices(vertices, m_quantization);
+
+    m_geometry = Application::get().get_geometry_pool().allocate(
+        packed_vertices, indices);
+    if (is_pooled()) {
+        return true;
+    }
+
+    return init((void*)packed_vertices.data(),
+                sizeof(PackedMeshVertex) * packed_vertices.size(),
+                (void*)indices.data(), sizeof(uint32_t) * indices.size(),
+                indices.size());
 }
 
 bool Mesh::init(void* vertices, size_t vertices_size, void* indices,
@@ -76,4 +199,75 @@ bool Mesh::init(void* vertices, size_t vertices_size, void* indices,
     // TODO: Error checks
     return true;
 }
+
+void Mesh::generate_lods(const std::vector<MeshVertex>& vertices,
+                         std::vector<uint32_t>& indices) {
+    if (indices.size() < k_min_lod_index_count) {
+        return;
+    }
+
+    m_lods.push_back({
+        .first_index = 0,
+        .index_count = static_cast<uint32_t>(indices.size()),
+        .error = 0.0f,
+    });
+
+    // Every LOD halves the triangles of the previous one, and is simplified
+    // from the full mesh so the errors don't add up. They are appended once
+    // done, since the full mesh is the input.
+    const float max_error = k_max_lod_error * m_bounding_sphere.radius;
+    std::vector<uint32_t> lods_indices;
+    while (m_lods.size() < k_max_mesh_lods) {
+        const MeshLod& previous = m_lods.back();
+        const size_t target_index_count = previous.index_count / 6 * 3;
+        float error = 0.0f;
+        std::vector<uint32_t> lod_indices = simplify_mesh(
+            vertices, indices, target_index_count, max_error, &error);
+        if (lod_indices.empty() ||
+            lod_indices.size() > previous.index_count * k_min_lod_reduction) {
+            break;
+        }
+
+        optimize_vertex_cache(lod_indices, vertices.size());
+        m_lods.push_back({
+            .first_index =
+                static_cast<uint32_t>(indices.size() + lods_indices.size()),
+            .index_count = static_cast<uint32_t>(lod_indices.size()),
+            .error = std::max(error, previous.error),
+        });
+        lods_indices.insert(lods_indices.end(), lod_indices.begin(),
+                            lod_indices.end());
+    }
+    indices.insert(indices.end(), lods_indices.begin(), lods_indices.end());
+
+    // Only the full mesh
+    if (m_lods.size() == 1) {
+        m_lods.clear();
+    }
+}
+
+void Mesh::compute_bounds(const std::vector<MeshVertex>& vertices) {
+    if (vertices.empty()) {
+        return;
+    }
+
+    m_bounding_box.min = vertices[0].position;
+    m_bounding_box.max = vertices[0].position;
+    for (const auto& vertex : vertices) {
+        m_bounding_box.min = glm::min(m_bounding_box.min, vertex.position);
+        m_bounding_box.max = glm::max(m_bounding_box.max, vertex.position);
+    }
+
+    // Center the sphere on the box, but use the farthest vertex for the
+    // radius, which is tighter than the half diagonal of the box
+    m_bounding_sphere.center = (m_bounding_box.min + m_bounding_box.max) * 0.5f;
+    float radius2 = 0.0f;
+    for (const auto& vertex : vertices) {
+        glm::vec3 d = vertex.position - m_bounding_sphere.center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    m_bounding_sphere.radius = std::sqrt(radius2);
+
+    m_has_bounds = true;
+}
 } // namespace Helios
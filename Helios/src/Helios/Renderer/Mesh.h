@@ -1,14 +1,29 @@
 ﻿#pragma once
 
+#include <algorithm>
 #include <volk/volk.h>
 
 #include "Helios/Assets/Asset.h"
+#include "Culling.h"
+#include "GeometryPool.h"
 #include "Helios/Core/Core.h"
 #include "IndexBuffer.h"
+#include "MeshVertex.h"
 #include "VertexBuffer.h"
 #include <filesystem>
 
 namespace Helios {
+constexpr uint32_t k_max_mesh_lods = 4;
+// The coarsest LOD whose error is at most this many pixels on screen is used
+constexpr float k_max_lod_error_pixels = 1.0f;
+
+// A level of detail, as a range of the mesh's indices
+struct MeshLod {
+    uint32_t first_index = 0; // Relative to the mesh's first index
+    uint32_t index_count = 0;
+    float error = 0.0f; // The simplification error, in mesh units
+};
+
 class Mesh : public Resource, public Asset {
   public:
     static SharedPtr<Mesh> create(const std::filesystem::path& path) {
@@ -32,6 +47,25 @@ class Mesh : public Resource, public Asset {
         return obj;
     }
 
+    /**
+     * \brief Create a mesh from MeshVertex data. Unlike the untyped overload,
+     * this also computes the bounds of the mesh, and stores the geometry in
+     * the geometry pool.
+     */
+    static SharedPtr<Mesh> create(const std::string& name,
+                                  const std::vector<MeshVertex>& vertices,
+                                  const std::vector<uint32_t>& indices) {
+        SharedPtr<Mesh> obj = SharedPtr<Mesh>::create();
+        obj->init_uuid();
+        obj->init_asset(name);
+        obj->init(vertices, indices);
+        return obj;
+    }
+
+    /**
+     * \brief The mesh's own buffers, only set if it is not in the geometry
+     * pool.
+     */
     const SharedPtr<VertexBuffer>& get_vertex_buffer() const {
         return m_vertex_buffer;
     }
@@ -39,16 +73,84 @@ class Mesh : public Resource, public Asset {
         return m_index_buffer;
     }
 
+    /**
+     * \brief If the geometry is in the geometry pool, so it shares its
+     * buffers with the other pooled meshes.
+     */
+    bool is_pooled() const { return m_geometry != k_invalid_geometry; }
+
+    // The buffers and offsets to draw the mesh with, pooled or not
+    VkBuffer get_vk_vertex_buffer() const;
+    VkBuffer get_vk_index_buffer() const;
+    uint32_t get_index_count(uint32_t lod = 0) const;
+    uint32_t get_first_index(uint32_t lod = 0) const;
+    int32_t get_vertex_offset() const;
+    VkIndexType get_index_type() const;
+
+    /**
+     * \brief If the mesh's data is on the GPU. It can be drawn before, the
+     * frames wait for the upload.
+     */
+    bool is_uploaded() const;
+
+    /**
+     * \brief The number of LODs, 1 if the mesh has none. They are generated
+     * when importing a mesh, and share its vertices.
+     */
+    uint32_t get_lod_count() const {
+        return std::max<uint32_t>(static_cast<uint32_t>(m_lods.size()), 1);
+    }
+
+    /**
+     * \brief Pick the coarsest LOD that looks the same on screen.
+     * \param pixels_per_unit The size on screen of one mesh unit, in pixels.
+     */
+    uint32_t select_lod(float pixels_per_unit) const;
+
+    /**
+     * \brief If the mesh has bounds. Meshes created from untyped vertex data
+     * do not, and should never be culled.
+     */
+    bool has_bounds() const { return m_has_bounds; }
+    const AABB& get_bounding_box() const { return m_bounding_box; }
+    const BoundingSphere& get_bounding_sphere() const {
+        return m_bounding_sphere;
+    }
+
+    /**
+     * \brief Maps the vertex buffer's quantized positions to mesh space. The
+     * instances' transforms include it. Identity for meshes created from
+     * untyped vertex data.
+     */
+    const VertexQuantization& get_vertex_quantization() const {
+        return m_quantization;
+    }
+
     Mesh() = default;
-    ~Mesh() = default;
+    ~Mesh();
 
   private:
     bool init(const std::filesystem::path& file);
     bool init(void* vertices, size_t vertices_size, void* indices,
               size_t indices_size, size_t indices_count);
+    bool init(const std::vector<MeshVertex>& vertices,
+              const std::vector<uint32_t>& indices);
+
+    void compute_bounds(const std::vector<MeshVertex>& vertices);
+    // Append the LODs' indices to the indices
+    void generate_lods(const std::vector<MeshVertex>& vertices,
+                       std::vector<uint32_t>& indices);
 
   private:
     SharedPtr<VertexBuffer> m_vertex_buffer;
     SharedPtr<IndexBuffer> m_index_buffer;
+    uint32_t m_geometry = k_invalid_geometry;
+    // Empty if the mesh has no LODs, the first one is the full mesh
+    std::vector<MeshLod> m_lods;
+
+    AABB m_bounding_box;
+    BoundingSphere m_bounding_sphere;
+    bool m_has_bounds = false;
+    VertexQuantization m_quantization;
 };
 } // namespace Helios
@@ -0,0 +1,563 @@
+#include "MeshProcessing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#include <glm/gtc/packing.hpp>
+
+namespace Helios {
+namespace {
+// The simulated post-transform cache, most GPUs have at least this many
+// entries
+constexpr size_t k_vertex_cache_size = 32;
+
+// Every pass recomputes the costs, since they change as the mesh gets
+// simplified
+constexpr size_t k_max_simplify_passes = 64;
+
+// The sum of the squared distances to a set of planes, as a symmetric 4x4
+// matrix. Weighted by the triangles' areas.
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+    double weight = 0;
+
+    static Quadric from_plane(const glm::dvec3& n, double d, double weight) {
+        return {
+            .a00 = n.x * n.x * weight,
+            .a01 = n.x * n.y * weight,
+            .a02 = n.x * n.z * weight,
+            .a03 = n.x * d * weight,
+            .a11 = n.y * n.y * weight,
+            .a12 = n.y * n.z * weight,
+            .a13 = n.y * d * weight,
+            .a22 = n.z * n.z * weight,
+            .a23 = n.z * d * weight,
+            .a33 = d * d * weight,
+            .weight = weight,
+        };
+    }
+
+    Quadric& operator+=(const Quadric& other) {
+        a00 += other.a00;
+        a01 += other.a01;
+        a02 += other.a02;
+        a03 += other.a03;
+        a11 += other.a11;
+        a12 += other.a12;
+        a13 += other.a13;
+        a22 += other.a22;
+        a23 += other.a23;
+        a33 += other.a33;
+        weight += other.weight;
+        return *this;
+    }
+
+    // The mean squared distance of a point to the planes
+    double error(const glm::vec3& p) const {
+        if (weight <= 0.0) {
+            return 0.0;
+        }
+        double x = p.x, y = p.y, z = p.z;
+        double e = a00 * x * x + a11 * y * y + a22 * z * z +
+                   2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                   2.0 * (a03 * x + a13 * y + a23 * z) + a33;
+        return std::max(e, 0.0) / weight;
+    }
+};
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+};
+
+uint64_t edge_key(uint32_t a, uint32_t b) {
+    return (uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+}
+
+// Forsyth's vertex score. Recently used vertices score higher (except the
+// last triangle's, to avoid strips), and so do the ones with few triangles
+// left, so no vertex gets left behind.
+float vertex_score(int32_t cache_position, uint32_t valence) {
+    if (valence == 0) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cache_position >= 0) {
+        if (cache_position < 3) {
+            score = 0.75f;
+        } else {
+            const float scale = 1.0f / (k_vertex_cache_size - 3);
+            score = std::pow(1.0f - (cache_position - 3) * scale, 1.5f);
+        }
+    }
+    return score + 2.0f / std::sqrt(static_cast<float>(valence));
+}
+
+// Map a unit vector to the octahedron, and unfold it onto a square
+glm::vec2 encode_octahedral(const glm::vec3& normal) {
+    glm::vec3 n =
+        normal / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+    glm::vec2 encoded(n.x, n.y);
+    if (n.z < 0.0f) {
+        encoded = (1.0f - glm::abs(glm::vec2(n.y, n.x))) *
+                  glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f,
+                            n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return encoded;
+}
+
+// If moving a vertex of a triangle flips it, or makes it (close to)
+// degenerate
+bool flips(const glm::vec3& moved, const glm::vec3& to, const glm::vec3& b,
+           const glm::vec3& c) {
+    glm::vec3 before = glm::cross(b - moved, c - moved);
+    glm::vec3 after = glm::cross(b - to, c - to);
+    return glm::dot(before, after) <=
+           0.25f * glm::length(before) * glm::length(after);
+}
+} // namespace
+
+void optimize_vertex_cache(std::vector<uint32_t>& indices,
+                           size_t vertex_count) {
+    const size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    // The triangles not emitted yet around each vertex, the first valence
+    // entries of its range are the remaining ones
+    std::vector<uint32_t> valences(vertex_count, 0);
+    for (uint32_t index : indices) {
+        valences[index]++;
+    }
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; v++) {
+        offsets[v + 1] = offsets[v] + valences[v];
+    }
+    std::vector<uint32_t> vertex_triangles(indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        vertex_triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<int32_t> cache_positions(vertex_count, -1);
+    std::vector<float> vertex_scores(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++) {
+        vertex_scores[v] = vertex_score(-1, valences[v]);
+    }
+
+    // Start with the best triangle, and then continue with the best one
+    // around the cached vertices
+    std::vector<uint8_t> emitted(triangle_count, 0);
+    size_t best = 0;
+    float best_score = -1.0f;
+    for (size_t t = 0; t < triangle_count; t++) {
+        float score = vertex_scores[indices[t * 3]] +
+                      vertex_scores[indices[t * 3 + 1]] +
+                      vertex_scores[indices[t * 3 + 2]];
+        if (score > best_score) {
+            best = t;
+            best_score = score;
+        }
+    }
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> new_cache;
+    size_t next_unemitted = 0;
+    while (result.size() < indices.size()) {
+        // Nothing left around the cache, take the next triangle in order
+        if (best_score < 0.0f) {
+            while (emitted[next_unemitted]) {
+                next_unemitted++;
+            }
+            best = next_unemitted;
+        }
+
+        const uint32_t* triangle = &indices[best * 3];
+        emitted[best] = 1;
+        result.insert(result.end(), triangle, triangle + 3);
+
+        new_cache.assign(triangle, triangle + 3);
+        for (uint32_t v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                new_cache.push_back(v);
+            }
+        }
+
+        for (size_t k = 0; k < 3; k++) {
+            const uint32_t v = triangle[k];
+            uint32_t* first = &vertex_triangles[offsets[v]];
+            uint32_t* last = first + valences[v] - 1;
+            *std::find(first, last, static_cast<uint32_t>(best)) = *last;
+            valences[v]--;
+        }
+
+        // Update the vertices in, or just pushed out of, the cache, and find
+        // the best triangle around them
+        for (size_t i = 0; i < new_cache.size(); i++) {
+            const uint32_t v = new_cache[i];
+            cache_positions[v] =
+                i < k_vertex_cache_size ? static_cast<int32_t>(i) : -1;
+            vertex_scores[v] = vertex_score(cache_positions[v], valences[v]);
+        }
+        best_score = -1.0f;
+        for (uint32_t v : new_cache) {
+            for (uint32_t i = offsets[v]; i < offsets[v] + valences[v]; i++) {
+                const uint32_t t = vertex_triangles[i];
+                float score = vertex_scores[indices[t * 3]] +
+                              vertex_scores[indices[t * 3 + 1]] +
+                              vertex_scores[indices[t * 3 + 2]];
+                if (score > best_score) {
+                    best = t;
+                    best_score = score;
+                }
+            }
+        }
+
+        if (new_cache.size() > k_vertex_cache_size) {
+            new_cache.resize(k_vertex_cache_size);
+        }
+        cache.swap(new_cache);
+    }
+
+    indices.swap(result);
+}
+
+void optimize_overdraw(std::vector<uint32_t>& indices,
+                       const std::vector<MeshVertex>& vertices) {
+    const size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    // The cache optimized order starts over where a triangle misses the
+    // cache with all of its vertices, which is where it can be split
+    // without costing vertex cache hits
+    std::vector<size_t> cluster_starts;
+    std::vector<uint32_t> timestamps(vertices.size(), 0);
+    uint32_t time = k_vertex_cache_size + 1;
+    for (size_t t = 0; t < triangle_count; t++) {
+        uint32_t misses = 0;
+        for (size_t k = 0; k < 3; k++) {
+            uint32_t& timestamp = timestamps[indices[t * 3 + k]];
+            if (time - timestamp > k_vertex_cache_size) {
+                timestamp = time++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3) {
+            cluster_starts.push_back(t);
+        }
+    }
+    cluster_starts.push_back(triangle_count);
+
+    // The clusters facing away from the mesh's center are drawn first, as
+    // they are the most likely to occlude the others
+    struct Cluster {
+        size_t first_triangle;
+        size_t triangle_count;
+        float sort_key;
+    };
+    std::vector<Cluster> clusters(cluster_starts.size() - 1);
+    std::vector<glm::vec3> centroids(clusters.size());
+    std::vector<glm::vec3> normals(clusters.size());
+    glm::vec3 mesh_centroid(0.0f);
+    float mesh_area = 0.0f;
+    for (size_t c = 0; c < clusters.size(); c++) {
+        clusters[c].first_triangle = cluster_starts[c];
+        clusters[c].triangle_count = cluster_starts[c + 1] - cluster_starts[c];
+
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = cluster_starts[c]; t < cluster_starts[c + 1]; t++) {
+            const glm::vec3& p0 = vertices[indices[t * 3]].position;
+            const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+            glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+            float triangle_area = glm::length(cross);
+            centroid += (p0 + p1 + p2) * (triangle_area / 3.0f);
+            normal += cross;
+            area += triangle_area;
+        }
+
+        mesh_centroid += centroid;
+        mesh_area += area;
+        centroids[c] = area > 0.0f ? centroid / area : centroid;
+        float length = glm::length(normal);
+        normals[c] = length > 0.0f ? normal / length : normal;
+    }
+    if (mesh_area > 0.0f) {
+        mesh_centroid /= mesh_area;
+    }
+    for (size_t c = 0; c < clusters.size(); c++) {
+        clusters[c].sort_key =
+            glm::dot(centroids[c] - mesh_centroid, normals[c]);
+    }
+
+    std::ranges::stable_sort(clusters, std::ranges::greater{},
+                             &Cluster::sort_key);
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (const Cluster& cluster : clusters) {
+        auto first = indices.begin() + cluster.first_triangle * 3;
+        result.insert(result.end(), first, first + cluster.triangle_count * 3);
+    }
+    indices.swap(result);
+}
+
+void optimize_vertex_fetch(std::vector<MeshVertex>& vertices,
+                           std::vector<uint32_t>& indices) {
+    std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+    std::vector<MeshVertex> result;
+    result.reserve(vertices.size());
+    for (uint32_t& index : indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = static_cast<uint32_t>(result.size());
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(result);
+}
+
+std::vector<PackedMeshVertex>
+pack_vertices(const std::vector<MeshVertex>& vertices,
+              VertexQuantization& quantization) {
+    std::vector<PackedMeshVertex> packed(vertices.size());
+    if (vertices.empty()) {
+        quantization = {};
+        return packed;
+    }
+
+    glm::vec3 min = vertices[0].position;
+    glm::vec3 max = vertices[0].position;
+    for (const auto& vertex : vertices) {
+        min = glm::min(min, vertex.position);
+        max = glm::max(max, vertex.position);
+    }
+    const glm::vec3 extent = max - min;
+    quantization.offset = min;
+    quantization.scale = std::max({extent.x, extent.y, extent.z, 1e-6f});
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const MeshVertex& vertex = vertices[i];
+        glm::vec3 position =
+            (vertex.position - quantization.offset) / quantization.scale;
+        glm::u16vec4 quantized_position =
+            glm::packUnorm<uint16_t>(glm::vec4(position, 0.0f));
+
+        float length = glm::length(vertex.normal);
+        glm::vec2 normal = length > 0.0f
+                               ? encode_octahedral(vertex.normal / length)
+                               : glm::vec2(0.0f);
+        glm::i16vec2 quantized_normal = glm::packSnorm<int16_t>(normal);
+
+        packed[i] = PackedMeshVertex{
+            .position = {quantized_position.x, quantized_position.y,
+                         quantized_position.z, 0},
+            .normal = {quantized_normal.x, quantized_normal.y},
+            .tex_coords = {glm::packHalf1x16(vertex.tex_coords.x),
+                           glm::packHalf1x16(vertex.tex_coords.y)},
+        };
+    }
+    return packed;
+}
+
+std::vector<uint32_t> simplify_mesh(const std::vector<MeshVertex>& vertices,
+                                    const std::vector<uint32_t>& indices,
+                                    size_t target_index_count, float max_error,
+                                    float* result_error) {
+    std::vector<uint32_t> result = indices;
+    double error = 0.0;
+    const size_t vertex_count = vertices.size();
+
+    // The vertices sharing a position with another one are on an attribute
+    // seam, and the ones on an edge of a single triangle are on a border.
+    // Neither are collapsed, so the seams and the silhouette hold.
+    std::vector<uint8_t> locked(vertex_count, 0);
+    std::unordered_map<glm::vec3, uint32_t> positions;
+    positions.reserve(vertex_count);
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        auto [it, inserted] = positions.emplace(vertices[v].position, v);
+        if (!inserted) {
+            locked[v] = 1;
+            locked[it->second] = 1;
+        }
+    }
+
+    std::unordered_map<uint64_t, uint32_t> edge_counts;
+    edge_counts.reserve(result.size());
+    for (size_t i = 0; i + 2 < result.size(); i += 3) {
+        for (size_t e = 0; e < 3; e++) {
+            edge_counts[edge_key(result[i + e], result[i + (e + 1) % 3])]++;
+        }
+    }
+    for (const auto& [key, count] : edge_counts) {
+        if (count == 1) {
+            locked[key >> 32] = 1;
+            locked[key & UINT32_MAX] = 1;
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertex_count);
+    for (size_t i = 0; i + 2 < result.size(); i += 3) {
+        glm::dvec3 p0 = vertices[result[i]].position;
+        glm::dvec3 p1 = vertices[result[i + 1]].position;
+        glm::dvec3 p2 = vertices[result[i + 2]].position;
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if (length <= 0.0) {
+            continue;
+        }
+        normal /= length;
+        Quadric quadric =
+            Quadric::from_plane(normal, -glm::dot(normal, p0), length * 0.5);
+        for (size_t k = 0; k < 3; k++) {
+            quadrics[result[i + k]] += quadric;
+        }
+    }
+
+    std::vector<uint32_t> triangle_offsets(vertex_count + 1);
+    std::vector<uint32_t> vertex_triangles;
+    std::vector<Collapse> collapses;
+    std::vector<uint8_t> touched(vertex_count);
+    std::vector<uint32_t> remap(vertex_count);
+
+    for (size_t pass = 0;
+         pass < k_max_simplify_passes && result.size() > target_index_count;
+         pass++) {
+        const size_t triangle_count = result.size() / 3;
+
+        // The triangles around each vertex
+        std::fill(triangle_offsets.begin(), triangle_offsets.end(), 0);
+        for (uint32_t index : result) {
+            triangle_offsets[index + 1]++;
+        }
+        for (size_t v = 0; v < vertex_count; v++) {
+            triangle_offsets[v + 1] += triangle_offsets[v];
+        }
+        vertex_triangles.resize(result.size());
+        std::vector<uint32_t> fill(triangle_offsets.begin(),
+                                   triangle_offsets.end() - 1);
+        for (size_t i = 0; i < result.size(); i++) {
+            vertex_triangles[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        // The cheapest collapse of every vertex that can be collapsed
+        collapses.clear();
+        for (uint32_t v = 0; v < vertex_count; v++) {
+            if (locked[v]) {
+                continue;
+            }
+            Collapse best{v, v, 0.0};
+            for (uint32_t t = triangle_offsets[v]; t < triangle_offsets[v + 1];
+                 t++) {
+                const uint32_t* triangle = &result[vertex_triangles[t] * 3];
+                for (size_t k = 0; k < 3; k++) {
+                    uint32_t to = triangle[k];
+                    if (to == v) {
+                        continue;
+                    }
+                    Quadric quadric = quadrics[v];
+                    quadric += quadrics[to];
+                    double cost = quadric.error(vertices[to].position);
+                    if (best.to == v || cost < best.cost) {
+                        best = {v, to, cost};
+                    }
+                }
+            }
+            if (best.to != v) {
+                collapses.push_back(best);
+            }
+        }
+        if (collapses.empty()) {
+            break;
+        }
+        std::ranges::sort(collapses, {}, &Collapse::cost);
+
+        // Apply the collapses in order, skipping the ones whose triangles
+        // were already changed in this pass
+        std::fill(touched.begin(), touched.end(), 0);
+        for (uint32_t v = 0; v < vertex_count; v++) {
+            remap[v] = v;
+        }
+        size_t remaining = triangle_count;
+        size_t applied = 0;
+        for (const Collapse& collapse : collapses) {
+            if (remaining * 3 <= target_index_count ||
+                std::sqrt(collapse.cost) > max_error) {
+                break;
+            }
+
+            bool valid = true;
+            size_t removed = 0;
+            for (uint32_t t = triangle_offsets[collapse.from];
+                 valid && t < triangle_offsets[collapse.from + 1]; t++) {
+                const uint32_t* triangle = &result[vertex_triangles[t] * 3];
+                size_t k = 0;
+                while (triangle[k] != collapse.from) {
+                    k++;
+                }
+                uint32_t b = triangle[(k + 1) % 3];
+                uint32_t c = triangle[(k + 2) % 3];
+                valid = !touched[b] && !touched[c];
+                if (b == collapse.to || c == collapse.to) {
+                    removed++;
+                } else if (valid) {
+                    valid = !flips(vertices[collapse.from].position,
+                                   vertices[collapse.to].position,
+                                   vertices[b].position, vertices[c].position);
+                }
+            }
+            if (!valid || touched[collapse.from]) {
+                continue;
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            for (uint32_t t = triangle_offsets[collapse.from];
+                 t < triangle_offsets[collapse.from + 1]; t++) {
+                const uint32_t* triangle = &result[vertex_triangles[t] * 3];
+                touched[triangle[0]] = 1;
+                touched[triangle[1]] = 1;
+                touched[triangle[2]] = 1;
+            }
+            error = std::max(error, std::sqrt(collapse.cost));
+            remaining -= std::min(removed, remaining);
+            applied++;
+        }
+        if (applied == 0) {
+            break;
+        }
+
+        // Drop the triangles that collapsed
+        size_t write = 0;
+        for (size_t i = 0; i + 2 < result.size(); i += 3) {
+            uint32_t a = remap[result[i]];
+            uint32_t b = remap[result[i + 1]];
+            uint32_t c = remap[result[i + 2]];
+            if (a != b && b != c && a != c) {
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+        }
+        result.resize(write);
+    }
+
+    if (result_error) {
+        *result_error = static_cast<float>(error);
+    }
+    return result;
+}
+} // namespace Helios
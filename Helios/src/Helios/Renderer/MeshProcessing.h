@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MeshVertex.h"
+
+namespace Helios {
+/**
+ * \brief Reorder the triangles so their vertices are reused while they are
+ * still in the GPU's post-transform cache (Forsyth's algorithm).
+ */
+void optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertex_count);
+
+/**
+ * \brief Reorder clusters of triangles, keeping the order inside of them,
+ * so the ones facing outwards are drawn first and occlude the others. Run
+ * it after optimize_vertex_cache, whose order it splits into clusters.
+ */
+void optimize_overdraw(std::vector<uint32_t>& indices,
+                       const std::vector<MeshVertex>& vertices);
+
+/**
+ * \brief Reorder the vertices in the order the indices first use them, so
+ * they are fetched sequentially. Unused vertices are removed.
+ */
+void optimize_vertex_fetch(std::vector<MeshVertex>& vertices,
+                           std::vector<uint32_t>& indices);
+
+/**
+ * \brief Convert vertices to the layout used by the vertex buffers.
+ * \param quantization Set to what maps the quantized positions back.
+ */
+std::vector<PackedMeshVertex>
+pack_vertices(const std::vector<MeshVertex>& vertices,
+              VertexQuantization& quantization);
+
+/**
+ * \brief Simplify a triangle mesh by collapsing edges, the ones with the
+ * smallest quadric error first. The vertices are neither moved nor added,
+ * only the indices change, so the result can share the vertex buffer. The
+ * vertices on borders and attribute seams (e.g. UV seams) are kept.
+ * \param target_index_count Stop once there are at most this many indices.
+ * \param max_error The largest error allowed, a distance in mesh units.
+ * \param result_error Set to the error of the result, if not null.
+ * \return The simplified indices.
+ */
+std::vector<uint32_t> simplify_mesh(const std::vector<MeshVertex>& vertices,
+                                    const std::vector<uint32_t>& indices,
+                                    size_t target_index_count, float max_error,
+                                    float* result_error = nullptr);
+} // namespace Helios
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/hash.hpp>
@@ -15,6 +16,24 @@ struct MeshVertex {
                tex_coords == other.tex_coords;
     }
 };
+
+/**
+ * \brief The vertex layout in the vertex buffers, 16 bytes. The position is
+ * quantized in the mesh's bounds (see VertexQuantization), the normal is
+ * octahedral encoded and the texture coordinates are half floats.
+ */
+struct PackedMeshVertex {
+    uint16_t position[4]; // Unorm, w is unused
+    int16_t normal[2];    // Snorm
+    uint16_t tex_coords[2];
+};
+
+// Maps a quantized position (0 to 1) back to mesh space. The scale is the same
+// on every axis, so it doesn't change the normals' directions.
+struct VertexQuantization {
+    glm::vec3 offset = glm::vec3(0.0f);
+    float scale = 1.0f;
+};
 } // namespace Helios
 
 namespace std {
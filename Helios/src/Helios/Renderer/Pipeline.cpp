@@ -26,19 +26,46 @@ void Pipeline::init(const PipelineCreateInfo& info) {
     const VulkanContext& context =
         Application::get().get_vulkan_manager()->get_context();
 
+    // The constants are packed one after the other
+    std::vector<VkSpecializationMapEntry> specialization_entries(
+        info.specialization_constants.size());
+    std::vector<uint32_t> specialization_data(
+        info.specialization_constants.size());
+    for (size_t i = 0; i < info.specialization_constants.size(); i++) {
+        specialization_entries[i] = VkSpecializationMapEntry{
+            .constantID = info.specialization_constants[i].id,
+            .offset = static_cast<uint32_t>(i * sizeof(uint32_t)),
+            .size = sizeof(uint32_t),
+        };
+        specialization_data[i] = info.specialization_constants[i].value;
+    }
+
+    VkSpecializationInfo specialization{};
+    specialization.mapEntryCount =
+        static_cast<uint32_t>(specialization_entries.size());
+    specialization.pMapEntries = specialization_entries.data();
+    specialization.dataSize = specialization_data.size() * sizeof(uint32_t);
+    specialization.pData = specialization_data.data();
+    const VkSpecializationInfo* specialization_info =
+        specialization_entries.empty() ? nullptr : &specialization;
+
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
     vertShaderStageInfo.sType =
         VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
     vertShaderStageInfo.module = info.vertex_shader->get_vk_module();
     vertShaderStageInfo.pName = "main";
+    vertShaderStageInfo.pSpecializationInfo = specialization_info;
 
     VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
     fragShaderStageInfo.sType =
         VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module = info.fragment_shader->get_vk_module();
     fragShaderStageInfo.pName = "main";
+    fragShaderStageInfo.pSpecializationInfo = specialization_info;
+    if (info.fragment_shader) {
+        fragShaderStageInfo.module = info.fragment_shader->get_vk_module();
+    }
 
     VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo,
                                                       fragShaderStageInfo};
@@ -97,9 +124,16 @@ void Pipeline::init(const PipelineCreateInfo& info) {
     multisampling.sampleShadingEnable = VK_FALSE;
     multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
+    std::vector<VkFormat> color_attachment_formats = {
+        info.color_attachment_format};
+    color_attachment_formats.insert(color_attachment_formats.end(),
+                                    info.extra_color_attachment_formats.begin(),
+                                    info.extra_color_attachment_formats.end());
+
+    // The attachments without a blend state don't blend
     std::vector<VkPipelineColorBlendAttachmentState> color_blend_attachments =
         info.color_blend_attachments;
-    if (color_blend_attachments.empty()) {
+    while (color_blend_attachments.size() < color_attachment_formats.size()) {
         VkPipelineColorBlendAttachmentState colorBlendAttachment{};
         colorBlendAttachment.colorWriteMask =
             VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
@@ -114,7 +148,8 @@ void Pipeline::init(const PipelineCreateInfo& info) {
         VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlending.logicOpEnable = VK_FALSE;
     colorBlending.logicOp = VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
+    colorBlending.attachmentCount =
+        static_cast<uint32_t>(color_attachment_formats.size());
     colorBlending.pAttachments = color_blend_attachments.data();
     colorBlending.blendConstants[0] = 0.0f;
     colorBlending.blendConstants[1] = 0.0f;
@@ -152,8 +187,9 @@ void Pipeline::init(const PipelineCreateInfo& info) {
     VkPipelineRenderingCreateInfoKHR dynamicInfo{};
     dynamicInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
     dynamicInfo.pNext = VK_NULL_HANDLE;
-    dynamicInfo.colorAttachmentCount = 1;
-    dynamicInfo.pColorAttachmentFormats = &info.color_attachment_format;
+    dynamicInfo.colorAttachmentCount =
+        static_cast<uint32_t>(color_attachment_formats.size());
+    dynamicInfo.pColorAttachmentFormats = color_attachment_formats.data();
 
     // TODO: Maybe change this
 
@@ -163,16 +199,17 @@ void Pipeline::init(const PipelineCreateInfo& info) {
     VkPipelineDepthStencilStateCreateInfo depthStencil{};
     depthStencil.sType =
         VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depthStencil.depthTestEnable = VK_TRUE;
-    depthStencil.depthWriteEnable = VK_TRUE;
-    depthStencil.depthCompareOp = VK_COMPARE_OP_GREATER;
+    depthStencil.depthTestEnable = info.depth_test ? VK_TRUE : VK_FALSE;
+    depthStencil.depthWriteEnable =
+        info.depth_test && info.depth_write ? VK_TRUE : VK_FALSE;
+    depthStencil.depthCompareOp = info.depth_compare_op;
     depthStencil.depthBoundsTestEnable = VK_FALSE;
     depthStencil.stencilTestEnable = VK_FALSE;
 
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pipelineInfo.pNext = &dynamicInfo;
-    pipelineInfo.stageCount = 2;
+    pipelineInfo.stageCount = info.fragment_shader ? 2 : 1;
     pipelineInfo.pStages = shaderStages;
     pipelineInfo.pVertexInputState = &vertexInputInfo;
     pipelineInfo.pInputAssemblyState = &inputAssembly;
@@ -187,9 +224,12 @@ void Pipeline::init(const PipelineCreateInfo& info) {
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-    if (vkCreateGraphicsPipelines(context.device, VK_NULL_HANDLE, 1,
-                                  &pipelineInfo, nullptr,
-                                  &m_pipeline) != VK_SUCCESS) {
+    VkPipelineCache cache = Application::get()
+                                .get_vulkan_manager()
+                                ->get_pipeline_cache()
+                                .get_vk_cache();
+    if (vkCreateGraphicsPipelines(context.device, cache, 1, &pipelineInfo,
+                                  nullptr, &m_pipeline) != VK_SUCCESS) {
         HL_ERROR("Failed to create graphics pipeline!");
     }
 
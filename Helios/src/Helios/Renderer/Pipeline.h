@@ -1,4 +1,6 @@
 ﻿#pragma once
+#include <compare>
+
 #include "DescriptorSetLayout.h"
 #include "Helios/Core/Core.h"
 #include "Shader.h"
@@ -6,15 +8,32 @@
 
 namespace Helios {
 
+// A 32 bit specialization constant (int, uint, float or bool)
+struct SpecializationConstant {
+    uint32_t id;
+    uint32_t value;
+
+    auto operator<=>(const SpecializationConstant&) const = default;
+};
+
 struct PipelineCreateInfo {
     VkFormat color_attachment_format;
     std::vector<SharedPtr<DescriptorSetLayout>> descriptor_set_layouts;
     SharedPtr<Shader> vertex_shader;
-    SharedPtr<Shader> fragment_shader;
+    SharedPtr<Shader> fragment_shader; // Optional, e.g. depth only passes
     std::vector<VertexBufferDescription> vertex_buffer_descriptions;
     std::vector<VkPushConstantRange> push_constants = {};
     std::vector<VkPipelineColorBlendAttachmentState> color_blend_attachments =
         {};
+    // The formats of the attachments after the first one, e.g. a G-buffer
+    std::vector<VkFormat> extra_color_attachment_formats = {};
+    // If false, the depth attachment is neither tested nor written
+    bool depth_test = true;
+    bool depth_write = true;
+    // The depth is reversed (1 is the near plane)
+    VkCompareOp depth_compare_op = VK_COMPARE_OP_GREATER;
+    // Set in every stage that declares them, the others ignore them
+    std::vector<SpecializationConstant> specialization_constants = {};
 };
 
 class Pipeline {
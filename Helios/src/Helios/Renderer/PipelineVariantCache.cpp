@@ -0,0 +1,22 @@
+#include "PipelineVariantCache.h"
+
+#include <algorithm>
+
+namespace Helios {
+const SharedPtr<Pipeline>&
+PipelineVariantCache::get(std::vector<SpecializationConstant> constants) {
+    std::ranges::sort(constants);
+
+    auto it = m_variants.find(constants);
+    if (it != m_variants.end()) {
+        return it->second;
+    }
+
+    PipelineCreateInfo info = m_info;
+    info.specialization_constants.insert(info.specialization_constants.end(),
+                                         constants.begin(), constants.end());
+    SharedPtr<Pipeline> pipeline = Pipeline::create(info);
+    return m_variants.emplace(std::move(constants), std::move(pipeline))
+        .first->second;
+}
+} // namespace Helios
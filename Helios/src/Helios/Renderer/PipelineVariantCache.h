@@ -0,0 +1,46 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "Pipeline.h"
+
+namespace Helios {
+/**
+ * \brief The variants of a pipeline, one for each set of specialization
+ * constant values. A variant is compiled the first time it's requested.
+ */
+class PipelineVariantCache {
+  public:
+    static std::unique_ptr<PipelineVariantCache>
+    create_unique(const PipelineCreateInfo& info) {
+        std::unique_ptr<PipelineVariantCache> cache =
+            std::make_unique<PipelineVariantCache>();
+        cache->m_info = info;
+        return cache;
+    }
+
+    /**
+     * \brief Get the variant of a set of constant values, compiling it if
+     * needed. They are added to the constants of the create info.
+     * \param constants The constant values, in any order.
+     */
+    const SharedPtr<Pipeline>&
+    get(std::vector<SpecializationConstant> constants);
+
+    size_t size() const { return m_variants.size(); }
+
+    PipelineVariantCache() = default;
+
+    PipelineVariantCache(const PipelineVariantCache&) = delete;
+    PipelineVariantCache& operator=(const PipelineVariantCache&) = delete;
+    PipelineVariantCache(PipelineVariantCache&&) = delete;
+    PipelineVariantCache& operator=(PipelineVariantCache&&) = delete;
+
+  private:
+    PipelineCreateInfo m_info;
+    // Keyed by the constants sorted by id
+    std::map<std::vector<SpecializationConstant>, SharedPtr<Pipeline>>
+        m_variants;
+};
+} // namespace Helios
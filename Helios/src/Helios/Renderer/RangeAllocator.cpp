@@ -0,0 +1,92 @@
+#include "RangeAllocator.h"
+
+namespace Helios {
+uint32_t RangeAllocator::allocate(uint32_t size) {
+    if (size == 0) {
+        return k_invalid_offset;
+    }
+
+    auto best_fit = m_free_by_size.lower_bound(size);
+    if (best_fit == m_free_by_size.end()) {
+        return k_invalid_offset;
+    }
+
+    const uint32_t offset = best_fit->second;
+    const uint32_t free_size = best_fit->first;
+    erase_free(m_free_by_offset.find(offset));
+
+    if (free_size > size) {
+        insert_free(offset + size, free_size - size);
+    }
+    return offset;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    // Merge with the free ranges right after and before
+    auto next = m_free_by_offset.find(offset + size);
+    if (next != m_free_by_offset.end()) {
+        size += next->second;
+        erase_free(next);
+    }
+
+    auto previous = m_free_by_offset.lower_bound(offset);
+    if (previous != m_free_by_offset.begin()) {
+        --previous;
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            erase_free(previous);
+        }
+    }
+
+    insert_free(offset, size);
+}
+
+void RangeAllocator::grow(uint32_t capacity) {
+    if (capacity <= m_capacity) {
+        return;
+    }
+
+    const uint32_t old_capacity = m_capacity;
+    m_capacity = capacity;
+    free(old_capacity, capacity - old_capacity);
+}
+
+void RangeAllocator::reset(uint32_t capacity, uint32_t used) {
+    m_free_by_offset.clear();
+    m_free_by_size.clear();
+    m_capacity = capacity;
+    m_free_size = 0;
+
+    if (used < capacity) {
+        insert_free(used, capacity - used);
+    }
+}
+
+uint32_t RangeAllocator::get_largest_free_range() const {
+    return m_free_by_size.empty() ? 0 : m_free_by_size.rbegin()->first;
+}
+
+void RangeAllocator::insert_free(uint32_t offset, uint32_t size) {
+    m_free_by_offset.emplace(offset, size);
+    m_free_by_size.emplace(size, offset);
+    m_free_size += size;
+}
+
+void RangeAllocator::erase_free(std::map<uint32_t, uint32_t>::iterator it) {
+    auto [first, last] = m_free_by_size.equal_range(it->second);
+    for (auto size_it = first; size_it != last; ++size_it) {
+        if (size_it->second == it->first) {
+            m_free_by_size.erase(size_it);
+            break;
+        }
+    }
+
+    m_free_size -= it->second;
+    m_free_by_offset.erase(it);
+}
+} // namespace Helios
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <map>
+
+namespace Helios {
+/**
+ * \brief Allocates ranges from [0, capacity), e.g. elements of a buffer. The
+ * best fitting free range is used, and freed ranges are merged with their
+ * free neighbours.
+ */
+class RangeAllocator {
+  public:
+    static constexpr uint32_t k_invalid_offset = UINT32_MAX;
+
+    RangeAllocator(uint32_t capacity = 0) { reset(capacity, 0); }
+
+    /**
+     * \brief Allocate a range.
+     * \return The offset, or k_invalid_offset if no free range is big enough.
+     */
+    uint32_t allocate(uint32_t size);
+
+    void free(uint32_t offset, uint32_t size);
+
+    /**
+     * \brief Add free space at the end.
+     */
+    void grow(uint32_t capacity);
+
+    /**
+     * \brief Forget every range, and mark [0, used) as allocated.
+     */
+    void reset(uint32_t capacity, uint32_t used);
+
+    uint32_t get_capacity() const { return m_capacity; }
+    uint32_t get_free_size() const { return m_free_size; }
+    uint32_t get_largest_free_range() const;
+
+  private:
+    void insert_free(uint32_t offset, uint32_t size);
+    void erase_free(std::map<uint32_t, uint32_t>::iterator it);
+
+  private:
+    // Offset -> size, to find the neighbours when freeing
+    std::map<uint32_t, uint32_t> m_free_by_offset;
+    // Size -> offset, to find the best fit
+    std::multimap<uint32_t, uint32_t> m_free_by_size;
+
+    uint32_t m_capacity = 0;
+    uint32_t m_free_size = 0;
+};
+} // namespace Helios
@@ -0,0 +1,75 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+namespace Helios {
+// Below this, sorting by comparison is faster than the histogram passes
+constexpr size_t k_min_radix_sort_items = 64;
+
+namespace {
+uint64_t clamp_bits(uint32_t value, uint32_t bits) {
+    return std::min<uint64_t>(value, (uint64_t(1) << bits) - 1);
+}
+} // namespace
+
+uint64_t RenderQueue::make_key(uint32_t pipeline, uint32_t descriptors,
+                               float depth, uint32_t mesh) {
+    // The bits of a positive float sort like the float itself, so the top
+    // bits of it are a depth with more precision close to the camera. This
+    // also maps -0 (and NaN) to 0.
+    float positive_depth = depth > 0.0f ? depth : 0.0f;
+    uint32_t depth_bits =
+        std::bit_cast<uint32_t>(positive_depth) >> (32 - k_depth_bits);
+
+    uint64_t key = clamp_bits(pipeline, k_pipeline_bits);
+    key = (key << k_descriptor_bits) |
+          clamp_bits(descriptors, k_descriptor_bits);
+    key = (key << k_depth_bits) | depth_bits;
+    key = (key << k_mesh_bits) | clamp_bits(mesh, k_mesh_bits);
+    return key;
+}
+
+void RenderQueue::sort() {
+    if (m_items.size() < k_min_radix_sort_items) {
+        std::stable_sort(
+            m_items.begin(), m_items.end(),
+            [](const RenderQueueItem& lhs, const RenderQueueItem& rhs) {
+                return lhs.key < rhs.key;
+            });
+        return;
+    }
+
+    // Count every byte of every key in one pass
+    std::array<std::array<uint32_t, 256>, 8> histograms{};
+    for (const auto& item : m_items) {
+        for (uint32_t pass = 0; pass < 8; pass++) {
+            histograms[pass][(item.key >> (pass * 8)) & 0xff]++;
+        }
+    }
+
+    m_scratch.resize(m_items.size());
+    for (uint32_t pass = 0; pass < 8; pass++) {
+        auto& histogram = histograms[pass];
+
+        // Every key has the same byte, so this pass wouldn't move anything
+        const uint64_t first_byte = (m_items[0].key >> (pass * 8)) & 0xff;
+        if (histogram[first_byte] == m_items.size()) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (auto& count : histogram) {
+            uint32_t bucket_count = count;
+            count = offset;
+            offset += bucket_count;
+        }
+
+        for (const auto& item : m_items) {
+            m_scratch[histogram[(item.key >> (pass * 8)) & 0xff]++] = item;
+        }
+        m_items.swap(m_scratch);
+    }
+}
+} // namespace Helios
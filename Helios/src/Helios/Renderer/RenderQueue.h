@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Helios {
+struct RenderQueueItem {
+    uint64_t key;
+    // The index of the draw, e.g. in the recorded mesh instances
+    uint32_t index;
+};
+
+/**
+ * \brief Draws ordered by a 64 bit sort key, so draws sharing state end up
+ * next to each other and the state only has to be bound once for them.
+ */
+class RenderQueue {
+  public:
+    static constexpr uint32_t k_pipeline_bits = 12;
+    static constexpr uint32_t k_descriptor_bits = 12;
+    static constexpr uint32_t k_depth_bits = 24;
+    static constexpr uint32_t k_mesh_bits = 16;
+
+    /**
+     * \brief Pack the state of a draw into a sort key. From the most to the
+     * least significant bits: pipeline, descriptor sets (and so the
+     * material), view depth (front to back) and mesh. Ids that don't fit are
+     * clamped, which only costs some redundant binds.
+     * \param pipeline The pipeline id.
+     * \param descriptors The id of the descriptor sets and push constants.
+     * \param depth The view space depth, negative depths sort first.
+     * \param mesh The mesh id.
+     */
+    static uint64_t make_key(uint32_t pipeline, uint32_t descriptors,
+                             float depth, uint32_t mesh);
+
+    void clear() { m_items.clear(); }
+    void reserve(size_t count) { m_items.reserve(count); }
+    void push(uint64_t key, uint32_t index) { m_items.push_back({key, index}); }
+
+    /**
+     * \brief Sort the items by key (LSD radix sort, stable).
+     */
+    void sort();
+
+    const std::vector<RenderQueueItem>& get_items() const { return m_items; }
+    size_t size() const { return m_items.size(); }
+
+  private:
+    std::vector<RenderQueueItem> m_items;
+    std::vector<RenderQueueItem> m_scratch;
+};
+} // namespace Helios
@@ -1,6 +1,8 @@
 #include "Renderer.h"
 #include "Helios/Vulkan/VulkanUtils.h"
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <cwchar>
 #include <volk/volk.h>
 
@@ -21,10 +23,9 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include <filesystem>
-#include <future>
-#include <thread>
 
 #include "ShaderLibrary.h"
 
@@ -37,17 +38,19 @@
 #include "Helios/Core/Application.h"
 #include "Helios/Core/Core.h"
 #include "Helios/Scene/PerspectiveCamera.h"
+#include "InstanceBuffer.h"
 #include "Material.h"
 #include "Pipeline.h"
 #include "SwapChain.h"
 #include "Texture.h"
 #include "TextureLibrary.h"
+#include "TransientAllocator.h"
 #include "UniformBuffer.h"
 #include "VertexBuffer.h"
 #include "VertexBufferDescription.h"
 
 constexpr uint32_t k_min_instances_for_mt = 500;
-constexpr uint32_t k_mesh_instance_preparation_thread_count = 15;
+constexpr uint32_t k_mesh_instance_preparation_job_count = 15;
 
 struct QuadVertex {
     alignas(8) glm::vec2 position;
@@ -58,6 +61,51 @@ struct SkyboxVertex {
     alignas(16) glm::vec3 position;
 };
 
+// cull_instances.comp copies the instances as 3 uvec4s
+static_assert(sizeof(Helios::MeshRenderingShaderInstanceData) ==
+              3 * sizeof(glm::uvec4));
+
+// Matches CullingGroup in cull_instances.comp
+struct GpuCullingGroup {
+    alignas(16) glm::vec4 bounding_sphere;
+    alignas(4) uint32_t instance_base;
+    alignas(4) uint32_t first_instance; // In uvec4s
+    alignas(4) uint32_t instance_count;
+    alignas(4) uint32_t padding;
+};
+
+struct GpuCullingPushConstants {
+    alignas(4) uint32_t instance_count;
+    alignas(4) uint32_t group_count;
+    alignas(4) uint32_t output_offset; // In uvec4s
+};
+
+constexpr uint32_t k_culling_workgroup_size = 64;
+
+// The view is split into a grid of clusters (screen tiles, and exponential
+// depth slices) for the clustered lighting
+constexpr uint32_t k_cluster_grid_x = 16;
+constexpr uint32_t k_cluster_grid_y = 9;
+constexpr uint32_t k_cluster_grid_z = 24;
+constexpr uint32_t k_cluster_count =
+    k_cluster_grid_x * k_cluster_grid_y * k_cluster_grid_z;
+// The lights past this are dropped from a cluster
+constexpr uint32_t k_max_lights_per_cluster = 127;
+constexpr uint32_t k_light_clustering_workgroup_size = 64;
+// A point light's range ends where its attenuation makes it contribute less
+// than this to a fragment
+constexpr float k_point_light_cutoff = 1.0f / 256.0f;
+
+// The G-buffer targets of the deferred path, in the order of gbuffer.frag's
+// outputs: albedo (diffuse, specular), octahedral normal, material (tint,
+// shininess) and linear view depth
+constexpr std::array<VkFormat, 4> k_gbuffer_formats = {
+    VK_FORMAT_R8G8B8A8_UNORM,
+    VK_FORMAT_R16G16_SFLOAT,
+    VK_FORMAT_R16G16B16A16_SFLOAT,
+    VK_FORMAT_R32_SFLOAT,
+};
+
 namespace Helios {
 std::vector<QuadVertex> ui_quad_vertices = {
     {{0.0f, 0.0f}, {0.0f, 1.0f}},
@@ -86,23 +134,20 @@ std::vector<VertexAttribute> quad_instance_attributes = {
 };
 
 std::vector<VertexAttribute> mesh_rendering_vertex_attributes = {
-    {VertexAttributeFormat::FLOAT3, 0}, // position
-    {VertexAttributeFormat::FLOAT3, 1}, // normal
-    {VertexAttributeFormat::FLOAT2, 2}, // Texture Coords
+    // See PackedMeshVertex
+    {VertexAttributeFormat::UNORM16x4, 0}, // Quantized position
+    {VertexAttributeFormat::SNORM16x2, 1}, // Octahedral normal
+    {VertexAttributeFormat::HALF2, 2},     // Texture Coords
 };
 
+// See MeshRenderingShaderInstanceData
 std::vector<VertexAttribute> mesh_rendering_instance_attributes = {
-    {VertexAttributeFormat::FLOAT4, 3}, // Model Col0
-    {VertexAttributeFormat::FLOAT4, 4}, // Model Col1
-    {VertexAttributeFormat::FLOAT4, 5}, // Model Col2
-    {VertexAttributeFormat::FLOAT4, 6}, // Model Col3
-
-    {VertexAttributeFormat::INT32, 7},  // diffuse
-    {VertexAttributeFormat::INT32, 8},  // specular
-    {VertexAttributeFormat::INT32, 9},  // emission
-    {VertexAttributeFormat::FLOAT, 10}, // shininess
-
-    {VertexAttributeFormat::FLOAT4, 11} // tint_color
+    {VertexAttributeFormat::FLOAT3, 3},    // position
+    {VertexAttributeFormat::FLOAT, 4},     // shininess
+    {VertexAttributeFormat::FLOAT3, 5},    // scale
+    {VertexAttributeFormat::UNORM8x4, 6},  // tint_color
+    {VertexAttributeFormat::SNORM16x4, 7}, // rotation
+    {VertexAttributeFormat::UINT16x4, 8},  // diffuse, specular, emission
 };
 
 std::vector<VertexAttribute> skybox_vertex_attributes = {
@@ -142,8 +187,73 @@ struct CameraUniformBuffer {
 struct LightsPushConstantCount {
     int32_t directional_light_count;
     int32_t point_light_count;
+    int32_t clustered;
 };
 
+// The specialization constants of Lighting.frag
+constexpr uint32_t k_directional_light_count_constant = 0;
+constexpr uint32_t k_point_lights_constant = 1;
+// Frames with more directional lights use the variant reading the count from
+// the push constants
+constexpr int32_t k_max_specialized_directional_lights = 1;
+
+std::vector<SpecializationConstant>
+make_lighting_constants(int32_t directional_light_count, bool point_lights) {
+    return {
+        {k_directional_light_count_constant,
+         std::bit_cast<uint32_t>(directional_light_count)},
+        {k_point_lights_constant, point_lights ? 1u : 0u},
+    };
+}
+
+// Compile every variant the frames can select up front
+void prewarm_lighting_variants(PipelineVariantCache& variants) {
+    for (int32_t count = -1; count <= k_max_specialized_directional_lights;
+         count++) {
+        variants.get(make_lighting_constants(count, true));
+        variants.get(make_lighting_constants(count, false));
+    }
+}
+
+// Matches ClusterInfo in cluster_lights.comp, Lighting.frag and
+// deferred_lighting.frag
+struct ClusterInfo {
+    alignas(16) glm::mat4 view;
+    alignas(16) glm::mat4 projection;
+    alignas(16) glm::mat4 inverse_projection;
+    alignas(16) glm::mat4 inverse_view;
+    alignas(16) glm::uvec4 grid_size;
+    alignas(4) float z_near;
+    alignas(4) float z_far;
+    alignas(4) uint32_t point_light_count;
+};
+
+// The distance at which a point light's attenuation drops below the cutoff
+float get_point_light_range(const PointLight& light) {
+    const float intensity = glm::max(
+        glm::max(light.ambient.x, glm::max(light.ambient.y, light.ambient.z)),
+        glm::max(
+            glm::max(light.diffuse.x, glm::max(light.diffuse.y,
+                                               light.diffuse.z)),
+            glm::max(light.specular.x,
+                     glm::max(light.specular.y, light.specular.z))));
+
+    // Solve constant + linear * d + quadratic * d^2 = intensity / cutoff
+    const float c = light.constant - intensity / k_point_light_cutoff;
+    if (c >= 0.0f) {
+        return 0.0f;
+    }
+    if (light.quadratic > 0.0f) {
+        return (-light.linear + std::sqrt(light.linear * light.linear -
+                                          4.0f * light.quadratic * c)) /
+               (2.0f * light.quadratic);
+    }
+    if (light.linear > 0.0f) {
+        return -c / light.linear;
+    }
+    return std::numeric_limits<float>::max(); // Never fades
+}
+
 struct ShaderCubeMaterial {
     int diffuse_texture_unit;
     int specular_texture_unit;
@@ -154,7 +264,7 @@ struct ShaderCubeMaterial {
 void Renderer::init(uint32_t max_frames_in_flight) {
     m_vulkan_state = &Application::get().get_vulkan_manager()->get_context();
     m_max_frames_in_flight = max_frames_in_flight;
-    m_num_threads_for_instancing = k_mesh_instance_preparation_thread_count;
+    m_num_threads_for_instancing = k_mesh_instance_preparation_job_count;
     m_min_instances_for_mt = k_min_instances_for_mt;
 
     // create the command buffers from the pool. We have one for each frame in
@@ -163,6 +273,10 @@ void Renderer::init(uint32_t max_frames_in_flight) {
     for (auto& m_command_buffer : m_command_buffers) {
         m_command_buffer = CommandBuffer::create();
     }
+    m_texture_update_command_buffers.resize(m_max_frames_in_flight);
+    for (auto& command_buffer : m_texture_update_command_buffers) {
+        command_buffer = CommandBuffer::create();
+    }
 
     // Load and create the default shaders. TODO: Move them outside core Helios?
     m_shaders = SharedPtr<ShaderLibrary>::create();
@@ -174,54 +288,146 @@ void Renderer::init(uint32_t max_frames_in_flight) {
     VulkanUtils::create_fences(m_vulkan_state->device, m_max_frames_in_flight,
                                m_main_fences);
 
+    // All the per-frame data (lights, camera...) is sub-allocated from here,
+    // so the frame can be recorded without any intermediate submissions.
+    m_transient_allocator = TransientAllocator::create_unique(
+        m_max_frames_in_flight, k_transient_memory_per_frame);
+    // Instances are written directly to this one, which grows when needed.
+    m_instance_buffer = InstanceBuffer::create_unique(
+        m_max_frames_in_flight, k_initial_instance_buffer_size);
+
     // Textures //
 
+    m_max_textures =
+        std::min(k_max_textures, m_vulkan_state->max_bindless_textures);
+
     m_sampler_descriptor_pool = DescriptorPool::create(
-        m_max_frames_in_flight * 2,
+        m_max_frames_in_flight + 1,
         {VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_SAMPLER,
-                              .descriptorCount = 1 * m_max_frames_in_flight},
+                              .descriptorCount = 1 + k_max_samplers},
          VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-                              .descriptorCount = static_cast<uint32_t>(
-                                  k_max_textures * m_max_frames_in_flight)},
+                              .descriptorCount = m_max_textures},
          VkDescriptorPoolSize{
              .type =
                  VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, // For the skybox
              .descriptorCount = 1 * m_max_frames_in_flight,
-         }});
+         },
+         VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                              .descriptorCount = 2}},
+        VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT);
 
     m_texture_sampler = TextureSampler::create_unique();
 
-    m_texture_array_layout =
-        DescriptorSetLayout::create({DescriptorSetLayoutBinding{
-                                         0,
-                                         VK_DESCRIPTOR_TYPE_SAMPLER,
-                                         VK_SHADER_STAGE_FRAGMENT_BIT,
-                                         1,
-                                     },
-                                     DescriptorSetLayoutBinding{
-                                         1,
-                                         VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-                                         VK_SHADER_STAGE_FRAGMENT_BIT,
-                                         k_max_textures,
-                                     }});
-
-    m_texture_arrays.resize(m_max_frames_in_flight);
-    // Update the first bindings with our sampler. The second binding (for our
-    // images) is updated when new textures are registered.
-    for (size_t i = 0; i < m_max_frames_in_flight; i++) {
-        m_texture_arrays[i] = DescriptorSet::create(
-            m_sampler_descriptor_pool, m_texture_array_layout,
-            {DescriptorSpec{
-                .binding = 0,
-                .type = VK_DESCRIPTOR_TYPE_SAMPLER,
-                .descriptor_class = DescriptorClass::Image,
-                .image_view = VK_NULL_HANDLE,
-                .sampler = m_texture_sampler->get_vk_sampler(),
-            }});
+    // The images are a bindless array. Only the registered slots are valid,
+    // and they are written while the set is bound by the frames in flight.
+    // The mesh shaders pick a sampler per texture from the third binding.
+    // The shaders find a texture index's slot in the fourth one, and the
+    // mesh shaders write the mip levels they sample to the fifth.
+    m_texture_array_layout = DescriptorSetLayout::create(
+        {DescriptorSetLayoutBinding{
+             0,
+             VK_DESCRIPTOR_TYPE_SAMPLER,
+             VK_SHADER_STAGE_FRAGMENT_BIT,
+             1,
+         },
+         DescriptorSetLayoutBinding{
+             1,
+             VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+             VK_SHADER_STAGE_FRAGMENT_BIT,
+             m_max_textures,
+             VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                 VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+         },
+         DescriptorSetLayoutBinding{
+             2,
+             VK_DESCRIPTOR_TYPE_SAMPLER,
+             VK_SHADER_STAGE_FRAGMENT_BIT,
+             k_max_samplers,
+             VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+         },
+         DescriptorSetLayoutBinding{
+             3,
+             VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+             VK_SHADER_STAGE_FRAGMENT_BIT,
+             1,
+         },
+         DescriptorSetLayoutBinding{
+             4,
+             VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+             VK_SHADER_STAGE_FRAGMENT_BIT,
+             1,
+         }});
+
+    m_texture_slots.resize(m_max_textures, 0);
+    m_texture_slot_buffer = Buffer::create(
+        sizeof(uint32_t) * m_max_textures,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_texture_feedback_buffer = Buffer::create(
+        sizeof(uint32_t) * m_max_textures,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_texture_feedback_readbacks.resize(m_max_frames_in_flight);
+    m_texture_feedback_counts.resize(m_max_frames_in_flight, 0);
+    for (auto& readback : m_texture_feedback_readbacks) {
+        readback = Buffer::create(sizeof(uint32_t) * m_max_textures,
+                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                  true);
     }
 
-    // Needed by the default texture creation
-    m_texture_specs.resize(k_max_textures);
+    // Each frame only clears the feedback of the indices used so far, the
+    // others must start cleared (no level sampled)
+    std::vector<uint32_t> cleared_feedback(m_max_textures, UINT32_MAX);
+    Application::get().get_upload_manager().upload_buffer(
+        m_texture_feedback_buffer->get_vk_buffer(), 0,
+        cleared_feedback.data(), sizeof(uint32_t) * m_max_textures,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+    // Update the first binding with our sampler. The second binding (for our
+    // images) is updated one slot at a time, when textures are registered.
+    m_texture_array = DescriptorSet::create(
+        m_sampler_descriptor_pool, m_texture_array_layout,
+        {DescriptorSpec{
+            .binding = 0,
+            .type = VK_DESCRIPTOR_TYPE_SAMPLER,
+            .descriptor_class = DescriptorClass::Image,
+            .image_view = VK_NULL_HANDLE,
+            .sampler = m_texture_sampler->get_vk_sampler(),
+        },
+         DescriptorSpec{
+             .binding = 3,
+             .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+             .descriptor_class = DescriptorClass::Buffer,
+             .buffer = m_texture_slot_buffer,
+         },
+         DescriptorSpec{
+             .binding = 4,
+             .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+             .descriptor_class = DescriptorClass::Buffer,
+             .buffer = m_texture_feedback_buffer,
+         }});
+
+    // Every sampler slot starts as the default state, so a stale index
+    // still samples
+    m_samplers.emplace_back(SamplerSpec{}, TextureSampler::create_unique());
+    std::vector<DescriptorSpec> sampler_specs;
+    for (uint32_t i = 0; i < k_max_samplers; i++) {
+        sampler_specs.push_back(DescriptorSpec{
+            .binding = 2,
+            .type = VK_DESCRIPTOR_TYPE_SAMPLER,
+            .descriptor_class = DescriptorClass::Image,
+            .image_view = VK_NULL_HANDLE,
+            .sampler = m_samplers[0].second->get_vk_sampler(),
+            .dst_array_element = i,
+        });
+    }
+    m_texture_array->update_descriptor_set(sampler_specs);
+    m_pending_texture_frees.resize(m_max_frames_in_flight);
+    m_pending_texture_index_frees.resize(m_max_frames_in_flight);
 
     m_textures = SharedPtr<TextureLibrary>::create();
     create_default_textures(m_textures);
@@ -239,46 +445,78 @@ void Renderer::init(uint32_t max_frames_in_flight) {
 
     m_lights_uniform_pool = DescriptorPool::create(
         m_max_frames_in_flight,
-        {VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        {VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                              .descriptorCount = 2 * m_max_frames_in_flight},
+         VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
                               .descriptorCount = 1 * m_max_frames_in_flight},
-         VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+         VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                               .descriptorCount = 1 * m_max_frames_in_flight}});
 
+    // The lights (and cluster info) are written to the transient buffer
+    // every time they are submitted, so the bindings are dynamic. The
+    // cluster light lists are written by the light clustering pass.
     m_lights_set_layout = DescriptorSetLayout::create(
-        {DescriptorSetLayoutBinding{.binding = 0,
-                                    .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                                    .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-                                    .descriptor_count = 1},
-         DescriptorSetLayoutBinding{.binding = 1,
-                                    .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                                    .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-                                    .descriptor_count = 1}});
-
-    m_directional_lights_uniform_buffers.resize(m_max_frames_in_flight);
-    m_point_lights_uniform_buffers.resize(m_max_frames_in_flight);
+        {DescriptorSetLayoutBinding{
+             .binding = 0,
+             .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+             .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+             .descriptor_count = 1},
+         DescriptorSetLayoutBinding{
+             .binding = 1,
+             .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+             .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+             .descriptor_count = 1},
+         DescriptorSetLayoutBinding{
+             .binding = 2,
+             .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+             .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+             .descriptor_count = 1},
+         DescriptorSetLayoutBinding{
+             .binding = 3,
+             .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+             .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+             .descriptor_count = 1}});
+
     m_lights_set.resize(m_max_frames_in_flight);
+    m_cluster_light_buffers.resize(m_max_frames_in_flight);
 
     for (size_t i = 0; i < m_max_frames_in_flight; i++) {
-        m_directional_lights_uniform_buffers[i] = UniformBuffer::create_unique(
-            sizeof(DirectionalLight) * k_max_directional_lights);
-        m_point_lights_uniform_buffers[i] = UniformBuffer::create_unique(
-            sizeof(PointLight) * k_max_point_lights);
+        // The light count, and the light indices of every cluster
+        m_cluster_light_buffers[i] = Buffer::create(
+            sizeof(uint32_t) * k_cluster_count * (k_max_lights_per_cluster + 1),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
         m_lights_set[i] = DescriptorSet::create_unique(
             m_lights_uniform_pool, m_lights_set_layout,
             {
                 DescriptorSpec{
                     .binding = 0,
-                    .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                    .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                     .descriptor_class = DescriptorClass::Buffer,
-                    .buffer =
-                        m_directional_lights_uniform_buffers[i]->get_buffer(),
-                    .descriptor_count = 1},
+                    .buffer = m_transient_allocator->get_buffer(i),
+                    .descriptor_count = 1,
+                    .buffer_range =
+                        sizeof(DirectionalLight) * k_max_directional_lights},
                 DescriptorSpec{
                     .binding = 1,
-                    .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                    .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
                     .descriptor_class = DescriptorClass::Buffer,
-                    .buffer = m_point_lights_uniform_buffers[i]->get_buffer(),
+                    .buffer = m_transient_allocator->get_buffer(i),
+                    .descriptor_count = 1,
+                    .buffer_range = VK_WHOLE_SIZE},
+                DescriptorSpec{
+                    .binding = 2,
+                    .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                    .descriptor_class = DescriptorClass::Buffer,
+                    .buffer = m_transient_allocator->get_buffer(i),
+                    .descriptor_count = 1,
+                    .buffer_range = sizeof(ClusterInfo)},
+                DescriptorSpec{
+                    .binding = 3,
+                    .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .descriptor_class = DescriptorClass::Buffer,
+                    .buffer = m_cluster_light_buffers[i],
                     .descriptor_count = 1},
             });
     }
@@ -290,13 +528,6 @@ void Renderer::init(uint32_t max_frames_in_flight) {
 
     // Instancing
     m_mesh_rendering_instances.resize(m_max_frames_in_flight);
-    m_mesh_rendering_shader_instances.resize(m_max_frames_in_flight);
-    m_mesh_rendering_instances_buffers.resize(m_max_frames_in_flight);
-
-    for (uint32_t i = 0; i < m_max_frames_in_flight; i++) {
-        m_mesh_rendering_instances_buffers[i] = VertexBuffer::create(
-            nullptr, sizeof(MeshRenderingShaderInstanceData) * k_max_meshes);
-    }
 
     // Cube //
     m_cube_mesh = Application::get().get_asset_manager().get_mesh("Cube");
@@ -306,6 +537,10 @@ void Renderer::init(uint32_t max_frames_in_flight) {
     setup_lighting_pipeline();
     setup_skybox_pipeline();
     setup_ui_quad_pipeline();
+    setup_gpu_culling();
+    setup_light_clustering();
+    setup_deferred_pipeline();
+    setup_depth_prepass();
     create_ui_camera();
 
     load_fonts();
@@ -322,43 +557,78 @@ void Renderer::shutdown() {
 }
 
 void Renderer::begin_rendering(const BeginRenderingSpec& spec) {
+    begin_rendering(spec, false);
+}
+
+void Renderer::begin_rendering(const BeginRenderingSpec& spec, bool gbuffer) {
     uint32_t width =
         spec.width == 0 ? m_swapchain->get_vk_extent().width : spec.width;
     uint32_t height =
         spec.height == 0 ? m_swapchain->get_vk_extent().height : spec.height;
 
-    VkRenderingAttachmentInfoKHR color_attachment_info{};
-    color_attachment_info.sType =
-        VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
-    color_attachment_info.clearValue.color = {
-        spec.color_clear_value.r, spec.color_clear_value.g,
-        spec.color_clear_value.b, spec.color_clear_value.a};
-    color_attachment_info.loadOp = spec.color_load_op;
-    color_attachment_info.storeOp = spec.color_store_op;
-    color_attachment_info.imageLayout = spec.color_image_layout;
-
-    VkImage color_image;
-    if (spec.color_image == nullptr) {
-        color_attachment_info.imageView =
-            m_swapchain->get_vk_image_view(m_current_image_index);
-        color_image = m_swapchain->get_vk_image(m_current_image_index);
+    std::vector<VkRenderingAttachmentInfoKHR> color_attachment_infos;
+    if (gbuffer) {
+        // The G-buffer replaces the color attachment. It's cleared to 0,
+        // which marks the pixels without any geometry.
+        for (const auto& target : m_gbuffer_targets) {
+            VkRenderingAttachmentInfoKHR& target_info =
+                color_attachment_infos.emplace_back();
+            target_info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+            target_info.imageView = target->get_vk_image_view();
+            target_info.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            target_info.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            target_info.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            target_info.clearValue.color = {0.0f, 0.0f, 0.0f, 0.0f};
+
+            // The previous lighting pass may still be reading it
+            VulkanUtils::transition_image_layout(
+                {.image = target->get_vk_image(),
+                 .old_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+                 .new_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                 .src_access_mask = VK_ACCESS_SHADER_READ_BIT,
+                 .dst_access_mask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                 .src_stage_mask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                 .dst_stage_mask =
+                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                 .command_buffer =
+                     m_command_buffers[m_current_frame]->get_command_buffer()});
+        }
     } else {
-        color_attachment_info.imageView = spec.color_image->get_vk_image_view();
-        color_image = spec.color_image->get_vk_image();
-    }
+        VkRenderingAttachmentInfoKHR& color_attachment_info =
+            color_attachment_infos.emplace_back();
+        color_attachment_info.sType =
+            VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        color_attachment_info.clearValue.color = {
+            spec.color_clear_value.r, spec.color_clear_value.g,
+            spec.color_clear_value.b, spec.color_clear_value.a};
+        color_attachment_info.loadOp = spec.color_load_op;
+        color_attachment_info.storeOp = spec.color_store_op;
+        color_attachment_info.imageLayout = spec.color_image_layout;
+
+        VkImage color_image;
+        if (spec.color_image == nullptr) {
+            color_attachment_info.imageView =
+                m_swapchain->get_vk_image_view(m_current_image_index);
+            color_image = m_swapchain->get_vk_image(m_current_image_index);
+        } else {
+            color_attachment_info.imageView =
+                spec.color_image->get_vk_image_view();
+            color_image = spec.color_image->get_vk_image();
+        }
 
-    // Synchronize from previous begin_rendering??
-    VulkanUtils::transition_image_layout(
-        {.image = color_image,
-         .old_layout = spec.color_image_layout,
-         .new_layout = spec.color_image_layout,
-         .src_access_mask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-         .dst_access_mask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-         .src_stage_mask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-         .dst_stage_mask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-         .dependency_flags = VK_DEPENDENCY_BY_REGION_BIT,
-         .command_buffer =
-             m_command_buffers[m_current_frame]->get_command_buffer()});
+        // Synchronize from previous begin_rendering??
+        VulkanUtils::transition_image_layout(
+            {.image = color_image,
+             .old_layout = spec.color_image_layout,
+             .new_layout = spec.color_image_layout,
+             .src_access_mask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+             .dst_access_mask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+             .src_stage_mask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+             .dst_stage_mask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+             .dependency_flags = VK_DEPENDENCY_BY_REGION_BIT,
+             .command_buffer =
+                 m_command_buffers[m_current_frame]->get_command_buffer()});
+    }
 
     VkRenderingAttachmentInfoKHR depth_attachment_info{};
     depth_attachment_info.sType =
@@ -396,8 +666,9 @@ void Renderer::begin_rendering(const BeginRenderingSpec& spec) {
     render_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
     render_info.renderArea = VkRect2D{VkOffset2D{}, VkExtent2D{width, height}};
     render_info.layerCount = 1;
-    render_info.colorAttachmentCount = 1;
-    render_info.pColorAttachments = &color_attachment_info;
+    render_info.colorAttachmentCount =
+        static_cast<uint32_t>(color_attachment_infos.size());
+    render_info.pColorAttachments = color_attachment_infos.data();
     render_info.pDepthAttachment = &depth_attachment_info;
 
     VulkanUtils::cmd_begin_rendering_khr(
@@ -429,73 +700,569 @@ void Renderer::end_rendering() {
 
 void Renderer::submit_mesh_instances(
     const BeginRenderingSpec& begin_rendering_spec) {
-    // Update the current mesh instance buffer
-    if (!m_mesh_rendering_shader_instances[m_current_frame].empty()) {
-        // Copy the buffer
-
-        memcpy(m_instance_staging_buffer->get_mapped_memory(),
-               m_mesh_rendering_shader_instances[m_current_frame].data(),
-               sizeof(MeshRenderingShaderInstanceData) *
-                   m_mesh_rendering_shader_instances[m_current_frame].size());
-
-        VulkanUtils::copy_buffer(
-            m_instance_staging_buffer->get_vk_buffer(),
-            m_mesh_rendering_instances_buffers[m_current_frame]
-                ->get_vk_buffer(),
-            sizeof(MeshRenderingShaderInstanceData) *
-                m_mesh_rendering_shader_instances[m_current_frame].size(),
-            m_vulkan_state->device, VK_NULL_HANDLE, VK_NULL_HANDLE,
-            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-            m_command_buffers[m_current_frame]->get_command_buffer());
-    }
-
-    // Update the lighting
-
-    memcpy(m_directional_lights_uniform_buffers[m_current_frame]
-               ->get_mapped_data(),
-           m_directional_lights[m_current_frame].data(),
-           sizeof(DirectionalLight) *
-               m_directional_lights[m_current_frame].size());
+    // The instances were written to the instance buffer by draw_mesh. The
+    // memory is host coherent, so no copy or barrier is needed.
+    upload_lights();
+    cluster_lights();
 
-    memcpy(m_point_lights_uniform_buffers[m_current_frame]->get_mapped_data(),
-           m_point_lights[m_current_frame].data(),
-           sizeof(PointLight) * m_point_lights[m_current_frame].size());
+    render_meshes(begin_rendering_spec, false);
 
-    begin_rendering(begin_rendering_spec);
-    {
-        draw_meshes();
+    m_mesh_rendering_instances[m_current_frame].clear();
+
+    m_directional_lights[m_current_frame].clear();
+    m_point_lights[m_current_frame].clear();
+}
+
+void Renderer::submit_views(const std::vector<RenderView>& views) {
+    upload_lights();
+
+    m_gpu_culling_active =
+        m_gpu_driven_rendering && cull_instances_on_gpu(views);
+
+    for (size_t i = 0; i < views.size(); i++) {
+        const RenderView& view = views[i];
+        m_current_view = static_cast<uint32_t>(i);
+
+        // Every view gets its own camera constants, the instances and
+        // lights are shared
+        set_perspective_camera(view.camera);
+        update_camera_uniform();
+        // The clusters are in view space
+        if (view.draw_meshes) {
+            cluster_lights();
+        }
+
+        // The skybox is drawn last, so the meshes' depth rejects it
+        const bool skybox = view.render_skybox && m_skybox_texture;
+        if (view.draw_meshes) {
+            render_meshes(view.begin_rendering_spec, skybox);
+        } else {
+            begin_rendering(view.begin_rendering_spec);
+            if (skybox) {
+                draw_skybox();
+            }
+            end_rendering();
+        }
     }
-    end_rendering();
+
+    m_gpu_culling_active = false;
+    m_current_view = 0;
 
     m_mesh_rendering_instances[m_current_frame].clear();
-    m_mesh_rendering_shader_instances[m_current_frame].clear();
 
     m_directional_lights[m_current_frame].clear();
     m_point_lights[m_current_frame].clear();
 }
 
+void Renderer::render_meshes(const BeginRenderingSpec& spec, bool skybox) {
+    const uint32_t width =
+        spec.width == 0 ? m_swapchain->get_vk_extent().width : spec.width;
+    const uint32_t height =
+        spec.height == 0 ? m_swapchain->get_vk_extent().height : spec.height;
+
+    if (m_render_path != RenderPath::Deferred ||
+        !m_deferred_lighting_pipeline || !prepare_gbuffer(width, height)) {
+        begin_rendering(spec);
+        if (m_depth_prepass && m_depth_prepass_pipeline) {
+            // The depth tests are ordered within the pass, so the lighting
+            // can follow the pre-pass without a barrier
+            draw_meshes(MeshPass::DepthPrepass);
+            draw_meshes(MeshPass::AfterDepthPrepass);
+        } else {
+            draw_meshes();
+        }
+        if (skybox) {
+            draw_skybox();
+        }
+        end_rendering();
+        return;
+    }
+
+    VkCommandBuffer command_buffer =
+        m_command_buffers[m_current_frame]->get_command_buffer();
+
+    // Write the surfaces of the default pipeline's instances. The depth is
+    // kept for the instances drawn forward afterwards.
+    BeginRenderingSpec gbuffer_spec = spec;
+    gbuffer_spec.depth_store_op = VK_ATTACHMENT_STORE_OP_STORE;
+    begin_rendering(gbuffer_spec, true);
+    draw_meshes(MeshPass::GBuffer);
+    end_rendering();
+
+    for (const auto& target : m_gbuffer_targets) {
+        VulkanUtils::transition_image_layout(
+            {.image = target->get_vk_image(),
+             .old_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+             .new_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+             .src_access_mask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+             .dst_access_mask = VK_ACCESS_SHADER_READ_BIT,
+             .src_stage_mask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+             .dst_stage_mask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+             .command_buffer = command_buffer});
+    }
+
+    const Image& depth_image =
+        spec.depth_image ? *spec.depth_image.get() : *m_depth_image;
+    VulkanUtils::transition_image_layout(
+        {.image = depth_image.get_vk_image(),
+         .old_layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+         .new_layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+         .src_access_mask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+         .dst_access_mask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+         .src_stage_mask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+         .dst_stage_mask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                           VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+         .dependency_flags = VK_DEPENDENCY_BY_REGION_BIT,
+         .command_buffer = command_buffer});
+
+    // Shade every covered pixel once, then draw the custom pipelines on top
+    BeginRenderingSpec lighting_spec = spec;
+    lighting_spec.depth_load_op = VK_ATTACHMENT_LOAD_OP_LOAD;
+    begin_rendering(lighting_spec);
+    {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          m_deferred_lighting_pipeline->get_vk_pipeline());
+
+        VkDescriptorSet sets[] = {
+            m_gbuffer_sets[m_current_frame]->get_vk_set(),
+            m_lights_set[m_current_frame]->get_vk_set(),
+        };
+
+        uint32_t dynamic_offsets[] = {
+            m_directional_lights_offset,
+            m_point_lights_offset,
+            m_cluster_info_offset,
+        };
+
+        vkCmdBindDescriptorSets(command_buffer,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                m_deferred_lighting_pipeline->get_vk_layout(),
+                                0, 2, sets, 3, dynamic_offsets);
+
+        LightsPushConstantCount count{
+            .directional_light_count = static_cast<int32_t>(
+                m_directional_lights[m_current_frame].size()),
+            .point_light_count =
+                static_cast<int32_t>(m_point_lights[m_current_frame].size()),
+            .clustered = m_lights_clustered ? 1 : 0};
+
+        vkCmdPushConstants(command_buffer,
+                           m_deferred_lighting_pipeline->get_vk_layout(),
+                           VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                           sizeof(LightsPushConstantCount), &count);
+
+        vkCmdDraw(command_buffer, 3, 1, 0, 0);
+
+        draw_meshes(MeshPass::CustomPipelines);
+        if (skybox) {
+            draw_skybox();
+        }
+    }
+    end_rendering();
+}
+
+bool Renderer::prepare_gbuffer(uint32_t width, uint32_t height) {
+    const bool fits = !m_gbuffer_targets.empty() &&
+                      m_gbuffer_targets[0]->get_width() >= width &&
+                      m_gbuffer_targets[0]->get_height() >= height;
+    if (!fits) {
+        // The targets can't be replaced while this frame's set uses them
+        if (m_gbuffer_set_used_this_frame) {
+            return false;
+        }
+
+        // Grow to fit every view, so they don't recreate it in turns
+        uint32_t gbuffer_width = width;
+        uint32_t gbuffer_height = height;
+        if (!m_gbuffer_targets.empty()) {
+            gbuffer_width =
+                std::max(gbuffer_width, m_gbuffer_targets[0]->get_width());
+            gbuffer_height =
+                std::max(gbuffer_height, m_gbuffer_targets[0]->get_height());
+        }
+
+        // The previous targets are destroyed once the frames in flight are
+        // done with them
+        m_gbuffer_targets.clear();
+        for (VkFormat format : k_gbuffer_formats) {
+            m_gbuffer_targets.push_back(Image::create_unique({
+                .width = gbuffer_width,
+                .height = gbuffer_height,
+                .format = format,
+                .aspect_flags = VK_IMAGE_ASPECT_COLOR_BIT,
+                .tiling = VK_IMAGE_TILING_OPTIMAL,
+                .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                         VK_IMAGE_USAGE_SAMPLED_BIT,
+                .memory_property = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            }));
+        }
+        m_gbuffer_generation++;
+    }
+
+    if (m_gbuffer_set_generations[m_current_frame] != m_gbuffer_generation) {
+        std::vector<DescriptorSpec> specs;
+        for (uint32_t i = 0; i < m_gbuffer_targets.size(); i++) {
+            specs.push_back(DescriptorSpec{
+                .binding = i,
+                .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptor_class = DescriptorClass::Image,
+                .image_view = m_gbuffer_targets[i]->get_vk_image_view(),
+                .sampler = m_texture_sampler->get_vk_sampler(),
+            });
+        }
+        m_gbuffer_sets[m_current_frame]->update_descriptor_set(specs);
+        m_gbuffer_set_generations[m_current_frame] = m_gbuffer_generation;
+    }
+
+    m_gbuffer_set_used_this_frame = true;
+    return true;
+}
+
+void Renderer::upload_lights() {
+    m_directional_lights[m_current_frame].resize(
+        std::min<size_t>(m_directional_lights[m_current_frame].size(),
+                         k_max_directional_lights));
+    auto& point_lights = m_point_lights[m_current_frame];
+
+    // The point lights are stored in a storage buffer, so any number of
+    // them fits (as long as the transient buffer does). Allocate at least
+    // one, so the bindings stay valid.
+    const size_t point_light_slots = std::max<size_t>(point_lights.size(), 1);
+    TransientAllocation dir_lights = m_transient_allocator->allocate_uniform(
+        sizeof(DirectionalLight) * k_max_directional_lights);
+    TransientAllocation gpu_point_lights =
+        m_transient_allocator->allocate_uniform(sizeof(PointLight) *
+                                                point_light_slots);
+    TransientAllocation light_spheres = m_transient_allocator->allocate_uniform(
+        sizeof(glm::vec4) * point_light_slots);
+    if (!dir_lights.is_valid() || !gpu_point_lights.is_valid() ||
+        !light_spheres.is_valid()) {
+        HL_ERROR("Not enough transient memory for {} point lights.",
+                 point_lights.size());
+        m_directional_lights[m_current_frame].clear();
+        point_lights.clear();
+        return;
+    }
+
+    memcpy(dir_lights.mapped_memory,
+           m_directional_lights[m_current_frame].data(),
+           sizeof(DirectionalLight) *
+               m_directional_lights[m_current_frame].size());
+    memcpy(gpu_point_lights.mapped_memory, point_lights.data(),
+           sizeof(PointLight) * point_lights.size());
+
+    // The bounding spheres are used to bin the lights into the clusters
+    auto* spheres = static_cast<glm::vec4*>(light_spheres.mapped_memory);
+    for (size_t i = 0; i < point_lights.size(); i++) {
+        spheres[i] = glm::vec4(point_lights[i].position,
+                               get_point_light_range(point_lights[i]));
+    }
+
+    m_directional_lights_offset = static_cast<uint32_t>(dir_lights.offset);
+    m_point_lights_offset = static_cast<uint32_t>(gpu_point_lights.offset);
+    m_light_spheres_offset = static_cast<uint32_t>(light_spheres.offset);
+}
+
+void Renderer::cluster_lights() {
+    const glm::mat4& projection = m_perspective_camera.projection_matrix;
+    const auto point_light_count =
+        static_cast<uint32_t>(m_point_lights[m_current_frame].size());
+
+    // The near and far planes of a perspectiveRH_ZO projection
+    ClusterInfo info{
+        .view = m_perspective_camera.view_matrix,
+        .projection = projection,
+        .inverse_projection = glm::inverse(projection),
+        .inverse_view = glm::inverse(m_perspective_camera.view_matrix),
+        .grid_size = glm::uvec4(k_cluster_grid_x, k_cluster_grid_y,
+                                k_cluster_grid_z, k_max_lights_per_cluster),
+        .z_near = projection[3][2] / projection[2][2],
+        .z_far = projection[3][2] / (projection[2][2] + 1.0f),
+        .point_light_count = point_light_count,
+    };
+
+    m_lights_clustered = false;
+    TransientAllocation allocation =
+        m_transient_allocator->allocate_uniform(sizeof(ClusterInfo));
+    if (!allocation.is_valid()) {
+        return;
+    }
+    memcpy(allocation.mapped_memory, &info, sizeof(ClusterInfo));
+    m_cluster_info_offset = static_cast<uint32_t>(allocation.offset);
+
+    // Without the clustering pass, every fragment iterates every light
+    if (!m_light_clustering_pipeline || point_light_count == 0) {
+        return;
+    }
+
+    VkCommandBuffer command_buffer =
+        m_command_buffers[m_current_frame]->get_command_buffer();
+    VkBuffer cluster_buffer =
+        m_cluster_light_buffers[m_current_frame]->get_vk_buffer();
+
+    // The previous view may still be reading the clusters
+    VkBufferMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = cluster_buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1,
+                         &barrier, 0, nullptr);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      m_light_clustering_pipeline->get_vk_pipeline());
+
+    uint32_t dynamic_offsets[] = {
+        m_cluster_info_offset,
+        m_light_spheres_offset,
+    };
+    vkCmdBindDescriptorSets(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        m_light_clustering_pipeline->get_vk_layout(), 0, 1,
+        &m_light_clustering_sets[m_current_frame]->get_vk_set(), 2,
+        dynamic_offsets);
+
+    vkCmdDispatch(command_buffer,
+                  (k_cluster_count + k_light_clustering_workgroup_size - 1) /
+                      k_light_clustering_workgroup_size,
+                  1, 1);
+
+    // The fragment shaders read the light lists
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                         1, &barrier, 0, nullptr);
+
+    m_lights_clustered = true;
+}
+
+// The instances culled on the GPU must use the default pipeline, and be in
+// the geometry pool so all of them can be drawn with one indirect draw
+bool is_gpu_cullable(const MeshInstances& instances) {
+    return !instances.custom_pipeline_info.pipeline &&
+           instances.mesh->is_pooled();
+}
+
+bool Renderer::cull_instances_on_gpu(const std::vector<RenderView>& views) {
+    if (!m_culling_pipeline || views.empty()) {
+        return false;
+    }
+
+    auto& mesh_instances = m_mesh_rendering_instances[m_current_frame];
+
+    // Only the instances using the default pipeline (and pooled meshes) are
+    // culled on the GPU
+    uint32_t group_count = 0;
+    uint32_t uint16_group_count = 0;
+    uint32_t instance_count = 0;
+    for (auto& instances : mesh_instances) {
+        instances.culling_group = UINT32_MAX;
+        if (is_gpu_cullable(instances)) {
+            group_count++;
+            instance_count += static_cast<uint32_t>(instances.instance_count);
+            if (instances.mesh->get_index_type() == VK_INDEX_TYPE_UINT16) {
+                uint16_group_count++;
+            }
+        }
+    }
+    if (group_count == 0) {
+        return false;
+    }
+
+    const auto view_count = static_cast<uint32_t>(views.size());
+
+    // The recorded instances must all be in the same buffer, which is not
+    // the case if the instance buffer grew while recording them. Draw them
+    // directly this frame, the next one will fit.
+    SharedPtr<Buffer> input = nullptr;
+    for (const auto& instances : mesh_instances) {
+        if (!is_gpu_cullable(instances)) {
+            continue;
+        }
+        if (!input) {
+            input = instances.instance_buffer;
+        } else if (instances.instance_buffer != input) {
+            return false;
+        }
+    }
+
+    // The visible instances are compacted into the instance buffer, with one
+    // range for each view. It grows if they don't fit, and the culling set
+    // then has to point at the new buffer.
+    const VkDeviceSize output_size =
+        sizeof(MeshRenderingShaderInstanceData) * instance_count * view_count;
+    const bool update_set =
+        m_culling_input_buffers[m_current_frame] != input ||
+        m_culling_output_buffers[m_current_frame] !=
+            m_instance_buffer->get_current_buffer() ||
+        !m_instance_buffer->fits(output_size);
+
+    // The culling set can only be updated before it is used in a frame
+    if (update_set && m_culling_set_used_this_frame) {
+        return false;
+    }
+
+    TransientAllocation groups = m_transient_allocator->allocate_uniform(
+        sizeof(GpuCullingGroup) * group_count);
+    TransientAllocation frustums =
+        m_transient_allocator->allocate_uniform(sizeof(Frustum) * view_count);
+    TransientAllocation commands = m_transient_allocator->allocate_uniform(
+        sizeof(VkDrawIndexedIndirectCommand) * group_count * view_count);
+    if (!groups.is_valid() || !frustums.is_valid() || !commands.is_valid()) {
+        return false;
+    }
+
+    // Allocated once nothing falls back to direct draws, which would waste it
+    TransientAllocation output = m_instance_buffer->allocate(output_size);
+    const SharedPtr<Buffer>& output_buffer =
+        m_instance_buffer->get_current_buffer();
+
+    if (update_set) {
+        m_culling_sets[m_current_frame]->update_descriptor_set({
+            DescriptorSpec{
+                .binding = 2,
+                .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptor_class = DescriptorClass::Buffer,
+                .buffer = input,
+            },
+            DescriptorSpec{
+                .binding = 4,
+                .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptor_class = DescriptorClass::Buffer,
+                .buffer = output_buffer,
+            },
+        });
+        m_culling_input_buffers[m_current_frame] = input;
+        m_culling_output_buffers[m_current_frame] = output_buffer;
+    }
+
+    auto* gpu_groups = static_cast<GpuCullingGroup*>(groups.mapped_memory);
+    auto* gpu_commands =
+        static_cast<VkDrawIndexedIndirectCommand*>(commands.mapped_memory);
+
+    // The groups with 16 bit indices come first, so the groups of each index
+    // type can be drawn with one indirect draw
+    uint32_t uint16_group = 0;
+    uint32_t uint32_group = uint16_group_count;
+    uint32_t instance_base = 0;
+    for (auto& instances : mesh_instances) {
+        if (!is_gpu_cullable(instances)) {
+            continue;
+        }
+
+        const uint32_t group =
+            instances.mesh->get_index_type() == VK_INDEX_TYPE_UINT16
+                ? uint16_group++
+                : uint32_group++;
+        instances.culling_group = group;
+        instances.culling_instance_base = instance_base;
+
+        gpu_groups[group] = GpuCullingGroup{
+            .bounding_sphere = instances.bounding_sphere,
+            .instance_base = instance_base,
+            .first_instance =
+                static_cast<uint32_t>(instances.offset / sizeof(glm::vec4)),
+            .instance_count = static_cast<uint32_t>(instances.instance_count),
+        };
+
+        // The instance counts are filled in by the culling pass. If
+        // supported, the first instance selects the group's range of the
+        // output, so the groups can be drawn with one indirect draw.
+        for (uint32_t view = 0; view < view_count; view++) {
+            gpu_commands[view * group_count + group] =
+                VkDrawIndexedIndirectCommand{
+                    .indexCount = instances.mesh->get_index_count(
+                        instances.lod),
+                    .instanceCount = 0,
+                    .firstIndex =
+                        instances.mesh->get_first_index(instances.lod),
+                    .vertexOffset = instances.mesh->get_vertex_offset(),
+                    .firstInstance =
+                        m_vulkan_state->draw_indirect_first_instance
+                            ? view * instance_count + instance_base
+                            : 0,
+                };
+        }
+
+        instance_base += static_cast<uint32_t>(instances.instance_count);
+    }
+
+    auto* gpu_frustums = static_cast<Frustum*>(frustums.mapped_memory);
+    for (uint32_t view = 0; view < view_count; view++) {
+        gpu_frustums[view] = Frustum::from_view_projection(
+            views[view].camera.view_projection_matrix);
+    }
+
+    VkCommandBuffer command_buffer =
+        m_command_buffers[m_current_frame]->get_command_buffer();
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      m_culling_pipeline->get_vk_pipeline());
+
+    uint32_t dynamic_offsets[] = {
+        static_cast<uint32_t>(groups.offset),
+        static_cast<uint32_t>(frustums.offset),
+        static_cast<uint32_t>(commands.offset),
+    };
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            m_culling_pipeline->get_vk_layout(), 0, 1,
+                            &m_culling_sets[m_current_frame]->get_vk_set(), 3,
+                            dynamic_offsets);
+    m_culling_set_used_this_frame = true;
+
+    GpuCullingPushConstants push_constants{
+        .instance_count = instance_count,
+        .group_count = group_count,
+        .output_offset =
+            static_cast<uint32_t>(output.offset / sizeof(glm::vec4)),
+    };
+    vkCmdPushConstants(command_buffer, m_culling_pipeline->get_vk_layout(),
+                       VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(GpuCullingPushConstants), &push_constants);
+
+    vkCmdDispatch(command_buffer,
+                  (instance_count + k_culling_workgroup_size - 1) /
+                      k_culling_workgroup_size,
+                  view_count, 1);
+
+    // The draws read the commands, and the compacted instances
+    VkMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                         VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+    };
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    m_gpu_culling_group_count = group_count;
+    m_gpu_culling_uint16_group_count = uint16_group_count;
+    m_gpu_culling_instance_count = instance_count;
+    m_gpu_culling_commands = commands;
+    m_gpu_culling_output = output;
+    return true;
+}
+
 void Renderer::submit_ui_quad_instances(
     const BeginRenderingSpec& begin_rendering_spec) {
 
-    // Update the current quad instance buffer
+    // Write the quad instances to the instance buffer
+    m_ui_quad_instances_allocation = {};
     if (!m_ui_quad_shader_instances[m_current_frame].empty()) {
-        // Copy the buffer
-
-        memcpy(m_instance_staging_buffer->get_mapped_memory(),
-               m_ui_quad_shader_instances[m_current_frame].data(),
-               sizeof(UIQuadShaderInstanceData) *
-                   m_ui_quad_shader_instances[m_current_frame].size());
-
-        VulkanUtils::copy_buffer(
-            m_instance_staging_buffer->get_vk_buffer(),
-            m_ui_quad_instances_buffers[m_current_frame]->get_vk_buffer(),
+        m_ui_quad_instances_allocation = m_instance_buffer->allocate(
+            m_ui_quad_shader_instances[m_current_frame].data(),
             sizeof(UIQuadShaderInstanceData) *
-                m_ui_quad_shader_instances[m_current_frame].size(),
-            m_vulkan_state->device, VK_NULL_HANDLE, VK_NULL_HANDLE,
-            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-            m_command_buffers[m_current_frame]->get_command_buffer());
+                m_ui_quad_shader_instances[m_current_frame].size());
     }
 
     begin_rendering(begin_rendering_spec);
@@ -513,33 +1280,36 @@ void Renderer::render_skybox(const BeginRenderingSpec& begin_rendering_spec) {
     }
     begin_rendering(begin_rendering_spec);
     {
-        vkCmdBindPipeline(
-            m_command_buffers[m_current_frame]->get_command_buffer(),
-            VK_PIPELINE_BIND_POINT_GRAPHICS,
-            m_skybox_pipeline->get_vk_pipeline());
-
-        VkDeviceSize offsets[1]{0};
-        vkCmdBindVertexBuffers(
-            m_command_buffers[m_current_frame]->get_command_buffer(), 0, 1,
-            &m_skybox_mesh->get_vertex_buffer()->get_vk_buffer(), offsets);
-        vkCmdBindIndexBuffer(
-            m_command_buffers[m_current_frame]->get_command_buffer(),
-            m_skybox_mesh->get_index_buffer()->get_vk_buffer(), 0,
-            VK_INDEX_TYPE_UINT32);
-        VkDescriptorSet sets[2]{
-            m_skybox_texture_sets[m_current_frame]->get_vk_set(),
-            m_camera_uniform_sets[m_current_frame]->get_vk_set()};
-        vkCmdBindDescriptorSets(
-            m_command_buffers[m_current_frame]->get_command_buffer(),
-            VK_PIPELINE_BIND_POINT_GRAPHICS, m_skybox_pipeline->get_vk_layout(),
-            0, 2, sets, 0, 0);
-        vkCmdDrawIndexed(
-            m_command_buffers[m_current_frame]->get_command_buffer(),
-            m_skybox_mesh->get_index_buffer()->get_index_count(), 1, 0, 0, 0);
+        draw_skybox();
     }
     end_rendering();
 }
 
+void Renderer::draw_skybox() {
+    vkCmdBindPipeline(m_command_buffers[m_current_frame]->get_command_buffer(),
+                      VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      m_skybox_pipeline->get_vk_pipeline());
+
+    VkDeviceSize offsets[1]{0};
+    vkCmdBindVertexBuffers(
+        m_command_buffers[m_current_frame]->get_command_buffer(), 0, 1,
+        &m_skybox_mesh->get_vertex_buffer()->get_vk_buffer(), offsets);
+    vkCmdBindIndexBuffer(
+        m_command_buffers[m_current_frame]->get_command_buffer(),
+        m_skybox_mesh->get_index_buffer()->get_vk_buffer(), 0,
+        VK_INDEX_TYPE_UINT32);
+    VkDescriptorSet sets[2]{
+        m_skybox_texture_sets[m_current_frame]->get_vk_set(),
+        m_camera_uniform_sets[m_current_frame]->get_vk_set()};
+    vkCmdBindDescriptorSets(
+        m_command_buffers[m_current_frame]->get_command_buffer(),
+        VK_PIPELINE_BIND_POINT_GRAPHICS, m_skybox_pipeline->get_vk_layout(), 0,
+        2, sets, 1, &m_camera_uniform_offset);
+    vkCmdDrawIndexed(m_command_buffers[m_current_frame]->get_command_buffer(),
+                     m_skybox_mesh->get_index_buffer()->get_index_count(), 1, 0,
+                     0, 0);
+}
+
 void Renderer::submit_command_buffer() {
     // Check for swap chain recreation?
     end_recording();
@@ -556,9 +1326,11 @@ void Renderer::submit_command_buffer() {
     submit_info.waitSemaphoreCount = 1;
     submit_info.pWaitSemaphores = wait_semaphores;
     submit_info.pWaitDstStageMask = wait_stages;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers =
-        &m_command_buffers[m_current_frame]->get_command_buffer();
+    VkCommandBuffer command_buffers[] = {
+        record_texture_updates(),
+        m_command_buffers[m_current_frame]->get_command_buffer()};
+    submit_info.commandBufferCount = 2;
+    submit_info.pCommandBuffers = command_buffers;
 
     // A little trick, because the final queueSubmit also need the signal. Works
     // because we wait for the queue right after.
@@ -672,6 +1444,20 @@ void Renderer::begin_frame() {
 
     vkWaitForFences(m_vulkan_state->device, 1, fences, VK_TRUE, UINT64_MAX);
 
+    // The GPU is done with this frame, so its transient memory can be reused
+    m_transient_allocator->reset(m_current_frame);
+    m_instance_buffer->reset(m_current_frame);
+    Application::get().get_geometry_pool().begin_frame(m_current_frame);
+    release_texture_slots(m_current_frame);
+    // The feedback of the last frame submitted with this index
+    const auto* feedback = static_cast<const uint32_t*>(
+        m_texture_feedback_readbacks[m_current_frame]->get_mapped_memory());
+    Application::get().get_texture_streamer().update(
+        {feedback, m_texture_feedback_counts[m_current_frame]});
+    m_culling_set_used_this_frame = false;
+    m_gbuffer_set_used_this_frame = false;
+    update_camera_uniform();
+
     VkResult result = vkAcquireNextImageKHR(
         m_vulkan_state->device, m_swapchain->get_vk_swapchain(), UINT64_MAX,
         m_image_available_semaphores[m_current_swapchain_frame]
@@ -691,6 +1477,9 @@ void Renderer::begin_frame() {
 }
 
 void Renderer::end_frame() {
+    // Submitted before the frame, which may use the uploaded resources
+    Application::get().get_upload_manager().flush();
+
     // We don't want to call vkEndCommandBuffer if vkBeginCommandBuffer was
     // never called
     if (m_swapchain_recreated_this_frame) {
@@ -713,9 +1502,11 @@ void Renderer::end_frame() {
     submit_info.waitSemaphoreCount = 1;
     submit_info.pWaitSemaphores = wait_semaphores;
     submit_info.pWaitDstStageMask = wait_stages;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers =
-        &m_command_buffers[m_current_frame]->get_command_buffer();
+    VkCommandBuffer command_buffers[] = {
+        record_texture_updates(),
+        m_command_buffers[m_current_frame]->get_command_buffer()};
+    submit_info.commandBufferCount = 2;
+    submit_info.pCommandBuffers = command_buffers;
     submit_info.signalSemaphoreCount = 1;
     submit_info.pSignalSemaphores = render_available_semaphores;
 
@@ -759,31 +1550,49 @@ int32_t Renderer::register_texture(const Texture& texture) {
         return -1;
     }
 
-    if (m_available_texture_index == k_max_textures) {
-        HL_ERROR("Maximum number of textures reached ({}).", k_max_textures);
+    uint32_t index;
+    if (!m_free_texture_indices.empty()) {
+        index = m_free_texture_indices.back();
+        m_free_texture_indices.pop_back();
+    } else if (m_texture_index_count < m_max_textures) {
+        index = m_texture_index_count++;
+    } else {
+        HL_ERROR("Maximum number of textures reached ({}).", m_max_textures);
         return -1;
     }
 
-    m_texture_specs[m_available_texture_index] =
-        DescriptorSpec{.binding = 1,
-                       .type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-                       .descriptor_class = DescriptorClass::Image,
-                       .image_view = texture.get_image()->get_vk_image_view(),
-                       .dst_array_element = m_available_texture_index};
-
-    // Update all the image view descriptors, for every frame in flight
-    for (size_t i = 0; i < m_texture_arrays.size(); i++) {
-        // We also defer for the current frame because otherwise the command
-        // buffer complains
-        Application::get().get_vulkan_manager()->enqueue_deferred_action(
-            static_cast<uint32_t>(i), [&, i] {
-                m_texture_arrays[i]->update_descriptor_set(m_texture_specs);
-            });
+    uint32_t slot = allocate_texture_slot();
+    if (slot == UINT32_MAX) {
+        m_free_texture_indices.push_back(index);
+        return -1;
     }
 
-    m_available_texture_index++;
+    // The slot is not used by any frame in flight, so it can be written
+    // right away, even while the set is bound
+    write_texture_slot(slot, texture.get_image()->get_vk_image_view());
+    set_texture_slot(index, slot, texture.get_first_level());
 
-    return static_cast<int32_t>(m_available_texture_index - 1);
+    return static_cast<int32_t>(index);
+}
+
+bool Renderer::set_texture_image(int32_t texture_index, const Image& image,
+                                 uint32_t first_level) {
+    if (texture_index < 0 || m_shutting_down) {
+        return false;
+    }
+
+    uint32_t slot = allocate_texture_slot();
+    if (slot == UINT32_MAX) {
+        return false;
+    }
+    write_texture_slot(slot, image.get_vk_image_view());
+
+    // The frames in flight may still sample the old slot
+    uint32_t index = static_cast<uint32_t>(texture_index);
+    m_pending_texture_frees[m_current_frame].push_back(m_texture_slots[index] &
+                                                       0xFFFF);
+    set_texture_slot(index, slot, first_level);
+    return true;
 }
 
 void Renderer::deregister_texture(uint32_t textureIndex, bool cube_texture) {
@@ -793,21 +1602,162 @@ void Renderer::deregister_texture(uint32_t textureIndex, bool cube_texture) {
                         // registration, and deregistration
         return;
     }
+    // It failed to register
+    if (textureIndex >= m_texture_index_count) {
+        return;
+    }
 
-    m_texture_specs[textureIndex] = DescriptorSpec{
-        .binding = 1,
-        .type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-        .descriptor_class = DescriptorClass::Image,
-        .image_view = m_white_texture->get_image()->get_vk_image_view(),
-        .dst_array_element = textureIndex};
+    // The frames in flight may still sample the slot, so it is only
+    // recycled once this frame is done
+    m_pending_texture_frees[m_current_frame].push_back(
+        m_texture_slots[textureIndex] & 0xFFFF);
+    m_pending_texture_index_frees[m_current_frame].push_back(textureIndex);
+}
 
-    // Update all the image view descriptors, for every frame in flight
-    for (size_t i = 0; i < m_texture_arrays.size(); i++) {
-        Application::get().get_vulkan_manager()->enqueue_deferred_action(
-            static_cast<uint32_t>(i), [&, i] {
-                m_texture_arrays[i]->update_descriptor_set(m_texture_specs);
-            });
+uint32_t Renderer::get_sampler_index(const SamplerSpec& spec) {
+    for (uint32_t i = 0; i < m_samplers.size(); i++) {
+        if (m_samplers[i].first == spec) {
+            return i;
+        }
+    }
+
+    if (m_samplers.size() == k_max_samplers) {
+        HL_WARN("Maximum number of sampler states reached ({}), the default "
+                "one is used.",
+                k_max_samplers);
+        return 0;
+    }
+
+    // No draw uses the slot yet, so it can be written while the set is bound
+    uint32_t index = static_cast<uint32_t>(m_samplers.size());
+    m_samplers.emplace_back(spec, TextureSampler::create_unique(spec));
+    m_texture_array->update_descriptor_set(
+        {DescriptorSpec{.binding = 2,
+                        .type = VK_DESCRIPTOR_TYPE_SAMPLER,
+                        .descriptor_class = DescriptorClass::Image,
+                        .image_view = VK_NULL_HANDLE,
+                        .sampler = m_samplers[index].second->get_vk_sampler(),
+                        .dst_array_element = index}});
+    return index;
+}
+
+uint32_t Renderer::allocate_texture_slot() {
+    if (!m_free_texture_slots.empty()) {
+        uint32_t slot = m_free_texture_slots.back();
+        m_free_texture_slots.pop_back();
+        return slot;
+    }
+    if (m_texture_slot_count < m_max_textures) {
+        return m_texture_slot_count++;
+    }
+    HL_ERROR("Maximum number of texture slots reached ({}).", m_max_textures);
+    return UINT32_MAX;
+}
+
+void Renderer::write_texture_slot(uint32_t slot, VkImageView image_view) {
+    m_texture_array->update_descriptor_set(
+        {DescriptorSpec{.binding = 1,
+                        .type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+                        .descriptor_class = DescriptorClass::Image,
+                        .image_view = image_view,
+                        .dst_array_element = slot}});
+}
+
+void Renderer::release_texture_slots(uint32_t frame) {
+    for (uint32_t slot : m_pending_texture_frees[frame]) {
+        // Point the slot at a valid image, in case a stale index is still
+        // used somewhere
+        write_texture_slot(slot,
+                           m_white_texture->get_image()->get_vk_image_view());
+        m_free_texture_slots.push_back(slot);
+    }
+    m_pending_texture_frees[frame].clear();
+
+    // The stale entries of the freed indices are overwritten when they're
+    // reused
+    m_free_texture_indices.insert(m_free_texture_indices.end(),
+                                  m_pending_texture_index_frees[frame].begin(),
+                                  m_pending_texture_index_frees[frame].end());
+    m_pending_texture_index_frees[frame].clear();
+}
+
+void Renderer::set_texture_slot(uint32_t texture_index, uint32_t slot,
+                                uint32_t first_level) {
+    m_texture_slots[texture_index] = slot | first_level << 16;
+    m_dirty_texture_slots.push_back(texture_index);
+}
+
+VkCommandBuffer Renderer::record_texture_updates() {
+    VkCommandBuffer command_buffer =
+        m_texture_update_command_buffers[m_current_frame]->get_command_buffer();
+    vkResetCommandBuffer(command_buffer, 0);
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+        HL_ERROR("Failed to begin recording command buffer!");
+    }
+
+    // After the earlier frames' fragment shaders, which read the slots and
+    // write the feedback
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask =
+        VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+
+    // Read back what the earlier frames sampled, and start over. The count
+    // only grows, the feedback past it is still cleared.
+    VkDeviceSize feedback_size =
+        sizeof(uint32_t) * std::max(m_texture_index_count, 1u);
+    VkBufferCopy region{.srcOffset = 0, .dstOffset = 0, .size = feedback_size};
+    vkCmdCopyBuffer(
+        command_buffer, m_texture_feedback_buffer->get_vk_buffer(),
+        m_texture_feedback_readbacks[m_current_frame]->get_vk_buffer(), 1,
+        &region);
+    m_texture_feedback_counts[m_current_frame] = m_texture_index_count;
+    vkCmdFillBuffer(command_buffer, m_texture_feedback_buffer->get_vk_buffer(),
+                    0, feedback_size, UINT32_MAX);
+
+    // The entries set since the last submit, in runs of consecutive indices
+    std::sort(m_dirty_texture_slots.begin(), m_dirty_texture_slots.end());
+    m_dirty_texture_slots.erase(std::unique(m_dirty_texture_slots.begin(),
+                                            m_dirty_texture_slots.end()),
+                                m_dirty_texture_slots.end());
+    // vkCmdUpdateBuffer copies at most 65536 bytes
+    constexpr size_t max_run = 65536 / sizeof(uint32_t);
+    const std::vector<uint32_t>& dirty = m_dirty_texture_slots;
+    for (size_t i = 0; i < dirty.size();) {
+        size_t end = i + 1;
+        while (end < dirty.size() && end - i < max_run &&
+               dirty[end] == dirty[end - 1] + 1) {
+            end++;
+        }
+        vkCmdUpdateBuffer(
+            command_buffer, m_texture_slot_buffer->get_vk_buffer(),
+            sizeof(uint32_t) * dirty[i], sizeof(uint32_t) * (end - i),
+            &m_texture_slots[dirty[i]]);
+        i = end;
+    }
+    m_dirty_texture_slots.clear();
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT |
+                            VK_ACCESS_SHADER_WRITE_BIT |
+                            VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                             VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+        HL_ERROR("Failed to record command buffer!");
     }
+    return command_buffer;
 }
 
 void Renderer::draw_ui_quad(const Transform& transform, const glm::vec4& color,
@@ -824,131 +1774,142 @@ void Renderer::draw_cube(const std::vector<MeshRenderingInstance>& instances) {
     draw_mesh(m_cube_mesh, instances);
 }
 
-std::vector<MeshRenderingShaderInstanceData>
-prepare_mesh_shader_instances_mt(std::vector<MeshRenderingInstance>&& instances,
-                                 SharedPtr<Texture> gray_texture,
-                                 SharedPtr<Texture> black_texture) {
-
-    std::vector<MeshRenderingShaderInstanceData> data;
-    for (auto& instance : instances) {
-        data.push_back({
-            .model = instance.transform.ToMat4(),
-            .material =
-                ShaderMaterial{
-                    .diffuse_texture_unit =
-                        instance.material == nullptr ||
-                                instance.material->get_diffuse() == nullptr
-                            ? gray_texture->GetTextureIndex()
-                            : instance.material->get_diffuse()
-                                  ->GetTextureIndex(),
-                    .specular_texture_unit =
-                        instance.material == nullptr ||
-                                instance.material->get_specular() == nullptr
-                            ? black_texture->GetTextureIndex()
-                            : instance.material->get_specular()
-                                  ->GetTextureIndex(),
-                    .emission_texture_unit =
-                        instance.material == nullptr ||
-                                instance.material->get_emission() == nullptr
-                            ? black_texture->GetTextureIndex()
-                            : instance.material->get_emission()
-                                  ->GetTextureIndex(),
-                    .shininess = instance.material == nullptr
-                                     ? 32.0f
-                                     : instance.material->get_shininess(),
-                },
-            .tint_color = instance.tint_color,
-        });
+void prepare_mesh_shader_instances(const MeshRenderingInstance* instances,
+                                   size_t count,
+                                   MeshRenderingShaderInstanceData* dst,
+                                   const VertexQuantization& quantization,
+                                   const SharedPtr<Texture>& gray_texture,
+                                   const SharedPtr<Texture>& black_texture) {
+    static_assert(k_max_textures <= UINT16_MAX + 1);
+
+    for (size_t i = 0; i < count; i++) {
+        const auto& instance = instances[i];
+        const Transform& transform = instance.transform;
+        const Material* material = instance.material.get();
+
+        const int32_t diffuse =
+            material == nullptr || material->get_diffuse() == nullptr
+                ? gray_texture->GetTextureIndex()
+                : material->get_diffuse()->GetTextureIndex();
+        const int32_t specular =
+            material == nullptr || material->get_specular() == nullptr
+                ? black_texture->GetTextureIndex()
+                : material->get_specular()->GetTextureIndex();
+        const int32_t emission =
+            material == nullptr || material->get_emission() == nullptr
+                ? black_texture->GetTextureIndex()
+                : material->get_emission()->GetTextureIndex();
+
+        const uint16_t samplers =
+            material == nullptr ? 0 : material->get_sampler_indices();
+
+        const glm::i16vec4 rotation = glm::packSnorm<int16_t>(
+            glm::vec4(transform.rotation.x, transform.rotation.y,
+                      transform.rotation.z, transform.rotation.w));
+
+        // Fold the dequantization in: the quantization box's offset is moved
+        // by the instance's scale and rotation
+        dst[i] = {
+            .position = transform.position +
+                        transform.rotation *
+                            (transform.scale * quantization.offset),
+            .shininess =
+                material == nullptr ? 32.0f : material->get_shininess(),
+            .scale = transform.scale * quantization.scale,
+            .tint_color = glm::packUnorm4x8(instance.tint_color),
+            .rotation = {rotation.x, rotation.y, rotation.z, rotation.w},
+            .texture_units = {static_cast<uint16_t>(diffuse),
+                              static_cast<uint16_t>(specular),
+                              static_cast<uint16_t>(emission), samplers},
+        };
     }
-
-    return data;
 }
 
 void Renderer::draw_mesh(const SharedPtr<Mesh>& geometry,
                          const std::vector<MeshRenderingInstance>& instances,
                          const CustomMeshPipelineInfo& custom_pipeline_info) {
-    m_mesh_rendering_instances[m_current_frame].push_back({
-        .mesh = geometry,
-        .custom_pipeline_info = custom_pipeline_info,
-        .offset = sizeof(MeshRenderingShaderInstanceData) *
-                  m_mesh_rendering_shader_instances[m_current_frame].size(),
-        .instance_count = instances.size(),
-    });
+    if (instances.empty()) {
+        return;
+    }
+
+    // Write the instances straight into the (mapped) instance buffer
+    TransientAllocation allocation = m_instance_buffer->allocate(
+        sizeof(MeshRenderingShaderInstanceData) * instances.size());
+    auto* dst = static_cast<MeshRenderingShaderInstanceData*>(
+        allocation.mapped_memory);
+
+    glm::vec3 centroid(0.0f);
+    for (const auto& instance : instances) {
+        centroid += instance.transform.position;
+    }
+    centroid /= static_cast<float>(instances.size());
+    const VertexQuantization& quantization =
+        geometry->get_vertex_quantization();
+
+    draw_mesh_instances(geometry, m_instance_buffer->get_current_buffer(),
+                        allocation.offset, instances.size(),
+                        custom_pipeline_info, centroid);
 
     if (instances.size() >= m_min_instances_for_mt &&
         m_num_threads_for_instancing > 1) {
-        uint32_t instances_per_thread =
-            instances.size() / m_num_threads_for_instancing;
-        uint32_t remainder = instances.size() % m_num_threads_for_instancing;
-
-        uint32_t offset = 0;
-        uint32_t instances_prepared = 0;
-
-        std::vector<std::future<std::vector<MeshRenderingShaderInstanceData>>>
-            futures(m_num_threads_for_instancing);
-        std::vector<std::vector<MeshRenderingInstance>> instance_batches(
-            m_num_threads_for_instancing);
-        for (uint32_t i = 0; i < m_num_threads_for_instancing; i++) {
-
-            uint32_t num_instances_to_prepare =
-                instances_per_thread +
-                (i < remainder ? 1 : 0); // Distribute the remainder until done
-
-            auto start = instances.begin() + offset;
-            auto end = start + num_instances_to_prepare;
-            instance_batches[i] =
-                std::vector<MeshRenderingInstance>(start, end);
-
-            futures[i] =
-                std::async(std::launch::async, prepare_mesh_shader_instances_mt,
-                           std::move(instance_batches[i]), m_gray_texture,
-                           m_black_texture);
-
-            instances_prepared += num_instances_to_prepare;
-            offset += num_instances_to_prepare;
-        }
-
-        for (auto& future : futures) {
-            auto instances = future.get();
-            m_mesh_rendering_shader_instances[m_current_frame].insert(
-                m_mesh_rendering_shader_instances[m_current_frame].end(),
-                instances.begin(), instances.end());
-        }
-    } else {
-        // Prepare the instances
-        for (auto& instance : instances) {
-            m_mesh_rendering_shader_instances[m_current_frame].push_back({
-                .model = instance.transform.ToMat4(),
-                .material =
-                    ShaderMaterial{
-                        .diffuse_texture_unit =
-                            instance.material == nullptr ||
-                                    instance.material->get_diffuse() == nullptr
-                                ? m_gray_texture->GetTextureIndex()
-                                : instance.material->get_diffuse()
-                                      ->GetTextureIndex(),
-                        .specular_texture_unit =
-                            instance.material == nullptr ||
-                                    instance.material->get_specular() == nullptr
-                                ? m_black_texture->GetTextureIndex()
-                                : instance.material->get_specular()
-                                      ->GetTextureIndex(),
-                        .emission_texture_unit =
-                            instance.material == nullptr ||
-                                    instance.material->get_emission() == nullptr
-                                ? m_black_texture->GetTextureIndex()
-                                : instance.material->get_emission()
-                                      ->GetTextureIndex(),
-                        .shininess = instance.material == nullptr
-                                         ? 32.0f
-                                         : instance.material->get_shininess(),
-                    },
-                .tint_color = instance.tint_color,
+        const size_t batch_size =
+            (instances.size() + m_num_threads_for_instancing - 1) /
+            m_num_threads_for_instancing;
+
+        // Every job writes its own range of the buffer
+        Application::get().get_job_system().parallel_for(
+            instances.size(), batch_size, [&](size_t begin, size_t end) {
+                prepare_mesh_shader_instances(
+                    instances.data() + begin, end - begin, dst + begin,
+                    quantization, m_gray_texture, m_black_texture);
             });
-        }
+    } else {
+        prepare_mesh_shader_instances(instances.data(), instances.size(), dst,
+                                      quantization, m_gray_texture,
+                                      m_black_texture);
     }
 }
 
+void Renderer::draw_mesh_instances(
+    const SharedPtr<Mesh>& geometry, const SharedPtr<Buffer>& instance_buffer,
+    VkDeviceSize offset, size_t instance_count,
+    const CustomMeshPipelineInfo& custom_pipeline_info,
+    const glm::vec3& sort_position, uint32_t lod) {
+    if (instance_count == 0) {
+        return;
+    }
+
+    // The instances' transforms include the dequantization, so the culling
+    // pass needs the bounds in the quantized space
+    const VertexQuantization& quantization =
+        geometry->get_vertex_quantization();
+    const BoundingSphere& bounds = geometry->get_bounding_sphere();
+
+    m_mesh_rendering_instances[m_current_frame].push_back({
+        .mesh = geometry,
+        .custom_pipeline_info = custom_pipeline_info,
+        .instance_buffer = instance_buffer,
+        .offset = offset,
+        .instance_count = instance_count,
+        .lod = lod,
+        .bounding_sphere =
+            geometry->has_bounds()
+                ? glm::vec4(bounds.center - quantization.offset,
+                            bounds.radius) /
+                      quantization.scale
+                : glm::vec4(0.0f, 0.0f, 0.0f, -1.0f),
+        .sort_position = sort_position,
+    });
+}
+
+void Renderer::prepare_mesh_instances(
+    const Mesh& mesh, const MeshRenderingInstance* instances, size_t count,
+    MeshRenderingShaderInstanceData* dst) const {
+    prepare_mesh_shader_instances(instances, count, dst,
+                                  mesh.get_vertex_quantization(),
+                                  m_gray_texture, m_black_texture);
+}
+
 void Renderer::set_perspective_camera(const PerspectiveCamera& camera) {
     m_perspective_camera = camera;
 }
@@ -1008,103 +1969,359 @@ SharedPtr<Texture> Renderer::get_texture(const std::string& key) {
     return texture;
 }
 
-void Renderer::draw_meshes() {
-    for (auto& geometry_instances :
-         m_mesh_rendering_instances[m_current_frame]) {
-
-        if (!geometry_instances.custom_pipeline_info.pipeline) {
-            // Use the normal pipeline
-            vkCmdBindPipeline(
-                m_command_buffers[m_current_frame]->get_command_buffer(),
-                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                m_lighting_pipeline->get_vk_pipeline());
-
-            VkDescriptorSet sets[] = {
-                m_camera_uniform_sets[m_current_frame]->get_vk_set(),
-                m_texture_arrays[m_current_frame]->get_vk_set(),
-                m_lights_set[m_current_frame]->get_vk_set(),
-            };
-
-            vkCmdBindDescriptorSets(
-                m_command_buffers[m_current_frame]->get_command_buffer(),
-                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                m_lighting_pipeline->get_vk_layout(), 0, 3, sets, 0, nullptr);
-
-            LightsPushConstantCount count{
-                .directional_light_count = static_cast<int32_t>(
-                    m_directional_lights[m_current_frame].size()),
-                .point_light_count = static_cast<int32_t>(
-                    m_point_lights[m_current_frame].size())};
-
-            vkCmdPushConstants(
-                m_command_buffers[m_current_frame]->get_command_buffer(),
-                m_lighting_pipeline->get_vk_layout(),
-                VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-                sizeof(LightsPushConstantCount), &count);
+// If two sets of instances bind the same descriptor sets and push constants
+bool has_same_state(const MeshInstances& lhs, const MeshInstances& rhs) {
+    const CustomMeshPipelineInfo& lhs_info = lhs.custom_pipeline_info;
+    const CustomMeshPipelineInfo& rhs_info = rhs.custom_pipeline_info;
+    if (!lhs_info.pipeline || !rhs_info.pipeline) {
+        // The default pipeline always binds the same state
+        return !lhs_info.pipeline && !rhs_info.pipeline;
+    }
 
-        } else {
-            vkCmdBindPipeline(
-                m_command_buffers[m_current_frame]->get_command_buffer(),
-                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                geometry_instances.custom_pipeline_info.pipeline
-                    ->get_vk_pipeline());
-
-            std::vector<VkDescriptorSet> descriptor_sets(
-                geometry_instances.custom_pipeline_info.descriptor_sets.size());
-            for (size_t i = 0;
-                 i <
-                 geometry_instances.custom_pipeline_info.descriptor_sets.size();
-                 i++) {
-                descriptor_sets[i] =
-                    geometry_instances.custom_pipeline_info.descriptor_sets[i]
-                        ->get_vk_set();
+    return lhs_info.descriptor_sets == rhs_info.descriptor_sets &&
+           lhs_info.push_constants.size == rhs_info.push_constants.size &&
+           lhs_info.push_constants.stages == rhs_info.push_constants.stages &&
+           lhs_info.push_constants.data == rhs_info.push_constants.data;
+}
+
+void Renderer::draw_meshes(MeshPass pass) {
+    const auto& mesh_instances = m_mesh_rendering_instances[m_current_frame];
+    build_render_queue(mesh_instances, pass);
+
+    VkCommandBuffer command_buffer =
+        m_command_buffers[m_current_frame]->get_command_buffer();
+
+    const Pipeline* default_pipeline_ptr = nullptr;
+    switch (pass) {
+    case MeshPass::DepthPrepass:
+        default_pipeline_ptr = m_depth_prepass_pipeline.get();
+        break;
+    case MeshPass::AfterDepthPrepass:
+        default_pipeline_ptr =
+            m_lighting_equal_depth_variants->get(get_lighting_constants())
+                .get();
+        break;
+    case MeshPass::GBuffer:
+        default_pipeline_ptr = m_gbuffer_pipeline.get();
+        break;
+    default:
+        default_pipeline_ptr =
+            m_lighting_variants->get(get_lighting_constants()).get();
+        break;
+    }
+    const Pipeline& default_pipeline = *default_pipeline_ptr;
+
+    // Consecutive draws of pooled meshes are merged into one indirect draw,
+    // which needs both features. Otherwise they are drawn one by one.
+    const bool multi_draw = m_vulkan_state->multi_draw_indirect &&
+                            m_vulkan_state->draw_indirect_first_instance;
+
+    // The state bound by the previous draws, which isn't bound again. The
+    // pending indirect draws are flushed before anything is rebound.
+    VkPipeline bound_pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout bound_layout = VK_NULL_HANDLE;
+    const MeshInstances* bound_state = nullptr;
+    VkBuffer bound_index_buffer = VK_NULL_HANDLE;
+    VkIndexType bound_index_type = VK_INDEX_TYPE_UINT32;
+    VkBuffer bound_vertex_buffer = VK_NULL_HANDLE;
+    VkBuffer bound_instance_buffer = VK_NULL_HANDLE;
+    VkDeviceSize bound_instance_offset = 0;
+    bool gpu_culled_drawn = false;
+
+    m_indirect_commands.clear();
+    for (const auto& item : m_render_queue.get_items()) {
+        const MeshInstances& geometry_instances = mesh_instances[item.index];
+        const bool gpu_culled = m_gpu_culling_active &&
+                                geometry_instances.culling_group != UINT32_MAX;
+        if (gpu_culled && gpu_culled_drawn) {
+            continue;
+        }
+
+        const Pipeline& pipeline =
+            geometry_instances.custom_pipeline_info.pipeline
+                ? *geometry_instances.custom_pipeline_info.pipeline.get()
+                : default_pipeline;
+
+        if (pipeline.get_vk_pipeline() != bound_pipeline) {
+            flush_indirect_draws(command_buffer);
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              pipeline.get_vk_pipeline());
+            bound_pipeline = pipeline.get_vk_pipeline();
+        }
+
+        if (pipeline.get_vk_layout() != bound_layout ||
+            bound_state == nullptr ||
+            !has_same_state(*bound_state, geometry_instances)) {
+            flush_indirect_draws(command_buffer);
+            bind_mesh_instances_state(command_buffer, geometry_instances);
+            bound_layout = pipeline.get_vk_layout();
+            bound_state = &geometry_instances;
+        }
+
+        const Mesh& mesh = *geometry_instances.mesh.get();
+        VkBuffer index_buffer = mesh.get_vk_index_buffer();
+        VkIndexType index_type = mesh.get_index_type();
+        if (index_buffer != bound_index_buffer ||
+            index_type != bound_index_type) {
+            flush_indirect_draws(command_buffer);
+            vkCmdBindIndexBuffer(command_buffer, index_buffer, 0, index_type);
+            bound_index_buffer = index_buffer;
+            bound_index_type = index_type;
+        }
+
+        VkBuffer vertex_buffer = mesh.get_vk_vertex_buffer();
+        if (vertex_buffer != bound_vertex_buffer) {
+            flush_indirect_draws(command_buffer);
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer,
+                                   &offset);
+            bound_vertex_buffer = vertex_buffer;
+        }
+
+        if (gpu_culled) {
+            // Draw the instances the culling pass kept for this view. With
+            // first instance support the commands select their range of the
+            // output, otherwise they start at instance 0 and the range has to
+            // be bound at its offset.
+            flush_indirect_draws(command_buffer);
+            VkDeviceSize offset = m_gpu_culling_output.offset;
+            if (!m_vulkan_state->draw_indirect_first_instance) {
+                offset += sizeof(MeshRenderingShaderInstanceData) *
+                          (m_current_view * m_gpu_culling_instance_count +
+                           geometry_instances.culling_instance_base);
+            }
+            if (m_gpu_culling_output.buffer != bound_instance_buffer ||
+                offset != bound_instance_offset) {
+                vkCmdBindVertexBuffers(command_buffer, 1, 1,
+                                       &m_gpu_culling_output.buffer, &offset);
+                bound_instance_buffer = m_gpu_culling_output.buffer;
+                bound_instance_offset = offset;
             }
 
-            vkCmdBindDescriptorSets(
-                m_command_buffers[m_current_frame]->get_command_buffer(),
-                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                geometry_instances.custom_pipeline_info.pipeline
-                    ->get_vk_layout(),
-                0, descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
+            const VkDeviceSize command_size =
+                sizeof(VkDrawIndexedIndirectCommand);
+            const VkDeviceSize view_commands =
+                m_gpu_culling_commands.offset +
+                command_size * m_current_view * m_gpu_culling_group_count;
+            if (multi_draw) {
+                // Every group shares the pool's buffers and the default
+                // state, so they are drawn at once for each index type
+                const uint32_t group_counts[] = {
+                    m_gpu_culling_uint16_group_count,
+                    m_gpu_culling_group_count -
+                        m_gpu_culling_uint16_group_count,
+                };
+                const VkIndexType index_types[] = {VK_INDEX_TYPE_UINT16,
+                                                   VK_INDEX_TYPE_UINT32};
+                uint32_t first_group = 0;
+                for (size_t i = 0; i < 2; i++) {
+                    if (group_counts[i] == 0) {
+                        continue;
+                    }
+                    if (index_types[i] != bound_index_type) {
+                        vkCmdBindIndexBuffer(command_buffer, index_buffer, 0,
+                                             index_types[i]);
+                        bound_index_type = index_types[i];
+                    }
+                    vkCmdDrawIndexedIndirect(
+                        command_buffer, m_gpu_culling_commands.buffer,
+                        view_commands + command_size * first_group,
+                        group_counts[i], command_size);
+                    first_group += group_counts[i];
+                }
+                gpu_culled_drawn = true;
+            } else {
+                vkCmdDrawIndexedIndirect(
+                    command_buffer, m_gpu_culling_commands.buffer,
+                    view_commands +
+                        command_size * geometry_instances.culling_group,
+                    1, command_size);
+            }
+            continue;
+        }
 
-            if (geometry_instances.custom_pipeline_info.push_constants.size >
+        // Draws from the same buffer keep the binding, and select their
+        // instances with the first instance instead
+        VkBuffer instance_buffer =
+            geometry_instances.instance_buffer->get_vk_buffer();
+        const VkDeviceSize instance_size =
+            sizeof(MeshRenderingShaderInstanceData);
+        if (instance_buffer != bound_instance_buffer ||
+            geometry_instances.offset < bound_instance_offset ||
+            (geometry_instances.offset - bound_instance_offset) %
+                    instance_size !=
                 0) {
-                vkCmdPushConstants(
-                    m_command_buffers[m_current_frame]->get_command_buffer(),
-                    geometry_instances.custom_pipeline_info.pipeline
-                        ->get_vk_layout(),
-                    geometry_instances.custom_pipeline_info.push_constants
-                        .stages,
-                    0,
-                    geometry_instances.custom_pipeline_info.push_constants.size,
-                    geometry_instances.custom_pipeline_info.push_constants.data
-                        .data());
+            flush_indirect_draws(command_buffer);
+            VkDeviceSize offset = geometry_instances.offset;
+            vkCmdBindVertexBuffers(command_buffer, 1, 1, &instance_buffer,
+                                   &offset);
+            bound_instance_buffer = instance_buffer;
+            bound_instance_offset = offset;
+        }
+
+        VkDrawIndexedIndirectCommand command{
+            .indexCount = mesh.get_index_count(geometry_instances.lod),
+            .instanceCount =
+                static_cast<uint32_t>(geometry_instances.instance_count),
+            .firstIndex = mesh.get_first_index(geometry_instances.lod),
+            .vertexOffset = mesh.get_vertex_offset(),
+            .firstInstance = static_cast<uint32_t>(
+                (geometry_instances.offset - bound_instance_offset) /
+                instance_size),
+        };
+
+        if (multi_draw) {
+            m_indirect_commands.push_back(command);
+        } else {
+            vkCmdDrawIndexed(command_buffer, command.indexCount,
+                             command.instanceCount, command.firstIndex,
+                             command.vertexOffset, command.firstInstance);
+        }
+    }
+    flush_indirect_draws(command_buffer);
+}
+
+void Renderer::flush_indirect_draws(VkCommandBuffer command_buffer) {
+    if (m_indirect_commands.empty()) {
+        return;
+    }
+
+    const auto draw_count = static_cast<uint32_t>(m_indirect_commands.size());
+    TransientAllocation commands = m_transient_allocator->allocate(
+        m_indirect_commands.data(),
+        sizeof(VkDrawIndexedIndirectCommand) * draw_count);
+
+    if (commands.is_valid()) {
+        vkCmdDrawIndexedIndirect(command_buffer, commands.buffer,
+                                 commands.offset, draw_count,
+                                 sizeof(VkDrawIndexedIndirectCommand));
+    } else {
+        for (const auto& command : m_indirect_commands) {
+            vkCmdDrawIndexed(command_buffer, command.indexCount,
+                             command.instanceCount, command.firstIndex,
+                             command.vertexOffset, command.firstInstance);
+        }
+    }
+    m_indirect_commands.clear();
+}
+
+void Renderer::build_render_queue(
+    const std::vector<MeshInstances>& mesh_instances, MeshPass pass) {
+    // Ids in order of first use, they only have to be unique within the queue
+    std::unordered_map<const Pipeline*, uint32_t> pipeline_ids;
+    std::vector<const MeshInstances*> states;
+    std::unordered_map<const Mesh*, uint32_t> mesh_ids;
+
+    m_render_queue.clear();
+    m_render_queue.reserve(mesh_instances.size());
+    for (uint32_t i = 0; i < mesh_instances.size(); i++) {
+        const MeshInstances& instances = mesh_instances[i];
+        const bool custom_pipeline =
+            instances.custom_pipeline_info.pipeline != nullptr;
+        const bool default_only =
+            pass == MeshPass::DepthPrepass || pass == MeshPass::GBuffer;
+        if ((default_only && custom_pipeline) ||
+            (pass == MeshPass::CustomPipelines && !custom_pipeline)) {
+            continue;
+        }
+
+        // The default pipeline (and its state) sorts first
+        uint32_t pipeline_id = 0;
+        uint32_t state_id = 0;
+        if (const auto* pipeline =
+                instances.custom_pipeline_info.pipeline.get()) {
+            pipeline_id =
+                pipeline_ids.try_emplace(pipeline, pipeline_ids.size() + 1)
+                    .first->second;
+
+            auto state = std::ranges::find_if(states, [&](const auto* other) {
+                return has_same_state(*other, instances);
+            });
+            state_id = std::distance(states.begin(), state) + 1;
+            if (state == states.end()) {
+                states.push_back(&instances);
             }
         }
 
-        VkBuffer buffers[2] = {
-            geometry_instances.mesh->get_vertex_buffer()->get_vk_buffer(),
-            m_mesh_rendering_instances_buffers[m_current_frame]
-                ->get_vk_buffer()};
-        VkDeviceSize offsets[2] = {0, geometry_instances.offset};
-        vkCmdBindVertexBuffers(
-            m_command_buffers[m_current_frame]->get_command_buffer(), 0, 2,
-            buffers, offsets);
+        uint32_t mesh_id =
+            mesh_ids.try_emplace(instances.mesh.get(), mesh_ids.size())
+                .first->second;
 
-        vkCmdBindIndexBuffer(
-            m_command_buffers[m_current_frame]->get_command_buffer(),
-            geometry_instances.mesh->get_index_buffer()->get_vk_buffer(), 0,
-            VK_INDEX_TYPE_UINT32);
+        // The camera looks down -z
+        float depth = -(m_perspective_camera.view_matrix *
+                        glm::vec4(instances.sort_position, 1.0f))
+                           .z;
 
-        vkCmdDrawIndexed(
-            m_command_buffers[m_current_frame]->get_command_buffer(),
-            geometry_instances.mesh->get_index_buffer()->get_index_count(),
-            static_cast<uint32_t>(geometry_instances.instance_count), 0, 0, 0);
+        m_render_queue.push(
+            RenderQueue::make_key(pipeline_id, state_id, depth, mesh_id), i);
+    }
+
+    m_render_queue.sort();
+}
+
+void Renderer::bind_mesh_instances_state(VkCommandBuffer command_buffer,
+                                         const MeshInstances& mesh_instances) {
+    if (!mesh_instances.custom_pipeline_info.pipeline) {
+        VkDescriptorSet sets[] = {
+            m_camera_uniform_sets[m_current_frame]->get_vk_set(),
+            m_texture_array->get_vk_set(),
+            m_lights_set[m_current_frame]->get_vk_set(),
+        };
+
+        uint32_t dynamic_offsets[] = {
+            m_camera_uniform_offset,
+            m_directional_lights_offset,
+            m_point_lights_offset,
+            m_cluster_info_offset,
+        };
+
+        vkCmdBindDescriptorSets(command_buffer,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                m_lighting_pipeline->get_vk_layout(), 0, 3,
+                                sets, 4, dynamic_offsets);
+
+        LightsPushConstantCount count{
+            .directional_light_count = static_cast<int32_t>(
+                m_directional_lights[m_current_frame].size()),
+            .point_light_count =
+                static_cast<int32_t>(m_point_lights[m_current_frame].size()),
+            .clustered = m_lights_clustered ? 1 : 0};
+
+        vkCmdPushConstants(command_buffer,
+                           m_lighting_pipeline->get_vk_layout(),
+                           VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                           sizeof(LightsPushConstantCount), &count);
+        return;
+    }
+
+    const CustomMeshPipelineInfo& info = mesh_instances.custom_pipeline_info;
+
+    std::vector<VkDescriptorSet> descriptor_sets(info.descriptor_sets.size());
+    // The camera set uses a dynamic uniform buffer
+    std::vector<uint32_t> dynamic_offsets;
+    for (size_t i = 0; i < info.descriptor_sets.size(); i++) {
+        const auto& set = info.descriptor_sets[i];
+        descriptor_sets[i] = set->get_vk_set();
+        if (set == m_camera_uniform_sets[m_current_frame]) {
+            dynamic_offsets.push_back(m_camera_uniform_offset);
+        }
+    }
+
+    vkCmdBindDescriptorSets(
+        command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+        info.pipeline->get_vk_layout(), 0, descriptor_sets.size(),
+        descriptor_sets.data(), dynamic_offsets.size(), dynamic_offsets.data());
+
+    if (info.push_constants.size > 0) {
+        vkCmdPushConstants(command_buffer, info.pipeline->get_vk_layout(),
+                           info.push_constants.stages, 0,
+                           info.push_constants.size,
+                           info.push_constants.data.data());
     }
 }
 
 void Renderer::draw_quads() {
-    if (m_ui_quad_shader_instances[m_current_frame].empty()) {
+    if (!m_ui_quad_instances_allocation.is_valid()) {
         return;
     }
 
@@ -1116,9 +2333,9 @@ void Renderer::draw_quads() {
 
     VkBuffer buffers[2]{
         m_ui_quad_mesh->get_vertex_buffer()->get_vk_buffer(),
-        m_ui_quad_instances_buffers[m_current_frame]->get_vk_buffer(),
+        m_ui_quad_instances_allocation.buffer,
     };
-    VkDeviceSize offsets[2] = {0, 0};
+    VkDeviceSize offsets[2] = {0, m_ui_quad_instances_allocation.offset};
 
     vkCmdBindVertexBuffers(
         m_command_buffers[m_current_frame]->get_command_buffer(), 0, 2, buffers,
@@ -1130,13 +2347,13 @@ void Renderer::draw_quads() {
         VK_INDEX_TYPE_UINT32);
 
     VkDescriptorSet sets[2] = {
-        m_texture_arrays[m_current_frame]->get_vk_set(),
+        m_texture_array->get_vk_set(),
         m_camera_uniform_sets[m_current_frame]->get_vk_set()};
 
     vkCmdBindDescriptorSets(
         m_command_buffers[m_current_frame]->get_command_buffer(),
         VK_PIPELINE_BIND_POINT_GRAPHICS, m_ui_quad_pipeline->get_vk_layout(), 0,
-        2, sets, 0, nullptr);
+        2, sets, 1, &m_camera_uniform_offset);
 
     vkCmdDrawIndexed(m_command_buffers[m_current_frame]->get_command_buffer(),
                      m_ui_quad_mesh->get_index_buffer()->get_index_count(),
@@ -1155,21 +2372,6 @@ void Renderer::create_default_textures(
     auto texture = Texture::create("WhiteTexture", data, 1, 1, sizeof(data));
     texture_lib->add_texture(texture);
 
-    // Now update all the slots with the default white texture
-    for (uint32_t i = 0; i < k_max_textures; i++) {
-        m_texture_specs[i] = DescriptorSpec{
-            .binding = 1,
-            .type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-            .descriptor_class = DescriptorClass::Image,
-            .image_view = texture->get_image()->get_vk_image_view(),
-            .dst_array_element = i};
-    }
-
-    // Update all the image view descriptors, for every frame in flight
-    for (size_t i = 0; i < m_texture_arrays.size(); i++) {
-        m_texture_arrays[i]->update_descriptor_set(m_texture_specs);
-    }
-
     // Now create the rest of the textures
     for (int i = 0; i < 1 * 1 * 4; i++) {
         data[i] = 0;
@@ -1234,12 +2436,6 @@ void Renderer::setup_ui_quad_pipeline() {
         VertexInputRate::Instance, 1, quad_instance_attributes);
 
     m_ui_quad_shader_instances.resize(m_max_frames_in_flight);
-    m_ui_quad_instances_buffers.resize(m_max_frames_in_flight);
-
-    for (uint32_t i = 0; i < m_max_frames_in_flight; i++) {
-        m_ui_quad_instances_buffers[i] = VertexBuffer::create(
-            nullptr, sizeof(UIQuadShaderInstanceData) * k_max_ui_quads);
-    }
 
     m_ui_quad_pipeline = Pipeline::create_unique(
         {.color_attachment_format = m_swapchain->get_vk_format(),
@@ -1266,13 +2462,6 @@ void Renderer::setup_ui_quad_pipeline() {
 }
 
 void Renderer::setup_lighting_pipeline() {
-    m_instance_staging_buffer = Buffer::create_unique(
-        sizeof(MeshRenderingShaderInstanceData) * k_max_meshes,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        true);
-
     m_lighting_vertex_shader = m_shaders->get_shader("Lighting.vert");
     m_lighting_fragment_shader = m_shaders->get_shader("Lighting.frag");
 
@@ -1291,8 +2480,21 @@ void Renderer::setup_lighting_pipeline() {
         },
     };
 
+    m_lighting_variants = PipelineVariantCache::create_unique(
+        m_default_lighting_pipeline_create_info);
+    prewarm_lighting_variants(*m_lighting_variants);
     m_lighting_pipeline =
-        Pipeline::create(m_default_lighting_pipeline_create_info);
+        m_lighting_variants->get(make_lighting_constants(-1, true));
+}
+
+std::vector<SpecializationConstant> Renderer::get_lighting_constants() const {
+    const auto directional_light_count = static_cast<int32_t>(
+        m_directional_lights[m_current_frame].size());
+    return make_lighting_constants(
+        directional_light_count <= k_max_specialized_directional_lights
+            ? directional_light_count
+            : -1,
+        !m_point_lights[m_current_frame].empty());
 }
 
 void Renderer::setup_skybox_pipeline() {
@@ -1322,49 +2524,329 @@ void Renderer::setup_skybox_pipeline() {
         sizeof(SkyboxVertex) * skybox_vertices.size(), skybox_indices.data(),
         sizeof(uint32_t) * skybox_indices.size(), skybox_indices.size());
 
-    m_skybox_pipeline = Pipeline::create(
-        {m_swapchain->get_vk_format(),
-         {m_skybox_texture_layout, m_camera_uniform_set_layout},
-         m_skybox_vertex_shader,
-         m_skybox_fragment_shader,
-         {
-             m_skybox_vertex_buffer_description,
-         }});
+    // The skybox is on the far plane (0), so it only passes where nothing
+    // was drawn
+    m_skybox_pipeline = Pipeline::create({
+        .color_attachment_format = m_swapchain->get_vk_format(),
+        .descriptor_set_layouts = {m_skybox_texture_layout,
+                                   m_camera_uniform_set_layout},
+        .vertex_shader = m_skybox_vertex_shader,
+        .fragment_shader = m_skybox_fragment_shader,
+        .vertex_buffer_descriptions = {m_skybox_vertex_buffer_description},
+        .depth_write = false,
+        .depth_compare_op = VK_COMPARE_OP_GREATER_OR_EQUAL,
+    });
 }
 
 void Renderer::setup_camera_uniform() {
     m_camera_uniform_pool = DescriptorPool::create(
         m_max_frames_in_flight,
         {
-            VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                                 .descriptorCount = static_cast<uint32_t>(
-                                     m_max_frames_in_flight)},
+            VkDescriptorPoolSize{
+                .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                .descriptorCount =
+                    static_cast<uint32_t>(m_max_frames_in_flight)},
         });
 
+    // The camera constants are written to the transient buffer each time they
+    // are updated, and selected with a dynamic offset when binding the set.
     m_camera_uniform_set_layout = DescriptorSetLayout::create({
         DescriptorSetLayoutBinding{
             .binding = 0,
-            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
             .stage = VK_SHADER_STAGE_VERTEX_BIT,
             .descriptor_count = 1,
         },
     });
 
-    m_camera_uniform_buffers.resize(m_max_frames_in_flight);
     m_camera_uniform_sets.resize(m_max_frames_in_flight);
     for (size_t i = 0; i < m_max_frames_in_flight; i++) {
-        m_camera_uniform_buffers[i] =
-            UniformBuffer::create_unique(sizeof(CameraUniformBuffer));
         m_camera_uniform_sets[i] = DescriptorSet::create(
             m_camera_uniform_pool, m_camera_uniform_set_layout,
             {
-                DescriptorSpec{.binding = 0,
-                               .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                               .descriptor_class = DescriptorClass::Buffer,
-                               .buffer =
-                                   m_camera_uniform_buffers[i]->get_buffer()},
+                DescriptorSpec{
+                    .binding = 0,
+                    .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                    .descriptor_class = DescriptorClass::Buffer,
+                    .buffer = m_transient_allocator->get_buffer(i),
+                    .buffer_range = sizeof(CameraUniformBuffer)},
+            });
+    }
+}
+
+void Renderer::setup_gpu_culling() {
+    SharedPtr<Shader> culling_shader =
+        m_shaders->get_shader("cull_instances.comp");
+    if (!culling_shader) {
+        HL_WARN("GPU culling is unavailable, the instances are drawn "
+                "directly.");
+        return;
+    }
+
+    m_culling_pool = DescriptorPool::create(
+        m_max_frames_in_flight,
+        {
+            VkDescriptorPoolSize{
+                .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                .descriptorCount = 3 * m_max_frames_in_flight},
+            VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                 .descriptorCount = 2 * m_max_frames_in_flight},
+        });
+
+    // The groups, frustums and commands are written to the transient buffer,
+    // so they are bound with dynamic offsets
+    m_culling_set_layout = DescriptorSetLayout::create({
+        DescriptorSetLayoutBinding{
+            .binding = 0,
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .descriptor_count = 1},
+        DescriptorSetLayoutBinding{
+            .binding = 1,
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .descriptor_count = 1},
+        DescriptorSetLayoutBinding{
+            .binding = 2,
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .descriptor_count = 1},
+        DescriptorSetLayoutBinding{
+            .binding = 3,
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .descriptor_count = 1},
+        DescriptorSetLayoutBinding{
+            .binding = 4,
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .descriptor_count = 1},
+    });
+
+    // The instance buffers are bound when culling, since they can change
+    m_culling_sets.resize(m_max_frames_in_flight);
+    m_culling_input_buffers.resize(m_max_frames_in_flight);
+    m_culling_output_buffers.resize(m_max_frames_in_flight);
+    for (size_t i = 0; i < m_max_frames_in_flight; i++) {
+        const auto& transient_buffer = m_transient_allocator->get_buffer(i);
+        m_culling_sets[i] = DescriptorSet::create_unique(
+            m_culling_pool, m_culling_set_layout,
+            {
+                DescriptorSpec{
+                    .binding = 0,
+                    .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                    .descriptor_class = DescriptorClass::Buffer,
+                    .buffer = transient_buffer,
+                    .buffer_range = VK_WHOLE_SIZE},
+                DescriptorSpec{
+                    .binding = 1,
+                    .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                    .descriptor_class = DescriptorClass::Buffer,
+                    .buffer = transient_buffer,
+                    .buffer_range = VK_WHOLE_SIZE},
+                DescriptorSpec{
+                    .binding = 3,
+                    .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                    .descriptor_class = DescriptorClass::Buffer,
+                    .buffer = transient_buffer,
+                    .buffer_range = VK_WHOLE_SIZE},
             });
     }
+
+    m_culling_pipeline = ComputePipeline::create_unique({
+        .descriptor_set_layouts = {m_culling_set_layout},
+        .compute_shader = culling_shader,
+        .push_constants =
+            {
+                VkPushConstantRange{
+                    .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .offset = 0,
+                    .size = sizeof(GpuCullingPushConstants)},
+            },
+    });
+}
+
+void Renderer::setup_light_clustering() {
+    SharedPtr<Shader> clustering_shader =
+        m_shaders->get_shader("cluster_lights.comp");
+    if (!clustering_shader) {
+        HL_WARN("Light clustering is unavailable, every fragment shades "
+                "every point light.");
+        return;
+    }
+
+    m_light_clustering_pool = DescriptorPool::create(
+        m_max_frames_in_flight,
+        {
+            VkDescriptorPoolSize{
+                .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                .descriptorCount = 1 * m_max_frames_in_flight},
+            VkDescriptorPoolSize{
+                .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                .descriptorCount = 1 * m_max_frames_in_flight},
+            VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                 .descriptorCount = 1 * m_max_frames_in_flight},
+        });
+
+    // The cluster info and light spheres are written to the transient
+    // buffer, so they are bound with dynamic offsets
+    m_light_clustering_set_layout = DescriptorSetLayout::create({
+        DescriptorSetLayoutBinding{
+            .binding = 0,
+            .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .descriptor_count = 1},
+        DescriptorSetLayoutBinding{
+            .binding = 1,
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .descriptor_count = 1},
+        DescriptorSetLayoutBinding{
+            .binding = 2,
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .descriptor_count = 1},
+    });
+
+    m_light_clustering_sets.resize(m_max_frames_in_flight);
+    for (size_t i = 0; i < m_max_frames_in_flight; i++) {
+        const auto& transient_buffer = m_transient_allocator->get_buffer(i);
+        m_light_clustering_sets[i] = DescriptorSet::create_unique(
+            m_light_clustering_pool, m_light_clustering_set_layout,
+            {
+                DescriptorSpec{
+                    .binding = 0,
+                    .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                    .descriptor_class = DescriptorClass::Buffer,
+                    .buffer = transient_buffer,
+                    .buffer_range = sizeof(ClusterInfo)},
+                DescriptorSpec{
+                    .binding = 1,
+                    .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                    .descriptor_class = DescriptorClass::Buffer,
+                    .buffer = transient_buffer,
+                    .buffer_range = VK_WHOLE_SIZE},
+                DescriptorSpec{
+                    .binding = 2,
+                    .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .descriptor_class = DescriptorClass::Buffer,
+                    .buffer = m_cluster_light_buffers[i]},
+            });
+    }
+
+    m_light_clustering_pipeline = ComputePipeline::create_unique({
+        .descriptor_set_layouts = {m_light_clustering_set_layout},
+        .compute_shader = clustering_shader,
+    });
+}
+
+void Renderer::setup_deferred_pipeline() {
+    SharedPtr<Shader> gbuffer_shader = m_shaders->get_shader("gbuffer.frag");
+    SharedPtr<Shader> fullscreen_shader =
+        m_shaders->get_shader("fullscreen.vert");
+    SharedPtr<Shader> lighting_shader =
+        m_shaders->get_shader("deferred_lighting.frag");
+    if (!gbuffer_shader || !fullscreen_shader || !lighting_shader) {
+        HL_WARN("Deferred rendering is unavailable, the meshes are rendered "
+                "forward.");
+        return;
+    }
+
+    const auto target_count = static_cast<uint32_t>(k_gbuffer_formats.size());
+    m_gbuffer_pool = DescriptorPool::create(
+        m_max_frames_in_flight,
+        {
+            VkDescriptorPoolSize{
+                .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = target_count * m_max_frames_in_flight},
+        });
+
+    std::vector<DescriptorSetLayoutBinding> bindings;
+    for (uint32_t i = 0; i < target_count; i++) {
+        bindings.push_back(DescriptorSetLayoutBinding{
+            .binding = i,
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .descriptor_count = 1});
+    }
+    m_gbuffer_set_layout = DescriptorSetLayout::create(bindings);
+
+    // The targets are created (and the sets written) by the first deferred
+    // submission, once the size of the views is known
+    m_gbuffer_sets.resize(m_max_frames_in_flight);
+    m_gbuffer_set_generations.assign(m_max_frames_in_flight, 0);
+    for (size_t i = 0; i < m_max_frames_in_flight; i++) {
+        m_gbuffer_sets[i] =
+            DescriptorSet::create_unique(m_gbuffer_pool, m_gbuffer_set_layout);
+    }
+
+    // The same layout as the lighting pipeline, so the instances bind the
+    // same state in both passes
+    PipelineCreateInfo gbuffer_info = m_default_lighting_pipeline_create_info;
+    gbuffer_info.color_attachment_format = k_gbuffer_formats[0];
+    gbuffer_info.fragment_shader = gbuffer_shader;
+    gbuffer_info.extra_color_attachment_formats = {
+        k_gbuffer_formats.begin() + 1, k_gbuffer_formats.end()};
+    m_gbuffer_pipeline = Pipeline::create(gbuffer_info);
+
+    m_deferred_lighting_pipeline = Pipeline::create_unique({
+        .color_attachment_format = m_swapchain->get_vk_format(),
+        .descriptor_set_layouts = {m_gbuffer_set_layout, m_lights_set_layout},
+        .vertex_shader = fullscreen_shader,
+        .fragment_shader = lighting_shader,
+        .vertex_buffer_descriptions = {},
+        .push_constants =
+            {
+                VkPushConstantRange{
+                    .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+                    .offset = 0,
+                    .size = sizeof(LightsPushConstantCount)},
+            },
+        .depth_test = false,
+    });
+}
+
+void Renderer::setup_depth_prepass() {
+    SharedPtr<Shader> prepass_shader =
+        m_shaders->get_shader("depth_prepass.vert");
+    if (!prepass_shader) {
+        HL_WARN("The depth pre-pass is unavailable.");
+        return;
+    }
+
+    // Only the vertex position, and the instance's position, scale and
+    // rotation, are fetched. The strides are kept, since the same buffers are
+    // bound.
+    VertexBufferDescription vertices = m_meshes_vertices_description;
+    std::erase_if(vertices.attribute_description, [](const auto& attribute) {
+        return attribute.location != 0;
+    });
+    VertexBufferDescription instances =
+        m_mesh_rendering_instance_vertices_description;
+    std::erase_if(instances.attribute_description, [](const auto& attribute) {
+        return attribute.location != 3 && attribute.location != 5 &&
+               attribute.location != 7;
+    });
+
+    // The same layout as the lighting pipeline, so the instances bind the
+    // same state in both passes
+    PipelineCreateInfo prepass_info = m_default_lighting_pipeline_create_info;
+    prepass_info.vertex_shader = prepass_shader;
+    prepass_info.fragment_shader = nullptr;
+    prepass_info.vertex_buffer_descriptions = {vertices, instances};
+    prepass_info.color_blend_attachments = {
+        VkPipelineColorBlendAttachmentState{.colorWriteMask = 0}};
+    m_depth_prepass_pipeline = Pipeline::create_unique(prepass_info);
+
+    // The fragments behind the pre-pass' depth are rejected before shading
+    PipelineCreateInfo lighting_info = m_default_lighting_pipeline_create_info;
+    lighting_info.depth_write = false;
+    lighting_info.depth_compare_op = VK_COMPARE_OP_EQUAL;
+    m_lighting_equal_depth_variants =
+        PipelineVariantCache::create_unique(lighting_info);
+    prewarm_lighting_variants(*m_lighting_equal_depth_variants);
+    m_lighting_equal_depth_pipeline = m_lighting_equal_depth_variants->get(
+        make_lighting_constants(-1, true));
 }
 
 void Renderer::recreate_swapchain() {
@@ -1407,8 +2889,14 @@ void Renderer::update_camera_uniform() {
         .orthographic_proj = m_ui_projection,
     };
 
-    memcpy(m_camera_uniform_buffers[m_current_frame]->get_mapped_data(), &ubo,
-           sizeof(CameraUniformBuffer));
+    TransientAllocation allocation = m_transient_allocator->allocate_uniform(
+        sizeof(CameraUniformBuffer));
+    if (!allocation.is_valid()) {
+        return;
+    }
+
+    memcpy(allocation.mapped_memory, &ubo, sizeof(CameraUniformBuffer));
+    m_camera_uniform_offset = static_cast<uint32_t>(allocation.offset);
 }
 
 void Renderer::set_skybox(const SharedPtr<Texture>& skybox) {
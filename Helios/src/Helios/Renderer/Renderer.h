@@ -3,9 +3,11 @@
 #include <glm/glm.hpp>
 
 #include "CommandBuffer.h"
+#include "ComputePipeline.h"
 #include "DescriptorSet.h"
 #include "FontLibrary.h"
 #include "Helios/Renderer/Semaphore.h"
+#include "InstanceBuffer.h"
 #include "Helios/Scene/PerspectiveCamera.h"
 #include "Helios/Scene/Transform.h"
 #include "Helios/Vulkan/VulkanContext.h"
@@ -13,12 +15,15 @@
 #include "Material.h"
 #include "Mesh.h"
 #include "Pipeline.h"
+#include "PipelineVariantCache.h"
+#include "RenderQueue.h"
 #include "Shader.h"
 #include "ShaderLibrary.h"
 #include "SwapChain.h"
 #include "Texture.h"
 #include "TextureLibrary.h"
 #include "TextureSampler.h"
+#include "TransientAllocator.h"
 #include "UniformBuffer.h"
 
 #include <freetype/freetype.h>
@@ -45,6 +50,21 @@ struct BeginRenderingSpec {
     uint32_t height = 0;
 };
 
+/**
+ * \brief A camera and a render target to draw the recorded mesh instances
+ * into. All views in a submission share the same instance data and lighting,
+ * only the camera constants differ.
+ */
+struct RenderView {
+    PerspectiveCamera camera;
+    BeginRenderingSpec begin_rendering_spec;
+    // Render the skybox (if one is set) after the meshes, on the pixels they
+    // didn't cover
+    bool render_skybox = false;
+    // If false the target is only cleared.
+    bool draw_meshes = true;
+};
+
 struct PushConstantInfo {
     size_t size = 0;
     VkShaderStageFlags stages;
@@ -61,8 +81,22 @@ struct CustomMeshPipelineInfo {
 struct MeshInstances {
     SharedPtr<Mesh> mesh;
     CustomMeshPipelineInfo custom_pipeline_info;
+    SharedPtr<Buffer> instance_buffer;
     size_t offset;
     size_t instance_count;
+    // The mesh's LOD the instances are drawn with
+    uint32_t lod = 0;
+
+    // The local bounding sphere of the mesh, a negative radius means there
+    // are no bounds
+    glm::vec4 bounding_sphere = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+    // The group's index in the GPU culling pass, if it was culled on the GPU
+    uint32_t culling_group = UINT32_MAX;
+    uint32_t culling_instance_base = 0;
+
+    // A world space point the instances are sorted front to back by, e.g.
+    // their centroid
+    glm::vec3 sort_position = glm::vec3(0.0f);
 };
 
 // Used to describe an instance's properties.
@@ -72,19 +106,18 @@ struct MeshRenderingInstance {
     glm::vec4 tint_color;
 };
 
-// Used for the texture indices
-struct ShaderMaterial {
-    alignas(4) int32_t diffuse_texture_unit;
-    alignas(4) int32_t specular_texture_unit;
-    alignas(4) int32_t emission_texture_unit;
-    alignas(4) float shininess;
-};
-
-// Used as per-instance vertex attributes when rendering geometries.
+// Used as per-instance vertex attributes when rendering geometries. The
+// vertex shaders build the model matrix from the position, rotation and
+// scale, which include the mesh's vertex dequantization.
 struct MeshRenderingShaderInstanceData {
-    alignas(16) glm::mat4 model;
-    ShaderMaterial material;
-    glm::vec4 tint_color;
+    alignas(16) glm::vec3 position;
+    alignas(4) float shininess;
+    alignas(4) glm::vec3 scale;
+    alignas(4) uint32_t tint_color; // Unorm8x4
+    alignas(4) int16_t rotation[4]; // Snorm quaternion, xyzw
+    // The diffuse, specular and emission textures, then their samplers, 4
+    // bits each
+    alignas(4) uint16_t texture_units[4];
 };
 
 struct QuadRenderingInstance {
@@ -99,12 +132,31 @@ struct UIQuadShaderInstanceData {
     alignas(4) int32_t texture_unit;
 };
 
-constexpr int k_max_meshes = 10000;
-constexpr int k_max_textures = 1000;
-constexpr int k_max_ui_quads = 10000;
+// The size of the bindless texture array, unless the device supports less
+constexpr uint32_t k_max_textures = 1 << 16;
+// The distinct sampler states the materials can use, indexed with 4 bits
+constexpr uint32_t k_max_samplers = 16;
 
 constexpr int k_max_directional_lights = 32;
-constexpr int k_max_point_lights = 32;
+// The point lights have no fixed limit, they are binned into view space
+// clusters so each fragment only shades the lights near it.
+
+// The size of the transient buffer (lights, camera constants...) used by each
+// frame in flight.
+constexpr VkDeviceSize k_transient_memory_per_frame = 4 * 1024 * 1024;
+// The starting size of the instance buffers. They grow when needed.
+constexpr VkDeviceSize k_initial_instance_buffer_size =
+    sizeof(MeshRenderingShaderInstanceData) * 10000;
+
+/**
+ * \brief How the meshes drawn with the default pipeline are lit. Forward
+ * shades every fragment as it is drawn. Deferred writes the surfaces into a
+ * G-buffer first, and then shades each pixel once.
+ */
+enum class RenderPath {
+    Forward,
+    Deferred,
+};
 
 class Renderer {
   public:
@@ -134,6 +186,14 @@ class Renderer {
     void
     submit_mesh_instances(const BeginRenderingSpec& begin_rendering_spec = {});
 
+    /**
+     * \brief Submit the instances recorded so far into several views. The
+     * instances and lights are only uploaded once, each view just gets its
+     * own camera constants. This will clear the instances and lighting.
+     * \param views The views to render, in order.
+     */
+    void submit_views(const std::vector<RenderView>& views);
+
     void submit_ui_quad_instances(
         const BeginRenderingSpec& begin_rendering_spec = {});
 
@@ -141,7 +201,9 @@ class Renderer {
 
     /**
      * \brief Submit the current command buffer, and then wait for completion.
-     * After that, it will start recording again.
+     * After that, it will start recording again. The frame is otherwise
+     * submitted once in end_frame, so only use this when the results are
+     * needed on the CPU (e.g. read backs).
      */
     void submit_command_buffer();
 
@@ -173,6 +235,24 @@ class Renderer {
     int32_t register_texture(const Texture& texture);
     void deregister_texture(uint32_t textureIndex, bool cube_texture = false);
 
+    /**
+     * \brief [Helios internal] Point a texture index at another image, e.g.
+     * when a streamed texture's levels change. The old image stays valid for
+     * the frames in flight, the caller keeps it alive until they're done.
+     * \param first_level The mip level of the texture the image starts at.
+     * \return False if no slot is left for the image.
+     */
+    bool set_texture_image(int32_t texture_index, const Image& image,
+                           uint32_t first_level);
+
+    /**
+     * \brief The index of a sampler with the given state, in the samplers the
+     * mesh shaders use. It's created the first time a state is used. Index 0
+     * is the default state, which is also used once k_max_samplers states
+     * exist.
+     */
+    uint32_t get_sampler_index(const SamplerSpec& spec);
+
     void draw_ui_quad(const Transform& transform, const glm::vec4& color,
                       const SharedPtr<Texture>& texture = nullptr);
 
@@ -186,6 +266,33 @@ class Renderer {
                    const std::vector<MeshRenderingInstance>& instances,
                    const CustomMeshPipelineInfo& custom_pipeline = {});
 
+    /**
+     * \brief Record instances that are already prepared in a buffer, e.g. a
+     * RetainedInstanceBuffer.
+     * \param instance_buffer The buffer with the
+     * MeshRenderingShaderInstanceData.
+     * \param offset The offset (in bytes) of the first instance.
+     * \param instance_count The number of instances.
+     * \param sort_position A world space point used to order the draws front
+     * to back, e.g. the centroid of the instances.
+     * \param lod The mesh's LOD to draw.
+     */
+    void
+    draw_mesh_instances(const SharedPtr<Mesh>& geometry,
+                        const SharedPtr<Buffer>& instance_buffer,
+                        VkDeviceSize offset, size_t instance_count,
+                        const CustomMeshPipelineInfo& custom_pipeline = {},
+                        const glm::vec3& sort_position = glm::vec3(0.0f),
+                        uint32_t lod = 0);
+
+    /**
+     * \brief Convert instances of a mesh to the data used by the shaders.
+     */
+    void prepare_mesh_instances(const Mesh& mesh,
+                                const MeshRenderingInstance* instances,
+                                size_t count,
+                                MeshRenderingShaderInstanceData* dst) const;
+
     void set_perspective_camera(const PerspectiveCamera& camera);
 
     void render_directional_light(const DirectionalLight& dir_light);
@@ -245,8 +352,8 @@ class Renderer {
     }
 
     /**
-     * Sets the number of threads to use for preparing instances when calling
-     * draw_mesh.
+     * Sets the number of jobs to split the instances into when preparing them
+     * in draw_mesh. The jobs run on the application's job system.
      */
     void set_num_threads_for_instancing(uint32_t num_threads) {
         m_num_threads_for_instancing = num_threads;
@@ -266,6 +373,36 @@ class Renderer {
 
     uint32_t get_min_instances_for_mt() const { return m_min_instances_for_mt; }
 
+    /**
+     * \brief Use GPU driven rendering in submit_views. The instances drawn
+     * with the default pipeline are then frustum culled, and compacted, by a
+     * compute pass, and drawn with indirect draws. Instances using custom
+     * pipelines are still drawn directly.
+     */
+    void set_gpu_driven_rendering(bool enabled) {
+        m_gpu_driven_rendering = enabled;
+    }
+
+    bool is_gpu_driven_rendering() const { return m_gpu_driven_rendering; }
+
+    /**
+     * \brief Select the render path of the mesh submissions. Instances using
+     * custom pipelines are always drawn forward, after the deferred lighting.
+     * If the deferred shaders are unavailable, forward is used.
+     */
+    void set_render_path(RenderPath path) { m_render_path = path; }
+
+    RenderPath get_render_path() const { return m_render_path; }
+
+    /**
+     * \brief Draw the depth of the default pipeline's instances before
+     * lighting them, so only their visible fragments are shaded. Only used by
+     * the forward path, the deferred one already shades each pixel once.
+     */
+    void set_depth_prepass(bool enabled) { m_depth_prepass = enabled; }
+
+    bool is_depth_prepass() const { return m_depth_prepass; }
+
     const SharedPtr<Shader>& get_lighting_vertex_shader() const {
         return m_lighting_vertex_shader;
     };
@@ -288,31 +425,79 @@ class Renderer {
         return m_camera_uniform_set_layout;
     }
 
-    const SharedPtr<DescriptorSet>& get_current_texture_array() const {
-        return m_texture_arrays[m_current_frame];
+    const SharedPtr<DescriptorSet>& get_texture_array() const {
+        return m_texture_array;
     }
 
+    /**
+     * \brief get the camera set for this frame. The set uses a dynamic uniform
+     * buffer, which is bound with get_current_camera_uniform_offset().
+     */
     const SharedPtr<DescriptorSet>& get_current_camera_uniform_set() const {
         return m_camera_uniform_sets[m_current_frame];
     }
 
+    uint32_t get_current_camera_uniform_offset() const {
+        return m_camera_uniform_offset;
+    }
+
+    TransientAllocator& get_transient_allocator() {
+        return *m_transient_allocator;
+    }
+
+    InstanceBuffer& get_instance_buffer() { return *m_instance_buffer; }
+
     void update_camera_uniform();
 
     void set_skybox(const SharedPtr<Texture>& skybox);
 
   private:
-    void draw_meshes();
+    // The recorded instances a draw_meshes call draws
+    enum class MeshPass {
+        All,
+        DepthPrepass,      // Only the default pipeline, depth only
+        AfterDepthPrepass, // All, the default pipeline tests for equal depth
+        GBuffer,           // Only the default pipeline, into the G-buffer
+        CustomPipelines,   // Only the custom pipelines
+    };
+
+    void begin_rendering(const BeginRenderingSpec& spec, bool gbuffer);
+    void render_meshes(const BeginRenderingSpec& spec, bool skybox);
+    void draw_skybox();
+    bool prepare_gbuffer(uint32_t width, uint32_t height);
+    void draw_meshes(MeshPass pass = MeshPass::All);
+    void build_render_queue(const std::vector<MeshInstances>& mesh_instances,
+                            MeshPass pass);
+    void flush_indirect_draws(VkCommandBuffer command_buffer);
+    void bind_mesh_instances_state(VkCommandBuffer command_buffer,
+                                   const MeshInstances& mesh_instances);
     void draw_quads();
+    void upload_lights();
+    void cluster_lights();
+    bool cull_instances_on_gpu(const std::vector<RenderView>& views);
 
     void create_default_textures(const SharedPtr<TextureLibrary>& texture_lib);
+    uint32_t allocate_texture_slot();
+    void write_texture_slot(uint32_t slot, VkImageView image_view);
+    void set_texture_slot(uint32_t texture_index, uint32_t slot,
+                          uint32_t first_level);
+    void release_texture_slots(uint32_t frame);
+    // Read back the texture feedback, and copy the slots set since the last
+    // submit. Submitted before the frame's command buffer.
+    VkCommandBuffer record_texture_updates();
     void load_default_shaders(const SharedPtr<ShaderLibrary>& shader_lib);
 
     void create_depth_image();
 
     void setup_ui_quad_pipeline();
     void setup_lighting_pipeline();
+    std::vector<SpecializationConstant> get_lighting_constants() const;
     void setup_skybox_pipeline();
     void setup_camera_uniform();
+    void setup_gpu_culling();
+    void setup_light_clustering();
+    void setup_deferred_pipeline();
+    void setup_depth_prepass();
 
     void recreate_swapchain();
 
@@ -344,10 +529,13 @@ class Renderer {
     SharedPtr<DescriptorPool> m_sampler_descriptor_pool;
     std::unique_ptr<TextureSampler>
         m_texture_sampler; // We should be able to use a single sampler...
-    std::vector<SharedPtr<DescriptorSet>>
-        m_texture_arrays; // One for each frame in flight
-    std::vector<DescriptorSpec> m_texture_specs;
+    // Updated after bind, so a single set is used by every frame in flight
+    SharedPtr<DescriptorSet> m_texture_array;
     SharedPtr<DescriptorSetLayout> m_texture_array_layout;
+    uint32_t m_max_textures = 0;
+    // The states of the samplers array, in order
+    std::vector<std::pair<SamplerSpec, std::unique_ptr<TextureSampler>>>
+        m_samplers;
 
     std::unique_ptr<TextureSampler>
         m_skybox_texture_sampler; // We should be able to use a single
@@ -363,13 +551,43 @@ class Renderer {
     SharedPtr<Mesh> m_skybox_mesh;
     SharedPtr<Texture> m_skybox_texture = nullptr;
 
-    uint32_t m_available_texture_index = 0;
+    // Textures are referenced by their index, which maps to a slot of the
+    // images array. A texture's slot changes when its image is replaced,
+    // its index doesn't. Both are recycled once the frames in flight are
+    // done with them.
+    uint32_t m_texture_index_count = 0;
+    std::vector<uint32_t> m_free_texture_indices;
+    uint32_t m_texture_slot_count = 0;
+    std::vector<uint32_t> m_free_texture_slots;
+    std::vector<std::vector<uint32_t>>
+        m_pending_texture_frees; // One for each frame in flight
+    std::vector<std::vector<uint32_t>> m_pending_texture_index_frees;
+
+    // The slot of each texture index, with its first mip level in the upper
+    // 16 bits. The entries set since the last submit are copied to the GPU
+    // before the next one.
+    std::vector<uint32_t> m_texture_slots;
+    std::vector<uint32_t> m_dirty_texture_slots;
+    SharedPtr<Buffer> m_texture_slot_buffer;
+    // The finest mip level each texture index was sampled at by the mesh
+    // shaders, read back for the texture streamer
+    SharedPtr<Buffer> m_texture_feedback_buffer;
+    std::vector<SharedPtr<Buffer>>
+        m_texture_feedback_readbacks; // One for each frame in flight
+    std::vector<uint32_t> m_texture_feedback_counts;
+    std::vector<SharedPtr<CommandBuffer>> m_texture_update_command_buffers;
 
     SharedPtr<Texture> m_white_texture;
     SharedPtr<Texture> m_black_texture;
     SharedPtr<Texture> m_gray_texture;
 
+    // The variant reading the light counts from the push constants
     SharedPtr<Pipeline> m_lighting_pipeline;
+    // Shades the surfaces left by the depth pre-pass
+    SharedPtr<Pipeline> m_lighting_equal_depth_pipeline;
+    // Lighting.frag specialized for the lights of the frame
+    std::unique_ptr<PipelineVariantCache> m_lighting_variants;
+    std::unique_ptr<PipelineVariantCache> m_lighting_equal_depth_variants;
     PipelineCreateInfo m_default_lighting_pipeline_create_info;
     SharedPtr<Shader> m_lighting_vertex_shader;
     SharedPtr<Shader> m_lighting_fragment_shader;
@@ -380,32 +598,30 @@ class Renderer {
 
     SharedPtr<ShaderLibrary> m_shaders;
 
-    // Put the texture library below m_texture_specs, so the textures are
-    // destroyed before m_texture_specs
+    // Put the texture library below the texture slots, so the textures are
+    // destroyed before them
     SharedPtr<TextureLibrary> m_textures;
 
-    std::unique_ptr<Buffer> m_instance_staging_buffer;
+    std::unique_ptr<TransientAllocator> m_transient_allocator;
+    std::unique_ptr<InstanceBuffer> m_instance_buffer;
 
     // Mesh Rendering Instances //
-    std::vector<std::vector<MeshRenderingShaderInstanceData>>
-        m_mesh_rendering_shader_instances; // One for each frame in flight
     std::vector<std::vector<MeshInstances>>
         m_mesh_rendering_instances; // One for each frame in flight
-    std::vector<SharedPtr<VertexBuffer>>
-        m_mesh_rendering_instances_buffers; // One for each frame in flight
+    RenderQueue m_render_queue;
+    // The draws merged into the next indirect draw
+    std::vector<VkDrawIndexedIndirectCommand> m_indirect_commands;
     VertexBufferDescription m_mesh_rendering_instance_vertices_description;
 
     std::vector<std::vector<UIQuadShaderInstanceData>>
         m_ui_quad_shader_instances; // One for each frame in flight
-    std::vector<SharedPtr<VertexBuffer>>
-        m_ui_quad_instances_buffers; // One for each frame in flight
+    TransientAllocation m_ui_quad_instances_allocation;
     VertexBufferDescription m_ui_quad_instance_vertices_description;
 
     SharedPtr<DescriptorPool> m_camera_uniform_pool;
     std::vector<SharedPtr<DescriptorSet>> m_camera_uniform_sets;
     SharedPtr<DescriptorSetLayout> m_camera_uniform_set_layout;
-    std::vector<std::unique_ptr<UniformBuffer>>
-        m_camera_uniform_buffers; // One for each frame in flight
+    uint32_t m_camera_uniform_offset = 0;
 
     //  Cube  //
     SharedPtr<Mesh> m_cube_mesh;
@@ -435,16 +651,71 @@ class Renderer {
 
     std::vector<std::vector<DirectionalLight>>
         m_directional_lights; // One for each frame in flight
-    std::vector<std::unique_ptr<UniformBuffer>>
-        m_directional_lights_uniform_buffers;
+    uint32_t m_directional_lights_offset = 0;
 
     std::vector<std::vector<PointLight>>
         m_point_lights; // One for each frame in flight
-    std::vector<std::unique_ptr<UniformBuffer>> m_point_lights_uniform_buffers;
+    uint32_t m_point_lights_offset = 0;
+
+    // Clustered lighting //
+    std::unique_ptr<ComputePipeline> m_light_clustering_pipeline;
+    SharedPtr<DescriptorPool> m_light_clustering_pool;
+    std::vector<std::unique_ptr<DescriptorSet>>
+        m_light_clustering_sets; // One for each frame in flight
+    SharedPtr<DescriptorSetLayout> m_light_clustering_set_layout;
+    std::vector<SharedPtr<Buffer>>
+        m_cluster_light_buffers; // One for each frame in flight
+    uint32_t m_light_spheres_offset = 0;
+    uint32_t m_cluster_info_offset = 0;
+    // If the point lights of the current view were binned into clusters
+    bool m_lights_clustered = false;
+
+    // Depth pre-pass //
+    bool m_depth_prepass = false;
+    std::unique_ptr<Pipeline> m_depth_prepass_pipeline;
+
+    // Deferred rendering //
+    RenderPath m_render_path = RenderPath::Forward;
+    SharedPtr<Pipeline> m_gbuffer_pipeline;
+    std::unique_ptr<Pipeline> m_deferred_lighting_pipeline;
+    // Albedo, normal, material and linear depth. They grow to fit the
+    // largest view, and are shared by the frames in flight.
+    std::vector<std::unique_ptr<Image>> m_gbuffer_targets;
+    SharedPtr<DescriptorPool> m_gbuffer_pool;
+    std::vector<std::unique_ptr<DescriptorSet>>
+        m_gbuffer_sets; // One for each frame in flight
+    SharedPtr<DescriptorSetLayout> m_gbuffer_set_layout;
+    // Incremented when the targets are recreated, each frame's set records
+    // the one it points to
+    uint32_t m_gbuffer_generation = 0;
+    std::vector<uint32_t> m_gbuffer_set_generations;
+    bool m_gbuffer_set_used_this_frame = false;
 
     uint32_t m_min_instances_for_mt;
     uint32_t m_num_threads_for_instancing;
 
+    // GPU driven rendering //
+    bool m_gpu_driven_rendering = false;
+    // If the instances of the current submission were culled on the GPU
+    bool m_gpu_culling_active = false;
+    uint32_t m_current_view = 0;
+    uint32_t m_gpu_culling_group_count = 0;
+    // The groups with 16 bit indices, which come first
+    uint32_t m_gpu_culling_uint16_group_count = 0;
+    uint32_t m_gpu_culling_instance_count = 0;
+    TransientAllocation m_gpu_culling_commands;
+    TransientAllocation m_gpu_culling_output;
+
+    std::unique_ptr<ComputePipeline> m_culling_pipeline;
+    SharedPtr<DescriptorPool> m_culling_pool;
+    std::vector<std::unique_ptr<DescriptorSet>>
+        m_culling_sets; // One for each frame in flight
+    SharedPtr<DescriptorSetLayout> m_culling_set_layout;
+    // The instance buffers each frame's culling set points to
+    std::vector<SharedPtr<Buffer>> m_culling_input_buffers;
+    std::vector<SharedPtr<Buffer>> m_culling_output_buffers;
+    bool m_culling_set_used_this_frame = false;
+
     bool m_recreate_swapchain_next_frame = false;
     bool m_vsync = true;
 
@@ -0,0 +1,74 @@
+#include "RetainedInstanceBuffer.h"
+
+#include "Helios/Core/Application.h"
+
+namespace Helios {
+void RetainedInstanceBuffer::resize(size_t count) {
+    m_count = count;
+    m_data.resize(count * m_element_size);
+    mark_dirty(0, count);
+}
+
+void RetainedInstanceBuffer::mark_dirty(size_t first, size_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    // The ranges are merged, so a frame's buffer is synced with one copy
+    for (auto& range : m_dirty_ranges) {
+        if (range.first >= range.last) {
+            range = {first, first + count};
+        } else {
+            range.first = std::min(range.first, first);
+            range.last = std::max(range.last, first + count);
+        }
+    }
+}
+
+void RetainedInstanceBuffer::sync(uint32_t frame) {
+    auto& buffer = m_buffers[frame];
+    auto& range = m_dirty_ranges[frame];
+
+    if (m_count * m_element_size > buffer->get_vk_size()) {
+        // The old buffer is destroyed through the destruction queue
+        VkDeviceSize capacity = buffer->get_vk_size() * 2;
+        while (capacity < m_count * m_element_size) {
+            capacity *= 2;
+        }
+        buffer = create_buffer(capacity);
+        range = {0, m_count};
+    }
+
+    range.last = std::min(range.last, m_count);
+    if (range.first < range.last) {
+        memcpy(static_cast<uint8_t*>(buffer->get_mapped_memory()) +
+                   range.first * m_element_size,
+               m_data.data() + range.first * m_element_size,
+               (range.last - range.first) * m_element_size);
+    }
+    range = {};
+}
+
+void RetainedInstanceBuffer::init(uint32_t max_frames_in_flight,
+                                  size_t element_size,
+                                  size_t initial_capacity) {
+    m_element_size = element_size;
+    m_memory_properties = VulkanUtils::get_host_write_memory_properties(
+        Application::get().get_vulkan_manager()->get_context().physical_device);
+
+    m_buffers.resize(max_frames_in_flight);
+    m_dirty_ranges.resize(max_frames_in_flight);
+    for (auto& buffer : m_buffers) {
+        buffer = create_buffer(std::max<size_t>(initial_capacity, 1) *
+                               m_element_size);
+    }
+}
+
+SharedPtr<Buffer>
+RetainedInstanceBuffer::create_buffer(VkDeviceSize size) const {
+    return Buffer::create(
+        size,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        m_memory_properties, true);
+}
+} // namespace Helios
@@ -0,0 +1,86 @@
+#pragma once
+#include <volk/volk.h>
+
+#include "Buffer.h"
+#include "Helios/Core/Core.h"
+
+namespace Helios {
+/**
+ * \brief Instance data that persists between frames. The data is kept in a
+ * CPU side copy, and every frame in flight has its own persistently mapped
+ * buffer. Only the ranges marked dirty since a frame's buffer was last synced
+ * are copied to it, so unchanged instances cost nothing per frame.
+ */
+class RetainedInstanceBuffer {
+  public:
+    static std::unique_ptr<RetainedInstanceBuffer>
+    create_unique(uint32_t max_frames_in_flight, size_t element_size,
+                  size_t initial_capacity) {
+        std::unique_ptr<RetainedInstanceBuffer> obj =
+            std::make_unique<RetainedInstanceBuffer>();
+        obj->init(max_frames_in_flight, element_size, initial_capacity);
+        return obj;
+    }
+
+    /**
+     * \brief Resize the CPU side data. The buffers grow when needed, and the
+     * whole buffer is marked dirty.
+     * \param count The number of elements.
+     */
+    void resize(size_t count);
+
+    /**
+     * \brief Mark elements as changed, so they are copied to the buffer of
+     * every frame in flight.
+     */
+    void mark_dirty(size_t first, size_t count);
+
+    /**
+     * \brief Copy the dirty ranges to a frame's buffer. Only call this once
+     * the GPU is done with the frame (e.g. during recording).
+     * \param frame The frame in flight index.
+     */
+    void sync(uint32_t frame);
+
+    template <typename T> T* get_data() {
+        return reinterpret_cast<T*>(m_data.data());
+    }
+
+    size_t get_size() const { return m_count; }
+    size_t get_element_size() const { return m_element_size; }
+
+    const SharedPtr<Buffer>& get_buffer(uint32_t frame) const {
+        return m_buffers[frame];
+    }
+
+    RetainedInstanceBuffer() = default;
+    ~RetainedInstanceBuffer() = default;
+
+    RetainedInstanceBuffer(const RetainedInstanceBuffer&) = delete;
+    RetainedInstanceBuffer& operator=(const RetainedInstanceBuffer&) = delete;
+    RetainedInstanceBuffer(RetainedInstanceBuffer&&) = delete;
+    RetainedInstanceBuffer& operator=(RetainedInstanceBuffer&&) = delete;
+
+  private:
+    void init(uint32_t max_frames_in_flight, size_t element_size,
+              size_t initial_capacity);
+
+    SharedPtr<Buffer> create_buffer(VkDeviceSize size) const;
+
+  private:
+    // A range of elements, empty if first >= last
+    struct DirtyRange {
+        size_t first = 0;
+        size_t last = 0;
+    };
+
+    std::vector<uint8_t> m_data;
+    size_t m_count = 0;
+    size_t m_element_size = 0;
+
+    std::vector<SharedPtr<Buffer>> m_buffers; // One for each frame in flight
+    std::vector<DirtyRange> m_dirty_ranges; // One for each frame in flight
+
+    VkMemoryPropertyFlags m_memory_properties = 0;
+};
+} // namespace Helios
@@ -1,11 +1,16 @@
 ﻿#include "Texture.h"
 
+#include <algorithm>
+#include <bit>
+
 #include <stb_image.h>
 
 #include "Buffer.h"
 #include "Helios/Core/Application.h"
 #include "Helios/Core/IOUtils.h"
+#include "Ktx2.h"
 #include "Renderer.h"
+#include "TextureStreamer.h"
 
 namespace Helios {
 
@@ -18,14 +23,39 @@ stbi_uc* load_image(const std::filesystem::path& path, int* width, int* height,
         width, height, channels, STBI_rgb_alpha);
 }
 
+namespace {
+// A full mip chain, if the format can be blitted with linear filtering to
+// generate it
+uint32_t get_mip_levels(uint32_t width, uint32_t height, VkFormat format) {
+    const VkFormatFeatureFlags required_features =
+        VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(
+        Application::get().get_vulkan_manager()->get_context().physical_device,
+        format, &properties);
+    if ((properties.optimalTilingFeatures & required_features) !=
+        required_features) {
+        return 1;
+    }
+    return std::bit_width(std::max(width, height));
+}
+} // namespace
+
 Texture::~Texture() {
+    if (m_streamed) {
+        Application::get().get_texture_streamer().remove(m_texture_index);
+    }
     Renderer& renderer = Application::get().get_renderer();
     renderer.deregister_texture(m_texture_index, m_cube_map);
 }
 
+bool Texture::is_uploaded() const {
+    return Application::get().get_upload_manager().is_complete(m_upload);
+}
+
 bool Texture::init(const std::filesystem::path& path, VkFormat format) {
-    const VulkanContext& context =
-        Application::get().get_vulkan_manager()->get_context();
     Renderer& renderer = Application::get().get_renderer();
 
     stbi_set_flip_vertically_on_load(true);
@@ -36,6 +66,10 @@ bool Texture::init(const std::filesystem::path& path, VkFormat format) {
         return false;
     }
 
+    if (path.extension() == ".ktx2") {
+        return init_ktx2(path);
+    }
+
     int tex_width, tex_height, tex_channels;
     stbi_uc* pixles = stbi_load(
         IOUtils::resolve_path(Application::get().get_asset_base_path(), path)
@@ -49,57 +83,21 @@ bool Texture::init(const std::filesystem::path& path, VkFormat format) {
         return false;
     }
 
-    std::unique_ptr<Buffer> staging_buffer =
-        Buffer::create_unique(image_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    void* data;
-    vkMapMemory(context.device, staging_buffer->get_vk_memory(), 0, image_size,
-                0, &data);
-    memcpy(data, pixles, static_cast<size_t>(image_size));
-    vkUnmapMemory(context.device, staging_buffer->get_vk_memory());
-
-    stbi_image_free(pixles);
-
     m_image = Image::create({
         .width = static_cast<uint32_t>(tex_width),
         .height = static_cast<uint32_t>(tex_height),
         .format = format,
+        .mip_levels = get_mip_levels(tex_width, tex_height, format),
         .tiling = VK_IMAGE_TILING_OPTIMAL,
-        .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                 VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
         .memory_property = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
     });
 
-    VkCommandBuffer command_buffer = VulkanUtils::begin_single_time_commands(
-        context.device, context.command_pool);
-
-    VulkanUtils::transition_image_layout(
-        {.image = m_image->get_vk_image(),
-         .old_layout = VK_IMAGE_LAYOUT_UNDEFINED,
-         .new_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-         .src_access_mask = 0,
-         .dst_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT,
-         .src_stage_mask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-         .dst_stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT,
-         .command_buffer = command_buffer});
-    VulkanUtils::copy_buffer_to_image(
-        command_buffer, staging_buffer->get_vk_buffer(),
-        m_image->get_vk_image(), static_cast<uint32_t>(tex_width),
-        static_cast<uint32_t>(tex_height));
-    VulkanUtils::transition_image_layout(
-        {.image = m_image->get_vk_image(),
-         .old_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-         .new_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-         .src_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT,
-         .dst_access_mask = VK_ACCESS_SHADER_READ_BIT,
-         .src_stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT,
-         .dst_stage_mask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-         .command_buffer = command_buffer});
-
-    VulkanUtils::end_single_time_commands(command_buffer, context.device,
-                                          context.command_pool,
-                                          context.graphics_queue);
+    const void* layers[] = {pixles};
+    m_upload = Application::get().get_upload_manager().upload_image(
+        *m_image, layers, image_size);
+    stbi_image_free(pixles);
 
     m_texture_index = renderer.register_texture(*this);
     return true;
@@ -107,68 +105,117 @@ bool Texture::init(const std::filesystem::path& path, VkFormat format) {
 
 bool Texture::init(void* data, uint32_t width, uint32_t height, size_t size,
                    VkFormat format) {
-    const VulkanContext& context =
-        Application::get().get_vulkan_manager()->get_context();
     Renderer& renderer = Application::get().get_renderer();
 
     stbi_set_flip_vertically_on_load(true);
 
-    std::unique_ptr<Buffer> staging_buffer =
-        Buffer::create_unique(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    void* data_map;
-    vkMapMemory(context.device, staging_buffer->get_vk_memory(), 0, size, 0,
-                &data_map);
-    memcpy(data_map, data, static_cast<size_t>(size));
-    vkUnmapMemory(context.device, staging_buffer->get_vk_memory());
-
     m_image = Image::create({
         .width = width,
         .height = height,
         .format = format,
+        .mip_levels = get_mip_levels(width, height, format),
         .tiling = VK_IMAGE_TILING_OPTIMAL,
-        .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                 VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
         .memory_property = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
     });
 
-    VkCommandBuffer command_buffer = VulkanUtils::begin_single_time_commands(
-        context.device, context.command_pool);
-
-    VulkanUtils::transition_image_layout(
-        {.image = m_image->get_vk_image(),
-         .old_layout = VK_IMAGE_LAYOUT_UNDEFINED,
-         .new_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-         .src_access_mask = 0,
-         .dst_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT,
-         .src_stage_mask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-         .dst_stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT,
-         .command_buffer = command_buffer});
-    VulkanUtils::copy_buffer_to_image(command_buffer,
-                                      staging_buffer->get_vk_buffer(),
-                                      m_image->get_vk_image(), width, height);
-    VulkanUtils::transition_image_layout(
-        {.image = m_image->get_vk_image(),
-         .old_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-         .new_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-         .src_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT,
-         .dst_access_mask = VK_ACCESS_SHADER_READ_BIT,
-         .src_stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT,
-         .dst_stage_mask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-         .command_buffer = command_buffer});
-
-    VulkanUtils::end_single_time_commands(command_buffer, context.device,
-                                          context.command_pool,
-                                          context.graphics_queue);
+    const void* layers[] = {data};
+    m_upload = Application::get().get_upload_manager().upload_image(
+        *m_image, layers, size);
 
     m_texture_index = renderer.register_texture(*this);
     return true;
 }
 
-bool Texture::init_cube_map(const CubeMapInfo& cube_map_info, VkFormat format) {
+bool Texture::init_ktx2(const std::filesystem::path& path) {
+    Renderer& renderer = Application::get().get_renderer();
+    TextureStreamer& streamer = Application::get().get_texture_streamer();
     const VulkanContext& context =
         Application::get().get_vulkan_manager()->get_context();
+
+    const std::filesystem::path resolved_path =
+        IOUtils::resolve_path(Application::get().get_asset_base_path(), path);
+    Ktx2Texture ktx2;
+    std::vector<Ktx2LevelRange> ranges;
+    std::string error;
+    if (!read_ktx2_header(resolved_path, ktx2, ranges, error)) {
+        HL_ERROR("Failed to load texture image: {0} ({1})", path.string(),
+                 error);
+        return false;
+    }
+
+    // The texels are uploaded as they are, so the device has to sample them
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(context.physical_device, ktx2.format,
+                                        &properties);
+    bool block_compressed = get_texel_block(ktx2.format).width > 1;
+    if (!(properties.optimalTilingFeatures &
+          VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) ||
+        (block_compressed && !context.texture_compression_bc)) {
+        HL_ERROR("Failed to load texture image: {0} (the device can't sample "
+                 "its format)",
+                 path.string());
+        return false;
+    }
+
+    // Only the small levels are read now, the streamer loads the others
+    // once they're sampled
+    m_cube_map = ktx2.cube_map;
+    m_first_level =
+        ktx2.cube_map ? 0
+                      : streamer.get_first_resident_level(
+                            ktx2.width, ktx2.height,
+                            static_cast<uint32_t>(ranges.size()));
+    if (!read_ktx2_levels(resolved_path, ranges, m_first_level, ktx2.levels,
+                          error)) {
+        HL_ERROR("Failed to load texture image: {0} ({1})", path.string(),
+                 error);
+        return false;
+    }
+
+    m_image = Image::create({
+        .width = std::max(ktx2.width >> m_first_level, 1u),
+        .height = std::max(ktx2.height >> m_first_level, 1u),
+        .format = ktx2.format,
+        .cube_map = ktx2.cube_map,
+        .mip_levels = static_cast<uint32_t>(ktx2.levels.size()),
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .memory_property = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    });
+
+    std::vector<ImageLevelData> levels;
+    for (const auto& level : ktx2.levels) {
+        levels.push_back({level.data(), level.size()});
+    }
+    m_upload = Application::get().get_upload_manager().upload_image_levels(
+        *m_image, levels);
+
+    m_texture_index = renderer.register_texture(*this);
+    if (m_first_level > 0 && m_texture_index >= 0) {
+        ktx2.levels.clear();
+        streamer.add(*this, resolved_path, ktx2, std::move(ranges));
+        m_streamed = true;
+    }
+    return true;
+}
+
+bool Texture::set_streamed_image(const SharedPtr<Image>& image,
+                                 uint32_t first_level, UploadTicket upload) {
+    if (!Application::get().get_renderer().set_texture_image(
+            m_texture_index, *image.get(), first_level)) {
+        return false;
+    }
+
+    // The old image is destroyed once the frames in flight are done with it
+    m_image = image;
+    m_first_level = first_level;
+    m_upload = upload;
+    return true;
+}
+
+bool Texture::init_cube_map(const CubeMapInfo& cube_map_info, VkFormat format) {
     Renderer& renderer = Application::get().get_renderer();
 
     stbi_set_flip_vertically_on_load(false);
@@ -207,53 +254,16 @@ bool Texture::init_cube_map(const CubeMapInfo& cube_map_info, VkFormat format) {
         .memory_property = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
     });
 
+    // All the faces in one upload
     VkDeviceSize image_size = tex_width * tex_height * 4;
-
-    std::unique_ptr<Buffer> staging_buffer =
-        Buffer::create_unique(image_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    for (int i = 0; i < 6; i++) {
-
-        VkCommandBuffer command_buffer =
-            VulkanUtils::begin_single_time_commands(context.device,
-                                                    context.command_pool);
-        void* data;
-        vkMapMemory(context.device, staging_buffer->get_vk_memory(), 0,
-                    image_size, 0, &data);
-        memcpy(data, texture_data[i], static_cast<size_t>(image_size));
-        vkUnmapMemory(context.device, staging_buffer->get_vk_memory());
-
-        stbi_image_free(texture_data[i]);
-        VulkanUtils::transition_image_layout(
-            {.image = m_image->get_vk_image(),
-             .old_layout = VK_IMAGE_LAYOUT_UNDEFINED,
-             .new_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-             .src_access_mask = 0,
-             .dst_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT,
-             .src_stage_mask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-             .dst_stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT,
-             .index = static_cast<uint32_t>(i),
-             .command_buffer = command_buffer});
-        VulkanUtils::copy_buffer_to_image(
-            command_buffer, staging_buffer->get_vk_buffer(),
-            m_image->get_vk_image(), static_cast<uint32_t>(tex_width),
-            static_cast<uint32_t>(tex_height), i);
-        VulkanUtils::transition_image_layout(
-            {.image = m_image->get_vk_image(),
-             .old_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-             .new_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-             .src_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT,
-             .dst_access_mask = VK_ACCESS_SHADER_READ_BIT,
-             .src_stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT,
-             .dst_stage_mask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-             .index = static_cast<uint32_t>(i),
-             .command_buffer = command_buffer});
-
-        VulkanUtils::end_single_time_commands(command_buffer, context.device,
-                                              context.command_pool,
-                                              context.graphics_queue);
+    const void* layers[6];
+    std::copy(std::begin(texture_data), std::end(texture_data), layers);
+    m_upload = Application::get().get_upload_manager().upload_image(
+        *m_image, layers, image_size);
+    for (stbi_uc* face : texture_data) {
+        stbi_image_free(face);
     }
+
     m_texture_index = renderer.register_texture(*this);
     return true;
 }
@@ -8,6 +8,7 @@
 #include "Helios/Assets/Asset.h"
 #include "Helios/Core/Core.h"
 #include "Image.h"
+#include "UploadManager.h"
 
 namespace Helios {
 
@@ -23,7 +24,9 @@ struct CubeMapInfo {
 class Texture : public Asset {
   public:
     /**
-     * \brief create a texture from path.
+     * \brief create a texture from path. A .ktx2 file is uploaded as is, with
+     * its format and mip levels, the other images are decoded to format. The
+     * large mip levels of a .ktx2 file are streamed, see TextureStreamer.
      * \param path The path.
      * \return The texture
      */
@@ -74,6 +77,19 @@ class Texture : public Asset {
     int32_t GetTextureIndex() const { return m_texture_index; }
 
     bool is_cube_map() const { return m_cube_map; }
+
+    /**
+     * \brief The mip level of the texture the image starts at. A streamed
+     * texture's image only holds the levels that are loaded.
+     */
+    uint32_t get_first_level() const { return m_first_level; }
+    bool is_streamed() const { return m_streamed; }
+
+    /**
+     * \brief If the texture's data is on the GPU. It can be used before, the
+     * frames wait for the upload.
+     */
+    bool is_uploaded() const;
     const CubeMapInfo& get_cube_map_info() const { return m_cube_map_info; }
 
     Texture() = default;
@@ -87,14 +103,25 @@ class Texture : public Asset {
   private:
     bool init(const std::filesystem::path& path, VkFormat format);
     bool init_cube_map(const CubeMapInfo& cube_map_info, VkFormat format);
+    bool init_ktx2(const std::filesystem::path& path);
     bool init(void* data, uint32_t width, uint32_t height, size_t size,
               VkFormat format);
 
+    // Replace the image with one holding the levels from first_level on.
+    // False if it's kept, the renderer has no slot left.
+    bool set_streamed_image(const SharedPtr<Image>& image,
+                            uint32_t first_level, UploadTicket upload);
+
   private:
     int32_t m_texture_index;
     bool m_cube_map = false;
+    UploadTicket m_upload = 0;
+    uint32_t m_first_level = 0;
+    bool m_streamed = false;
 
     SharedPtr<Image> m_image;
     CubeMapInfo m_cube_map_info;
+
+    friend class TextureStreamer;
 };
 } // namespace Helios
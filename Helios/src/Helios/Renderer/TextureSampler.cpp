@@ -1,5 +1,7 @@
 ﻿#include "TextureSampler.h"
 
+#include <algorithm>
+
 #include "Helios/Core/Application.h"
 
 namespace Helios {
@@ -14,7 +16,7 @@ TextureSampler::~TextureSampler() {
   }
 }
 
-void TextureSampler::init() {
+void TextureSampler::init(const SamplerSpec& spec) {
     m_is_initialized = true;
 
   const VulkanContext &context =
@@ -22,23 +24,28 @@ void TextureSampler::init() {
 
     VkSamplerCreateInfo sampler_info{};
       sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-      sampler_info.magFilter = VK_FILTER_LINEAR;
-      sampler_info.minFilter = VK_FILTER_LINEAR;
-      sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-      sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-      sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-      // Disable anisotropic filtering for text
-      sampler_info.anisotropyEnable = VK_FALSE;
-      sampler_info.maxAnisotropy = 1.0f;
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(context.physical_device, &properties);
+    float max_anisotropy = std::min(spec.max_anisotropy,
+                                    properties.limits.maxSamplerAnisotropy);
+
+      sampler_info.magFilter = spec.filter;
+      sampler_info.minFilter = spec.filter;
+      sampler_info.addressModeU = spec.address_mode;
+      sampler_info.addressModeV = spec.address_mode;
+      sampler_info.addressModeW = spec.address_mode;
+      sampler_info.anisotropyEnable = max_anisotropy > 1.0f;
+      sampler_info.maxAnisotropy = std::max(max_anisotropy, 1.0f);
       sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
       sampler_info.unnormalizedCoordinates = VK_FALSE;
       sampler_info.compareEnable = VK_FALSE;
       sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
-      // For text, you might want to disable mipmapping completely
-      sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+      sampler_info.mipmapMode = spec.filter == VK_FILTER_NEAREST
+                                    ? VK_SAMPLER_MIPMAP_MODE_NEAREST
+                                    : VK_SAMPLER_MIPMAP_MODE_LINEAR;
       sampler_info.mipLodBias = 0.0f;
       sampler_info.minLod = 0.0f;
-      sampler_info.maxLod = 0.0f;
+      sampler_info.maxLod = spec.mipmaps ? VK_LOD_CLAMP_NONE : 0.0f;
 
   if (vkCreateSampler(context.device, &sampler_info, nullptr, &m_sampler) !=
       VK_SUCCESS) {
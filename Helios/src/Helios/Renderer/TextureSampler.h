@@ -6,20 +6,32 @@
 
 namespace Helios
 {
+	struct SamplerSpec
+	{
+		VkFilter filter = VK_FILTER_LINEAR;
+		VkSamplerAddressMode address_mode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		// 1 disables anisotropic filtering, clamped to the device's limit
+		float max_anisotropy = 1.0f;
+		// Sample the mip levels, or only the first one
+		bool mipmaps = true;
+
+		bool operator==(const SamplerSpec&) const = default;
+	};
+
 	class TextureSampler
 	{
 	public:
-		static SharedPtr<TextureSampler> create()
+		static SharedPtr<TextureSampler> create(const SamplerSpec& spec = {})
 		{
 			SharedPtr<TextureSampler> obj = SharedPtr<TextureSampler>::create();
-            obj->init();
+            obj->init(spec);
 			return obj;
 		}
 
-		static std::unique_ptr<TextureSampler> create_unique()
+		static std::unique_ptr<TextureSampler> create_unique(const SamplerSpec& spec = {})
 		{
 			std::unique_ptr<TextureSampler> obj = std::make_unique<TextureSampler>();
-            obj->init();
+            obj->init(spec);
 			return obj;
 		}
 
@@ -34,7 +46,7 @@ namespace Helios
 		TextureSampler& operator=(TextureSampler&&) = delete;
 
 	private:
-		void init();
+		void init(const SamplerSpec& spec);
 
 	private:
 		VkSampler m_sampler;
@@ -0,0 +1,324 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+
+#include "Helios/Core/Application.h"
+#include "Helios/Core/Log.h"
+#include "Image.h"
+#include "Texture.h"
+#include "UploadManager.h"
+
+namespace Helios {
+namespace {
+// Bounds the memory of the levels read but not uploaded yet. Evictions only
+// read the small levels, so they don't count.
+constexpr uint32_t k_max_pending_loads = 4;
+// Textures not sampled for this many frames give their levels up first, and
+// aren't loaded further
+constexpr uint64_t k_unused_frames = 60;
+// Left out of the device's budget, for the allocations to come
+constexpr VkDeviceSize k_budget_margin_percent = 10;
+} // namespace
+
+TextureStreamer::~TextureStreamer() {
+    Application::get().get_job_system().wait(m_jobs);
+}
+
+void TextureStreamer::init(const TextureStreamerSpecification& spec) {
+    m_spec = spec;
+    m_budget = spec.budget;
+}
+
+uint32_t TextureStreamer::get_first_resident_level(uint32_t width,
+                                                   uint32_t height,
+                                                   uint32_t level_count) const {
+    if (m_spec.budget == 0) {
+        return 0;
+    }
+
+    uint32_t level = 0;
+    while (level + 1 < level_count &&
+           std::max(width >> level, height >> level) > m_spec.resident_size) {
+        level++;
+    }
+    return level;
+}
+
+void TextureStreamer::add(Texture& texture, const std::filesystem::path& path,
+                          const Ktx2Texture& info,
+                          std::vector<Ktx2LevelRange> ranges) {
+    uint32_t first_level = get_first_resident_level(
+        info.width, info.height, static_cast<uint32_t>(ranges.size()));
+
+    StreamedTexture streamed{
+        .texture = &texture,
+        .id = m_next_id++,
+        .path = path,
+        .format = info.format,
+        .width = info.width,
+        .height = info.height,
+        .ranges = std::move(ranges),
+        .first_level = first_level,
+        .target_level = first_level,
+        .resident_level = first_level,
+        .wanted_level = first_level,
+        .image_bytes = texture.get_image()->get_vk_size(),
+    };
+    m_image_bytes += streamed.image_bytes;
+    m_textures[texture.GetTextureIndex()] = std::move(streamed);
+}
+
+void TextureStreamer::remove(int32_t texture_index) {
+    auto it = m_textures.find(texture_index);
+    if (it == m_textures.end()) {
+        return;
+    }
+    // A pending load is dropped once it's done
+    m_image_bytes -= it->second.image_bytes;
+    m_textures.erase(it);
+}
+
+void TextureStreamer::update(std::span<const uint32_t> feedback) {
+    m_frame++;
+    apply_loads();
+
+    for (auto& [index, texture] : m_textures) {
+        uint32_t level = static_cast<size_t>(index) < feedback.size()
+                             ? feedback[index]
+                             : UINT32_MAX;
+        if (level == UINT32_MAX) {
+            continue;
+        }
+        texture.wanted_level = std::min(level, texture.resident_level);
+        texture.last_used_frame = m_frame;
+    }
+
+    request_loads();
+}
+
+TextureStreamer::Statistics TextureStreamer::get_statistics() const {
+    return {
+        .texture_count = static_cast<uint32_t>(m_textures.size()),
+        .resident_bytes = m_image_bytes,
+        .budget = m_budget,
+        .pending_loads = m_pending_loads,
+    };
+}
+
+VkDeviceSize TextureStreamer::get_size(const StreamedTexture& texture,
+                                       uint32_t first_level) {
+    VkDeviceSize size = 0;
+    for (size_t i = first_level; i < texture.ranges.size(); i++) {
+        size += texture.ranges[i].size;
+    }
+    return size;
+}
+
+VkDeviceSize TextureStreamer::get_budget() const {
+    // The images are in the largest device local heap
+    std::vector<MemoryAllocator::HeapStatistics> heaps =
+        Application::get()
+            .get_vulkan_manager()
+            ->get_memory_allocator()
+            .get_heap_statistics();
+    const MemoryAllocator::HeapStatistics* device_heap = nullptr;
+    for (const auto& heap : heaps) {
+        if ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) &&
+            (device_heap == nullptr ||
+             heap.heap_size > device_heap->heap_size)) {
+            device_heap = &heap;
+        }
+    }
+    if (device_heap == nullptr) {
+        return m_spec.budget;
+    }
+
+    // What the rest of the process, and the other processes, leave
+    VkDeviceSize budget =
+        device_heap->budget / 100 * (100 - k_budget_margin_percent);
+    VkDeviceSize others =
+        device_heap->usage - std::min(device_heap->usage, m_image_bytes);
+    return std::min(m_spec.budget, budget - std::min(budget, others));
+}
+
+void TextureStreamer::apply_loads() {
+    std::vector<LoadResult> results;
+    {
+        std::lock_guard lock(m_results_mutex);
+        results.swap(m_results);
+    }
+
+    for (LoadResult& result : results) {
+        m_pending_loads--;
+        auto it = m_textures.find(result.texture_index);
+        if (it == m_textures.end() || it->second.id != result.id) {
+            continue; // Removed while it was loading
+        }
+        StreamedTexture& texture = it->second;
+
+        if (!result.error.empty()) {
+            HL_WARN("Failed to stream the texture {0} ({1}), it keeps the "
+                    "levels it has.",
+                    texture.path.string(), result.error);
+            texture.failed = true;
+            texture.target_level = texture.first_level;
+            continue;
+        }
+
+        SharedPtr<Image> image = Image::create({
+            .width = std::max(texture.width >> result.first_level, 1u),
+            .height = std::max(texture.height >> result.first_level, 1u),
+            .format = texture.format,
+            .mip_levels = static_cast<uint32_t>(result.levels.size()),
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage =
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            .memory_property = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        });
+
+        std::vector<ImageLevelData> levels;
+        for (const auto& level : result.levels) {
+            levels.push_back({level.data(), level.size()});
+        }
+        // The frames wait for the upload, so the image is used right away
+        UploadTicket upload =
+            Application::get().get_upload_manager().upload_image_levels(
+                *image, levels);
+
+        if (!texture.texture->set_streamed_image(image, result.first_level,
+                                                 upload)) {
+            texture.failed = true;
+            texture.target_level = texture.first_level;
+            continue;
+        }
+        m_image_bytes -= texture.image_bytes;
+        m_image_bytes += image->get_vk_size();
+        texture.image_bytes = image->get_vk_size();
+        texture.first_level = result.first_level;
+        texture.target_level = result.first_level;
+    }
+}
+
+void TextureStreamer::request_loads() {
+    m_budget = get_budget();
+
+    // The memory once the pending loads are done
+    VkDeviceSize usage = 0;
+    for (const auto& [index, texture] : m_textures) {
+        usage += get_size(texture, texture.target_level);
+    }
+    if (usage > m_budget) {
+        usage -= std::min(usage, evict(usage - m_budget, nullptr));
+    }
+
+    // The textures missing the most levels first, then the ones sampled last
+    std::vector<std::pair<int32_t, StreamedTexture*>> candidates;
+    for (auto& [index, texture] : m_textures) {
+        if (!texture.is_loading() && !texture.failed &&
+            texture.wanted_level < texture.first_level &&
+            m_frame - texture.last_used_frame < k_unused_frames) {
+            candidates.emplace_back(index, &texture);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const auto& a, const auto& b) {
+                  uint32_t a_missing =
+                      a.second->first_level - a.second->wanted_level;
+                  uint32_t b_missing =
+                      b.second->first_level - b.second->wanted_level;
+                  if (a_missing != b_missing) {
+                      return a_missing > b_missing;
+                  }
+                  return a.second->last_used_frame > b.second->last_used_frame;
+              });
+
+    for (auto& [index, texture] : candidates) {
+        if (m_pending_loads >= k_max_pending_loads) {
+            break;
+        }
+
+        VkDeviceSize current = get_size(*texture, texture->first_level);
+        VkDeviceSize wanted = get_size(*texture, texture->wanted_level);
+        if (usage + wanted - current > m_budget) {
+            usage -= std::min(
+                usage, evict(usage + wanted - current - m_budget, texture));
+        }
+
+        // The finest level that fits
+        uint32_t level = texture->wanted_level;
+        while (level < texture->first_level &&
+               usage + get_size(*texture, level) - current > m_budget) {
+            level++;
+        }
+        if (level == texture->first_level) {
+            continue;
+        }
+        usage += get_size(*texture, level) - current;
+        load(index, *texture, level);
+    }
+}
+
+VkDeviceSize TextureStreamer::evict(VkDeviceSize bytes,
+                                    const StreamedTexture* except) {
+    // The textures with levels they don't sample anymore, and the ones not
+    // sampled lately, the least recently sampled first. The others keep the
+    // levels they sample.
+    std::vector<std::pair<int32_t, StreamedTexture*>> victims;
+    for (auto& [index, texture] : m_textures) {
+        if (&texture == except || texture.is_loading() ||
+            texture.first_level == texture.resident_level) {
+            continue;
+        }
+        bool unused = m_frame - texture.last_used_frame >= k_unused_frames;
+        if (unused || texture.first_level < texture.wanted_level) {
+            victims.emplace_back(index, &texture);
+        }
+    }
+    std::sort(victims.begin(), victims.end(),
+              [](const auto& a, const auto& b) {
+                  return a.second->last_used_frame < b.second->last_used_frame;
+              });
+
+    VkDeviceSize freed = 0;
+    for (auto& [index, texture] : victims) {
+        if (freed >= bytes) {
+            break;
+        }
+        bool unused = m_frame - texture->last_used_frame >= k_unused_frames;
+        uint32_t level =
+            unused ? texture->resident_level : texture->wanted_level;
+        freed += get_size(*texture, texture->first_level) -
+                 get_size(*texture, level);
+        load(index, *texture, level);
+    }
+    return freed;
+}
+
+void TextureStreamer::load(int32_t texture_index, StreamedTexture& texture,
+                           uint32_t first_level) {
+    texture.target_level = first_level;
+    m_pending_loads++;
+
+    auto job = [this, texture_index, id = texture.id, path = texture.path,
+                ranges = texture.ranges, first_level] {
+        LoadResult result{
+            .texture_index = texture_index,
+            .id = id,
+            .first_level = first_level,
+        };
+        read_ktx2_levels(path, ranges, first_level, result.levels,
+                         result.error);
+
+        std::lock_guard lock(m_results_mutex);
+        m_results.push_back(std::move(result));
+    };
+
+    // Without workers, nothing would run the job until it's waited on
+    JobSystem& job_system = Application::get().get_job_system();
+    if (job_system.get_worker_count() == 0) {
+        job();
+    } else {
+        job_system.submit_background(job, &m_jobs);
+    }
+}
+} // namespace Helios
@@ -0,0 +1,169 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <volk/volk.h>
+
+#include "Helios/Core/JobSystem.h"
+#include "Ktx2.h"
+
+namespace Helios {
+class Texture;
+
+struct TextureStreamerSpecification {
+    // The most memory the streamed textures can use. It's lowered to what the
+    // device's budget leaves them, with VK_EXT_memory_budget. 0 disables
+    // streaming, the textures are loaded whole.
+    VkDeviceSize budget = 512ull * 1024 * 1024;
+    // The mip levels up to this size are loaded with the texture, and stay
+    // resident
+    uint32_t resident_size = 128;
+};
+
+/**
+ * \brief Streams the mip levels of the KTX2 textures. A texture is loaded
+ * with its smallest levels only, and the larger ones are read on the job
+ * system once the mesh shaders sample them. The shaders report the finest
+ * level each texture is sampled at, a few frames later the renderer hands
+ * that feedback to update().
+ *
+ * Images can't free some of their levels, so a texture's image holds its
+ * resident levels only, and is replaced by a larger one when levels are
+ * loaded, or a smaller one when they're evicted. Textures lose levels when
+ * the budget is full, the ones not sampled recently first.
+ *
+ * Only used from the main thread.
+ */
+class TextureStreamer {
+  public:
+    struct Statistics {
+        uint32_t texture_count = 0;
+        // The memory of the streamed textures' images
+        VkDeviceSize resident_bytes = 0;
+        VkDeviceSize budget = 0;
+        uint32_t pending_loads = 0;
+    };
+
+    static std::unique_ptr<TextureStreamer>
+    create_unique(const TextureStreamerSpecification& spec) {
+        std::unique_ptr<TextureStreamer> obj =
+            std::make_unique<TextureStreamer>();
+        obj->init(spec);
+        return obj;
+    }
+
+    /**
+     * \brief The first mip level a texture is loaded with, 0 if it's loaded
+     * whole.
+     */
+    uint32_t get_first_resident_level(uint32_t width, uint32_t height,
+                                      uint32_t level_count) const;
+
+    /**
+     * \brief Stream the levels of a texture, above the ones it was loaded
+     * with.
+     * \param path The resolved path of its KTX2 file.
+     * \param info The file's header, without levels.
+     * \param ranges Where each level is in the file.
+     */
+    void add(Texture& texture, const std::filesystem::path& path,
+             const Ktx2Texture& info, std::vector<Ktx2LevelRange> ranges);
+
+    // Stop streaming a texture, e.g. when it's destroyed
+    void remove(int32_t texture_index);
+
+    /**
+     * \brief Replace the images whose levels are loaded, and request levels
+     * from the feedback. Called once per frame.
+     * \param feedback The finest mip level each texture index was sampled
+     * at, UINT32_MAX if it wasn't.
+     */
+    void update(std::span<const uint32_t> feedback);
+
+    Statistics get_statistics() const;
+
+    TextureStreamer() = default;
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+    TextureStreamer(TextureStreamer&&) = delete;
+    TextureStreamer& operator=(TextureStreamer&&) = delete;
+
+  private:
+    struct StreamedTexture {
+        Texture* texture = nullptr;
+        // Tells a texture from a later one with the same index
+        uint64_t id = 0;
+        std::filesystem::path path;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<Ktx2LevelRange> ranges;
+
+        // The first level of the image, and of the one being loaded
+        uint32_t first_level = 0;
+        uint32_t target_level = 0;
+        // The levels from there on are always resident
+        uint32_t resident_level = 0;
+        // The finest level sampled lately
+        uint32_t wanted_level = 0;
+        uint64_t last_used_frame = 0;
+        VkDeviceSize image_bytes = 0;
+        // Reading the file failed, its levels aren't loaded again
+        bool failed = false;
+
+        bool is_loading() const { return target_level != first_level; }
+    };
+
+    // The levels read by a job, from first_level on
+    struct LoadResult {
+        int32_t texture_index;
+        uint64_t id;
+        uint32_t first_level;
+        std::vector<std::vector<uint8_t>> levels;
+        std::string error;
+    };
+
+    void init(const TextureStreamerSpecification& spec);
+
+    // The memory of the levels from first_level on
+    static VkDeviceSize get_size(const StreamedTexture& texture,
+                                 uint32_t first_level);
+    // The spec's budget, lowered to what the device's budget leaves
+    VkDeviceSize get_budget() const;
+
+    void apply_loads();
+    void request_loads();
+    /**
+     * \brief Drop levels of the textures that don't need them, to free
+     * memory. The memory is counted as freed once the smaller images are
+     * requested.
+     * \return The bytes freed.
+     */
+    VkDeviceSize evict(VkDeviceSize bytes, const StreamedTexture* except);
+    // Read the levels from first_level on, on the job system
+    void load(int32_t texture_index, StreamedTexture& texture,
+              uint32_t first_level);
+
+  private:
+    TextureStreamerSpecification m_spec;
+    std::unordered_map<int32_t, StreamedTexture> m_textures;
+    uint64_t m_next_id = 1;
+    uint64_t m_frame = 0;
+
+    VkDeviceSize m_image_bytes = 0;
+    VkDeviceSize m_budget = 0;
+    uint32_t m_pending_loads = 0;
+
+    // Filled by the jobs
+    std::mutex m_results_mutex;
+    std::vector<LoadResult> m_results;
+    JobCounter m_jobs;
+};
+} // namespace Helios
@@ -0,0 +1,69 @@
+#include "TransientAllocator.h"
+
+#include "Helios/Core/Application.h"
+
+namespace Helios {
+void TransientAllocator::reset(uint32_t frame) {
+    m_current_frame = frame;
+    m_head = 0;
+}
+
+TransientAllocation TransientAllocator::allocate(VkDeviceSize size,
+                                                 VkDeviceSize alignment) {
+    VkDeviceSize offset = (m_head + alignment - 1) & ~(alignment - 1);
+    if (offset + size > m_size_per_frame) {
+        HL_ERROR("[TransientAllocator] Out of memory ({} of {} bytes used, "
+                 "requested {}).",
+                 m_head, m_size_per_frame, size);
+        return {};
+    }
+
+    m_head = offset + size;
+
+    const auto& buffer = m_buffers[m_current_frame];
+    return TransientAllocation{
+        .buffer = buffer->get_vk_buffer(),
+        .offset = offset,
+        .size = size,
+        .mapped_memory =
+            static_cast<uint8_t*>(buffer->get_mapped_memory()) + offset,
+    };
+}
+
+TransientAllocation TransientAllocator::allocate(const void* data,
+                                                 VkDeviceSize size,
+                                                 VkDeviceSize alignment) {
+    TransientAllocation allocation = allocate(size, alignment);
+    if (allocation.is_valid() && data != nullptr) {
+        memcpy(allocation.mapped_memory, data, size);
+    }
+    return allocation;
+}
+
+void TransientAllocator::init(uint32_t max_frames_in_flight,
+                              VkDeviceSize size_per_frame) {
+    const VulkanContext& context =
+        Application::get().get_vulkan_manager()->get_context();
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(context.physical_device, &properties);
+    m_min_uniform_alignment = std::max<VkDeviceSize>(
+        properties.limits.minUniformBufferOffsetAlignment,
+        properties.limits.minStorageBufferOffsetAlignment);
+
+    m_size_per_frame = size_per_frame;
+
+    m_buffers.resize(max_frames_in_flight);
+    for (auto& buffer : m_buffers) {
+        buffer = Buffer::create(
+            size_per_frame,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VulkanUtils::get_host_write_memory_properties(
+                context.physical_device),
+            true);
+    }
+}
+} // namespace Helios
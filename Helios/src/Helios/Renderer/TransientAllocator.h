@@ -0,0 +1,89 @@
+#pragma once
+#include <volk/volk.h>
+
+#include "Buffer.h"
+#include "Helios/Core/Core.h"
+
+namespace Helios {
+// A sub-allocation made from the transient buffer of the current frame.
+struct TransientAllocation {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped_memory = nullptr;
+
+    bool is_valid() const { return mapped_memory != nullptr; }
+};
+
+/**
+ * \brief A linear allocator for data that only lives for a single frame
+ * (lights, camera constants, indirect commands...). There is one persistently
+ * mapped buffer for each frame in flight, which is reset once the frame's
+ * fence has been waited on, so the whole frame can be recorded without
+ * stalling.
+ */
+class TransientAllocator {
+  public:
+    static std::unique_ptr<TransientAllocator>
+    create_unique(uint32_t max_frames_in_flight, VkDeviceSize size_per_frame) {
+        std::unique_ptr<TransientAllocator> obj =
+            std::make_unique<TransientAllocator>();
+        obj->init(max_frames_in_flight, size_per_frame);
+        return obj;
+    }
+
+    /**
+     * \brief Reset the allocator for a frame. Only call this once the GPU is
+     * done with the frame.
+     * \param frame The frame in flight index.
+     */
+    void reset(uint32_t frame);
+
+    /**
+     * \brief Allocate memory from the current frame's buffer.
+     * \param size The size (in bytes).
+     * \param alignment The required alignment of the offset.
+     * \return The allocation, which is invalid if the buffer is full.
+     */
+    TransientAllocation allocate(VkDeviceSize size,
+                                 VkDeviceSize alignment = 16);
+
+    /**
+     * \brief Allocate, and copy data into, the current frame's buffer.
+     */
+    TransientAllocation allocate(const void* data, VkDeviceSize size,
+                                 VkDeviceSize alignment = 16);
+
+    /**
+     * \brief Allocate memory suitable for (dynamic) uniform buffer bindings.
+     */
+    TransientAllocation allocate_uniform(VkDeviceSize size) {
+        return allocate(size, m_min_uniform_alignment);
+    }
+
+    const SharedPtr<Buffer>& get_buffer(uint32_t frame) const {
+        return m_buffers[frame];
+    }
+
+    VkDeviceSize get_size_per_frame() const { return m_size_per_frame; }
+
+    TransientAllocator() = default;
+    ~TransientAllocator() = default;
+
+    TransientAllocator(const TransientAllocator&) = delete;
+    TransientAllocator& operator=(const TransientAllocator&) = delete;
+    TransientAllocator(TransientAllocator&&) = delete;
+    TransientAllocator& operator=(TransientAllocator&&) = delete;
+
+  private:
+    void init(uint32_t max_frames_in_flight, VkDeviceSize size_per_frame);
+
+  private:
+    std::vector<SharedPtr<Buffer>> m_buffers; // One for each frame in flight
+    uint32_t m_current_frame = 0;
+    VkDeviceSize m_head = 0;
+
+    VkDeviceSize m_size_per_frame = 0;
+    VkDeviceSize m_min_uniform_alignment = 256;
+};
+} // namespace Helios
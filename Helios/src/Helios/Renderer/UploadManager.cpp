@@ -0,0 +1,602 @@
+#include "UploadManager.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Helios/Core/Log.h"
+#include "Helios/Vulkan/VulkanContext.h"
+#include "Image.h"
+
+namespace Helios {
+namespace {
+// The staging memory of a batch, larger uploads get their own buffer
+constexpr VkDeviceSize k_staging_buffer_size = 32 * 1024 * 1024;
+// Enough for any texel size, and the 4 bytes copies need
+constexpr VkDeviceSize k_staging_alignment = 16;
+// Past this many batches in flight, the oldest one is waited for before
+// starting a new one. Bounds the staging memory.
+constexpr size_t k_max_submitted_batches = 8;
+
+VkCommandPool create_command_pool(VkDevice device, uint32_t queue_family) {
+    VkCommandPoolCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                 VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    info.queueFamilyIndex = queue_family;
+
+    VkCommandPool pool = VK_NULL_HANDLE;
+    if (vkCreateCommandPool(device, &info, nullptr, &pool) != VK_SUCCESS) {
+        HL_ERROR("Failed to create the upload command pool!");
+    }
+    return pool;
+}
+
+VkCommandBuffer allocate_command_buffer(VkDevice device, VkCommandPool pool) {
+    VkCommandBufferAllocateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    info.commandPool = pool;
+    info.commandBufferCount = 1;
+
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    vkAllocateCommandBuffers(device, &info, &command_buffer);
+    return command_buffer;
+}
+
+void begin_commands(VkCommandBuffer command_buffer) {
+    VkCommandBufferBeginInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(command_buffer, &info);
+}
+
+// Blit each mip level from the previous one, and transition them all to
+// shader read only. The levels are transfer destinations before.
+void generate_mips(VkCommandBuffer command_buffer, VkImage image,
+                   int32_t width, int32_t height, uint32_t mip_levels,
+                   uint32_t layer_count) {
+    VkImageMemoryBarrier to_source{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = layer_count,
+            },
+    };
+
+    for (uint32_t level = 1; level < mip_levels; level++) {
+        to_source.subresourceRange.baseMipLevel = level - 1;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                             nullptr, 1, &to_source);
+
+        int32_t level_width = std::max(width / 2, 1);
+        int32_t level_height = std::max(height / 2, 1);
+        VkImageBlit blit{
+            .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0,
+                               layer_count},
+            .srcOffsets = {{0, 0, 0}, {width, height, 1}},
+            .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0,
+                               layer_count},
+            .dstOffsets = {{0, 0, 0}, {level_width, level_height, 1}},
+        };
+        vkCmdBlitImage(command_buffer, image,
+                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+                       VK_FILTER_LINEAR);
+        width = level_width;
+        height = level_height;
+    }
+
+    // The blit sources, and the last level which is only written
+    VkImageMemoryBarrier to_shader[2];
+    to_shader[0] = to_source;
+    to_shader[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    to_shader[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    to_shader[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    to_shader[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    to_shader[0].subresourceRange.baseMipLevel = 0;
+    to_shader[0].subresourceRange.levelCount = mip_levels - 1;
+    to_shader[1] = to_shader[0];
+    to_shader[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    to_shader[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    to_shader[1].subresourceRange.baseMipLevel = mip_levels - 1;
+    to_shader[1].subresourceRange.levelCount = 1;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                         0, nullptr, 2, to_shader);
+}
+
+// Submit commands that signal the timeline, after waiting for it if
+// wait_value isn't 0
+void submit(VkQueue queue, VkCommandBuffer command_buffer,
+            VkSemaphore timeline, uint64_t wait_value,
+            VkPipelineStageFlags wait_stage, uint64_t signal_value) {
+    VkTimelineSemaphoreSubmitInfo timeline_info{};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.waitSemaphoreValueCount = wait_value != 0 ? 1 : 0;
+    timeline_info.pWaitSemaphoreValues = &wait_value;
+    timeline_info.signalSemaphoreValueCount = 1;
+    timeline_info.pSignalSemaphoreValues = &signal_value;
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = &timeline_info;
+    submit_info.waitSemaphoreCount = wait_value != 0 ? 1 : 0;
+    submit_info.pWaitSemaphores = &timeline;
+    submit_info.pWaitDstStageMask = &wait_stage;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &command_buffer;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &timeline;
+
+    if (vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+        HL_ERROR("Failed to submit the uploads!");
+    }
+}
+} // namespace
+
+UploadManager::~UploadManager() {
+    if (m_timeline == VK_NULL_HANDLE) {
+        return;
+    }
+
+    // The staging buffers are destroyed through the destruction queue, the
+    // rest once the uploads are done
+    VkSemaphoreWaitInfo wait_info{};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &m_timeline;
+    wait_info.pValues = &m_timeline_value;
+    vkWaitSemaphores(m_device, &wait_info, UINT64_MAX);
+
+    vkDestroyCommandPool(m_device, m_transfer_command_pool, nullptr);
+    if (m_acquire_command_pool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(m_device, m_acquire_command_pool, nullptr);
+    }
+    vkDestroySemaphore(m_device, m_timeline, nullptr);
+}
+
+void UploadManager::init(const VulkanContext& context) {
+    m_device = context.device;
+    m_graphics_queue = context.graphics_queue;
+    m_transfer_queue = context.transfer_queue;
+    m_graphics_family = context.graphics_family;
+    m_transfer_family = context.transfer_family;
+
+    m_transfer_command_pool = create_command_pool(m_device, m_transfer_family);
+    if (has_transfer_queue()) {
+        m_acquire_command_pool =
+            create_command_pool(m_device, m_graphics_family);
+    }
+
+    VkSemaphoreTypeCreateInfo type_info{};
+    type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue = 0;
+    VkSemaphoreCreateInfo semaphore_info{};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_info.pNext = &type_info;
+    if (vkCreateSemaphore(m_device, &semaphore_info, nullptr, &m_timeline) !=
+        VK_SUCCESS) {
+        HL_ERROR("Failed to create the upload timeline semaphore!");
+    }
+}
+
+UploadTicket UploadManager::upload_buffer(VkBuffer buffer,
+                                          VkDeviceSize offset,
+                                          const void* data, VkDeviceSize size,
+                                          VkAccessFlags dst_access,
+                                          VkPipelineStageFlags dst_stage) {
+    if (size == 0) {
+        return 0;
+    }
+
+    StagingAllocation staging = allocate_staging(size);
+    memcpy(staging.memory, data, size);
+
+    Batch& batch = get_batch();
+    VkBufferCopy region{
+        .srcOffset = staging.offset,
+        .dstOffset = offset,
+        .size = size,
+    };
+    vkCmdCopyBuffer(batch.transfer_commands, staging.buffer, buffer, 1,
+                    &region);
+
+    batch.buffer_acquires.push_back({
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = dst_access,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = buffer,
+        .offset = offset,
+        .size = size,
+    });
+    batch.acquire_stages |= dst_stage;
+    batch.empty = false;
+    return batch.ticket;
+}
+
+UploadTicket UploadManager::upload_image(const Image& image,
+                                         std::span<const void* const> layers,
+                                         VkDeviceSize layer_size) {
+    if (layers.empty()) {
+        return 0;
+    }
+
+    StagingAllocation staging = allocate_staging(layer_size * layers.size());
+    for (size_t i = 0; i < layers.size(); i++) {
+        memcpy(staging.memory + layer_size * i, layers[i], layer_size);
+    }
+
+    std::vector<VkBufferImageCopy> regions(layers.size());
+    for (size_t i = 0; i < layers.size(); i++) {
+        regions[i] = {
+            .bufferOffset = staging.offset + layer_size * i,
+            .imageSubresource =
+                {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = 0,
+                    .baseArrayLayer = static_cast<uint32_t>(i),
+                    .layerCount = 1,
+                },
+            .imageExtent = {image.get_width(), image.get_height(), 1},
+        };
+    }
+    // The other levels, if any, are generated from the first
+    return copy_to_image(image, static_cast<uint32_t>(layers.size()),
+                         staging.buffer, regions,
+                         image.get_mip_levels() > 1);
+}
+
+UploadTicket
+UploadManager::upload_image_levels(const Image& image,
+                                   std::span<const ImageLevelData> levels) {
+    if (levels.empty()) {
+        return 0;
+    }
+
+    // The levels are copied one after the other, each aligned for its texel
+    // blocks
+    auto align = [](VkDeviceSize offset) {
+        return (offset + k_staging_alignment - 1) & ~(k_staging_alignment - 1);
+    };
+    VkDeviceSize size = 0;
+    for (const ImageLevelData& level : levels) {
+        size = align(size) + level.size;
+    }
+    StagingAllocation staging = allocate_staging(size);
+
+    std::vector<VkBufferImageCopy> regions(levels.size());
+    VkDeviceSize offset = 0;
+    for (uint32_t i = 0; i < levels.size(); i++) {
+        offset = align(offset);
+        memcpy(staging.memory + offset, levels[i].data, levels[i].size);
+        regions[i] = {
+            .bufferOffset = staging.offset + offset,
+            .imageSubresource =
+                {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = i,
+                    .baseArrayLayer = 0,
+                    .layerCount = image.get_layer_count(),
+                },
+            .imageExtent = {std::max(image.get_width() >> i, 1u),
+                            std::max(image.get_height() >> i, 1u), 1},
+        };
+        offset += levels[i].size;
+    }
+
+    return copy_to_image(image, image.get_layer_count(), staging.buffer,
+                         regions, false);
+}
+
+UploadTicket
+UploadManager::copy_to_image(const Image& image, uint32_t layer_count,
+                             VkBuffer staging_buffer,
+                             std::span<const VkBufferImageCopy> regions,
+                             bool generate_mips) {
+    Batch& batch = get_batch();
+    const VkImageSubresourceRange range{
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel = 0,
+        .levelCount = image.get_mip_levels(),
+        .baseArrayLayer = 0,
+        .layerCount = layer_count,
+    };
+
+    VkImageMemoryBarrier to_transfer{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image.get_vk_image(),
+        .subresourceRange = range,
+    };
+    vkCmdPipelineBarrier(batch.transfer_commands,
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &to_transfer);
+
+    vkCmdCopyBufferToImage(batch.transfer_commands, staging_buffer,
+                           image.get_vk_image(),
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(regions.size()),
+                           regions.data());
+
+    if (!generate_mips) {
+        batch.image_acquires.push_back({
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image.get_vk_image(),
+            .subresourceRange = range,
+        });
+        batch.acquire_stages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    } else {
+        // Acquired as a transfer destination, the blits transition it after
+        batch.image_acquires.push_back({
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask =
+                VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image.get_vk_image(),
+            .subresourceRange = range,
+        });
+        batch.acquire_stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+        batch.mip_generations.push_back({
+            .image = image.get_vk_image(),
+            .width = static_cast<int32_t>(image.get_width()),
+            .height = static_cast<int32_t>(image.get_height()),
+            .mip_levels = image.get_mip_levels(),
+            .layer_count = layer_count,
+        });
+    }
+    batch.empty = false;
+    return batch.ticket;
+}
+
+void UploadManager::flush() {
+    if (m_batch == nullptr || m_batch->empty) {
+        return;
+    }
+    Batch& batch = *m_batch;
+
+    if (!has_transfer_queue()) {
+        // One queue, so the barriers only make the copies visible
+        vkCmdPipelineBarrier(
+            batch.transfer_commands, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            batch.acquire_stages, 0, 0, nullptr,
+            static_cast<uint32_t>(batch.buffer_acquires.size()),
+            batch.buffer_acquires.data(),
+            static_cast<uint32_t>(batch.image_acquires.size()),
+            batch.image_acquires.data());
+        record_mip_generations(batch, batch.transfer_commands);
+        vkEndCommandBuffer(batch.transfer_commands);
+        submit(m_graphics_queue, batch.transfer_commands, m_timeline, 0, 0,
+               batch.ticket);
+    } else {
+        // Release the resources to the graphics queue family. The release
+        // and acquire barriers have to match, except for the access masks.
+        for (auto& barrier : batch.buffer_acquires) {
+            barrier.srcQueueFamilyIndex = m_transfer_family;
+            barrier.dstQueueFamilyIndex = m_graphics_family;
+        }
+        for (auto& barrier : batch.image_acquires) {
+            barrier.srcQueueFamilyIndex = m_transfer_family;
+            barrier.dstQueueFamilyIndex = m_graphics_family;
+        }
+        std::vector<VkBufferMemoryBarrier> buffer_releases =
+            batch.buffer_acquires;
+        std::vector<VkImageMemoryBarrier> image_releases =
+            batch.image_acquires;
+        for (auto& barrier : buffer_releases) {
+            barrier.dstAccessMask = 0;
+        }
+        for (auto& barrier : image_releases) {
+            barrier.dstAccessMask = 0;
+        }
+        vkCmdPipelineBarrier(batch.transfer_commands,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+                             nullptr,
+                             static_cast<uint32_t>(buffer_releases.size()),
+                             buffer_releases.data(),
+                             static_cast<uint32_t>(image_releases.size()),
+                             image_releases.data());
+        vkEndCommandBuffer(batch.transfer_commands);
+        submit(m_transfer_queue, batch.transfer_commands, m_timeline, 0, 0,
+               batch.ticket - 1);
+
+        // The frames are submitted after, so they see the resources once
+        // acquired
+        for (auto& barrier : batch.buffer_acquires) {
+            barrier.srcAccessMask = 0;
+        }
+        for (auto& barrier : batch.image_acquires) {
+            barrier.srcAccessMask = 0;
+        }
+        begin_commands(batch.acquire_commands);
+        vkCmdPipelineBarrier(
+            batch.acquire_commands, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            batch.acquire_stages, 0, 0, nullptr,
+            static_cast<uint32_t>(batch.buffer_acquires.size()),
+            batch.buffer_acquires.data(),
+            static_cast<uint32_t>(batch.image_acquires.size()),
+            batch.image_acquires.data());
+        record_mip_generations(batch, batch.acquire_commands);
+        vkEndCommandBuffer(batch.acquire_commands);
+        submit(m_graphics_queue, batch.acquire_commands, m_timeline,
+               batch.ticket - 1, VK_PIPELINE_STAGE_TRANSFER_BIT,
+               batch.ticket);
+    }
+
+    m_timeline_value = batch.ticket;
+    m_submitted_batches.push_back(std::move(m_batch));
+}
+
+void UploadManager::record_mip_generations(const Batch& batch,
+                                           VkCommandBuffer command_buffer) {
+    for (const MipGeneration& mips : batch.mip_generations) {
+        generate_mips(command_buffer, mips.image, mips.width, mips.height,
+                      mips.mip_levels, mips.layer_count);
+    }
+}
+
+bool UploadManager::is_complete(UploadTicket ticket) const {
+    if (ticket == 0) {
+        return true;
+    }
+    uint64_t value = 0;
+    vkGetSemaphoreCounterValue(m_device, m_timeline, &value);
+    return value >= ticket;
+}
+
+void UploadManager::wait(UploadTicket ticket) {
+    if (ticket == 0) {
+        return;
+    }
+    if (m_batch != nullptr && ticket >= m_batch->ticket) {
+        flush();
+    }
+
+    VkSemaphoreWaitInfo wait_info{};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &m_timeline;
+    wait_info.pValues = &ticket;
+    vkWaitSemaphores(m_device, &wait_info, UINT64_MAX);
+}
+
+UploadManager::Batch& UploadManager::get_batch() {
+    if (m_batch != nullptr) {
+        return *m_batch;
+    }
+
+    recycle_batches();
+    if (m_free_batches.empty() &&
+        m_submitted_batches.size() >= k_max_submitted_batches) {
+        wait(m_submitted_batches.front()->ticket);
+        recycle_batches();
+    }
+
+    if (!m_free_batches.empty()) {
+        m_batch = std::move(m_free_batches.back());
+        m_free_batches.pop_back();
+    } else {
+        m_batch = create_batch();
+    }
+    begin_batch(*m_batch);
+    return *m_batch;
+}
+
+std::unique_ptr<UploadManager::Batch> UploadManager::create_batch() {
+    auto batch = std::make_unique<Batch>();
+    batch->transfer_commands =
+        allocate_command_buffer(m_device, m_transfer_command_pool);
+    if (has_transfer_queue()) {
+        batch->acquire_commands =
+            allocate_command_buffer(m_device, m_acquire_command_pool);
+    }
+    batch->staging_buffer = Buffer::create_unique(
+        k_staging_buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        true);
+    return batch;
+}
+
+void UploadManager::begin_batch(Batch& batch) {
+    vkResetCommandBuffer(batch.transfer_commands, 0);
+    if (batch.acquire_commands != VK_NULL_HANDLE) {
+        vkResetCommandBuffer(batch.acquire_commands, 0);
+    }
+    begin_commands(batch.transfer_commands);
+
+    batch.staging_head = 0;
+    batch.dedicated_staging_buffer.reset();
+    batch.buffer_acquires.clear();
+    batch.image_acquires.clear();
+    batch.acquire_stages = 0;
+    batch.mip_generations.clear();
+    batch.empty = true;
+    // With a transfer queue, the copies signal the value before the ticket,
+    // and the acquire the ticket
+    batch.ticket = m_timeline_value + (has_transfer_queue() ? 2 : 1);
+}
+
+UploadManager::StagingAllocation
+UploadManager::allocate_staging(VkDeviceSize size) {
+    // A batch with a dedicated staging buffer is submitted right away, so
+    // large uploads don't pile up
+    if (m_batch != nullptr && m_batch->dedicated_staging_buffer != nullptr) {
+        flush();
+    }
+
+    if (size > k_staging_buffer_size) {
+        Batch& batch = get_batch();
+        batch.dedicated_staging_buffer = Buffer::create_unique(
+            size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            true);
+        return {
+            .buffer = batch.dedicated_staging_buffer->get_vk_buffer(),
+            .offset = 0,
+            .memory = static_cast<uint8_t*>(
+                batch.dedicated_staging_buffer->get_mapped_memory()),
+        };
+    }
+
+    Batch* batch = &get_batch();
+    VkDeviceSize offset = (batch->staging_head + k_staging_alignment - 1) &
+                          ~(k_staging_alignment - 1);
+    if (offset + size > k_staging_buffer_size) {
+        flush();
+        batch = &get_batch();
+        offset = 0;
+    }
+    batch->staging_head = offset + size;
+
+    return {
+        .buffer = batch->staging_buffer->get_vk_buffer(),
+        .offset = offset,
+        .memory =
+            static_cast<uint8_t*>(batch->staging_buffer->get_mapped_memory()) +
+            offset,
+    };
+}
+
+void UploadManager::recycle_batches() {
+    uint64_t value = 0;
+    vkGetSemaphoreCounterValue(m_device, m_timeline, &value);
+    while (!m_submitted_batches.empty() &&
+           m_submitted_batches.front()->ticket <= value) {
+        m_submitted_batches.front()->dedicated_staging_buffer.reset();
+        m_free_batches.push_back(std::move(m_submitted_batches.front()));
+        m_submitted_batches.pop_front();
+    }
+}
+} // namespace Helios
@@ -0,0 +1,177 @@
+#pragma once
+#include <deque>
+#include <memory>
+#include <span>
+#include <vector>
+#include <volk/volk.h>
+
+#include "Buffer.h"
+#include "Helios/Core/Core.h"
+
+namespace Helios {
+struct VulkanContext;
+class Image;
+
+// A point on the upload timeline, an upload is complete once the timeline
+// reaches it. 0 is always complete.
+using UploadTicket = uint64_t;
+
+// A mip level's data, all the image's layers one after the other
+struct ImageLevelData {
+    const void* data;
+    VkDeviceSize size;
+};
+
+/**
+ * \brief Copies data to buffers and images through staging buffers. The
+ * uploads are batched, and a batch is submitted once per frame (or when its
+ * staging memory is full) instead of once per upload, and nothing waits for
+ * it. If the device has a transfer only queue family the copies run on it,
+ * and the graphics queue acquires the resources before the frame that
+ * submitted them, so they can be used in that frame. Completion is tracked
+ * with a timeline semaphore.
+ *
+ * Only used from the main thread, like the queues.
+ */
+class UploadManager {
+  public:
+    static std::unique_ptr<UploadManager>
+    create_unique(const VulkanContext& context) {
+        std::unique_ptr<UploadManager> obj = std::make_unique<UploadManager>();
+        obj->init(context);
+        return obj;
+    }
+
+    /**
+     * \brief Copy data to a range of a buffer.
+     * \param dst_access How the graphics queue accesses the range after.
+     * \param dst_stage The stages that access it.
+     */
+    UploadTicket upload_buffer(VkBuffer buffer, VkDeviceSize offset,
+                               const void* data, VkDeviceSize size,
+                               VkAccessFlags dst_access,
+                               VkPipelineStageFlags dst_stage);
+
+    /**
+     * \brief Copy the layers of an image's first mip level, and transition
+     * the image from undefined to shader read only. The other mip levels, if
+     * any, are generated from the first with linear blits on the graphics
+     * queue, so the format has to support them.
+     * \param layers The data of each layer, layer_size bytes each.
+     */
+    UploadTicket upload_image(const Image& image,
+                              std::span<const void* const> layers,
+                              VkDeviceSize layer_size);
+
+    /**
+     * \brief Copy every mip level of an image, e.g. the precomputed levels of
+     * a compressed texture, and transition it from undefined to shader read
+     * only.
+     * \param levels The data of each level, the first one first.
+     */
+    UploadTicket upload_image_levels(const Image& image,
+                                     std::span<const ImageLevelData> levels);
+
+    /**
+     * \brief Submit the uploads recorded so far. Called before every frame's
+     * submit, and before submitting work that uses the uploads without going
+     * through a frame.
+     */
+    void flush();
+
+    bool is_complete(UploadTicket ticket) const;
+    // Blocks until the upload is complete, flushing it first if needed
+    void wait(UploadTicket ticket);
+
+    UploadManager() = default;
+    ~UploadManager();
+
+    UploadManager(const UploadManager&) = delete;
+    UploadManager& operator=(const UploadManager&) = delete;
+    UploadManager(UploadManager&&) = delete;
+    UploadManager& operator=(UploadManager&&) = delete;
+
+  private:
+    struct StagingAllocation {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        uint8_t* memory;
+    };
+
+    // An image whose mip levels are generated once its first is copied
+    struct MipGeneration {
+        VkImage image;
+        int32_t width;
+        int32_t height;
+        uint32_t mip_levels;
+        uint32_t layer_count;
+    };
+
+    struct Batch {
+        VkCommandBuffer transfer_commands = VK_NULL_HANDLE;
+        // Acquires the resources, only used with a transfer queue
+        VkCommandBuffer acquire_commands = VK_NULL_HANDLE;
+        std::unique_ptr<Buffer> staging_buffer;
+        VkDeviceSize staging_head = 0;
+        // For an upload larger than the staging buffer
+        std::unique_ptr<Buffer> dedicated_staging_buffer;
+
+        std::vector<VkBufferMemoryBarrier> buffer_acquires;
+        std::vector<VkImageMemoryBarrier> image_acquires;
+        VkPipelineStageFlags acquire_stages = 0;
+        // Recorded after the acquires, blits need a graphics queue
+        std::vector<MipGeneration> mip_generations;
+
+        bool empty = true;
+        // The batch's commands are done once the timeline reaches it
+        UploadTicket ticket = 0;
+    };
+
+    void init(const VulkanContext& context);
+
+    // The batch being recorded, begun if needed
+    Batch& get_batch();
+    std::unique_ptr<Batch> create_batch();
+    void begin_batch(Batch& batch);
+
+    /**
+     * \brief Staging memory for an upload, in the current batch. The batch is
+     * flushed first if it is full.
+     */
+    StagingAllocation allocate_staging(VkDeviceSize size);
+
+    // Record the copy from staging memory, and the image's acquire
+    UploadTicket copy_to_image(const Image& image, uint32_t layer_count,
+                               VkBuffer staging_buffer,
+                               std::span<const VkBufferImageCopy> regions,
+                               bool generate_mips);
+
+    // On a graphics queue, after the acquires
+    void record_mip_generations(const Batch& batch,
+                                VkCommandBuffer command_buffer);
+
+    // Reclaim the batches whose commands are done
+    void recycle_batches();
+
+    bool has_transfer_queue() const {
+        return m_transfer_family != m_graphics_family;
+    }
+
+  private:
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkQueue m_graphics_queue = VK_NULL_HANDLE;
+    VkQueue m_transfer_queue = VK_NULL_HANDLE;
+    uint32_t m_graphics_family = 0;
+    uint32_t m_transfer_family = 0;
+
+    VkCommandPool m_transfer_command_pool = VK_NULL_HANDLE;
+    VkCommandPool m_acquire_command_pool = VK_NULL_HANDLE;
+    VkSemaphore m_timeline = VK_NULL_HANDLE;
+    // The last value signaled, or to be signaled, on the timeline
+    uint64_t m_timeline_value = 0;
+
+    std::unique_ptr<Batch> m_batch; // Being recorded
+    std::deque<std::unique_ptr<Batch>> m_submitted_batches;
+    std::vector<std::unique_ptr<Batch>> m_free_batches;
+};
+} // namespace Helios
@@ -3,6 +3,7 @@
 #include <volk/volk.h>
 
 #include "Buffer.h"
+#include "UploadManager.h"
 
 namespace Helios
 {
@@ -24,6 +25,8 @@ namespace Helios
 		void insert_memory(void* data, size_t size, uint32_t offset = 0);
 
 		const VkBuffer& get_vk_buffer() const { return m_buffer->get_vk_buffer(); }
+		// The last upload to the buffer
+		UploadTicket get_upload() const { return m_upload; }
 
 		VertexBuffer() = default;
 		~VertexBuffer() = default;
@@ -38,5 +41,6 @@ namespace Helios
 
 	private:
 		std::unique_ptr<Buffer> m_buffer;
+		UploadTicket m_upload = 0;
 	};
 }
@@ -14,6 +14,12 @@ namespace Helios
 		FLOAT4 = VK_FORMAT_R32G32B32A32_SFLOAT,
 		INT32 = VK_FORMAT_R32_SINT,
 		UINT32 = VK_FORMAT_R32_UINT,
+		UNORM16x4 = VK_FORMAT_R16G16B16A16_UNORM,
+		SNORM16x2 = VK_FORMAT_R16G16_SNORM,
+		HALF2 = VK_FORMAT_R16G16_SFLOAT,
+		UNORM8x4 = VK_FORMAT_R8G8B8A8_UNORM,
+		SNORM16x4 = VK_FORMAT_R16G16B16A16_SNORM,
+		UINT16x4 = VK_FORMAT_R16G16B16A16_UINT,
 	};
 
 	struct VertexAttribute
@@ -38,6 +44,12 @@ namespace Helios
 		case VertexAttributeFormat::FLOAT4: return 4 * sizeof(float);
 		case VertexAttributeFormat::INT32: return sizeof(int32_t);
 		case VertexAttributeFormat::UINT32: return sizeof(uint32_t);
+		case VertexAttributeFormat::UNORM16x4: return 4 * sizeof(uint16_t);
+		case VertexAttributeFormat::SNORM16x2: return 2 * sizeof(int16_t);
+		case VertexAttributeFormat::HALF2: return 2 * sizeof(uint16_t);
+		case VertexAttributeFormat::UNORM8x4: return 4 * sizeof(uint8_t);
+		case VertexAttributeFormat::SNORM16x4: return 4 * sizeof(int16_t);
+		case VertexAttributeFormat::UINT16x4: return 4 * sizeof(uint16_t);
 		}
 
 		return 0;
@@ -52,7 +64,13 @@ namespace Helios
 		case VertexAttributeFormat::FLOAT3: return 16;
 		case VertexAttributeFormat::FLOAT4: return 16;
 		case VertexAttributeFormat::INT32:
-		case VertexAttributeFormat::UINT32: return 4;
+		case VertexAttributeFormat::UINT32:
+		case VertexAttributeFormat::UNORM16x4:
+		case VertexAttributeFormat::SNORM16x2:
+		case VertexAttributeFormat::HALF2:
+		case VertexAttributeFormat::UNORM8x4:
+		case VertexAttributeFormat::SNORM16x4:
+		case VertexAttributeFormat::UINT16x4: return 4;
 		default: return 1;
 		}
 	}
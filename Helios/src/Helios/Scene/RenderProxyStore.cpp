@@ -0,0 +1,203 @@
+#include "RenderProxyStore.h"
+
+#include <map>
+
+#include "Helios/Core/Application.h"
+
+namespace Helios {
+namespace {
+constexpr size_t k_initial_proxy_capacity = 1024;
+
+// Materials with custom shaders are drawn with their own pipeline, so they
+// get their own batch
+const Material* get_custom_material(const MeshRendererComponent& component) {
+    if (component.material && (component.material->get_vertex_shader() ||
+                               component.material->get_fragment_shader())) {
+        return component.material.get();
+    }
+    return nullptr;
+}
+} // namespace
+
+RenderProxyStore::RenderProxyStore(entt::registry& registry)
+    : m_registry(registry) {
+    m_instance_buffer = RetainedInstanceBuffer::create_unique(
+        Application::get().get_max_frames_in_flight(),
+        sizeof(MeshRenderingShaderInstanceData), k_initial_proxy_capacity);
+
+    m_registry.on_construct<MeshRendererComponent>()
+        .connect<&RenderProxyStore::on_structure_changed>(*this);
+    m_registry.on_update<MeshRendererComponent>()
+        .connect<&RenderProxyStore::on_structure_changed>(*this);
+    m_registry.on_destroy<MeshRendererComponent>()
+        .connect<&RenderProxyStore::on_structure_changed>(*this);
+    m_registry.on_construct<TransformComponent>()
+        .connect<&RenderProxyStore::on_structure_changed>(*this);
+    m_registry.on_update<TransformComponent>()
+        .connect<&RenderProxyStore::on_transform_updated>(*this);
+    m_registry.on_destroy<TransformComponent>()
+        .connect<&RenderProxyStore::on_structure_changed>(*this);
+}
+
+RenderProxyStore::~RenderProxyStore() {
+    m_registry.on_construct<MeshRendererComponent>().disconnect(this);
+    m_registry.on_update<MeshRendererComponent>().disconnect(this);
+    m_registry.on_destroy<MeshRendererComponent>().disconnect(this);
+    m_registry.on_construct<TransformComponent>().disconnect(this);
+    m_registry.on_update<TransformComponent>().disconnect(this);
+    m_registry.on_destroy<TransformComponent>().disconnect(this);
+}
+
+void RenderProxyStore::update() {
+    if (!m_structure_dirty) {
+        for (entt::entity entity : m_updated_entities) {
+            auto it = m_proxy_indices.find(entity);
+            if (it != m_proxy_indices.end()) {
+                refresh_proxy(it->second,
+                              m_registry.get<TransformComponent>(entity),
+                              m_registry.get<MeshRendererComponent>(entity));
+            }
+        }
+    }
+    m_updated_entities.clear();
+
+    // Components are also modified in place (scripts, physics, the editor),
+    // which does not emit on_update. Catch those changes by comparing against
+    // the state the instances were prepared from.
+    for (size_t i = 0; i < m_proxies.size() && !m_structure_dirty; i++) {
+        const RenderProxy& proxy = m_proxies[i];
+        const auto& transform =
+            m_registry.get<TransformComponent>(proxy.entity);
+        const auto& mesh_renderer =
+            m_registry.get<MeshRendererComponent>(proxy.entity);
+
+        if (mesh_renderer.mesh.get() != proxy.mesh ||
+            get_custom_material(mesh_renderer) !=
+                m_batches[proxy.batch].custom_material.get()) {
+            // The entity moved to another batch
+            m_structure_dirty = true;
+        } else if (transform.position != proxy.transform.position ||
+                   transform.rotation != proxy.transform.rotation ||
+                   transform.scale != proxy.transform.scale ||
+                   mesh_renderer.material.get() != proxy.material ||
+                   mesh_renderer.tint_color != proxy.tint_color) {
+            refresh_proxy(i, transform, mesh_renderer);
+        }
+    }
+    for (size_t i = 0; i < m_meshless_entities.size() && !m_structure_dirty;
+         i++) {
+        if (m_registry.get<MeshRendererComponent>(m_meshless_entities[i])
+                .mesh) {
+            m_structure_dirty = true;
+        }
+    }
+
+    if (m_structure_dirty) {
+        rebuild();
+        m_structure_dirty = false;
+    }
+
+    m_instance_buffer->sync(Application::get().get_current_frame());
+}
+
+void RenderProxyStore::on_structure_changed(entt::registry& registry,
+                                            entt::entity entity) {
+    m_structure_dirty = true;
+}
+
+void RenderProxyStore::on_transform_updated(entt::registry& registry,
+                                            entt::entity entity) {
+    m_updated_entities.push_back(entity);
+}
+
+void RenderProxyStore::rebuild() {
+    m_batches.clear();
+    m_proxies.clear();
+    m_proxy_indices.clear();
+    m_meshless_entities.clear();
+
+    auto view =
+        m_registry
+            .view<const TransformComponent, const MeshRendererComponent>();
+
+    // Group the entities by mesh (and custom material)
+    std::map<std::pair<const Mesh*, const Material*>, size_t> batch_indices;
+    std::vector<std::pair<entt::entity, size_t>> entity_batches;
+    for (auto [entity, transform, mesh_renderer] : view.each()) {
+        if (mesh_renderer.mesh == nullptr) {
+            m_meshless_entities.push_back(entity);
+            continue;
+        }
+
+        auto key = std::make_pair(mesh_renderer.mesh.get(),
+                                  get_custom_material(mesh_renderer));
+        auto it = batch_indices.find(key);
+        if (it == batch_indices.end()) {
+            it = batch_indices.emplace(key, m_batches.size()).first;
+            m_batches.push_back({
+                .mesh = mesh_renderer.mesh,
+                .custom_material = key.second ? mesh_renderer.material
+                                              : nullptr,
+            });
+        }
+
+        m_batches[it->second].instance_count++;
+        entity_batches.emplace_back(entity, it->second);
+    }
+
+    // Lay the batches out one after another
+    size_t instance_count = 0;
+    for (auto& batch : m_batches) {
+        batch.first_instance = instance_count;
+        instance_count += batch.instance_count;
+    }
+
+    m_proxies.resize(instance_count);
+    m_bounds.resize(instance_count);
+    m_instance_buffer->resize(instance_count);
+
+    std::vector<size_t> batch_cursors(m_batches.size(), 0);
+    for (auto [entity, batch_index] : entity_batches) {
+        size_t index = m_batches[batch_index].first_instance +
+                       batch_cursors[batch_index]++;
+
+        m_proxies[index].entity = entity;
+        m_proxies[index].batch = batch_index;
+        m_proxy_indices[entity] = index;
+
+        refresh_proxy(index, m_registry.get<TransformComponent>(entity),
+                      m_registry.get<MeshRendererComponent>(entity));
+    }
+}
+
+void RenderProxyStore::refresh_proxy(
+    size_t index, const TransformComponent& transform,
+    const MeshRendererComponent& mesh_renderer) {
+    RenderProxy& proxy = m_proxies[index];
+    proxy.transform = transform.to_transform();
+    proxy.mesh = mesh_renderer.mesh.get();
+    proxy.material = mesh_renderer.material.get();
+    proxy.tint_color = mesh_renderer.tint_color;
+
+    MeshRenderingInstance instance{
+        .transform = proxy.transform,
+        .material = mesh_renderer.material,
+        .tint_color = mesh_renderer.tint_color,
+    };
+    Application::get().get_renderer().prepare_mesh_instances(
+        *proxy.mesh, &instance, 1,
+        m_instance_buffer->get_data<MeshRenderingShaderInstanceData>() +
+            index);
+    m_instance_buffer->mark_dirty(index, 1);
+
+    if (mesh_renderer.mesh->has_bounds()) {
+        m_bounds.set(index,
+                     transform_bounding_sphere(
+                         mesh_renderer.mesh->get_bounding_sphere(),
+                         proxy.transform));
+    } else {
+        m_bounds.set(index, {.center = proxy.transform.position,
+                             .radius = std::numeric_limits<float>::max()});
+    }
+}
+} // namespace Helios
@@ -0,0 +1,87 @@
+#pragma once
+#include <entt/entt.hpp>
+#include <unordered_map>
+
+#include "Helios/ECSComponents/Components.h"
+#include "Helios/Renderer/Culling.h"
+#include "Helios/Renderer/RetainedInstanceBuffer.h"
+
+namespace Helios {
+/**
+ * \brief The instances of one mesh, stored contiguously in the retained
+ * instance buffer.
+ */
+struct RenderBatch {
+    SharedPtr<Mesh> mesh;
+    // Only set if the material uses custom shaders, since those need their own
+    // pipeline. Otherwise the material is part of the instance data.
+    SharedPtr<Material> custom_material;
+    size_t first_instance = 0;
+    size_t instance_count = 0;
+};
+
+/**
+ * \brief Render proxies for every entity with a transform and a mesh
+ * renderer. The proxies, their instance data and their world space bounds are
+ * kept up to date from the registry's signals, and only changed instances are
+ * prepared and re-uploaded.
+ */
+class RenderProxyStore {
+  public:
+    RenderProxyStore(entt::registry& registry);
+    ~RenderProxyStore();
+
+    /**
+     * \brief Bring the proxies up to date, and sync the instance data of the
+     * current frame.
+     */
+    void update();
+
+    const std::vector<RenderBatch>& get_batches() const { return m_batches; }
+
+    RetainedInstanceBuffer& get_instance_buffer() { return *m_instance_buffer; }
+
+    /**
+     * \brief The world space bounds of the instances, in instance order.
+     * Meshes without bounds get an infinite radius.
+     */
+    const BoundingSpheres& get_bounds() const { return m_bounds; }
+
+    RenderProxyStore(const RenderProxyStore&) = delete;
+    RenderProxyStore& operator=(const RenderProxyStore&) = delete;
+    RenderProxyStore(RenderProxyStore&&) = delete;
+    RenderProxyStore& operator=(RenderProxyStore&&) = delete;
+
+  private:
+    // The state an instance was prepared from
+    struct RenderProxy {
+        entt::entity entity;
+        size_t batch;
+        Transform transform;
+        const Mesh* mesh;
+        const Material* material;
+        glm::vec4 tint_color;
+    };
+
+    void on_structure_changed(entt::registry& registry, entt::entity entity);
+    void on_transform_updated(entt::registry& registry, entt::entity entity);
+
+    void rebuild();
+    void refresh_proxy(size_t index, const TransformComponent& transform,
+                       const MeshRendererComponent& mesh_renderer);
+
+  private:
+    entt::registry& m_registry;
+
+    std::vector<RenderBatch> m_batches;
+    std::vector<RenderProxy> m_proxies; // In instance order
+    std::unordered_map<entt::entity, size_t> m_proxy_indices;
+    std::vector<entt::entity> m_updated_entities;
+    // Mesh renderers without a mesh yet, which are checked for one
+    std::vector<entt::entity> m_meshless_entities;
+    bool m_structure_dirty = true;
+
+    std::unique_ptr<RetainedInstanceBuffer> m_instance_buffer;
+    BoundingSpheres m_bounds;
+};
+} // namespace Helios
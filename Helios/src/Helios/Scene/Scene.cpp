@@ -6,6 +6,7 @@
 #include "Helios/Physics/PhysicsManager.h"
 #include "Helios/Renderer/Renderer.h"
 #include "Helios/Scene/Transform.h"
+#include "RenderProxyStore.h"
 #include "stduuid/uuid.h"
 #include "vulkan/vulkan_core.h"
 #include <chrono>
@@ -19,8 +20,40 @@ struct ShaderPushConstantsData {
 };
 
 namespace Helios {
+namespace {
+// The finest LOD any view needs for an instance, from its size on screen
+uint32_t select_instance_lod(const Mesh& mesh,
+                             const std::vector<LodView>& views,
+                             const BoundingSpheres& bounds, size_t instance) {
+    const float mesh_radius = mesh.get_bounding_sphere().radius;
+    if (mesh_radius <= 0.0f) {
+        return 0;
+    }
+
+    // The instance's scale, from its world space bounds
+    const float radius = bounds.radius[instance];
+    const float scale = radius / mesh_radius;
+    const glm::vec3 center(bounds.center_x[instance], bounds.center_y[instance],
+                           bounds.center_z[instance]);
+
+    uint32_t lod = mesh.get_lod_count() - 1;
+    for (const LodView& view : views) {
+        // The distance to the closest point of the sphere
+        const float distance = glm::length(center - view.position) - radius;
+        if (distance <= 0.0f) {
+            return 0;
+        }
+        lod = std::min(
+            lod, mesh.select_lod(view.pixels_per_unit * scale / distance));
+    }
+    return lod;
+}
+} // namespace
 
-Scene::Scene(SceneCamera* sceneCamera) : m_scene_camera(sceneCamera) {
+
+Scene::Scene(SceneCamera* sceneCamera)
+    : m_render_proxies(std::make_unique<RenderProxyStore>(m_registry)),
+      m_scene_camera(sceneCamera) {
     const auto& renderer = Application::get().get_renderer();
     auto& pm = Application::get().get_physics_manager();
     pm.set_scene({});
@@ -34,11 +67,20 @@ Scene::Scene(SceneCamera* sceneCamera) : m_scene_camera(sceneCamera) {
 
 Scene::~Scene() {
     m_destroyed = true;
+
+    // The workers reference the pending create infos
+    JobSystem& job_system = Application::get().get_job_system();
+    for (const auto& [material, custom_pipeline] : m_custom_pipelines) {
+        job_system.wait(custom_pipeline->compiled);
+    }
+
     auto& pm = Application::get().get_physics_manager();
     pm.destroy_bodies();
 }
 
 void Scene::scene_load_done() {
+    create_custom_pipelines();
+
     auto view = m_registry.view<ScriptComponent>();
 
     for (auto [entity, script] : view.each()) {
@@ -102,62 +144,67 @@ void Scene::on_update(float ts, const SceneViewportInfo& editor_spec,
 
     update_children();
 
+    update_camera(static_cast<float>(game_spec.width) /
+                  static_cast<float>(game_spec.height));
+
     // Editor viewport
+    RenderView editor_view{
+        .begin_rendering_spec =
+            {
+                .color_image = editor_spec.color_image,
+                .color_image_layout = editor_spec.color_image_layout,
+                .color_load_op = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .color_store_op = VK_ATTACHMENT_STORE_OP_STORE,
+                .color_clear_value = editor_spec.color_clear_value,
+                .depth_image = editor_spec.depth_image,
+                .width = editor_spec.width,
+                .height = editor_spec.height,
+            },
+        .render_skybox = m_skybox_enabled && m_skybox,
+        .draw_meshes = m_scene_camera != nullptr,
+    };
     if (m_scene_camera) {
-        draw_systems(m_scene_camera->get_camera());
-    }
-    renderer.update_camera_uniform();
-    if (m_skybox_enabled && m_skybox) {
-
-        renderer.render_skybox({
-            .color_image = editor_spec.color_image,
-            .color_image_layout = editor_spec.color_image_layout,
-            .color_load_op = VK_ATTACHMENT_LOAD_OP_CLEAR,
-            .color_store_op = VK_ATTACHMENT_STORE_OP_STORE,
-            .color_clear_value = editor_spec.color_clear_value,
-            .depth_image = editor_spec.depth_image,
-            .width = editor_spec.width,
-            .height = editor_spec.height,
-        });
-    }
-
-    renderer.submit_mesh_instances({
-        .color_image = editor_spec.color_image,
-        .color_image_layout = editor_spec.color_image_layout,
-        // Only clear if we are not using a skybox
-        .color_load_op = m_skybox_enabled ? VK_ATTACHMENT_LOAD_OP_LOAD
-                                          : VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .color_store_op = VK_ATTACHMENT_STORE_OP_STORE,
-        .color_clear_value = editor_spec.color_clear_value,
-        .depth_image = editor_spec.depth_image,
-        .width = editor_spec.width,
-        .height = editor_spec.height,
-    });
-    // Need to submit because we need to use different cameras (camera is a
-    // uniform)
-    renderer.submit_command_buffer();
+        editor_view.camera = m_scene_camera->get_camera();
+    }
 
-    update_camera(static_cast<float>(game_spec.width) /
-                  static_cast<float>(game_spec.height));
     // Game viewport
-    if (m_has_vaild_camera) {
-        draw_systems(m_current_camera);
+    RenderView game_view{
+        .camera = m_current_camera,
+        .begin_rendering_spec =
+            {
+                .color_image = game_spec.color_image,
+                .color_image_layout = game_spec.color_image_layout,
+                .color_load_op = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .color_store_op = VK_ATTACHMENT_STORE_OP_STORE,
+                .color_clear_value = game_spec.color_clear_value,
+                .depth_image = game_spec.depth_image,
+                .width = game_spec.width,
+                .height = game_spec.height,
+            },
+        .draw_meshes = m_has_vaild_camera,
+    };
+
+    // The instances are only built once, culled against every view that
+    // draws meshes, and then drawn into both viewports
+    std::vector<Frustum> frustums;
+    std::vector<LodView> lod_views;
+    for (const RenderView* view : {&editor_view, &game_view}) {
+        if (view->draw_meshes) {
+            frustums.push_back(Frustum::from_view_projection(
+                view->camera.view_projection_matrix));
+            lod_views.push_back({
+                .position = view->camera.position,
+                .pixels_per_unit =
+                    view->camera.projection_matrix[1][1] * 0.5f *
+                    static_cast<float>(view->begin_rendering_spec.height),
+            });
+        }
+    }
+    if (!frustums.empty()) {
+        draw_systems(frustums, lod_views);
     }
-    renderer.update_camera_uniform();
-    renderer.submit_mesh_instances({
-        .color_image = game_spec.color_image,
-        .color_image_layout = game_spec.color_image_layout,
-        .color_load_op = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .color_store_op = VK_ATTACHMENT_STORE_OP_STORE,
-        .color_clear_value = game_spec.color_clear_value,
-        .depth_image = game_spec.depth_image,
-        .width = game_spec.width,
-        .height = game_spec.height,
-    });
 
-    // Need to submit because mesh instancing, and ui instancing, share staging
-    // buffers
-    renderer.submit_command_buffer();
+    renderer.submit_views({editor_view, game_view});
 
     renderer.submit_ui_quad_instances({
         .color_image = game_spec.color_image,
@@ -168,8 +215,6 @@ void Scene::on_update(float ts, const SceneViewportInfo& editor_spec,
         .width = game_spec.width,
         .height = game_spec.height,
     });
-
-    renderer.submit_command_buffer();
 }
 
 void Scene::on_fixed_update() {
@@ -376,12 +421,10 @@ void Scene::render_text(const std::string& text, const glm::vec2& position,
     renderer.render_text(text, position, scale, tint_color);
 }
 
-void Scene::draw_systems(const PerspectiveCamera& camera) {
-    auto& renderer = Application::get().get_renderer();
-    renderer.set_perspective_camera(camera);
-
+void Scene::draw_systems(const std::vector<Frustum>& frustums,
+                         const std::vector<LodView>& lod_views) {
     render_lighting();
-    draw_meshes();
+    draw_meshes(frustums, lod_views);
 }
 
 void Scene::update_camera(float aspect_ratio) {
@@ -420,87 +463,27 @@ void Scene::render_lighting() {
     }
 }
 
-void Scene::draw_meshes() {
+void Scene::draw_meshes(const std::vector<Frustum>& frustums,
+                        const std::vector<LodView>& lod_views) {
     auto& renderer = Application::get().get_renderer();
 
-    auto meshes_view =
-        m_registry
-            .view<const TransformComponent, const MeshRendererComponent>();
-
-    std::map<uuids::uuid, std::vector<MeshRenderingInstance>> mesh_groups;
-    std::map<uuids::uuid, SharedPtr<Mesh>> meshes;
+    m_render_proxies->update();
 
-    std::vector<
-        std::tuple<SharedPtr<Mesh>, MeshRenderingInstance, SharedPtr<Pipeline>>>
-        meshes_custom_shaders;
+    RetainedInstanceBuffer& instances = m_render_proxies->get_instance_buffer();
+    const SharedPtr<Buffer>& instance_buffer =
+        instances.get_buffer(Application::get().get_current_frame());
+    const auto* instance_data =
+        instances.get_data<MeshRenderingShaderInstanceData>();
 
-    for (auto [entity, transform, mesh] : meshes_view.each()) {
-        if (mesh.mesh == nullptr) {
-            continue;
-        }
-
-        // Custom shaders
-        if (mesh.material && (mesh.material->get_vertex_shader() ||
-                              mesh.material->get_fragment_shader())) {
-            SharedPtr<Pipeline> custom_pipeline = nullptr;
-            if (m_custom_pipelines.contains(mesh.material)) {
-                custom_pipeline = m_custom_pipelines.at(mesh.material);
-            } else {
-                custom_pipeline = Pipeline::create({
-                    renderer.get_swapchain()->get_vk_format(),
-                    {
-                        renderer.get_camera_uniform_set_layout(),
-                        renderer.get_texture_array_layout(),
-                    },
-                    mesh.material->get_vertex_shader()
-                        ? mesh.material->get_vertex_shader()
-                        : renderer.get_lighting_vertex_shader(),
-                    mesh.material->get_fragment_shader()
-                        ? mesh.material->get_fragment_shader()
-                        : renderer.get_lighting_fragment_shader(),
-                    {renderer.get_meshes_vertices_description(),
-                     renderer
-                         .get_mesh_rendering_instance_vertices_description()},
-                    {
-                        VkPushConstantRange{
-                            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
-                            .offset = 0,
-                            .size = sizeof(ShaderPushConstantsData)},
-                    },
-                });
-
-                m_custom_pipelines.insert(
-                    std::pair<SharedPtr<Material>, SharedPtr<Pipeline>>(
-                        mesh.material, custom_pipeline));
-            }
-
-            meshes_custom_shaders.push_back(
-                std::tuple<SharedPtr<Mesh>, MeshRenderingInstance,
-                           SharedPtr<Pipeline>>(
-                    mesh.mesh,
-                    {
-                        .transform = transform.to_transform(),
-                        .material = mesh.material,
-                        .tint_color = mesh.tint_color,
-
-                    },
-                    custom_pipeline));
-        } else {
-            mesh_groups[mesh.mesh->get_uuid()].push_back({
-                .transform = transform.to_transform(),
-                .material = mesh.material,
-                .tint_color = mesh.tint_color,
-            });
-            meshes[mesh.mesh->get_uuid()] = mesh.mesh;
-        }
-    }
-
-    for (auto& [id, mesh] : meshes) {
-        renderer.draw_mesh(mesh, mesh_groups[id]);
+    // Cull every instance in one batch. With GPU driven rendering the
+    // renderer culls the instances instead.
+    const BoundingSpheres& bounds = m_render_proxies->get_bounds();
+    const bool cull = !renderer.is_gpu_driven_rendering();
+    if (cull) {
+        cull_spheres(frustums, bounds, m_culling_visibility);
     }
 
     const auto& window = Application::get().get_window();
-    Application::get().get_window().get_width();
 
     auto duration = std::chrono::high_resolution_clock::now() - m_start_time;
     ShaderPushConstantsData push_constants{
@@ -515,19 +498,163 @@ void Scene::draw_meshes() {
     std::memcpy(push_constants_data.data(), &push_constants,
                 sizeof(ShaderPushConstantsData));
 
-    for (auto& [mesh, info, pipeline] : meshes_custom_shaders) {
-        renderer.draw_mesh(mesh, {info},
-                           {.pipeline = pipeline,
-                            .descriptor_sets =
-                                {
-                                    renderer.get_current_camera_uniform_set(),
-                                    renderer.get_current_texture_array(),
-                                },
-                            .push_constants = {
-                                .size = sizeof(ShaderPushConstantsData),
-                                .stages = VK_SHADER_STAGE_FRAGMENT_BIT,
-                                .data = push_constants_data,
-                            }});
+    for (const auto& batch : m_render_proxies->get_batches()) {
+        // Batches whose pipeline is still compiling use the default one
+        CustomMeshPipelineInfo pipeline_info{};
+        SharedPtr<Pipeline> custom_pipeline =
+            batch.custom_material ? get_custom_pipeline(batch.custom_material)
+                                  : nullptr;
+        if (custom_pipeline) {
+            pipeline_info = {
+                .pipeline = custom_pipeline,
+                .descriptor_sets =
+                    {
+                        renderer.get_current_camera_uniform_set(),
+                        renderer.get_texture_array(),
+                    },
+                .push_constants = {
+                    .size = sizeof(ShaderPushConstantsData),
+                    .stages = VK_SHADER_STAGE_FRAGMENT_BIT,
+                    .data = push_constants_data,
+                }};
+        }
+
+        // Pick the LOD of every visible instance. With GPU driven rendering
+        // the batch is drawn with the finest LOD of its instances, so it
+        // stays in the retained buffer the culling pass reads.
+        const Mesh& mesh = *batch.mesh.get();
+        const uint32_t lod_count = mesh.get_lod_count();
+        m_instance_lods.assign(batch.instance_count, 0);
+        if (lod_count > 1) {
+            uint32_t batch_lod = lod_count - 1;
+            for (size_t i = 0; i < batch.instance_count; i++) {
+                const size_t instance = batch.first_instance + i;
+                if (!cull || m_culling_visibility[instance]) {
+                    m_instance_lods[i] =
+                        select_instance_lod(mesh, lod_views, bounds, instance);
+                    batch_lod = std::min(batch_lod, m_instance_lods[i]);
+                }
+            }
+            if (!cull) {
+                std::fill(m_instance_lods.begin(), m_instance_lods.end(),
+                          batch_lod);
+            }
+        }
+
+        for (uint32_t lod = 0; lod < lod_count; lod++) {
+            // Count the visible instances, and find their centroid so the
+            // renderer can sort the batches front to back
+            size_t visible_count = 0;
+            glm::vec3 centroid(0.0f);
+            for (size_t i = 0; i < batch.instance_count; i++) {
+                const size_t instance = batch.first_instance + i;
+                if ((!cull || m_culling_visibility[instance]) &&
+                    m_instance_lods[i] == lod) {
+                    centroid += glm::vec3(bounds.center_x[instance],
+                                          bounds.center_y[instance],
+                                          bounds.center_z[instance]);
+                    visible_count++;
+                }
+            }
+            if (visible_count == 0) {
+                continue;
+            }
+            centroid /= static_cast<float>(visible_count);
+
+            // Draw straight from the retained buffer if nothing was culled,
+            // otherwise compact the visible instances into this frame's
+            // buffer
+            if (visible_count == batch.instance_count) {
+                renderer.draw_mesh_instances(
+                    batch.mesh, instance_buffer,
+                    batch.first_instance *
+                        sizeof(MeshRenderingShaderInstanceData),
+                    batch.instance_count, pipeline_info, centroid, lod);
+                continue;
+            }
+
+            InstanceBuffer& frame_instances = renderer.get_instance_buffer();
+            TransientAllocation allocation = frame_instances.allocate(
+                visible_count * sizeof(MeshRenderingShaderInstanceData));
+            auto* dst = static_cast<MeshRenderingShaderInstanceData*>(
+                allocation.mapped_memory);
+            for (size_t i = 0; i < batch.instance_count; i++) {
+                const size_t instance = batch.first_instance + i;
+                if (m_culling_visibility[instance] &&
+                    m_instance_lods[i] == lod) {
+                    *dst++ = instance_data[instance];
+                }
+            }
+
+            renderer.draw_mesh_instances(
+                batch.mesh, frame_instances.get_current_buffer(),
+                allocation.offset, visible_count, pipeline_info, centroid,
+                lod);
+        }
+    }
+}
+
+SharedPtr<Pipeline>
+Scene::get_custom_pipeline(const SharedPtr<Material>& material) {
+    auto it = m_custom_pipelines.find(material);
+    if (it == m_custom_pipelines.end()) {
+        compile_custom_pipeline(material);
+        return nullptr;
+    }
+
+    // Drawn with the default pipeline until it's compiled
+    if (!it->second->compiled.is_done()) {
+        return nullptr;
+    }
+    return it->second->pipeline;
+}
+
+void Scene::compile_custom_pipeline(const SharedPtr<Material>& material) {
+    if (m_custom_pipelines.contains(material)) {
+        return;
+    }
+
+    // The create info is filled here, the worker mustn't copy SharedPtrs
+    auto& renderer = Application::get().get_renderer();
+    auto custom_pipeline = std::make_unique<CustomPipeline>();
+    custom_pipeline->info = {
+        renderer.get_swapchain()->get_vk_format(),
+        {
+            renderer.get_camera_uniform_set_layout(),
+            renderer.get_texture_array_layout(),
+        },
+        material->get_vertex_shader() ? material->get_vertex_shader()
+                                      : renderer.get_lighting_vertex_shader(),
+        material->get_fragment_shader()
+            ? material->get_fragment_shader()
+            : renderer.get_lighting_fragment_shader(),
+        {renderer.get_meshes_vertices_description(),
+         renderer.get_mesh_rendering_instance_vertices_description()},
+        {
+            VkPushConstantRange{.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+                                .offset = 0,
+                                .size = sizeof(ShaderPushConstantsData)},
+        },
+    };
+
+    // A compile takes long, so it mustn't be picked up by a thread waiting on
+    // other jobs
+    CustomPipeline* pending = custom_pipeline.get();
+    Application::get().get_job_system().submit_background(
+        [pending]() { pending->pipeline = Pipeline::create(pending->info); },
+        &pending->compiled);
+
+    m_custom_pipelines.emplace(material, std::move(custom_pipeline));
+}
+
+void Scene::create_custom_pipelines() {
+    auto view = m_registry.view<MeshRendererComponent>();
+    for (auto [entity, mesh_renderer] : view.each()) {
+        const SharedPtr<Material>& material = mesh_renderer.material;
+        if (material && (material->get_vertex_shader() ||
+                         material->get_fragment_shader())) {
+            compile_custom_pipeline(material);
+        }
     }
 }
 
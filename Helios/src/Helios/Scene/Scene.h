@@ -4,6 +4,8 @@
 #include <entt/entt.hpp>
 #include <unordered_map>
 
+#include "Helios/Core/JobSystem.h"
+#include "Helios/Renderer/Culling.h"
 #include "Helios/Renderer/Renderer.h"
 #include "Helios/Scene/PerspectiveCamera.h"
 #include "SceneCamera.h"
@@ -14,6 +16,7 @@ constexpr uint32_t k_no_entity = UINT32_MAX;
 
 class Entity;
 class Script;
+class RenderProxyStore;
 
 struct SceneViewportInfo {
     SharedPtr<Image> color_image = nullptr;
@@ -35,6 +38,13 @@ class Scene {
 
     void scene_load_done();
 
+    /**
+     * \brief Start compiling the pipelines of every material with custom
+     * shaders in the scene, so they are ready by the time they are drawn.
+     * Called once the scene is loaded.
+     */
+    void create_custom_pipelines();
+
     /**
      * \brief Creates a new entity.
      * \param name The name of the entity.
@@ -127,10 +137,12 @@ class Scene {
   private:
     // SYSTEMS //
 
-    void draw_systems(const PerspectiveCamera& camera);
+    void draw_systems(const std::vector<Frustum>& frustums,
+                      const std::vector<LodView>& lod_views);
     void update_camera(float aspect_ratio);
     void render_lighting();
-    void draw_meshes();
+    void draw_meshes(const std::vector<Frustum>& frustums,
+                     const std::vector<LodView>& lod_views);
     void update_scripts(float ts);
     void update_scripts_fixed();
     void setup_signals();
@@ -150,24 +162,40 @@ class Scene {
                                               entt::entity entity);
     void update_children();
 
-    void create_custom_pipelines();
+    SharedPtr<Pipeline>
+    get_custom_pipeline(const SharedPtr<Material>& material);
+    void compile_custom_pipeline(const SharedPtr<Material>& material);
 
     void set_skybox(const SharedPtr<Texture>& skybox);
 
   private:
     entt::registry m_registry;
+    // Declared after the registry, so it disconnects before the registry dies
+    std::unique_ptr<RenderProxyStore> m_render_proxies;
     SceneCamera* m_scene_camera;
     bool m_runtime = false;
 
     PerspectiveCamera m_current_camera;
     bool m_has_vaild_camera = false;
 
+    // Kept between frames to avoid reallocating
+    std::vector<uint8_t> m_culling_visibility;
+    std::vector<uint32_t> m_instance_lods;
+
     bool m_destroyed = false;
 
     std::unordered_map<uint32_t, std::vector<uint32_t>> m_entity_children;
     std::unordered_map<uuids::uuid, uint32_t> m_entity_id_map;
 
-    std::unordered_map<SharedPtr<Material>, SharedPtr<Pipeline>>
+    // A material's pipeline, compiled by a worker. The worker only reads the
+    // create info and writes the pipeline, the main thread reads the pipeline
+    // once the counter is done.
+    struct CustomPipeline {
+        PipelineCreateInfo info;
+        SharedPtr<Pipeline> pipeline = nullptr;
+        JobCounter compiled;
+    };
+    std::unordered_map<SharedPtr<Material>, std::unique_ptr<CustomPipeline>>
         m_custom_pipelines;
 
     glm::ivec2 m_game_viewport_size;
@@ -0,0 +1,323 @@
+#include "MemoryAllocator.h"
+
+#include <algorithm>
+
+#include "Helios/Core/Log.h"
+#include "Helios/Vulkan/VulkanContext.h"
+
+namespace Helios {
+namespace {
+constexpr VkDeviceSize k_block_size = 64ull * 1024 * 1024;
+// Blocks are allocated in units, offsets are aligned to it
+constexpr VkDeviceSize k_unit_size = 256;
+
+VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+} // namespace
+
+void MemoryAllocator::init(const VulkanContext& context) {
+    m_device = context.device;
+    m_physical_device = context.physical_device;
+    m_memory_budget = context.memory_budget;
+    vkGetPhysicalDeviceMemoryProperties(context.physical_device,
+                                        &m_memory_properties);
+
+    m_pools.resize(m_memory_properties.memoryTypeCount * 2);
+    for (uint32_t type = 0; type < m_memory_properties.memoryTypeCount;
+         type++) {
+        // Small heaps, e.g. host visible device memory, get smaller blocks
+        uint32_t heap = m_memory_properties.memoryTypes[type].heapIndex;
+        VkDeviceSize block_size = std::min(
+            k_block_size, m_memory_properties.memoryHeaps[heap].size / 8);
+        uint32_t block_units = static_cast<uint32_t>(
+            std::max(block_size / k_unit_size, VkDeviceSize{1}));
+
+        get_pool(type, false).block_units = block_units;
+        get_pool(type, true).block_units = block_units;
+    }
+
+    m_heap_statistics.resize(m_memory_properties.memoryHeapCount);
+    for (uint32_t heap = 0; heap < m_memory_properties.memoryHeapCount;
+         heap++) {
+        m_heap_statistics[heap].heap_size =
+            m_memory_properties.memoryHeaps[heap].size;
+        m_heap_statistics[heap].flags =
+            m_memory_properties.memoryHeaps[heap].flags;
+    }
+}
+
+MemoryAllocator::~MemoryAllocator() {
+    for (Pool& pool : m_pools) {
+        for (Block& block : pool.blocks) {
+            if (block.memory != VK_NULL_HANDLE) {
+                vkFreeMemory(m_device, block.memory, nullptr);
+            }
+        }
+    }
+}
+
+MemoryAllocation
+MemoryAllocator::allocate(const VkMemoryRequirements& requirements,
+                          VkMemoryPropertyFlags properties, bool image,
+                          bool dedicated) {
+    std::lock_guard lock(m_mutex);
+
+    uint32_t memory_type = UINT32_MAX;
+    for (uint32_t i = 0; i < m_memory_properties.memoryTypeCount; i++) {
+        if (requirements.memoryTypeBits & (1 << i) &&
+            (m_memory_properties.memoryTypes[i].propertyFlags & properties) ==
+                properties) {
+            memory_type = i;
+            break;
+        }
+    }
+    if (memory_type == UINT32_MAX) {
+        HL_ERROR("Failed to find suitable memory type");
+        return {};
+    }
+
+    Pool& pool = get_pool(memory_type, image);
+    VkDeviceSize block_size = pool.block_units * k_unit_size;
+    if (dedicated || requirements.size > block_size / 2) {
+        return allocate_dedicated(memory_type, requirements.size);
+    }
+
+    // Offsets are unit aligned, a larger alignment is made by padding
+    VkDeviceSize padding = requirements.alignment > k_unit_size
+                               ? requirements.alignment - k_unit_size
+                               : 0;
+    uint32_t units = static_cast<uint32_t>(
+        align_up(requirements.size + padding, k_unit_size) / k_unit_size);
+
+    uint32_t block_index = k_dedicated_block;
+    uint32_t block_offset = RangeAllocator::k_invalid_offset;
+    for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+        if (pool.blocks[i].memory == VK_NULL_HANDLE) {
+            continue;
+        }
+        block_offset = pool.blocks[i].ranges.allocate(units);
+        if (block_offset != RangeAllocator::k_invalid_offset) {
+            block_index = i;
+            break;
+        }
+    }
+
+    if (block_index == k_dedicated_block) {
+        block_index = create_block(pool, memory_type);
+        if (block_index == k_dedicated_block) {
+            return {};
+        }
+        block_offset = pool.blocks[block_index].ranges.allocate(units);
+        if (block_offset == RangeAllocator::k_invalid_offset) {
+            HL_ERROR("Allocation doesn't fit in a memory block");
+            return {};
+        }
+    }
+
+    Block& block = pool.blocks[block_index];
+    block.allocation_count++;
+
+    MemoryAllocation allocation;
+    allocation.memory = block.memory;
+    allocation.offset =
+        align_up(block_offset * k_unit_size, requirements.alignment);
+    allocation.size = requirements.size;
+    allocation.mapped =
+        block.mapped != nullptr ? block.mapped + allocation.offset : nullptr;
+    allocation.memory_type = memory_type;
+    allocation.block = block_index;
+    allocation.block_offset = block_offset;
+    allocation.block_size = units;
+    allocation.image = image;
+
+    HeapStatistics& statistics =
+        m_heap_statistics[m_memory_properties.memoryTypes[memory_type]
+                              .heapIndex];
+    statistics.used_bytes += allocation.size;
+    statistics.allocation_count++;
+
+    return allocation;
+}
+
+void MemoryAllocator::free(const MemoryAllocation& allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+    }
+
+    std::lock_guard lock(m_mutex);
+
+    HeapStatistics& statistics =
+        m_heap_statistics[m_memory_properties
+                              .memoryTypes[allocation.memory_type]
+                              .heapIndex];
+    statistics.used_bytes -= allocation.size;
+    statistics.allocation_count--;
+
+    if (allocation.block == k_dedicated_block) {
+        vkFreeMemory(m_device, allocation.memory, nullptr);
+        statistics.reserved_bytes -= allocation.size;
+        statistics.dedicated_count--;
+        return;
+    }
+
+    Pool& pool = get_pool(allocation.memory_type, allocation.image);
+    Block& block = pool.blocks[allocation.block];
+    block.ranges.free(allocation.block_offset, allocation.block_size);
+    block.allocation_count--;
+    if (block.allocation_count > 0) {
+        return;
+    }
+
+    // Release the empty block, unless it's the pool's last one
+    for (const Block& other : pool.blocks) {
+        if (&other != &block && other.memory != VK_NULL_HANDLE) {
+            vkFreeMemory(m_device, block.memory, nullptr);
+            block.memory = VK_NULL_HANDLE;
+            block.mapped = nullptr;
+            statistics.reserved_bytes -= pool.block_units * k_unit_size;
+            statistics.block_count--;
+            return;
+        }
+    }
+}
+
+bool MemoryAllocator::should_move(const MemoryAllocation& allocation) const {
+    if (allocation.block == k_dedicated_block ||
+        allocation.memory == VK_NULL_HANDLE) {
+        return false;
+    }
+
+    std::lock_guard lock(m_mutex);
+
+    const Pool& pool = get_pool(allocation.memory_type, allocation.image);
+    const Block& block = pool.blocks[allocation.block];
+    uint32_t used_units = pool.block_units - block.ranges.get_free_size();
+    if (used_units > pool.block_units / 4) {
+        return false;
+    }
+
+    for (const Block& other : pool.blocks) {
+        if (&other != &block && other.memory != VK_NULL_HANDLE &&
+            other.ranges.get_largest_free_range() >= allocation.block_size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<MemoryAllocator::HeapStatistics>
+MemoryAllocator::get_heap_statistics() const {
+    std::vector<HeapStatistics> statistics;
+    {
+        std::lock_guard lock(m_mutex);
+        statistics = m_heap_statistics;
+    }
+
+    if (!m_memory_budget) {
+        for (HeapStatistics& heap : statistics) {
+            heap.budget = heap.heap_size;
+            heap.usage = heap.reserved_bytes;
+        }
+        return statistics;
+    }
+
+    // The budget includes the other processes' usage, and changes over time
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+    budget.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = &budget;
+    vkGetPhysicalDeviceMemoryProperties2(m_physical_device, &properties);
+    for (uint32_t heap = 0; heap < statistics.size(); heap++) {
+        statistics[heap].budget = budget.heapBudget[heap];
+        statistics[heap].usage = budget.heapUsage[heap];
+    }
+    return statistics;
+}
+
+VkDeviceMemory MemoryAllocator::allocate_memory(uint32_t memory_type,
+                                                VkDeviceSize size,
+                                                void** mapped) {
+    VkMemoryAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = size;
+    alloc_info.memoryTypeIndex = memory_type;
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (vkAllocateMemory(m_device, &alloc_info, nullptr, &memory) !=
+        VK_SUCCESS) {
+        HL_ERROR("Failed to allocate device memory");
+        return VK_NULL_HANDLE;
+    }
+
+    *mapped = nullptr;
+    if (m_memory_properties.memoryTypes[memory_type].propertyFlags &
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, mapped);
+    }
+
+    return memory;
+}
+
+MemoryAllocation MemoryAllocator::allocate_dedicated(uint32_t memory_type,
+                                                     VkDeviceSize size) {
+    void* mapped;
+    VkDeviceMemory memory = allocate_memory(memory_type, size, &mapped);
+    if (memory == VK_NULL_HANDLE) {
+        return {};
+    }
+
+    MemoryAllocation allocation;
+    allocation.memory = memory;
+    allocation.size = size;
+    allocation.mapped = mapped;
+    allocation.memory_type = memory_type;
+    allocation.block = k_dedicated_block;
+
+    HeapStatistics& statistics =
+        m_heap_statistics[m_memory_properties.memoryTypes[memory_type]
+                              .heapIndex];
+    statistics.reserved_bytes += size;
+    statistics.used_bytes += size;
+    statistics.dedicated_count++;
+    statistics.allocation_count++;
+
+    return allocation;
+}
+
+uint32_t MemoryAllocator::create_block(Pool& pool, uint32_t memory_type) {
+    VkDeviceSize size = pool.block_units * k_unit_size;
+
+    void* mapped;
+    VkDeviceMemory memory = allocate_memory(memory_type, size, &mapped);
+    if (memory == VK_NULL_HANDLE) {
+        return k_dedicated_block;
+    }
+
+    // Reuse a released block's slot, so the other indices stay valid
+    uint32_t index = 0;
+    while (index < pool.blocks.size() &&
+           pool.blocks[index].memory != VK_NULL_HANDLE) {
+        index++;
+    }
+    if (index == pool.blocks.size()) {
+        pool.blocks.emplace_back();
+    }
+
+    Block& block = pool.blocks[index];
+    block.memory = memory;
+    block.mapped = static_cast<uint8_t*>(mapped);
+    block.ranges.reset(pool.block_units, 0);
+    block.allocation_count = 0;
+
+    HeapStatistics& statistics =
+        m_heap_statistics[m_memory_properties.memoryTypes[memory_type]
+                              .heapIndex];
+    statistics.reserved_bytes += size;
+    statistics.block_count++;
+
+    return index;
+}
+} // namespace Helios
@@ -0,0 +1,146 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <volk/volk.h>
+
+#include "Helios/Renderer/RangeAllocator.h"
+
+namespace Helios {
+struct VulkanContext;
+
+/**
+ * \brief A range of device memory, bound to a buffer or an image.
+ */
+struct MemoryAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // The range's memory, if the memory type is host visible
+    void* mapped = nullptr;
+
+    uint32_t memory_type = 0;
+    // The block the range is in, or k_dedicated_block
+    uint32_t block = 0;
+    // The units the range took from its block, alignment included
+    uint32_t block_offset = 0;
+    uint32_t block_size = 0;
+    bool image = false;
+};
+
+/**
+ * \brief Sub-allocates buffers and images from large blocks of device memory,
+ * instead of allocating each one separately. Drivers limit the number of
+ * allocations, and allocating is slow. Each memory type has a pool of blocks
+ * for buffers, and one for images, so linear and optimal resources never
+ * share a block (bufferImageGranularity). Large resources, and the ones the
+ * driver prefers dedicated memory for, get their own allocation.
+ *
+ * Host visible blocks stay mapped, an allocation's mapped pointer is valid
+ * until it's freed. Free an allocation once the GPU is done with it, i.e.
+ * from a destruction queue.
+ */
+class MemoryAllocator {
+  public:
+    static constexpr uint32_t k_dedicated_block = UINT32_MAX;
+
+    struct HeapStatistics {
+        VkDeviceSize heap_size = 0;
+        VkMemoryHeapFlags flags = 0;
+        // How much of the heap the process can use, and uses, from
+        // VK_EXT_memory_budget. Without it, the heap's size and the reserved
+        // bytes.
+        VkDeviceSize budget = 0;
+        VkDeviceSize usage = 0;
+        // Memory allocated from the driver, blocks and dedicated allocations
+        VkDeviceSize reserved_bytes = 0;
+        // Memory used by buffers and images
+        VkDeviceSize used_bytes = 0;
+        uint32_t block_count = 0;
+        uint32_t dedicated_count = 0;
+        uint32_t allocation_count = 0;
+    };
+
+    static std::unique_ptr<MemoryAllocator>
+    create_unique(const VulkanContext& context) {
+        std::unique_ptr<MemoryAllocator> allocator =
+            std::make_unique<MemoryAllocator>();
+        allocator->init(context);
+        return allocator;
+    }
+
+    /**
+     * \brief Allocate memory for a resource.
+     * \param image Whether the memory is for an image with optimal tiling.
+     * \param dedicated Give the resource its own allocation.
+     * \return The allocation, its memory is null if allocating failed.
+     */
+    MemoryAllocation allocate(const VkMemoryRequirements& requirements,
+                              VkMemoryPropertyFlags properties, bool image,
+                              bool dedicated = false);
+
+    void free(const MemoryAllocation& allocation);
+
+    /**
+     * \brief Whether the allocation should be moved, e.g. by re-creating its
+     * resource, to defragment memory. It's true for allocations in a mostly
+     * free block, when the other blocks of its pool have room for it, so the
+     * block can be released once they're all moved.
+     */
+    bool should_move(const MemoryAllocation& allocation) const;
+
+    // One per memory heap
+    std::vector<HeapStatistics> get_heap_statistics() const;
+
+    MemoryAllocator() = default;
+    ~MemoryAllocator();
+
+    MemoryAllocator(const MemoryAllocator&) = delete;
+    MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+    MemoryAllocator(MemoryAllocator&&) = delete;
+    MemoryAllocator& operator=(MemoryAllocator&&) = delete;
+
+  private:
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        uint8_t* mapped = nullptr;
+        RangeAllocator ranges;
+        uint32_t allocation_count = 0;
+    };
+
+    struct Pool {
+        // Released blocks leave an empty slot, which is reused
+        std::vector<Block> blocks;
+        uint32_t block_units = 0;
+    };
+
+    void init(const VulkanContext& context);
+
+    Pool& get_pool(uint32_t memory_type, bool image) {
+        return m_pools[memory_type * 2 + (image ? 1 : 0)];
+    }
+    const Pool& get_pool(uint32_t memory_type, bool image) const {
+        return m_pools[memory_type * 2 + (image ? 1 : 0)];
+    }
+
+    // Allocate device memory, mapped if the type is host visible
+    VkDeviceMemory allocate_memory(uint32_t memory_type, VkDeviceSize size,
+                                   void** mapped);
+    MemoryAllocation allocate_dedicated(uint32_t memory_type,
+                                        VkDeviceSize size);
+    // The new block's index, or k_dedicated_block if allocating failed
+    uint32_t create_block(Pool& pool, uint32_t memory_type);
+
+  private:
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkPhysicalDevice m_physical_device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties m_memory_properties{};
+    bool m_memory_budget = false;
+
+    std::vector<Pool> m_pools;
+    std::vector<HeapStatistics> m_heap_statistics;
+
+    // Allocations can come from any thread
+    mutable std::mutex m_mutex;
+};
+} // namespace Helios
@@ -0,0 +1,189 @@
+#include "PipelineCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "Helios/Core/Log.h"
+#include "Helios/Vulkan/VulkanContext.h"
+
+namespace Helios {
+namespace {
+constexpr uint32_t k_cache_file_magic = 0x43504c48; // "HLPC"
+constexpr uint32_t k_cache_file_version = 1;
+
+// Written before the driver's data. A cache from another device, or driver
+// version, is ignored instead of being handed to the driver.
+struct CacheFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint8_t device_uuid[VK_UUID_SIZE];
+    uint64_t data_size;
+    uint64_t data_hash;
+};
+
+// FNV-1a, to catch truncated or corrupted files
+uint64_t hash_data(const uint8_t* data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001b3;
+    }
+    return hash;
+}
+} // namespace
+
+PipelineCache::~PipelineCache() {
+    if (m_cache != VK_NULL_HANDLE) {
+        save();
+        vkDestroyPipelineCache(m_device, m_cache, nullptr);
+    }
+}
+
+void PipelineCache::init(const VulkanContext& context) {
+    m_device = context.device;
+
+    VkPhysicalDeviceIDProperties id_properties{};
+    id_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &id_properties;
+    vkGetPhysicalDeviceProperties2(context.physical_device, &properties);
+
+    m_vendor_id = properties.properties.vendorID;
+    m_device_id = properties.properties.deviceID;
+    m_driver_version = properties.properties.driverVersion;
+    memcpy(m_device_uuid, id_properties.deviceUUID, VK_UUID_SIZE);
+    memcpy(m_pipeline_cache_uuid, properties.properties.pipelineCacheUUID,
+           VK_UUID_SIZE);
+
+    // Empty until a file is loaded
+    m_cache = create_cache(nullptr, 0);
+}
+
+VkPipelineCache PipelineCache::create_cache(const void* data,
+                                            size_t size) const {
+    VkPipelineCacheCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    info.initialDataSize = size;
+    info.pInitialData = data;
+
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    if (vkCreatePipelineCache(m_device, &info, nullptr, &cache) !=
+        VK_SUCCESS) {
+        HL_ERROR("Failed to create the pipeline cache!");
+        return VK_NULL_HANDLE;
+    }
+    return cache;
+}
+
+void PipelineCache::load(const std::filesystem::path& path) {
+    if (path == m_path) {
+        return;
+    }
+    save();
+    m_path = path;
+
+    std::vector<uint8_t> data;
+    std::ifstream file(path, std::ios::binary);
+    CacheFileHeader header{};
+    if (file && file.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+        header.magic == k_cache_file_magic &&
+        header.version == k_cache_file_version &&
+        header.vendor_id == m_vendor_id && header.device_id == m_device_id &&
+        header.driver_version == m_driver_version &&
+        memcmp(header.device_uuid, m_device_uuid, VK_UUID_SIZE) == 0) {
+        // A truncated or corrupted file mustn't size the allocation
+        std::error_code error;
+        const uintmax_t file_size = std::filesystem::file_size(path, error);
+        const bool fits = !error && file_size >= sizeof(header) &&
+                          header.data_size <= file_size - sizeof(header);
+        if (fits) {
+            data.resize(header.data_size);
+        }
+        if (!fits ||
+            !file.read(reinterpret_cast<char*>(data.data()), data.size()) ||
+            hash_data(data.data(), data.size()) != header.data_hash) {
+            HL_WARN("The pipeline cache {} is corrupted, it's ignored.",
+                    path.string());
+            data.clear();
+        }
+    }
+
+    // The driver's own header has to match too
+    VkPipelineCacheHeaderVersionOne driver_header{};
+    if (data.size() >= sizeof(driver_header)) {
+        memcpy(&driver_header, data.data(), sizeof(driver_header));
+    }
+    if (driver_header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        driver_header.vendorID != m_vendor_id ||
+        driver_header.deviceID != m_device_id ||
+        memcmp(driver_header.pipelineCacheUUID, m_pipeline_cache_uuid,
+               VK_UUID_SIZE) != 0) {
+        data.clear();
+    }
+
+    VkPipelineCache cache = create_cache(data.data(), data.size());
+    if (cache == VK_NULL_HANDLE) {
+        return;
+    }
+
+    // Keep what was compiled so far (e.g. the renderer's pipelines). The
+    // pipelines themselves don't reference the cache.
+    if (m_cache != VK_NULL_HANDLE) {
+        vkMergePipelineCaches(m_device, cache, 1, &m_cache);
+        vkDestroyPipelineCache(m_device, m_cache, nullptr);
+    }
+    m_cache = cache;
+}
+
+void PipelineCache::save() const {
+    if (m_path.empty() || m_cache == VK_NULL_HANDLE) {
+        return;
+    }
+
+    size_t size = 0;
+    std::vector<uint8_t> data;
+    if (vkGetPipelineCacheData(m_device, m_cache, &size, nullptr) !=
+        VK_SUCCESS) {
+        return;
+    }
+    data.resize(size);
+    if (vkGetPipelineCacheData(m_device, m_cache, &size, data.data()) !=
+        VK_SUCCESS) {
+        return;
+    }
+
+    CacheFileHeader header{
+        .magic = k_cache_file_magic,
+        .version = k_cache_file_version,
+        .vendor_id = m_vendor_id,
+        .device_id = m_device_id,
+        .driver_version = m_driver_version,
+        .data_size = size,
+        .data_hash = hash_data(data.data(), size),
+    };
+    memcpy(header.device_uuid, m_device_uuid, VK_UUID_SIZE);
+
+    // Write a temporary file first, so a crash can't leave half a cache
+    std::error_code error;
+    std::filesystem::create_directories(m_path.parent_path(), error);
+    std::filesystem::path temp_path = m_path;
+    temp_path += ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.write(reinterpret_cast<const char*>(&header),
+                        sizeof(header)) ||
+            !file.write(reinterpret_cast<const char*>(data.data()), size)) {
+            HL_WARN("Could not write the pipeline cache {}.", m_path.string());
+            return;
+        }
+    }
+    std::filesystem::rename(temp_path, m_path, error);
+    if (error) {
+        HL_WARN("Could not write the pipeline cache {}.", m_path.string());
+    }
+}
+} // namespace Helios
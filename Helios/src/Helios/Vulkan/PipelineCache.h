@@ -0,0 +1,63 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <volk/volk.h>
+
+namespace Helios {
+struct VulkanContext;
+
+/**
+ * \brief The driver's cache of compiled pipelines. It can be persisted to a
+ * file, so the pipelines of a previous run aren't compiled again. A file is
+ * only used by the device, and driver version, that wrote it.
+ */
+class PipelineCache {
+  public:
+    static std::unique_ptr<PipelineCache>
+    create_unique(const VulkanContext& context) {
+        std::unique_ptr<PipelineCache> cache =
+            std::make_unique<PipelineCache>();
+        cache->init(context);
+        return cache;
+    }
+
+    /**
+     * \brief Use a cache file from now on, e.g. the project's. The current
+     * cache is saved to the previous file (if any) first, and then merged
+     * with the file's, if it's valid for this device.
+     * \param path The cache file, it's created when saving if needed.
+     */
+    void load(const std::filesystem::path& path);
+
+    /**
+     * \brief Write the cache to the current file, if one was loaded.
+     */
+    void save() const;
+
+    VkPipelineCache get_vk_cache() const { return m_cache; }
+
+    PipelineCache() = default;
+    ~PipelineCache();
+
+    PipelineCache(const PipelineCache&) = delete;
+    PipelineCache& operator=(const PipelineCache&) = delete;
+    PipelineCache(PipelineCache&&) = delete;
+    PipelineCache& operator=(PipelineCache&&) = delete;
+
+  private:
+    void init(const VulkanContext& context);
+    VkPipelineCache create_cache(const void* data, size_t size) const;
+
+  private:
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkPipelineCache m_cache = VK_NULL_HANDLE;
+    std::filesystem::path m_path;
+
+    // The cache key of the running device
+    uint32_t m_vendor_id = 0;
+    uint32_t m_device_id = 0;
+    uint32_t m_driver_version = 0;
+    uint8_t m_device_uuid[VK_UUID_SIZE] = {};
+    uint8_t m_pipeline_cache_uuid[VK_UUID_SIZE] = {};
+};
+} // namespace Helios
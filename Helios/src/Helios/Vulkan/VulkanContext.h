@@ -21,9 +21,23 @@ struct VulkanContext {
 
     VkQueue graphics_queue;
     VkQueue present_queue;
+    // The graphics queue if the device has no transfer only queue family
+    VkQueue transfer_queue;
+    uint32_t graphics_family = 0;
+    uint32_t transfer_family = 0;
 
     VkCommandPool command_pool;
 
+    // Optional features
+    bool multi_draw_indirect = false;
+    bool draw_indirect_first_instance = false;
+    bool texture_compression_bc = false;
+    // VK_EXT_memory_budget
+    bool memory_budget = false;
+
+    // The most textures a bindless (update after bind) array can hold
+    uint32_t max_bindless_textures = 0;
+
     void Init() {
         // Initialize vulkan, and device related states
         bool validation_layers_available;
@@ -35,9 +49,35 @@ struct VulkanContext {
         }
         VulkanUtils::create_surface(instance, surface);
         VulkanUtils::pick_physical_device(instance, surface, physical_device);
-        VulkanUtils::create_logical_device(use_validation_layers, surface,
-                                           physical_device, device,
-                                           graphics_queue, present_queue);
+        VulkanUtils::create_logical_device(
+            use_validation_layers, surface, physical_device, device,
+            graphics_queue, present_queue, transfer_queue);
+
+        QueueFamilyIndices queue_families =
+            VulkanUtils::find_queue_families(physical_device, surface);
+        graphics_family = queue_families.graphics_family.value();
+        transfer_family =
+            queue_families.transfer_family.value_or(graphics_family);
+
+        VkPhysicalDeviceFeatures features;
+        vkGetPhysicalDeviceFeatures(physical_device, &features);
+        multi_draw_indirect = features.multiDrawIndirect;
+        draw_indirect_first_instance = features.drawIndirectFirstInstance;
+        texture_compression_bc = features.textureCompressionBC;
+        memory_budget = VulkanUtils::is_device_extension_supported(
+            physical_device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+        VkPhysicalDeviceVulkan12Properties vulkan_12_properties{};
+        vulkan_12_properties.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+        VkPhysicalDeviceProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &vulkan_12_properties;
+        vkGetPhysicalDeviceProperties2(physical_device, &properties);
+        max_bindless_textures = std::min(
+            vulkan_12_properties.maxDescriptorSetUpdateAfterBindSampledImages,
+            vulkan_12_properties
+                .maxPerStageDescriptorUpdateAfterBindSampledImages);
 
         VulkanUtils::create_command_pool(device, physical_device, surface,
                                          command_pool);
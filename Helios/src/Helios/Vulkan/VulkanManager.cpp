@@ -7,6 +7,8 @@ void VulkanManager::init() {
     auto& app = Application::get();
 
     m_context.Init();
+    m_pipeline_cache = PipelineCache::create_unique(m_context);
+    m_memory_allocator = MemoryAllocator::create_unique(m_context);
 
     m_action_queues.resize(app.get_max_frames_in_flight());
     m_destruction_queues.resize(app.get_max_frames_in_flight());
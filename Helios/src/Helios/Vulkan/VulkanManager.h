@@ -1,6 +1,8 @@
 ﻿#pragma once
 #include <queue>
 
+#include "Helios/Vulkan/MemoryAllocator.h"
+#include "Helios/Vulkan/PipelineCache.h"
 #include "Helios/Vulkan/VulkanContext.h"
 
 namespace Helios {
@@ -25,8 +27,23 @@ class VulkanManager {
 
     const VulkanContext& get_context() const { return m_context; }
 
+    /**
+     * \brief The cache every pipeline is created with. It's saved to its file
+     * when the manager is destroyed.
+     */
+    PipelineCache& get_pipeline_cache() { return *m_pipeline_cache; }
+
+    /**
+     * \brief The device memory of every buffer and image is allocated from it.
+     */
+    MemoryAllocator& get_memory_allocator() { return *m_memory_allocator; }
+
   private:
     VulkanContext m_context;
+    // Destroyed before the context
+    std::unique_ptr<PipelineCache> m_pipeline_cache;
+    // Destroyed after the destruction queues are flushed
+    std::unique_ptr<MemoryAllocator> m_memory_allocator;
 
     std::vector<std::queue<std::function<void()>>> m_action_queues;
 
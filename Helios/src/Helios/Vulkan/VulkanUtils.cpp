@@ -188,12 +188,16 @@ void VulkanUtils::create_logical_device(bool use_validation_layers,
                                         VkPhysicalDevice physical_device,
                                         VkDevice& device,
                                         VkQueue& graphics_queue,
-                                        VkQueue& present_queue) {
+                                        VkQueue& present_queue,
+                                        VkQueue& transfer_queue) {
     QueueFamilyIndices indices = find_queue_families(physical_device, surface);
 
     std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
     std::set<uint32_t> unique_queue_families = {indices.graphics_family.value(),
                                                 indices.present_family.value()};
+    if (indices.transfer_family.has_value()) {
+        unique_queue_families.insert(indices.transfer_family.value());
+    }
 
     float queue_priority = 1.0f;
     for (uint32_t queue_family : unique_queue_families) {
@@ -212,6 +216,12 @@ void VulkanUtils::create_logical_device(bool use_validation_layers,
         VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
     vulkan_12_features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
     vulkan_12_features.descriptorIndexing = VK_TRUE;
+    // Bindless textures, updated one element at a time while in use
+    vulkan_12_features.runtimeDescriptorArray = VK_TRUE;
+    vulkan_12_features.descriptorBindingPartiallyBound = VK_TRUE;
+    vulkan_12_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    // Tracks the uploads' completion
+    vulkan_12_features.timelineSemaphore = VK_TRUE;
 
     // Dynamic rendering
     VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering{};
@@ -221,11 +231,31 @@ void VulkanUtils::create_logical_device(bool use_validation_layers,
     dynamic_rendering.dynamicRendering = VK_TRUE;
 
     // Features
+    VkPhysicalDeviceFeatures supported_features;
+    vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
+
     VkPhysicalDeviceFeatures2 device_features_2{};
     device_features_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
     device_features_2.pNext = &dynamic_rendering;
     device_features_2.features.samplerAnisotropy = VK_TRUE;
     device_features_2.features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+    // Optional, used to draw many meshes with one indirect draw
+    device_features_2.features.multiDrawIndirect =
+        supported_features.multiDrawIndirect;
+    device_features_2.features.drawIndirectFirstInstance =
+        supported_features.drawIndirectFirstInstance;
+    // Optional, for the block compressed KTX2 textures
+    device_features_2.features.textureCompressionBC =
+        supported_features.textureCompressionBC;
+    // The mesh shaders write the texture streaming feedback
+    device_features_2.features.fragmentStoresAndAtomics = VK_TRUE;
+
+    // Optional, lets the texture streamer follow the device's memory budget
+    std::vector<const char*> extensions = g_device_extensions;
+    if (is_device_extension_supported(physical_device,
+                                      VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
 
     VkDeviceCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -238,8 +268,8 @@ void VulkanUtils::create_logical_device(bool use_validation_layers,
     create_info.pEnabledFeatures = nullptr;
 
     create_info.enabledExtensionCount =
-        static_cast<uint32_t>(g_device_extensions.size());
-    create_info.ppEnabledExtensionNames = g_device_extensions.data();
+        static_cast<uint32_t>(extensions.size());
+    create_info.ppEnabledExtensionNames = extensions.data();
 
     if (use_validation_layers) {
         create_info.enabledLayerCount =
@@ -259,6 +289,10 @@ void VulkanUtils::create_logical_device(bool use_validation_layers,
     vkGetDeviceQueue(device, indices.graphics_family.value(), 0,
                      &graphics_queue);
     vkGetDeviceQueue(device, indices.present_family.value(), 0, &present_queue);
+    vkGetDeviceQueue(device,
+                     indices.transfer_family.value_or(
+                         indices.graphics_family.value()),
+                     0, &transfer_queue);
 }
 
 VkSurfaceFormatKHR VulkanUtils::choose_swap_surface_format(
@@ -390,13 +424,27 @@ bool VulkanUtils::is_device_suitable(VkPhysicalDevice device,
     VkPhysicalDeviceFeatures supported_features;
     vkGetPhysicalDeviceFeatures(device, &supported_features);
 
+    VkPhysicalDeviceVulkan12Features supported_vulkan_12_features{};
+    supported_vulkan_12_features.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
     VkPhysicalDeviceFeatures2 supported_features_2{};
     supported_features_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supported_features_2.pNext = &supported_vulkan_12_features;
     vkGetPhysicalDeviceFeatures2(device, &supported_features_2);
 
+    const bool bindless_supported =
+        supported_vulkan_12_features.runtimeDescriptorArray &&
+        supported_vulkan_12_features.descriptorBindingPartiallyBound &&
+        supported_vulkan_12_features
+            .descriptorBindingSampledImageUpdateAfterBind;
+
     return indices.is_complete() && extensions_supported &&
            swap_chain_adequate && supported_features.samplerAnisotropy &&
-           supported_features_2.features.shaderSampledImageArrayDynamicIndexing;
+           supported_features.fragmentStoresAndAtomics &&
+           supported_features_2.features
+               .shaderSampledImageArrayDynamicIndexing &&
+           bindless_supported;
 }
 
 bool VulkanUtils::check_device_extension_support(VkPhysicalDevice device) {
@@ -418,6 +466,24 @@ bool VulkanUtils::check_device_extension_support(VkPhysicalDevice device) {
     return required_extensions.empty();
 }
 
+bool VulkanUtils::is_device_extension_supported(VkPhysicalDevice device,
+                                                const char* extension_name) {
+    uint32_t extension_count;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count,
+                                         nullptr);
+
+    std::vector<VkExtensionProperties> available_extensions(extension_count);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count,
+                                         available_extensions.data());
+
+    for (const auto& extension : available_extensions) {
+        if (strcmp(extension.extensionName, extension_name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 QueueFamilyIndices VulkanUtils::find_queue_families(VkPhysicalDevice device,
                                                     VkSurfaceKHR surface) {
     QueueFamilyIndices indices;
@@ -430,6 +496,18 @@ QueueFamilyIndices VulkanUtils::find_queue_families(VkPhysicalDevice device,
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count,
                                              queue_families.data());
 
+    // Prefer a family without compute too, it's more likely to be a DMA
+    // engine
+    for (uint32_t family = 0; family < queue_family_count; family++) {
+        VkQueueFlags flags = queue_families[family].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) &&
+            !(flags & VK_QUEUE_GRAPHICS_BIT) &&
+            (!indices.transfer_family.has_value() ||
+             !(flags & VK_QUEUE_COMPUTE_BIT))) {
+            indices.transfer_family = family;
+        }
+    }
+
     int i = 0;
     for (const auto& queue_family : queue_families) {
         if (queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
@@ -737,6 +815,27 @@ uint32_t VulkanUtils::find_memory_type(uint32_t type_filter,
     return 0;
 }
 
+VkMemoryPropertyFlags VulkanUtils::get_host_write_memory_properties(
+    VkPhysicalDevice physical_device) {
+    constexpr VkMemoryPropertyFlags device_local_host_visible =
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    VkPhysicalDeviceMemoryProperties mem_properties;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
+
+    for (uint32_t i = 0; i < mem_properties.memoryTypeCount; i++) {
+        if ((mem_properties.memoryTypes[i].propertyFlags &
+             device_local_host_visible) == device_local_host_visible) {
+            return device_local_host_visible;
+        }
+    }
+
+    return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
 void VulkanUtils::cmd_begin_rendering_khr(VkInstance instance,
                                           VkCommandBuffer command_buffer,
                                           VkRenderingInfoKHR* render_info) {
@@ -27,6 +27,8 @@ struct SwapchainSupportDetails {
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphics_family;
     std::optional<uint32_t> present_family;
+    // A family for transfers only, if the device has one
+    std::optional<uint32_t> transfer_family;
 
     bool is_complete() {
         return graphics_family.has_value() && present_family.has_value();
@@ -61,7 +63,8 @@ class VulkanUtils {
                                       VkSurfaceKHR surface,
                                       VkPhysicalDevice physical_device,
                                       VkDevice& device, VkQueue& graphics_queue,
-                                      VkQueue& present_queue);
+                                      VkQueue& present_queue,
+                                      VkQueue& transfer_queue);
     static void create_command_pool(VkDevice device,
                                     VkPhysicalDevice physical_device,
                                     VkSurfaceKHR surface,
@@ -107,6 +110,14 @@ class VulkanUtils {
                                      VkMemoryPropertyFlags properties,
                                      VkPhysicalDevice physical_device);
 
+    /**
+     * \brief get the memory properties to use for buffers that are written by
+     * the CPU every frame. Device local memory is used if it is host visible
+     * (e.g. resizable BAR), otherwise normal host memory is used.
+     */
+    static VkMemoryPropertyFlags
+    get_host_write_memory_properties(VkPhysicalDevice physical_device);
+
     static std::vector<const char*>
     get_required_extensions(bool use_validation_layers);
     static bool check_validation_layer_support();
@@ -118,6 +129,9 @@ class VulkanUtils {
     static bool is_device_suitable(VkPhysicalDevice device,
                                    VkSurfaceKHR surface);
     static bool check_device_extension_support(VkPhysicalDevice device);
+    // For the optional extensions
+    static bool is_device_extension_supported(VkPhysicalDevice device,
+                                              const char* extension_name);
 
     static void
     setup_debug_messenger(VkInstance instance,
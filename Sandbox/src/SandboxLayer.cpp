@@ -161,6 +161,30 @@ void ShowMeshPickerModal() {
 void SandboxLayer::on_imgui_render() {
     ImGui::Begin("Stats");
     ImGui::Text("FPS: %d", m_current_fps);
+
+    auto heaps = Application::get()
+                     .get_vulkan_manager()
+                     ->get_memory_allocator()
+                     .get_heap_statistics();
+    for (size_t i = 0; i < heaps.size(); i++) {
+        const auto& heap = heaps[i];
+        if (heap.reserved_bytes == 0) {
+            continue;
+        }
+        constexpr float k_mb = 1024.0f * 1024.0f;
+        ImGui::Text("Heap %zu: %.1f / %.1f MB, %u blocks, %u dedicated", i,
+                    heap.used_bytes / k_mb, heap.reserved_bytes / k_mb,
+                    heap.block_count, heap.dedicated_count);
+        ImGui::Text("  Usage: %.1f / %.1f MB budget", heap.usage / k_mb,
+                    heap.budget / k_mb);
+    }
+
+    auto streaming = Application::get().get_texture_streamer().get_statistics();
+    ImGui::Text("Streamed textures: %u, %.1f / %.1f MB, %u loading",
+                streaming.texture_count,
+                streaming.resident_bytes / (1024.0f * 1024.0f),
+                streaming.budget / (1024.0f * 1024.0f),
+                streaming.pending_loads);
     ImGui::End();
 
     ImGui::Begin("Props");
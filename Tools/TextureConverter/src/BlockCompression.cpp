@@ -0,0 +1,264 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace TextureConverter {
+namespace {
+// The corners of the texels' bounding box, with the channels that decrease
+// along the main one swapped, so the endpoints follow the texels' trend
+void find_endpoints(const TexelBlock4x4& texels, uint32_t channels,
+                    int* min, int* max) {
+    int mean[4] = {};
+    for (uint32_t c = 0; c < channels; c++) {
+        min[c] = 255;
+        max[c] = 0;
+        for (const auto& texel : texels) {
+            min[c] = std::min<int>(min[c], texel[c]);
+            max[c] = std::max<int>(max[c], texel[c]);
+            mean[c] += texel[c];
+        }
+        mean[c] /= 16;
+    }
+
+    uint32_t main = 0;
+    for (uint32_t c = 1; c < channels; c++) {
+        if (max[c] - min[c] > max[main] - min[main]) {
+            main = c;
+        }
+    }
+    for (uint32_t c = 0; c < channels; c++) {
+        int covariance = 0;
+        for (const auto& texel : texels) {
+            covariance += (texel[c] - mean[c]) * (texel[main] - mean[main]);
+        }
+        if (covariance < 0) {
+            std::swap(min[c], max[c]);
+        }
+    }
+}
+
+int squared_distance(const uint8_t* texel, const int* color,
+                     uint32_t channels) {
+    int distance = 0;
+    for (uint32_t c = 0; c < channels; c++) {
+        int d = texel[c] - color[c];
+        distance += d * d;
+    }
+    return distance;
+}
+
+uint16_t to_565(const int* color) {
+    return static_cast<uint16_t>((color[0] * 31 + 127) / 255 << 11 |
+                                 (color[1] * 63 + 127) / 255 << 5 |
+                                 (color[2] * 31 + 127) / 255);
+}
+
+void from_565(uint16_t value, int* color) {
+    int r = value >> 11;
+    int g = (value >> 5) & 63;
+    int b = value & 31;
+    color[0] = r << 3 | r >> 2;
+    color[1] = g << 2 | g >> 4;
+    color[2] = b << 3 | b >> 2;
+}
+
+// The color half of BC1 and BC3, always in the 4 color mode
+void encode_color(const TexelBlock4x4& texels, uint8_t* block) {
+    int min[4];
+    int max[4];
+    find_endpoints(texels, 3, min, max);
+
+    uint16_t color0 = to_565(max);
+    uint16_t color1 = to_565(min);
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        int palette[4][4];
+        from_565(color0, palette[0]);
+        from_565(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (uint32_t i = 0; i < 16; i++) {
+            uint32_t best = 0;
+            int best_distance = squared_distance(texels[i], palette[0], 3);
+            for (uint32_t p = 1; p < 4; p++) {
+                int distance = squared_distance(texels[i], palette[p], 3);
+                if (distance < best_distance) {
+                    best = p;
+                    best_distance = distance;
+                }
+            }
+            indices |= best << (2 * i);
+        }
+    }
+
+    block[0] = color0 & 0xFF;
+    block[1] = color0 >> 8;
+    block[2] = color1 & 0xFF;
+    block[3] = color1 >> 8;
+    memcpy(block + 4, &indices, 4);
+}
+
+// A BC4 block of one channel, in the 8 value mode
+void encode_channel(const TexelBlock4x4& texels, uint32_t channel,
+                    uint8_t* block) {
+    int value0 = 0;
+    int value1 = 255;
+    for (const auto& texel : texels) {
+        value0 = std::max<int>(value0, texel[channel]);
+        value1 = std::min<int>(value1, texel[channel]);
+    }
+
+    uint64_t indices = 0;
+    if (value0 != value1) {
+        int palette[8] = {value0, value1};
+        for (int i = 1; i < 7; i++) {
+            palette[i + 1] = ((7 - i) * value0 + i * value1) / 7;
+        }
+
+        for (uint32_t i = 0; i < 16; i++) {
+            uint64_t best = 0;
+            int best_distance = 256;
+            for (uint32_t p = 0; p < 8; p++) {
+                int distance = std::abs(texels[i][channel] - palette[p]);
+                if (distance < best_distance) {
+                    best = p;
+                    best_distance = distance;
+                }
+            }
+            indices |= best << (3 * i);
+        }
+    }
+
+    block[0] = static_cast<uint8_t>(value0);
+    block[1] = static_cast<uint8_t>(value1);
+    for (int i = 0; i < 6; i++) {
+        block[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+    }
+}
+
+// Writes the bits of a block from the least significant one
+class BitWriter {
+  public:
+    explicit BitWriter(uint8_t* block) : m_block(block) {
+        memset(m_block, 0, 16);
+    }
+
+    void write(uint32_t value, uint32_t bits) {
+        for (uint32_t i = 0; i < bits; i++, m_position++) {
+            if (value >> i & 1) {
+                m_block[m_position / 8] |= 1 << (m_position % 8);
+            }
+        }
+    }
+
+  private:
+    uint8_t* m_block;
+    uint32_t m_position = 0;
+};
+
+constexpr int k_bc7_weights[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                                   34, 38, 43, 47, 51, 55, 60, 64};
+
+// A mode 6 endpoint, 7 bits per channel and a shared lowest bit
+struct Bc7Endpoint {
+    int color[4];
+    uint32_t p;
+};
+
+Bc7Endpoint quantize_bc7(const int* color) {
+    Bc7Endpoint best{};
+    int best_error = -1;
+    for (uint32_t p = 0; p < 2; p++) {
+        Bc7Endpoint endpoint{.color = {}, .p = p};
+        int error = 0;
+        for (int c = 0; c < 4; c++) {
+            endpoint.color[c] =
+                std::clamp((color[c] - static_cast<int>(p) + 1) / 2, 0, 127);
+            int d = (endpoint.color[c] << 1 | static_cast<int>(p)) - color[c];
+            error += d * d;
+        }
+        if (best_error < 0 || error < best_error) {
+            best = endpoint;
+            best_error = error;
+        }
+    }
+    return best;
+}
+} // namespace
+
+void encode_bc1(const TexelBlock4x4& texels, uint8_t* block) {
+    encode_color(texels, block);
+}
+
+void encode_bc3(const TexelBlock4x4& texels, uint8_t* block) {
+    encode_channel(texels, 3, block);
+    encode_color(texels, block + 8);
+}
+
+void encode_bc5(const TexelBlock4x4& texels, uint8_t* block) {
+    encode_channel(texels, 0, block);
+    encode_channel(texels, 1, block + 8);
+}
+
+void encode_bc7(const TexelBlock4x4& texels, uint8_t* block) {
+    int min[4];
+    int max[4];
+    find_endpoints(texels, 4, min, max);
+    Bc7Endpoint endpoints[2] = {quantize_bc7(min), quantize_bc7(max)};
+
+    int palette[16][4];
+    for (int c = 0; c < 4; c++) {
+        int value0 = endpoints[0].color[c] << 1 | endpoints[0].p;
+        int value1 = endpoints[1].color[c] << 1 | endpoints[1].p;
+        for (int i = 0; i < 16; i++) {
+            palette[i][c] = ((64 - k_bc7_weights[i]) * value0 +
+                             k_bc7_weights[i] * value1 + 32) >>
+                            6;
+        }
+    }
+
+    uint32_t indices[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        indices[i] = 0;
+        int best_distance = squared_distance(texels[i], palette[0], 4);
+        for (uint32_t p = 1; p < 16; p++) {
+            int distance = squared_distance(texels[i], palette[p], 4);
+            if (distance < best_distance) {
+                indices[i] = p;
+                best_distance = distance;
+            }
+        }
+    }
+
+    // The first index's highest bit is implied 0, swap the endpoints if
+    // it's set
+    if (indices[0] >= 8) {
+        std::swap(endpoints[0], endpoints[1]);
+        for (uint32_t& index : indices) {
+            index = 15 - index;
+        }
+    }
+
+    BitWriter writer(block);
+    writer.write(1 << 6, 7); // Mode 6
+    for (int c = 0; c < 4; c++) {
+        writer.write(endpoints[0].color[c], 7);
+        writer.write(endpoints[1].color[c], 7);
+    }
+    writer.write(endpoints[0].p, 1);
+    writer.write(endpoints[1].p, 1);
+    writer.write(indices[0], 3);
+    for (uint32_t i = 1; i < 16; i++) {
+        writer.write(indices[i], 4);
+    }
+}
+} // namespace TextureConverter
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+
+namespace TextureConverter {
+// A 4x4 block of RGBA8 texels, row by row
+using TexelBlock4x4 = uint8_t[16][4];
+
+/**
+ * \brief Encode a BC1 block, without alpha. The endpoints are the corners of
+ * the texels' bounding box, along their main diagonal.
+ */
+void encode_bc1(const TexelBlock4x4& texels, uint8_t* block);
+
+/**
+ * \brief Encode a BC3 block, the BC1 color and a BC4 alpha block.
+ */
+void encode_bc3(const TexelBlock4x4& texels, uint8_t* block);
+
+/**
+ * \brief Encode a BC5 block from the red and green channels, e.g. of a
+ * normal map.
+ */
+void encode_bc5(const TexelBlock4x4& texels, uint8_t* block);
+
+/**
+ * \brief Encode a BC7 block, in mode 6 only (one RGBA subset with 4 bit
+ * indices). It's fast, and close to the other modes on most textures.
+ */
+void encode_bc7(const TexelBlock4x4& texels, uint8_t* block);
+} // namespace TextureConverter
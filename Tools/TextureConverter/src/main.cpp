@@ -0,0 +1,202 @@
+// Converts PNG, JPG (and the other formats stb_image reads) to block
+// compressed KTX2 textures with their mip levels, which the engine uploads
+// without decoding them.
+//
+// Usage: TextureConverter <input> <output.ktx2>
+//            [--format bc1|bc3|bc5|bc7|rgba8] [--linear] [--no-mips]
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "BlockCompression.h"
+#include "Helios/Renderer/Ktx2.h"
+
+using namespace TextureConverter;
+
+namespace {
+struct Options {
+    std::string input;
+    std::string output;
+    std::string format = "bc7";
+    // The texels aren't colors, e.g. a normal map
+    bool linear = false;
+    bool mips = true;
+};
+
+struct Level {
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> texels; // RGBA8
+};
+
+float srgb_to_linear(uint8_t value) {
+    float v = value / 255.0f;
+    return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+}
+
+uint8_t linear_to_srgb(float value) {
+    float v = value <= 0.0031308f
+                  ? value * 12.92f
+                  : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    return static_cast<uint8_t>(std::clamp(v * 255.0f + 0.5f, 0.0f, 255.0f));
+}
+
+// Average 2x2 texels, in linear space for colors. A dimension of 1 stays 1.
+Level downsample(const Level& level, bool linear) {
+    Level next{std::max(level.width / 2, 1u), std::max(level.height / 2, 1u),
+               {}};
+    next.texels.resize(next.width * next.height * 4);
+
+    for (uint32_t y = 0; y < next.height; y++) {
+        for (uint32_t x = 0; x < next.width; x++) {
+            for (uint32_t c = 0; c < 4; c++) {
+                bool srgb = !linear && c < 3;
+                float sum = 0.0f;
+                for (uint32_t i = 0; i < 4; i++) {
+                    uint32_t sx = std::min(x * 2 + i % 2, level.width - 1);
+                    uint32_t sy = std::min(y * 2 + i / 2, level.height - 1);
+                    uint8_t value =
+                        level.texels[(sy * level.width + sx) * 4 + c];
+                    sum += srgb ? srgb_to_linear(value) : value / 255.0f;
+                }
+                float average = sum / 4.0f;
+                next.texels[(y * next.width + x) * 4 + c] =
+                    srgb ? linear_to_srgb(average)
+                         : static_cast<uint8_t>(average * 255.0f + 0.5f);
+            }
+        }
+    }
+    return next;
+}
+
+// Encode a level block by block, the edge texels fill the partial blocks
+std::vector<uint8_t> encode(const Level& level, const std::string& format) {
+    if (format == "rgba8") {
+        return level.texels;
+    }
+
+    uint32_t block_size = format == "bc1" ? 8 : 16;
+    uint32_t blocks_x = (level.width + 3) / 4;
+    uint32_t blocks_y = (level.height + 3) / 4;
+    std::vector<uint8_t> data(blocks_x * blocks_y * block_size);
+
+    for (uint32_t by = 0; by < blocks_y; by++) {
+        for (uint32_t bx = 0; bx < blocks_x; bx++) {
+            TexelBlock4x4 texels;
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t x = std::min(bx * 4 + i % 4, level.width - 1);
+                uint32_t y = std::min(by * 4 + i / 4, level.height - 1);
+                memcpy(texels[i], &level.texels[(y * level.width + x) * 4], 4);
+            }
+
+            uint8_t* block = &data[(by * blocks_x + bx) * block_size];
+            if (format == "bc1") {
+                encode_bc1(texels, block);
+            } else if (format == "bc3") {
+                encode_bc3(texels, block);
+            } else if (format == "bc5") {
+                encode_bc5(texels, block);
+            } else {
+                encode_bc7(texels, block);
+            }
+        }
+    }
+    return data;
+}
+
+VkFormat get_vk_format(const std::string& format, bool linear) {
+    if (format == "bc1") {
+        return linear ? VK_FORMAT_BC1_RGB_UNORM_BLOCK
+                      : VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+    }
+    if (format == "bc3") {
+        return linear ? VK_FORMAT_BC3_UNORM_BLOCK : VK_FORMAT_BC3_SRGB_BLOCK;
+    }
+    if (format == "bc5") {
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    }
+    if (format == "bc7") {
+        return linear ? VK_FORMAT_BC7_UNORM_BLOCK : VK_FORMAT_BC7_SRGB_BLOCK;
+    }
+    if (format == "rgba8") {
+        return linear ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R8G8B8A8_SRGB;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+bool parse_options(int argc, char** argv, Options& options) {
+    if (argc < 3) {
+        return false;
+    }
+    options.input = argv[1];
+    options.output = argv[2];
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc) {
+            options.format = argv[++i];
+        } else if (arg == "--linear") {
+            options.linear = true;
+        } else if (arg == "--no-mips") {
+            options.mips = false;
+        } else {
+            return false;
+        }
+    }
+    return get_vk_format(options.format, options.linear) !=
+           VK_FORMAT_UNDEFINED;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "Usage: TextureConverter <input> <output.ktx2> [--format "
+                     "bc1|bc3|bc5|bc7|rgba8] [--linear] [--no-mips]\n";
+        return 1;
+    }
+
+    // The engine flips the images it decodes, so the cooked ones are too
+    stbi_set_flip_vertically_on_load(true);
+    int width, height, channels;
+    stbi_uc* pixels = stbi_load(options.input.c_str(), &width, &height,
+                                &channels, STBI_rgb_alpha);
+    if (!pixels) {
+        std::cerr << "Failed to load " << options.input << ": "
+                  << stbi_failure_reason() << "\n";
+        return 1;
+    }
+
+    Level level{static_cast<uint32_t>(width), static_cast<uint32_t>(height),
+                {}};
+    level.texels.assign(pixels, pixels + width * height * 4);
+    stbi_image_free(pixels);
+
+    Helios::Ktx2Texture texture;
+    texture.format = get_vk_format(options.format, options.linear);
+    texture.width = level.width;
+    texture.height = level.height;
+    while (true) {
+        texture.levels.push_back(encode(level, options.format));
+        if (!options.mips || (level.width == 1 && level.height == 1)) {
+            break;
+        }
+        level = downsample(level, options.linear);
+    }
+
+    std::string error;
+    if (!Helios::write_ktx2(options.output, texture, error)) {
+        std::cerr << "Failed to write " << options.output << ": " << error
+                  << "\n";
+        return 1;
+    }
+    std::cout << options.input << " -> " << options.output << " ("
+              << texture.levels.size() << " levels)\n";
+    return 0;
+}
@@ -16,7 +16,7 @@ layout(location = 0) in VertexInput {
 } v_in;
 
 layout(set = 1, binding = 0) uniform sampler u_samp;
-layout (set = 1, binding = 1) uniform texture2D u_textures[32];
+layout (set = 1, binding = 1) uniform texture2D u_textures[];
 
 layout (push_constant) uniform PushConstants {
 	float time;
@@ -1,19 +1,18 @@
 #version 450
 
-// Per vertex data
+// Per vertex data, see PackedMeshVertex. The position is in the mesh's
+// quantization box, which the instance's scale and position map back.
 layout (location = 0) in vec3 iv_position;
-layout (location = 1) in vec3 iv_normal;
+layout (location = 1) in vec2 iv_normal; // Octahedral encoded
 layout (location = 2) in vec2 iv_tex_coord;
 
-// Per instance data
-layout(location = 3) in mat4 ii_model;
-
-layout(location = 7) in int ii_diffuse_index;
-layout(location = 8) in int ii_specular_index;
-layout(location = 9) in int ii_emission_index;
-layout(location = 10) in float ii_shininess;
-
-layout(location = 11) in vec4 ii_tint_color;
+// Per instance data, see MeshRenderingShaderInstanceData
+layout(location = 3) in vec3 ii_position;
+layout(location = 4) in float ii_shininess;
+layout(location = 5) in vec3 ii_scale;
+layout(location = 6) in vec4 ii_tint_color;
+layout(location = 7) in vec4 ii_rotation; // Quaternion, xyzw
+layout(location = 8) in uvec4 ii_texture_indices; // Diffuse, specular, emission, their samplers
 
 layout (location = 0) out vec2 o_frag_tex_coord;
 
@@ -26,8 +25,15 @@ layout(set = 0, binding = 0) uniform CameraUniform {
 	mat4 orthographic_proj;
 } u_camera;
 
+// Rotate a vector by a unit quaternion
+vec3 rotate(vec4 q, vec3 v) {
+  vec3 t = 2.0 * cross(q.xyz, v);
+  return v + q.w * t + cross(q.xyz, t);
+}
+
 void main() {
-  gl_Position = u_camera.perspective_view_proj * ii_model * vec4(iv_position, 1.0);
+  vec3 world_pos = ii_position + rotate(normalize(ii_rotation), ii_scale * iv_position);
+  gl_Position = u_camera.perspective_view_proj * vec4(world_pos, 1.0);
 
   o_frag_tex_coord = iv_tex_coord;
 }
@@ -10,7 +10,7 @@ layout (location = 0) out vec4 out_color;
 layout (location = 0) in vec2 v_frag_tex_coord;
 
 layout(set = 1, binding = 0) uniform sampler u_samp;
-layout (set = 1, binding = 1) uniform texture2D u_textures[1000];
+layout (set = 1, binding = 1) uniform texture2D u_textures[];
 
 layout (push_constant) uniform PushConstants {
 	float time;
@@ -0,0 +1,15 @@
+@echo off
+set CC=cl
+set CXX=cl
+set CXXFLAGS=/std:c++23
+
+echo "Building TextureConverter..."
+
+cmake -DCMAKE_C_COMPILER=%CC% -DCMAKE_CXX_COMPILER=%CXX% -DCMAKE_CXX_FLAGS=%CXXFLAGS% -DCMAKE_POLICY_DEFAULT_CMP0091=NEW -DCMAKE_BUILD_TYPE=Debug -DCMAKE_EXPORT_COMPILE_COMMANDS=ON .. -B ..\build
+
+cmake --build ..\build --config Debug --target TextureConverter --parallel 14
+
+if NOT ["%errorlevel%"]==["0"] (
+    pause
+    exit /b %errorlevel%
+)
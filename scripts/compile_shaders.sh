@@ -12,7 +12,7 @@ NC='\033[0m'
 function compile_shaders {
   cd "$base_dir"
   current_dir=""
-  for file in "$1"/**/*.{vert,frag}; do
+  for file in "$1"/**/*.{vert,frag,comp}; do
       if [ -f "$file" ]; then
           # Get the directory the file is in
           dir=$(dirname "$file")